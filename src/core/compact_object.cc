@@ -17,8 +17,11 @@ extern "C" {
 #include "redis/zmalloc.h"  // for non-string objects.
 #include "redis/zset.h"
 }
+#include <absl/strings/ascii.h>
+#include <absl/strings/numbers.h>
 #include <absl/strings/str_cat.h>
 #include <absl/strings/strip.h>
+#include <double-conversion/double-to-string.h>
 
 #include <jsoncons/json.hpp>
 
@@ -27,6 +30,7 @@ extern "C" {
 #include "base/pod_array.h"
 #include "core/bloom.h"
 #include "core/detail/bitpacking.h"
+#include "core/dict_compressor.h"
 #include "core/sorted_map.h"
 #include "core/string_map.h"
 #include "core/string_set.h"
@@ -204,6 +208,8 @@ struct TL {
   size_t small_str_bytes;
   base::PODArray<uint8_t> tmp_buf;
   string tmp_str;
+  DictCompressor* dict_compressor = nullptr;
+  string compress_buf;
 };
 
 thread_local TL tl;
@@ -214,6 +220,95 @@ constexpr bool kUseSmallStrings = true;
 /// file and implement with SIMD instructions.
 constexpr bool kUseAsciiEncoding = true;
 
+using double_conversion::DoubleToStringConverter;
+
+// Same settings as RedisReplyBuilder::FormatDouble, so that values set by INCRBYFLOAT read back
+// exactly as they were replied.
+constexpr unsigned kDoubleConvFlags =
+    DoubleToStringConverter::UNIQUE_ZERO | DoubleToStringConverter::EMIT_POSITIVE_EXPONENT_SIGN;
+
+const DoubleToStringConverter double_conv(kDoubleConvFlags, "inf", "nan", 'e', -6, 21, 6, 0);
+
+// Length of the longest formatted double, i.e. "-2.2250738585072014e-308".
+constexpr size_t kMaxDoubleLen = 24;
+
+struct DoubleBuf {
+  char data[32];
+};
+
+string_view FormatDouble(double val, DoubleBuf* buf) {
+  double_conversion::StringBuilder sb(buf->data, sizeof(buf->data));
+  double_conv.ToShortest(val, &sb);
+  size_t len = sb.position();
+  sb.Finalize();
+  return string_view{buf->data, len};
+}
+
+// Parses str only if it's exactly the formatting of the parsed value, so that it can be restored
+// from the double.
+bool ParseDoubleExact(string_view str, double* val) {
+  if (str.empty() || str.size() > kMaxDoubleLen || (str[0] != '-' && !absl::ascii_isdigit(str[0])))
+    return false;
+
+  if (!absl::SimpleAtod(str, val) || !isfinite(*val))
+    return false;
+
+  DoubleBuf buf;
+  return FormatDouble(*val, &buf) == str;
+}
+
+// NUMSTR_TAG strings are packed into nibbles, two symbols per byte, the first one in the low
+// nibble. Strings shorter than kMaxNumStrLen are terminated with kNumStrEnd.
+constexpr char kNumStrAlphabet[] = "0123456789 +-.:";
+constexpr uint8_t kNumStrEnd = 15;
+constexpr size_t kMaxNumStrLen = CompactObj::InlineLen() * 2;
+
+static_assert(sizeof(kNumStrAlphabet) - 1 == kNumStrEnd);
+
+// Returns the nibble of c or kNumStrEnd if c is not in kNumStrAlphabet.
+uint8_t NumStrNibble(char c) {
+  if (absl::ascii_isdigit(c))
+    return c - '0';
+  const char* pos = static_cast<const char*>(memchr(kNumStrAlphabet + 10, c, kNumStrEnd - 10));
+  return pos ? pos - kNumStrAlphabet : kNumStrEnd;
+}
+
+// Packs str into dest of kMaxNumStrLen / 2 zeroed bytes. Returns false if str can't be packed.
+bool PackNumStr(string_view str, uint8_t* dest) {
+  if (str.size() > kMaxNumStrLen)
+    return false;
+
+  for (size_t i = 0; i < str.size(); ++i) {
+    uint8_t nibble = NumStrNibble(str[i]);
+    if (nibble == kNumStrEnd)
+      return false;
+    dest[i / 2] |= nibble << (i % 2 * 4);
+  }
+
+  if (str.size() < kMaxNumStrLen)
+    dest[str.size() / 2] |= kNumStrEnd << (str.size() % 2 * 4);
+  return true;
+}
+
+inline uint8_t NumStrAt(const uint8_t* src, size_t i) {
+  return (src[i / 2] >> (i % 2 * 4)) & 0xF;
+}
+
+size_t NumStrLen(const uint8_t* src) {
+  size_t len = 0;
+  while (len < kMaxNumStrLen && NumStrAt(src, len) != kNumStrEnd)
+    ++len;
+  return len;
+}
+
+// dest must have at least kMaxNumStrLen bytes available. Returns the length of the string.
+size_t UnpackNumStr(const uint8_t* src, char* dest) {
+  size_t len = NumStrLen(src);
+  for (size_t i = 0; i < len; ++i)
+    dest[i] = kNumStrAlphabet[NumStrAt(src, i)];
+  return len;
+}
+
 }  // namespace
 
 static_assert(sizeof(CompactObj) == 18);
@@ -534,6 +629,10 @@ void CompactObj::InitThreadLocal(MemoryResource* mr) {
   tl.tmp_buf = base::PODArray<uint8_t>{mr};
 }
 
+void CompactObj::InitDictCompressor(DictCompressor* compressor) {
+  tl.dict_compressor = compressor;
+}
+
 CompactObj::~CompactObj() {
   if (HasAllocated()) {
     Free();
@@ -568,6 +667,17 @@ size_t CompactObj::Size() const {
         raw_size = an.size();
         break;
       }
+      case DOUBLE_TAG: {
+        DoubleBuf buf;
+        raw_size = FormatDouble(u_.dval, &buf).size();
+        break;
+      }
+      case NUMSTR_TAG:
+        raw_size = NumStrLen(to_byte(u_.inline_str));
+        break;
+      case COMPRESSED_TAG:
+        raw_size = u_.compressed.size;
+        break;
       case EXTERNAL_TAG:
         raw_size = u_.ext_ptr.size;
         break;
@@ -610,6 +720,19 @@ uint64_t CompactObj::HashCode() const {
       absl::AlphaNum an(u_.ival);
       return XXH3_64bits_withSeed(an.data(), an.size(), kHashSeed);
     }
+    case DOUBLE_TAG: {
+      DoubleBuf buf;
+      string_view str = FormatDouble(u_.dval, &buf);
+      return XXH3_64bits_withSeed(str.data(), str.size(), kHashSeed);
+    }
+    case NUMSTR_TAG: {
+      char buf[kMaxNumStrLen];
+      size_t len = UnpackNumStr(to_byte(u_.inline_str), buf);
+      return XXH3_64bits_withSeed(buf, len, kHashSeed);
+    }
+    case COMPRESSED_TAG:
+      GetString(&tl.tmp_str);
+      return XXH3_64bits_withSeed(tl.tmp_str.data(), tl.tmp_str.size(), kHashSeed);
   }
   // We need hash only for keys.
   LOG(DFATAL) << "Should not reach " << int(taglen_);
@@ -622,9 +745,13 @@ uint64_t CompactObj::HashCode(string_view str) {
 }
 
 unsigned CompactObj::ObjType() const {
-  if (IsInline() || taglen_ == INT_TAG || taglen_ == SMALL_TAG || taglen_ == EXTERNAL_TAG)
+  if (IsInline() || taglen_ == INT_TAG || taglen_ == SMALL_TAG || taglen_ == DOUBLE_TAG ||
+      taglen_ == NUMSTR_TAG || taglen_ == COMPRESSED_TAG)
     return OBJ_STRING;
 
+  if (taglen_ == EXTERNAL_TAG)
+    return u_.ext_ptr.type;
+
   if (taglen_ == ROBJ_TAG)
     return u_.r_obj.type();
 
@@ -669,6 +796,8 @@ unsigned CompactObj::Encoding() const {
       return u_.r_obj.encoding();
     case INT_TAG:
       return OBJ_ENCODING_INT;
+    case EXTERNAL_TAG:
+      return u_.ext_ptr.encoding;
     default:
       return OBJ_ENCODING_RAW;
   }
@@ -695,6 +824,38 @@ std::optional<int64_t> CompactObj::TryGetInt() const {
   return val;
 }
 
+void CompactObj::SetDouble(double val) {
+  // Doubles below 2^53 are integral exactly when their formatting is, larger ones may still be
+  // formatted without exponent and fraction.
+  if (std::trunc(val) == val && std::abs(val) < 1e21) {
+    if (std::abs(val) < double(1LL << 53)) {
+      SetInt(int64_t(val));
+      return;
+    }
+
+    DoubleBuf buf;
+    string_view str = FormatDouble(val, &buf);
+    long long ival;
+    if (string2ll(str.data(), str.size(), &ival)) {
+      SetInt(ival);
+      return;
+    }
+  }
+
+  if (DOUBLE_TAG != taglen_) {
+    SetMeta(DOUBLE_TAG, mask_ & ~kEncMask);
+  }
+
+  u_.dval = val;
+}
+
+std::optional<double> CompactObj::TryGetDouble() const {
+  if (taglen_ != DOUBLE_TAG)
+    return std::nullopt;
+  double val = u_.dval;
+  return val;
+}
+
 auto CompactObj::GetJson() const -> JsonType* {
   if (ObjType() == OBJ_JSON) {
     DCHECK_EQ(u_.json_obj.encoding, kEncodingJsonCons);
@@ -763,6 +924,23 @@ void CompactObj::SetString(std::string_view str) {
 
   DCHECK_GT(str.size(), kInlineLen);
 
+  // Numeric strings that don't fit inline as they are, i.e. float gauges and long counters.
+  if (str.size() <= kMaxNumStrLen) {
+    double dval;
+    if (ParseDoubleExact(str, &dval)) {
+      SetMeta(DOUBLE_TAG, mask);
+      u_.dval = dval;
+      return;
+    }
+
+    uint8_t packed[kInlineLen] = {0};
+    if (PackNumStr(str, packed)) {
+      SetMeta(NUMSTR_TAG, mask);
+      memcpy(u_.inline_str, packed, kInlineLen);
+      return;
+    }
+  }
+
   string_view encoded = str;
   bool is_ascii = kUseAsciiEncoding && detail::validate_ascii_fast(str.data(), str.size());
 
@@ -809,6 +987,33 @@ void CompactObj::SetString(std::string_view str) {
   u_.r_obj.SetString(encoded, tl.local_mr);
 }
 
+void CompactObj::SetCompressibleString(std::string_view str) {
+  CHECK(!IsExternal());
+  string_view blob;
+  if (tl.dict_compressor)
+    blob = tl.dict_compressor->Compress(str, &tl.compress_buf);
+
+  if (blob.empty()) {
+    SetString(str);
+    return;
+  }
+
+  SetMeta(COMPRESSED_TAG, mask_ & ~kEncMask);
+  u_.compressed.blob = static_cast<uint8_t*>(tl.local_mr->allocate(blob.size(), kAlignSize));
+  memcpy(u_.compressed.blob, blob.data(), blob.size());
+  u_.compressed.stored_size = blob.size();
+  u_.compressed.size = str.size();
+}
+
+void CompactObj::Decompress(char* dest) const {
+  DCHECK_EQ(COMPRESSED_TAG, taglen_);
+  CHECK(tl.dict_compressor) << "No dictionary to decompress value";
+
+  string_view blob{reinterpret_cast<const char*>(u_.compressed.blob), u_.compressed.stored_size};
+  bool res = tl.dict_compressor->Decompress(blob, u_.compressed.size, dest);
+  CHECK(res) << "Corrupted compressed value";
+}
+
 string_view CompactObj::GetSlice(string* scratch) const {
   CHECK(!IsExternal());
   uint8_t is_encoded = mask_ & kEncMask;
@@ -836,6 +1041,24 @@ string_view CompactObj::GetSlice(string* scratch) const {
     return *scratch;
   }
 
+  if (taglen_ == DOUBLE_TAG) {
+    DoubleBuf buf;
+    scratch->assign(FormatDouble(u_.dval, &buf));
+    return *scratch;
+  }
+
+  if (taglen_ == NUMSTR_TAG) {
+    scratch->resize(kMaxNumStrLen);
+    scratch->resize(UnpackNumStr(to_byte(u_.inline_str), scratch->data()));
+    return *scratch;
+  }
+
+  if (taglen_ == COMPRESSED_TAG) {
+    scratch->resize(u_.compressed.size);
+    Decompress(scratch->data());
+    return *scratch;
+  }
+
   if (is_encoded) {
     if (taglen_ == ROBJ_TAG) {
       CHECK_EQ(OBJ_STRING, u_.r_obj.type());
@@ -891,8 +1114,20 @@ bool CompactObj::DefragIfNeeded(float ratio) {
     case SMALL_TAG:
       return u_.small_str.DefragIfNeeded(ratio);
     case INT_TAG:
+    case DOUBLE_TAG:
+    case NUMSTR_TAG:
       // this is not relevant in this case
       return false;
+    case COMPRESSED_TAG: {
+      if (!zmalloc_page_is_underutilized(u_.compressed.blob, ratio))
+        return false;
+      size_t size = u_.compressed.stored_size;
+      void* blob = tl.local_mr->allocate(size, kAlignSize);
+      memcpy(blob, u_.compressed.blob, size);
+      tl.local_mr->deallocate(u_.compressed.blob, size, kAlignSize);
+      u_.compressed.blob = static_cast<uint8_t*>(blob);
+      return true;
+    }
     case EXTERNAL_TAG:
       return false;
     default:
@@ -903,10 +1138,12 @@ bool CompactObj::DefragIfNeeded(float ratio) {
 
 bool CompactObj::HasAllocated() const {
   if (IsRef() || taglen_ == INT_TAG || IsInline() || taglen_ == EXTERNAL_TAG ||
+      taglen_ == DOUBLE_TAG || taglen_ == NUMSTR_TAG ||
       (taglen_ == ROBJ_TAG && u_.r_obj.inner_obj() == nullptr))
     return false;
 
-  DCHECK(taglen_ == ROBJ_TAG || taglen_ == SMALL_TAG || taglen_ == JSON_TAG || taglen_ == SBF_TAG);
+  DCHECK(taglen_ == ROBJ_TAG || taglen_ == SMALL_TAG || taglen_ == JSON_TAG || taglen_ == SBF_TAG ||
+         taglen_ == COMPRESSED_TAG);
   return true;
 }
 
@@ -941,6 +1178,25 @@ void CompactObj::GetString(char* dest) const {
     return;
   }
 
+  if (taglen_ == DOUBLE_TAG) {
+    DoubleBuf buf;
+    string_view str = FormatDouble(u_.dval, &buf);
+    memcpy(dest, str.data(), str.size());
+    return;
+  }
+
+  if (taglen_ == NUMSTR_TAG) {
+    char buf[kMaxNumStrLen];
+    size_t len = UnpackNumStr(to_byte(u_.inline_str), buf);
+    memcpy(dest, buf, len);
+    return;
+  }
+
+  if (taglen_ == COMPRESSED_TAG) {
+    Decompress(dest);
+    return;
+  }
+
   if (is_encoded) {
     if (taglen_ == ROBJ_TAG) {
       CHECK_EQ(OBJ_STRING, u_.r_obj.type());
@@ -987,17 +1243,33 @@ void CompactObj::GetString(char* dest) const {
 }
 
 void CompactObj::SetExternal(size_t offset, size_t sz) {
+  SetExternal(offset, sz, 0, sz);
+}
+
+void CompactObj::SetExternal(size_t offset, size_t sz, uint8_t compression, size_t raw_size) {
+  DCHECK_LT(compression, 16u);
+  unsigned type = ObjType();
+  unsigned encoding = type == OBJ_STRING ? OBJ_ENCODING_RAW : Encoding();
   SetMeta(EXTERNAL_TAG, mask_ & ~kEncMask);
 
+  u_.ext_ptr.type = type;
+  u_.ext_ptr.encoding = encoding;
+  u_.ext_ptr.compression = compression;
   u_.ext_ptr.page_index = offset / 4096;
   u_.ext_ptr.page_offset = offset % 4096;
-  u_.ext_ptr.size = sz;
+  u_.ext_ptr.stored_size = sz;
+  u_.ext_ptr.size = raw_size;
 }
 
 std::pair<size_t, size_t> CompactObj::GetExternalSlice() const {
   DCHECK_EQ(EXTERNAL_TAG, taglen_);
   size_t offset = size_t(u_.ext_ptr.page_index) * 4096 + u_.ext_ptr.page_offset;
-  return pair<size_t, size_t>(offset, size_t(u_.ext_ptr.size));
+  return pair<size_t, size_t>(offset, size_t(u_.ext_ptr.stored_size));
+}
+
+uint8_t CompactObj::GetExternalCompression() const {
+  DCHECK_EQ(EXTERNAL_TAG, taglen_);
+  return u_.ext_ptr.compression;
 }
 
 void CompactObj::Reset() {
@@ -1026,6 +1298,8 @@ void CompactObj::Free() {
     }
   } else if (taglen_ == SBF_TAG) {
     DeleteMR<SBF>(u_.sbf);
+  } else if (taglen_ == COMPRESSED_TAG) {
+    tl.local_mr->deallocate(u_.compressed.blob, u_.compressed.stored_size, kAlignSize);
   } else {
     LOG(FATAL) << "Unsupported tag " << int(taglen_);
   }
@@ -1053,6 +1327,10 @@ size_t CompactObj::MallocUsed() const {
   if (taglen_ == SBF_TAG) {
     return u_.sbf->MallocUsed();
   }
+
+  if (taglen_ == COMPRESSED_TAG) {
+    return zmalloc_size(u_.compressed.blob);
+  }
   LOG(DFATAL) << "should not reach";
   return 0;
 }
@@ -1060,6 +1338,22 @@ size_t CompactObj::MallocUsed() const {
 bool CompactObj::operator==(const CompactObj& o) const {
   DCHECK(taglen_ != JSON_TAG && o.taglen_ != JSON_TAG) << "cannot use JSON type to check equal";
 
+  // SetDouble() keeps short values that SetString() would store inline.
+  if ((taglen_ == DOUBLE_TAG) != (o.taglen_ == DOUBLE_TAG)) {
+    DoubleBuf buf;
+    return taglen_ == DOUBLE_TAG ? o == FormatDouble(u_.dval, &buf)
+                                 : *this == FormatDouble(o.u_.dval, &buf);
+  }
+
+  // Compression depends on the dictionary, so compare uncompressed strings.
+  if (taglen_ == COMPRESSED_TAG) {
+    string tmp;
+    return o == GetSlice(&tmp);
+  }
+
+  if (o.taglen_ == COMPRESSED_TAG)
+    return o == *this;
+
   uint8_t m1 = mask_ & kEncMask;
   uint8_t m2 = o.mask_ & kEncMask;
   if (m1 != m2)
@@ -1074,6 +1368,12 @@ bool CompactObj::operator==(const CompactObj& o) const {
   if (taglen_ == INT_TAG)
     return u_.ival == o.u_.ival;
 
+  if (taglen_ == DOUBLE_TAG)
+    return u_.dval == o.u_.dval;
+
+  if (taglen_ == NUMSTR_TAG)
+    return memcmp(u_.inline_str, o.u_.inline_str, kInlineLen) == 0;
+
   if (taglen_ == SMALL_TAG)
     return u_.small_str.Equal(o.u_.small_str);
 
@@ -1088,6 +1388,21 @@ bool CompactObj::EqualNonInline(std::string_view sv) const {
       absl::AlphaNum an(u_.ival);
       return sv == an.Piece();
     }
+    case DOUBLE_TAG: {
+      DoubleBuf buf;
+      return sv == FormatDouble(u_.dval, &buf);
+    }
+    case NUMSTR_TAG: {
+      char buf[kMaxNumStrLen];
+      size_t len = UnpackNumStr(to_byte(u_.inline_str), buf);
+      return sv == string_view{buf, len};
+    }
+    case COMPRESSED_TAG: {
+      if (sv.size() != u_.compressed.size)
+        return false;
+      string tmp;
+      return sv == GetSlice(&tmp);
+    }
 
     case ROBJ_TAG:
       return u_.r_obj.Equal(sv);
@@ -23,6 +23,7 @@ constexpr unsigned kEncodingJsonCons = 0;
 constexpr unsigned kEncodingJsonFlat = 1;
 
 class SBF;
+class DictCompressor;
 
 namespace detail {
 
@@ -107,6 +108,9 @@ class CompactObj {
     EXTERNAL_TAG = 20,
     JSON_TAG = 21,
     SBF_TAG = 22,
+    DOUBLE_TAG = 23,      // string holding the shortest round-trip formatting of a double.
+    NUMSTR_TAG = 24,      // string of digits and a few separators, packed into nibbles.
+    COMPRESSED_TAG = 25,  // string compressed with the thread's DictCompressor.
   };
 
   enum MaskBit {
@@ -284,6 +288,11 @@ class CompactObj {
   void SetInt(int64_t val);
   std::optional<int64_t> TryGetInt() const;
 
+  // For STR object. Stores val formatted the same way as RedisReplyBuilder::FormatDouble.
+  // Integral values are stored with SetInt(), so that INCR and friends keep working on them.
+  void SetDouble(double val);
+  std::optional<double> TryGetDouble() const;
+
   // We temporary expose this function to avoid passing around robj objects.
   detail::RobjWrapper* GetRobjWrapper() {
     return &u_.r_obj;
@@ -297,6 +306,10 @@ class CompactObj {
   void SetString(std::string_view str);
   void GetString(std::string* res) const;
 
+  // Same as SetString, but the value is stored compressed if the thread's DictCompressor accepts
+  // it. Only for values, as keys must be compared and hashed without decompressing them.
+  void SetCompressibleString(std::string_view str);
+
   // Will set this to hold OBJ_JSON, after that it is safe to call GetJson
   // NOTE: in order to avid copy which can be expensive in this case,
   // you need to move an object that created with the function JsonFromString
@@ -322,9 +335,21 @@ class CompactObj {
     return taglen_ == EXTERNAL_TAG;
   }
 
+  // Replaces the value with a reference to its offloaded representation.
+  // Type and encoding of the replaced value are preserved and reported by ObjType() and
+  // Encoding(), so offloaded containers can be restored to their original form.
   void SetExternal(size_t offset, size_t sz);
+
+  // Same as above for blobs stored in compressed form. compression is a non-zero identifier of
+  // the compression method, raw_size is the size of the uncompressed blob reported by Size().
+  void SetExternal(size_t offset, size_t sz, uint8_t compression, size_t raw_size);
+
+  // Returns offset and length of the stored blob
   std::pair<size_t, size_t> GetExternalSlice() const;
 
+  // Returns compression method of the stored blob, 0 if it's not compressed
+  uint8_t GetExternalCompression() const;
+
   // In case this object a single blob, returns number of bytes allocated on heap
   // for that blob. Otherwise returns 0.
   size_t MallocUsed() const;
@@ -349,6 +374,10 @@ class CompactObj {
   static void InitThreadLocal(MemoryResource* mr);
   static MemoryResource* memory_resource();  // thread-local.
 
+  // Compressor used by SetCompressibleString and to decompress values. Must outlive all values
+  // compressed with it. nullptr disables compression.
+  static void InitDictCompressor(DictCompressor* compressor);  // thread-local.
+
   template <typename T>
   inline static constexpr bool IsConstructibleFromMR =
       std::is_constructible_v<T, decltype(memory_resource())>;
@@ -385,6 +414,9 @@ class CompactObj {
 
   bool CmpEncoded(std::string_view sv) const;
 
+  // Requires: taglen_ == COMPRESSED_TAG. dest must have at least Size() bytes available.
+  void Decompress(char* dest) const;
+
   void SetMeta(uint8_t taglen, uint8_t mask = 0) {
     if (HasAllocated()) {
       Free();
@@ -396,12 +428,19 @@ class CompactObj {
   }
 
   struct ExternalPtr {
-    uint32_t type : 8;
-    uint32_t reserved : 24;
+    uint32_t type : 8;          // object type of the offloaded value
+    uint32_t encoding : 8;      // object encoding of the offloaded value
+    uint32_t compression : 4;   // compression method of the stored blob, 0 if uncompressed
+    uint32_t page_offset : 12;  // 0 for multi-page blobs. != 0 for small blobs.
     uint32_t page_index;
-    uint16_t page_offset;  // 0 for multi-page blobs. != 0 for small blobs.
-    uint16_t reserved2;
-    uint32_t size;
+    uint32_t stored_size;  // size of the blob on disk
+    uint32_t size;         // size of the uncompressed blob
+  } __attribute__((packed));
+
+  struct CompressedPtr {
+    uint8_t* blob;
+    uint32_t stored_size;  // size of the compressed blob
+    uint32_t size;         // size of the uncompressed string
   } __attribute__((packed));
 
   struct JsonWrapper {
@@ -415,8 +454,8 @@ class CompactObj {
 
   // My main data structure. Union of representations.
   // RobjWrapper is kInlineLen=16 bytes, so we employ SSO of that size via inline_str.
-  // In case of int values, we waste 8 bytes. I am assuming it's ok and it's not the data type
-  // with biggest memory usage.
+  // In case of int and double values, we waste 8 bytes. I am assuming it's ok and it's not the
+  // data type with biggest memory usage. NUMSTR_TAG strings use all 16 bytes of inline_str.
   union U {
     char inline_str[kInlineLen];
 
@@ -427,7 +466,9 @@ class CompactObj {
     JsonWrapper json_obj __attribute__((packed));
     SBF* sbf __attribute__((packed));
     int64_t ival __attribute__((packed));
+    double dval __attribute__((packed));
     ExternalPtr ext_ptr;
+    CompressedPtr compressed;
 
     U() : r_obj() {
     }
@@ -13,6 +13,7 @@
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "core/detail/bitpacking.h"
+#include "core/dict_compressor.h"
 #include "core/flat_set.h"
 #include "core/mi_memory_resource.h"
 
@@ -281,6 +282,114 @@ TEST_F(CompactObjectTest, Int) {
   EXPECT_TRUE(cobj_.HasExpire());
 }
 
+TEST_F(CompactObjectTest, Double) {
+  string s = "0.30000000000000004";
+  cobj_.SetString(s);
+  EXPECT_EQ(0.1 + 0.2, cobj_.TryGetDouble());
+  EXPECT_EQ(0, cobj_.MallocUsed());
+  EXPECT_EQ(s.size(), cobj_.Size());
+  EXPECT_EQ(s, cobj_.GetSlice(&tmp_));
+  EXPECT_EQ(cobj_, s);
+  EXPECT_EQ(XXH3_64bits_withSeed(s.data(), s.size(), kSeed), cobj_.HashCode());
+  EXPECT_EQ(OBJ_STRING, cobj_.ObjType());
+
+  // Strings that are not formatted exactly as their value are kept as they are.
+  for (string_view str :
+       {"0.300000000000000040", "+0.30000000000000004", "3.0000000000000004e-1"}) {
+    cobj_.SetString(str);
+    EXPECT_FALSE(cobj_.TryGetDouble()) << str;
+    EXPECT_EQ(cobj_, str);
+  }
+
+  cobj_.SetDouble(-1.25e-30);
+  EXPECT_EQ("-1.25e-30", cobj_.GetSlice(&tmp_));
+  EXPECT_EQ(9, cobj_.Size());
+  EXPECT_EQ(cobj_, CompactObj{"-1.25e-30"});
+
+  cobj_.SetDouble(42.0);
+  EXPECT_FALSE(cobj_.TryGetDouble());
+  EXPECT_EQ(42, cobj_.TryGetInt());
+
+  cobj_.SetDouble(1e20);
+  EXPECT_EQ("100000000000000000000", cobj_.GetSlice(&tmp_));
+}
+
+TEST_F(CompactObjectTest, NumStr) {
+  for (string_view s : {"00000000000000012345", "2024-01-01 12:00:00", "+1 415 555 2671 0000",
+                        "99999999999999999999999999999999"}) {
+    cobj_.SetString(s);
+    EXPECT_EQ(0, cobj_.MallocUsed()) << s;
+    EXPECT_EQ(s.size(), cobj_.Size());
+    EXPECT_EQ(s, cobj_.GetSlice(&tmp_));
+    EXPECT_EQ(s, cobj_.ToString());
+    EXPECT_EQ(cobj_, s);
+    EXPECT_NE(cobj_, absl::StrCat(s, "0"));
+    EXPECT_EQ(cobj_, CompactObj{s});
+    EXPECT_EQ(XXH3_64bits_withSeed(s.data(), s.size(), kSeed), cobj_.HashCode());
+  }
+
+  // Too long or with symbols outside of the alphabet.
+  for (string_view s : {"999999999999999999999999999999999", "2024-01-01T12:00:00"}) {
+    cobj_.SetString(s);
+    EXPECT_EQ(s, cobj_.GetSlice(&tmp_));
+    EXPECT_EQ(cobj_, s);
+  }
+}
+
+TEST_F(CompactObjectTest, CompressedString) {
+  // Allocate from mimalloc to check allocated sizes
+  MiMemoryResource mi_resource(mi_heap_get_backing());
+  CompactObj::InitThreadLocal(&mi_resource);
+
+  DictCompressor compressor{4096};
+  CompactObj::InitDictCompressor(&compressor);
+
+  auto make_value = [](unsigned i) {
+    return absl::StrCat(R"({"user_id":)", i, R"(,"preferences":{"theme":"dark","lang":"en-US"},)",
+                        R"("user_agent":"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36"})");
+  };
+
+  // Values are stored as they are until the dictionary is trained in the background
+  unsigned i = 0;
+  for (; compressor.dict().empty(); ++i) {
+    cobj_.SetCompressibleString(make_value(i));
+    EXPECT_EQ(make_value(i), cobj_);
+    util::ThisFiber::Yield();
+  }
+
+  string value = make_value(i);
+  cobj_.SetCompressibleString(value);
+  EXPECT_LT(cobj_.MallocUsed(), value.size() / 2);
+  EXPECT_EQ(value.size(), cobj_.Size());
+  EXPECT_EQ(value, cobj_.GetSlice(&tmp_));
+  EXPECT_EQ(value, cobj_.ToString());
+  EXPECT_EQ(cobj_, value);
+  EXPECT_NE(cobj_, make_value(i + 1));
+  EXPECT_EQ(CompactObj::HashCode(value), cobj_.HashCode());
+  EXPECT_EQ(OBJ_STRING, cobj_.ObjType());
+  EXPECT_EQ(cobj_, CompactObj{value});
+
+  CompactObj other;
+  other.SetCompressibleString(value);
+  EXPECT_EQ(cobj_, other);
+  other.SetCompressibleString(make_value(i + 1));
+  EXPECT_NE(cobj_, other);
+  other.Reset();
+
+  // Small values are not compressed
+  cobj_.SetCompressibleString("foo");
+  EXPECT_EQ(cobj_, "foo");
+  EXPECT_EQ(3, cobj_.Size());
+
+  // Plain SetString never compresses
+  cobj_.SetString(value);
+  EXPECT_GT(cobj_.MallocUsed(), value.size() / 2);
+
+  cobj_.Reset();
+  CompactObj::InitDictCompressor(nullptr);
+  CompactObj::InitThreadLocal(PMR_NS::get_default_resource());
+}
+
 TEST_F(CompactObjectTest, MediumString) {
   string tmp(511, 'b');
 
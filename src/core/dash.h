@@ -3,6 +3,8 @@
 //
 #pragma once
 
+#include <algorithm>
+#include <bitset>
 #include <vector>
 
 #include "absl/random/random.h"
@@ -50,6 +52,10 @@ class DashTable : public detail::DashTableBase {
   static constexpr size_t kSlotNum = SegmentType::kSlotNum;
   static constexpr size_t kBucketNum = SegmentType::kBucketNum;
 
+  // Number of keys FindBatch() prefetches ahead of probing them. Larger batches risk evicting
+  // prefetched buckets before they're probed.
+  static constexpr size_t kFindBatchSize = 16;
+
   // if IsSingleBucket is true - iterates only over a single bucket.
   template <bool IsConst, bool IsSingleBucket = false> class Iterator;
 
@@ -149,10 +155,38 @@ class DashTable : public detail::DashTableBase {
   template <typename U> const_iterator Find(U&& key) const;
   template <typename U> iterator Find(U&& key);
 
+  // Same as Find() with key_hash computed by the caller with DoHash(), i.e. for Prefetch().
+  template <typename U> iterator Find(U&& key, uint64_t key_hash);
+
   // Find first entry with given key hash that evaulates to true on pred.
   // Pred accepts either (const key&) or (const key&, const value&)
   template <typename Pred> iterator FindFirst(uint64_t key_hash, Pred&& pred);
 
+  // Prefetch segment directory entries and buckets probed by Find() for every key hash.
+  // Lookups of multiple keys can issue it for all of them first to overlap their cache misses.
+  void Prefetch(const uint64_t* key_hashes, size_t count) const;
+
+  // Find count keys in groups of kFindBatchSize: every group is hashed and prefetched before
+  // it's probed. Calls cb(index, iterator) in order of keys, with end() for missing ones.
+  // The table must not be mutated by cb.
+  template <typename U, typename Cb> void FindBatch(const U* keys, size_t count, Cb&& cb);
+
+  // Splits of full segments are spread over later operations if step_buckets is positive.
+  // The new segment takes over its half of the directory right away, while entries are moved to
+  // it step_buckets buckets at a time by every insertion and by SplitStep(). Until then, keys of
+  // the new segment are also looked up in the source. At most one split is pending at a time.
+  void SetSplitStep(unsigned step_buckets);
+
+  // Moves entries of the next step of a pending split. Returns false if no split is pending.
+  bool SplitStep();
+
+  // Moves all remaining entries of a pending split, if any.
+  void FinishSplit();
+
+  bool HasPendingSplit() const {
+    return pending_split_.dest != nullptr;
+  }
+
   // it must be valid.
   void Erase(iterator it);
 
@@ -282,6 +316,10 @@ class DashTable : public detail::DashTableBase {
   bool ShiftRight(bucket_iterator it);
 
   template <typename BumpPolicy> iterator BumpUp(iterator it, const BumpPolicy& bp) {
+    // Entries of a segment that is being split must stay in their buckets.
+    if (segment_[it.seg_id_] == pending_split_.source)
+      return it;
+
     SegmentIterator seg_it =
         segment_[it.seg_id_]->BumpUp(it.bucket_id_, it.slot_id_, DoHash(it->first), bp);
 
@@ -308,6 +346,27 @@ class DashTable : public detail::DashTableBase {
   void IncreaseDepth(unsigned new_depth);
   void Split(uint32_t seg_id);
 
+  // Allocates the right half of segment seg_id and points its half of the directory to it.
+  SegmentType* AddSplitSegment(uint32_t seg_id);
+
+  // Starts splitting segment seg_id in steps, see SetSplitStep().
+  void StartSplit(uint32_t seg_id);
+  void SplitPendingBucket(unsigned bid);
+
+  // Splits buckets of the pending source that can host key_hash, so that it has room for it.
+  void SplitBucketsOf(uint64_t key_hash);
+
+  // Id of the pending source for an id of its target. They differ in a single bit.
+  uint32_t SplitSourceId(uint32_t dest_id) const {
+    return dest_id & ~(1u << (global_depth_ - pending_split_.dest->local_depth()));
+  }
+
+  // Finds entry in segment seg_id and, if it's the target of a pending split, in its source.
+  // Returns the id of the segment that holds the entry.
+  template <typename Pred>
+  std::pair<uint32_t, SegmentIterator> FindInSegment(uint32_t seg_id, uint64_t key_hash,
+                                                     Pred&& pred) const;
+
   // Segment directory contains multiple segment pointers, some of them pointing to
   // the same object. IterateDistinct goes over all distinct segments in the table.
   template <typename Cb> void IterateDistinct(Cb&& cb);
@@ -321,6 +380,16 @@ class DashTable : public detail::DashTableBase {
 
   uint64_t garbage_collected_ = 0;
   uint64_t stash_unloaded_ = 0;
+
+  struct PendingSplit {
+    SegmentType* source = nullptr;
+    SegmentType* dest = nullptr;
+    unsigned next_bid = 0;  // buckets below next_bid are split, as well as the ones in done.
+    std::bitset<SegmentType::kTotalBuckets> done;
+  };
+
+  PendingSplit pending_split_;
+  unsigned split_step_ = 0;
 };  // DashTable
 
 template <typename _Key, typename _Value, typename Policy>
@@ -538,6 +607,7 @@ DashTable<_Key, _Value, Policy>::~DashTable() {
 template <typename _Key, typename _Value, typename Policy>
 template <typename U, typename Cb>
 void DashTable<_Key, _Value, Policy>::CVCUponInsert(uint64_t ver_threshold, const U& key, Cb&& cb) {
+  assert(!HasPendingSplit());  // versions are not tracked for incremental splits.
   uint64_t key_hash = DoHash(key);
   uint32_t seg_id = SegmentId(key_hash);
   assert(seg_id < segment_.size());
@@ -583,6 +653,8 @@ void DashTable<_Key, _Value, Policy>::CVCUponBump(uint64_t ver_upperbound, const
 
 template <typename _Key, typename _Value, typename Policy>
 void DashTable<_Key, _Value, Policy>::Clear() {
+  pending_split_ = PendingSplit{};
+
   auto cb = [this](SegmentType* seg) {
     seg->TraverseAll([this, seg](const SegmentIterator& it) {
       policy_.DestroyKey(seg->Key(it.index, it.slot));
@@ -678,8 +750,8 @@ auto DashTable<_Key, _Value, Policy>::Find(U&& key) const -> const_iterator {
   // B - bucket id and F is a fingerprint. Segment id is needed to identify the correct segment.
   // Once identified, the segment instance uses the lower part of hash to locate the key.
   // It uses 8 least significant bits for a fingerprint and few more bits for bucket id.
-  if (auto seg_it = segment_[seg_id]->FindIt(key_hash, EqPred(key)); seg_it.found()) {
-    return {this, seg_id, seg_it.index, seg_it.slot};
+  if (auto [id, seg_it] = FindInSegment(seg_id, key_hash, EqPred(key)); seg_it.found()) {
+    return {this, id, seg_it.index, seg_it.slot};
   }
   return {};
 }
@@ -690,25 +762,72 @@ auto DashTable<_Key, _Value, Policy>::Find(U&& key) -> iterator {
   return FindFirst(DoHash(key), EqPred(key));
 }
 
+template <typename _Key, typename _Value, typename Policy>
+template <typename U>
+auto DashTable<_Key, _Value, Policy>::Find(U&& key, uint64_t key_hash) -> iterator {
+  assert(key_hash == DoHash(key));
+  return FindFirst(key_hash, EqPred(key));
+}
+
 template <typename _Key, typename _Value, typename Policy>
 template <typename Pred>
 auto DashTable<_Key, _Value, Policy>::FindFirst(uint64_t key_hash, Pred&& pred) -> iterator {
-  uint32_t seg_id = SegmentId(key_hash);
-  if (auto seg_it = segment_[seg_id]->FindIt(key_hash, pred); seg_it.found()) {
-    return {this, seg_id, seg_it.index, seg_it.slot};
+  if (auto [id, seg_it] = FindInSegment(SegmentId(key_hash), key_hash, pred); seg_it.found()) {
+    return {this, id, seg_it.index, seg_it.slot};
   }
   return {};
 }
 
+template <typename _Key, typename _Value, typename Policy>
+template <typename Pred>
+auto DashTable<_Key, _Value, Policy>::FindInSegment(uint32_t seg_id, uint64_t key_hash,
+                                                    Pred&& pred) const
+    -> std::pair<uint32_t, SegmentIterator> {
+  const SegmentType* seg = segment_[seg_id];
+  SegmentIterator it = seg->FindIt(key_hash, pred);
+  if (!it.found() && seg == pending_split_.dest) {
+    // The entry might not be moved yet.
+    seg_id = SplitSourceId(seg_id);
+    it = pending_split_.source->FindIt(key_hash, pred);
+  }
+  return {seg_id, it};
+}
+
+template <typename _Key, typename _Value, typename Policy>
+void DashTable<_Key, _Value, Policy>::Prefetch(const uint64_t* key_hashes, size_t count) const {
+  // Segment pointers must be loaded to find the buckets, so directory entries go first.
+  for (size_t i = 0; i < count; ++i)
+    __builtin_prefetch(&segment_[SegmentId(key_hashes[i])], 0, 1);
+
+  for (size_t i = 0; i < count; ++i)
+    segment_[SegmentId(key_hashes[i])]->Prefetch(key_hashes[i]);
+}
+
+template <typename _Key, typename _Value, typename Policy>
+template <typename U, typename Cb>
+void DashTable<_Key, _Value, Policy>::FindBatch(const U* keys, size_t count, Cb&& cb) {
+  uint64_t hashes[kFindBatchSize];
+  for (size_t start = 0; start < count; start += kFindBatchSize) {
+    size_t batch = std::min(kFindBatchSize, count - start);
+    for (size_t i = 0; i < batch; ++i)
+      hashes[i] = DoHash(keys[start + i]);
+
+    Prefetch(hashes, batch);
+
+    for (size_t i = 0; i < batch; ++i)
+      cb(start + i, FindFirst(hashes[i], EqPred(keys[start + i])));
+  }
+}
+
 template <typename _Key, typename _Value, typename Policy>
 size_t DashTable<_Key, _Value, Policy>::Erase(const Key_t& key) {
   uint64_t key_hash = DoHash(key);
-  size_t x = SegmentId(key_hash);
-  auto* target = segment_[x];
-  auto it = target->FindIt(key_hash, EqPred(key));
+  auto [seg_id, it] = FindInSegment(SegmentId(key_hash), key_hash, EqPred(key));
   if (!it.found())
     return 0;
 
+  auto* target = segment_[seg_id];
+
   policy_.DestroyKey(target->Key(it.index, it.slot));
   policy_.DestroyValue(target->Value(it.index, it.slot));
   target->Delete(it, key_hash);
@@ -752,6 +871,9 @@ auto DashTable<_Key, _Value, Policy>::InsertInternal(U&& key, V&& value, Evictio
   uint64_t key_hash = DoHash(key);
   uint32_t target_seg_id = SegmentId(key_hash);
 
+  if (pending_split_.dest)
+    SplitStep();
+
   while (true) {
     // Keep last global_depth_ msb bits of the hash.
     assert(target_seg_id < segment_.size());
@@ -762,6 +884,39 @@ auto DashTable<_Key, _Value, Policy>::InsertInternal(U&& key, V&& value, Evictio
 
     typename SegmentType::Iterator it;
     bool res = true;
+
+    if (target == pending_split_.source) {
+      // Entries of the source must stay in their buckets until they're split, so only free slots
+      // can be used. The buckets of the key are split first if there are none.
+      if (mode == InsertMode::kInsertIfNotFound) {
+        if (it = target->FindIt(key_hash, EqPred(key)); it.found())
+          return std::make_pair(iterator{this, target_seg_id, it.index, it.slot}, false);
+      }
+
+      for (unsigned i = 0; i < 2 && !it.found(); ++i) {
+        if (i > 0)
+          SplitBucketsOf(key_hash);
+        it = target->InsertUniq(std::forward<U>(key), std::forward<V>(value), key_hash, true,
+                                false);
+      }
+
+      if (it.found()) {
+        ++size_;
+        return std::make_pair(iterator{this, target_seg_id, it.index, it.slot}, true);
+      }
+
+      FinishSplit();
+      continue;
+    }
+
+    if (target == pending_split_.dest && mode == InsertMode::kInsertIfNotFound) {
+      // The key might not be moved from the source yet.
+      if (it = pending_split_.source->FindIt(key_hash, EqPred(key)); it.found()) {
+        return std::make_pair(iterator{this, SplitSourceId(target_seg_id), it.index, it.slot},
+                              false);
+      }
+    }
+
     if (mode == InsertMode::kForceInsert) {
       it = target->InsertUniq(std::forward<U>(key), std::forward<V>(value), key_hash, true);
       res = it.found();
@@ -780,6 +935,13 @@ auto DashTable<_Key, _Value, Policy>::InsertInternal(U&& key, V&& value, Evictio
       return std::make_pair(iterator{this, target_seg_id, it.index, it.slot}, false);
     }
 
+    // Garbage collection, eviction and stash unloading move entries between buckets, and only one
+    // split can be pending, so the pending one is finished first.
+    if (pending_split_.dest) {
+      FinishSplit();
+      continue;
+    }
+
     // At this point we must split the segment.
     // try garbage collect or evict.
     if constexpr (EvictionPolicy::can_evict || EvictionPolicy::can_gc) {
@@ -850,7 +1012,11 @@ auto DashTable<_Key, _Value, Policy>::InsertInternal(U&& key, V&& value, Evictio
     }
 
     ev.RecordSplit(target);
-    Split(target_seg_id);
+    if (split_step_ > 0) {
+      StartSplit(target_seg_id);
+    } else {
+      Split(target_seg_id);
+    }
   }
 
   return std::make_pair(iterator{}, false);
@@ -874,6 +1040,16 @@ void DashTable<_Key, _Value, Policy>::IncreaseDepth(unsigned new_depth) {
 template <typename _Key, typename _Value, typename Policy>
 void DashTable<_Key, _Value, Policy>::Split(uint32_t seg_id) {
   SegmentType* source = segment_[seg_id];
+  SegmentType* target = AddSplitSegment(seg_id);
+
+  auto hash_fn = [this](const auto& k) { return policy_.HashFn(k); };
+
+  source->Split(std::move(hash_fn), target);  // increases the depth.
+}
+
+template <typename _Key, typename _Value, typename Policy>
+auto DashTable<_Key, _Value, Policy>::AddSplitSegment(uint32_t seg_id) -> SegmentType* {
+  SegmentType* source = segment_[seg_id];
 
   size_t chunk_size = 1u << (global_depth_ - source->local_depth());
   size_t start_idx = seg_id & (~(chunk_size - 1));
@@ -881,15 +1057,82 @@ void DashTable<_Key, _Value, Policy>::Split(uint32_t seg_id) {
   PMR_NS::polymorphic_allocator<SegmentType> alloc(segment_.get_allocator().resource());
   SegmentType* target = alloc.allocate(1);
   alloc.construct(target, source->local_depth() + 1);
-
-  auto hash_fn = [this](const auto& k) { return policy_.HashFn(k); };
-
-  source->Split(std::move(hash_fn), target);  // increases the depth.
   ++unique_segments_;
 
   for (size_t i = start_idx + chunk_size / 2; i < start_idx + chunk_size; ++i) {
     segment_[i] = target;
   }
+  return target;
+}
+
+template <typename _Key, typename _Value, typename Policy>
+void DashTable<_Key, _Value, Policy>::StartSplit(uint32_t seg_id) {
+  assert(!pending_split_.dest);
+  SegmentType* source = segment_[seg_id];
+  SegmentType* target = AddSplitSegment(seg_id);
+
+  source->StartSplit(target);
+  pending_split_.source = source;
+  pending_split_.dest = target;
+}
+
+template <typename _Key, typename _Value, typename Policy>
+void DashTable<_Key, _Value, Policy>::SplitPendingBucket(unsigned bid) {
+  if (pending_split_.done[bid])
+    return;
+
+  auto hash_fn = [this](const auto& k) { return policy_.HashFn(k); };
+  pending_split_.source->SplitBucket(hash_fn, pending_split_.dest, bid);
+  pending_split_.done.set(bid);
+}
+
+template <typename _Key, typename _Value, typename Policy>
+void DashTable<_Key, _Value, Policy>::SplitBucketsOf(uint64_t key_hash) {
+  uint8_t bids[4];
+  SegmentType::FillProbeArray(key_hash, bids);
+
+  // Home and neighbour buckets, followed by stash buckets.
+  SplitPendingBucket(bids[1]);
+  SplitPendingBucket(bids[2]);
+  for (unsigned i = 0; i < Policy::kStashBucketNum; ++i) {
+    SplitPendingBucket(Policy::kBucketNum + i);
+  }
+}
+
+template <typename _Key, typename _Value, typename Policy>
+void DashTable<_Key, _Value, Policy>::SetSplitStep(unsigned step_buckets) {
+  if (step_buckets == 0)
+    FinishSplit();
+  split_step_ = step_buckets;
+}
+
+template <typename _Key, typename _Value, typename Policy>
+bool DashTable<_Key, _Value, Policy>::SplitStep() {
+  if (!pending_split_.dest)
+    return false;
+
+  auto& ps = pending_split_;
+  for (unsigned i = 0; i < split_step_ && ps.next_bid < SegmentType::kTotalBuckets; ++ps.next_bid) {
+    if (!ps.done[ps.next_bid]) {
+      SplitPendingBucket(ps.next_bid);
+      ++i;
+    }
+  }
+
+  if (ps.next_bid == SegmentType::kTotalBuckets)
+    ps = PendingSplit{};
+  return true;
+}
+
+template <typename _Key, typename _Value, typename Policy>
+void DashTable<_Key, _Value, Policy>::FinishSplit() {
+  if (!pending_split_.dest)
+    return;
+
+  for (unsigned bid = pending_split_.next_bid; bid < SegmentType::kTotalBuckets; ++bid) {
+    SplitPendingBucket(bid);
+  }
+  pending_split_ = PendingSplit{};
 }
 
 template <typename _Key, typename _Value, typename Policy>
@@ -6,6 +6,7 @@
 
 #include <absl/base/internal/cycleclock.h>
 #include <absl/container/flat_hash_map.h>
+#include <absl/strings/str_format.h>
 
 #include "base/hash.h"
 #include "base/histogram.h"
@@ -21,7 +22,7 @@ extern "C" {
 using namespace std;
 
 ABSL_FLAG(uint32_t, n, 100000, "num items");
-ABSL_FLAG(string, type, "dash", "");
+ABSL_FLAG(string, type, "dash", "dash, dict, flat or geometry");
 ABSL_FLAG(bool, sds, false, "If true, uses sds as primary key");
 
 namespace dfly {
@@ -85,6 +86,11 @@ struct SdsDashPolicy {
   }
 };
 
+template <unsigned kSlots, unsigned kBuckets, unsigned kStash>
+struct GeometryPolicy : public UInt64Policy {
+  enum { kSlotNum = kSlots, kBucketNum = kBuckets, kStashBucketNum = kStash };
+};
+
 using Dash64 = DashTable<uint64_t, uint64_t, UInt64Policy>;
 using DashSds = DashTable<sds, uint64_t, SdsDashPolicy>;
 
@@ -154,6 +160,51 @@ void BenchDashSds(uint64_t num) {
   }
 }
 
+uint64_t found_sink = 0;
+
+// Fills a table with the given bucket geometry and reports its average fill factor right before
+// segment splits, lookup cost of present and missing keys and memory per entry.
+template <unsigned kSlots, unsigned kBuckets, unsigned kStash> void BenchGeometry(uint64_t num) {
+  DashTable<uint64_t, uint64_t, GeometryPolicy<kSlots, kBuckets, kStash>> dt;
+
+  double fill_sum = 0;
+  unsigned splits = 0;
+  for (uint64_t i = 0; i < num; ++i) {
+    size_t capacity = dt.capacity();
+    dt.Insert(i, 0);
+    if (dt.capacity() != capacity) {
+      fill_sum += double(dt.size() - 1) / capacity;
+      ++splits;
+    }
+  }
+
+  auto find_ns = [&](uint64_t from) {
+    uint64_t start = absl::GetCurrentTimeNanos();
+    for (uint64_t i = from; i < from + num; ++i) {
+      found_sink += !dt.Find(i).is_done();
+    }
+    return double(absl::GetCurrentTimeNanos() - start) / num;
+  };
+
+  double hit_ns = find_ns(0);
+  double miss_ns = find_ns(num);
+
+  CONSOLE_INFO << absl::StrFormat(
+      "slots %2u buckets %3u stash %u: fill %.3f (final %.3f), hit %.1fns, miss %.1fns, "
+      "%.1f bytes per entry",
+      kSlots, kBuckets, kStash, splits ? fill_sum / splits : dt.load_factor(), dt.load_factor(),
+      hit_ns, miss_ns, double(dt.mem_usage()) / dt.size());
+}
+
+void BenchGeometries(uint64_t num) {
+  BenchGeometry<8, 96, 4>(num);
+  BenchGeometry<12, 64, 2>(num);
+  BenchGeometry<12, 64, 4>(num);
+  BenchGeometry<14, 56, 4>(num);
+  BenchGeometry<14, 112, 4>(num);
+  BenchGeometry<16, 48, 4>(num);
+}
+
 static uint64_t callbackHash(const void* key) {
   return XXH64(&key, sizeof(key), 0);
 }
@@ -219,6 +270,9 @@ int main(int argc, char* argv[]) {
     }
   } else if (table_type == "flat") {
     BenchFlat(num);
+  } else if (table_type == "geometry") {
+    BenchGeometries(num);
+    return 0;
   } else {
     LOG(FATAL) << "Unknown type " << table_type;
   }
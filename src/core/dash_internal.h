@@ -18,6 +18,15 @@
 namespace dfly {
 namespace detail {
 
+#if defined(__x86_64__)
+// Whether the cpu supports AVX2, resolved during static initialization. Lookups that run before
+// it see false and use the SSE path.
+inline const bool kHasAvx2 = [] {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+}();
+#endif
+
 template <unsigned NUM_SLOTS> class SlotBitmap {
   static_assert(NUM_SLOTS > 0 && NUM_SLOTS <= 28);
   static constexpr unsigned kLen = NUM_SLOTS > 14 ? 2 : 1;
@@ -148,6 +157,19 @@ template <unsigned NUM_SLOTS, unsigned NUM_STASH_FPS> class BucketBase {
     return mask & GetProbe(probe);
   }
 
+#if defined(__x86_64__)
+  // Same as Find(fp_hash, false) for this bucket and Find(fp_hash, true) for next, with both
+  // fingerprint arrays compared by a single instruction. Slots of this bucket are returned in the
+  // low 16 bits and slots of next in the high 16 bits. Requires kHasAvx2.
+  __attribute__((target("avx2"))) uint32_t FindWithNext(uint8_t fp_hash,
+                                                        const BucketBase& next) const {
+    uint32_t mask = CompareFPWithNext(fp_hash, next);
+    uint32_t own = mask & GetBusy() & GetProbe(false);
+    uint32_t probing = (mask >> 16) & next.GetBusy() & next.GetProbe(true);
+    return own | (probing << 16);
+  }
+#endif
+
   uint8_t Fp(unsigned i) const {
     assert(i < finger_arr_.size());
     return finger_arr_[i];
@@ -208,6 +230,10 @@ template <unsigned NUM_SLOTS, unsigned NUM_STASH_FPS> class BucketBase {
 
  protected:
   uint32_t CompareFP(uint8_t fp) const;
+#if defined(__x86_64__)
+  __attribute__((target("avx2"))) uint32_t CompareFPWithNext(uint8_t fp,
+                                                             const BucketBase& next) const;
+#endif
   bool ShiftRight();
 
   // Returns true if stash_pos was stored, false overwise
@@ -290,6 +316,9 @@ static_assert(sizeof(VersionedBB<12, 4>) == 12 * 2 + 8, "");
 static_assert(sizeof(VersionedBB<14, 4>) <= 14 * 2 + 8, "");
 
 // Segment - static-hashtable of size kSlotNum*(kBucketNum + kStashBucketNum).
+// Bucket geometry is defined by the policy at compile time: kSlotNum slots per bucket (at most 16,
+// as fingerprints are compared with a single 16 byte vector), kBucketNum regular buckets and
+// kStashBucketNum stash buckets (at most 4, as stash positions take 2 bits).
 struct DefaultSegmentPolicy {
   static constexpr unsigned kSlotNum = 12;
   static constexpr unsigned kBucketNum = 64;
@@ -305,6 +334,9 @@ template <typename _Key, typename _Value, typename Policy = DefaultSegmentPolicy
   static constexpr bool kUseVersion = Policy::kUseVersion;
 
  private:
+  static_assert(kSlotNum > 0 && kSlotNum <= 16, "fingerprints must fit into 16 bytes");
+  static_assert(kBucketNum > 1, "keys must have a neighbour bucket");
+  static_assert(kStashBucketNum > 0 && kStashBucketNum <= 4, "stash positions take 2 bits");
   static_assert(kBucketNum + kStashBucketNum < 255);
   static constexpr unsigned kFingerBits = 8;
 
@@ -328,7 +360,12 @@ template <typename _Key, typename _Value, typename Policy = DefaultSegmentPolicy
       this->SetHash(slot, meta_hash, probe);
     }
 
-    template <typename Pred> SlotId FindByFp(uint8_t fp_hash, bool probe, Pred&& pred) const;
+    template <typename Pred> SlotId FindByFp(uint8_t fp_hash, bool probe, Pred&& pred) const {
+      return FindByMask(this->Find(fp_hash, probe), pred);
+    }
+
+    // Returns first slot in mask that evaluates to true on pred or kNanSlot
+    template <typename Pred> SlotId FindByMask(unsigned mask, Pred&& pred) const;
 
     bool ShiftRight();
 
@@ -406,6 +443,17 @@ template <typename _Key, typename _Value, typename Policy = DefaultSegmentPolicy
 
   template <typename HashFn> void Split(HashFn&& hfunc, Segment* dest);
 
+  // Split() in steps: StartSplit() increases the local depth of both segments and SplitBucket()
+  // moves the entries of a single bucket that belong to dest. Until all buckets are split, keys
+  // of dest must be looked up in both segments and entries must not move between buckets of
+  // this segment, otherwise they could skip being split.
+  void StartSplit(Segment* dest) {
+    ++local_depth_;
+    dest->local_depth_ = local_depth_;
+  }
+
+  template <typename HashFn> void SplitBucket(HashFn&& hfunc, Segment* dest, unsigned bid);
+
   // Moves all the entries from 'src' segment to this segment.
   // The calling code must ensure first that we actually can move all the key and we do not
   // have hot, overfilled buckets that will prevent us from moving all the keys.
@@ -503,14 +551,23 @@ template <typename _Key, typename _Value, typename Policy = DefaultSegmentPolicy
   // Find item with given key hash and truthy predicate
   template <typename Pred> Iterator FindIt(Hash_t key_hash, Pred&& pred) const;
 
+  // Prefetch home and neighbour buckets probed by FindIt() for key_hash, so that lookups of
+  // multiple keys can overlap their cache misses.
+  void Prefetch(Hash_t key_hash) const {
+    uint8_t bidx = BucketIndex(key_hash);
+    __builtin_prefetch(&bucket_[bidx], 0, 1);
+    __builtin_prefetch(&bucket_[NextBid(bidx)], 0, 1);
+  }
+
   // Returns valid iterator if succeeded or invalid if not (it's full).
   // Requires: key should be not present in the segment.
   // if spread is true, tries to spread the load between neighbour and home buckets,
   // otherwise chooses home bucket first.
   // TODO: I am actually not sure if spread optimization is helpful. Worth checking
   // whether we get higher occupancy rates when using it.
+  // If displace is false, only free slots are used and other entries never move.
   template <typename U, typename V>
-  Iterator InsertUniq(U&& key, V&& value, Hash_t key_hash, bool spread);
+  Iterator InsertUniq(U&& key, V&& value, Hash_t key_hash, bool spread, bool displace = true);
 
   // capture version change in case of insert.
   // Returns ids of buckets whose version would cross ver_threshold upon insertion of key_hash
@@ -951,6 +1008,26 @@ uint32_t BucketBase<NUM_SLOTS, NUM_OVR>::CompareFP(uint8_t fp) const {
   // Note: Last 2 operations can be combined in skylake with _mm_cmpeq_epi8_mask.
   return mask;
 }
+
+#if defined(__x86_64__)
+template <unsigned NUM_SLOTS, unsigned NUM_OVR>
+__attribute__((target("avx2"))) uint32_t BucketBase<NUM_SLOTS, NUM_OVR>::CompareFPWithNext(
+    uint8_t fp, const BucketBase& next) const {
+  static_assert(FpArray{}.size() <= 16);
+
+  // Replicate 32 times fp to key_data.
+  const __m256i key_data = _mm256_set1_epi8(fp);
+
+  // Loads 16 bytes of this bucket into the low lane and 16 bytes of next into the high lane.
+  __m128i lo = mm_loadu_si128(reinterpret_cast<const __m128i*>(finger_arr_.data()));
+  __m128i hi = mm_loadu_si128(reinterpret_cast<const __m128i*>(next.finger_arr_.data()));
+  __m256i seg_data = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+  // compare 32-byte vectors seg_data and key_data and collapse msb bits of every byte into mask.
+  __m256i rv_mask = _mm256_cmpeq_epi8(seg_data, key_data);
+  return _mm256_movemask_epi8(rv_mask);
+}
+#endif
 #endif
 
 // Bucket slot array goes from left to right: [x, x, ...]
@@ -1022,9 +1099,7 @@ ___] |___ |__] |  | |___ | \|  |
 
 template <typename Key, typename Value, typename Policy>
 template <typename Pred>
-auto Segment<Key, Value, Policy>::Bucket::FindByFp(uint8_t fp_hash, bool probe, Pred&& pred) const
-    -> SlotId {
-  unsigned mask = this->Find(fp_hash, probe);
+auto Segment<Key, Value, Policy>::Bucket::FindByMask(unsigned mask, Pred&& pred) const -> SlotId {
   if (!mask)
     return kNanSlot;
 
@@ -1126,15 +1201,31 @@ auto Segment<Key, Value, Policy>::FindIt(Hash_t key_hash, Pred&& pred) const ->
   __builtin_prefetch(&target);
 
   uint8_t fp_hash = key_hash & kFpMask;
-  SlotId sid = target.FindByFp(fp_hash, false, pred);
-  if (sid != BucketType::kNanSlot) {
-    return Iterator{bidx, sid};
-  }
-
   uint8_t nid = NextBid(bidx);
   const Bucket& probe = bucket_[nid];
 
-  sid = probe.FindByFp(fp_hash, true, pred);
+  SlotId sid;
+#if defined(__x86_64__)
+  if (kHasAvx2) {
+    // Both buckets are matched at once, at the cost of reading the neighbour's fingerprints even
+    // when the key is found in its home bucket.
+    uint32_t mask = target.FindWithNext(fp_hash, probe);
+    sid = target.FindByMask(mask & 0xFFFF, pred);
+    if (sid != BucketType::kNanSlot) {
+      return Iterator{bidx, sid};
+    }
+
+    sid = probe.FindByMask(mask >> 16, pred);
+  } else
+#endif
+  {
+    sid = target.FindByFp(fp_hash, false, pred);
+    if (sid != BucketType::kNanSlot) {
+      return Iterator{bidx, sid};
+    }
+
+    sid = probe.FindByFp(fp_hash, true, pred);
+  }
 
 #ifdef ENABLE_DASH_STATS
   stats.neighbour_probes++;
@@ -1220,17 +1311,24 @@ void Segment<Key, Value, Policy>::Delete(const Iterator& it, Hash_t key_hash) {
 template <typename Key, typename Value, typename Policy>
 template <typename HFunc>
 void Segment<Key, Value, Policy>::Split(HFunc&& hfn, Segment* dest_right) {
-  ++local_depth_;
-  dest_right->local_depth_ = local_depth_;
+  StartSplit(dest_right);
+
+  for (unsigned i = 0; i < kTotalBuckets; ++i) {
+    SplitBucket(hfn, dest_right, i);
+  }
+}
 
+template <typename Key, typename Value, typename Policy>
+template <typename HFunc>
+void Segment<Key, Value, Policy>::SplitBucket(HFunc&& hfn, Segment* dest_right, unsigned bid) {
   // versioning does not work when entries move across buckets.
   // we need to setup rules on how we do that
   // do_versioning();
   auto is_mine = [this](Hash_t hash) { return (hash >> (64 - local_depth_) & 1) == 0; };
 
-  for (unsigned i = 0; i < kBucketNum; ++i) {
-    uint32_t invalid_mask = 0;
+  uint32_t invalid_mask = 0;
 
+  if (bid < kBucketNum) {
     auto cb = [&](auto* bucket, unsigned slot, bool probe) {
       auto& key = bucket->key[slot];
       Hash_t hash = hfn(key);
@@ -1273,48 +1371,46 @@ void Segment<Key, Value, Policy>::Split(HFunc&& hfn, Segment* dest_right) {
       }
     };
 
-    bucket_[i].ForEachSlot(std::move(cb));
-    bucket_[i].ClearSlots(invalid_mask);
+    bucket_[bid].ForEachSlot(std::move(cb));
+    bucket_[bid].ClearSlots(invalid_mask);
+    return;
   }
 
-  for (unsigned i = 0; i < kStashBucketNum; ++i) {
-    uint32_t invalid_mask = 0;
-    unsigned bid = kBucketNum + i;
-    Bucket& stash = bucket_[bid];
+  unsigned stash_id = bid - kBucketNum;
+  Bucket& stash = bucket_[bid];
 
-    auto cb = [&](auto* bucket, unsigned slot, bool probe) {
-      auto& key = bucket->key[slot];
-      Hash_t hash = hfn(key);
-
-      if (is_mine(hash)) {
-        // If the entry stays in the same segment we try to unload it back to the regular bucket.
-        Iterator it = TryMoveFromStash(i, slot, hash);
-        if (it.found()) {
-          invalid_mask |= (1u << slot);
-        }
+  auto cb = [&](auto* bucket, unsigned slot, bool probe) {
+    auto& key = bucket->key[slot];
+    Hash_t hash = hfn(key);
 
-        return;
+    if (is_mine(hash)) {
+      // If the entry stays in the same segment we try to unload it back to the regular bucket.
+      Iterator it = TryMoveFromStash(stash_id, slot, hash);
+      if (it.found()) {
+        invalid_mask |= (1u << slot);
       }
 
-      invalid_mask |= (1u << slot);
-      auto it = dest_right->InsertUniq(std::forward<Key_t>(bucket->key[slot]),
-                                       std::forward<Value_t>(bucket->value[slot]), hash, false);
-      (void)it;
-      assert(it.index != kNanBid);
+      return;
+    }
 
-      if constexpr (kUseVersion) {
-        // Update the version in the destination bucket.
-        uint64_t ver = bucket->GetVersion();
-        dest_right->bucket_[it.index].UpdateVersion(ver);
-      }
+    invalid_mask |= (1u << slot);
+    auto it = dest_right->InsertUniq(std::forward<Key_t>(bucket->key[slot]),
+                                     std::forward<Value_t>(bucket->value[slot]), hash, false);
+    (void)it;
+    assert(it.index != kNanBid);
 
-      // Remove stash reference pointing to stach bucket i.
-      RemoveStashReference(i, hash);
-    };
+    if constexpr (kUseVersion) {
+      // Update the version in the destination bucket.
+      uint64_t ver = bucket->GetVersion();
+      dest_right->bucket_[it.index].UpdateVersion(ver);
+    }
 
-    stash.ForEachSlot(std::move(cb));
-    stash.ClearSlots(invalid_mask);
-  }
+    // Remove stash reference pointing to stach bucket i.
+    RemoveStashReference(stash_id, hash);
+  };
+
+  stash.ForEachSlot(std::move(cb));
+  stash.ClearSlots(invalid_mask);
 }
 
 template <typename Key, typename Value, typename Policy>
@@ -1389,8 +1485,8 @@ bool Segment<Key, Value, Policy>::CheckIfMovesToOther(bool own_items, unsigned f
 
 template <typename Key, typename Value, typename Policy>
 template <typename U, typename V>
-auto Segment<Key, Value, Policy>::InsertUniq(U&& key, V&& value, Hash_t key_hash, bool spread)
-    -> Iterator {
+auto Segment<Key, Value, Policy>::InsertUniq(U&& key, V&& value, Hash_t key_hash, bool spread,
+                                             bool displace) -> Iterator {
   const uint8_t bid = BucketIndex(key_hash);
   const uint8_t nid = NextBid(bid);
 
@@ -1412,22 +1508,24 @@ auto Segment<Key, Value, Policy>::InsertUniq(U&& key, V&& value, Hash_t key_hash
     insert_first->Insert(slot, std::forward<U>(key), std::forward<V>(value), meta_hash, probe);
 
     return Iterator{uint8_t(insert_first - bucket_), uint8_t(slot)};
-  } else if (!spread) {
-    int slot = neighbor.FindEmptySlot();
+  } else if (!spread || !displace) {
+    // Try the other bucket of the pair.
+    Bucket& other = probe ? target : neighbor;
+    int slot = other.FindEmptySlot();
     if (slot >= 0) {
-      neighbor.Insert(slot, std::forward<U>(key), std::forward<V>(value), meta_hash, true);
-      return Iterator{nid, uint8_t(slot)};
+      other.Insert(slot, std::forward<U>(key), std::forward<V>(value), meta_hash, !probe);
+      return Iterator{uint8_t(&other - bucket_), uint8_t(slot)};
     }
   }
 
-  int displace_index = MoveToOther(true, nid, NextBid(nid));
+  int displace_index = displace ? MoveToOther(true, nid, NextBid(nid)) : -1;
   if (displace_index >= 0) {
     neighbor.Insert(displace_index, std::forward<U>(key), std::forward<V>(value), meta_hash, true);
     return Iterator{nid, uint8_t(displace_index)};
   }
 
   unsigned prev_idx = PrevBid(bid);
-  displace_index = MoveToOther(false, bid, prev_idx);
+  displace_index = displace ? MoveToOther(false, bid, prev_idx) : -1;
   if (displace_index >= 0) {
     target.Insert(displace_index, std::forward<U>(key), std::forward<V>(value), meta_hash, false);
     return Iterator{bid, uint8_t(displace_index)};
@@ -11,6 +11,7 @@
 #include <mimalloc.h>
 
 #include <functional>
+#include <random>
 #include <set>
 
 #include "base/gtest.h"
@@ -226,6 +227,24 @@ TEST_F(DashTest, Basic) {
   EXPECT_EQ(0, segment_.GetVersion(0));
 }
 
+#if defined(__x86_64__)
+TEST_F(DashTest, FindWithNext) {
+  if (!detail::kHasAvx2)
+    GTEST_SKIP() << "FindWithNext requires AVX2";
+
+  // Fills buckets 0 and 1 with entries displaced from their neighbours and the stash.
+  FillSegment(0);
+  for (unsigned bid = 0; bid + 1 < Segment::kBucketNum; ++bid) {
+    const auto& target = segment_.GetBucket(bid);
+    const auto& next = segment_.GetBucket(bid + 1);
+    for (unsigned fp = 0; fp < 256; ++fp) {
+      uint32_t expected = target.Find(fp, false) | (next.Find(fp, true) << 16);
+      EXPECT_EQ(expected, target.FindWithNext(fp, next)) << bid << " " << fp;
+    }
+  }
+}
+#endif
+
 TEST_F(DashTest, Segment) {
   std::unique_ptr<Segment> seg(new Segment(1));
 
@@ -334,6 +353,61 @@ TEST_F(DashTest, Split) {
   EXPECT_EQ(4 * Segment::kSlotNum, keys.size());
 }
 
+TEST_F(DashTest, IncrementalSplit) {
+  dt_.SetSplitStep(4);
+
+  absl::flat_hash_map<uint64_t, uint64_t> expected;
+  std::mt19937_64 rng(0);
+  bool pending = false;
+  for (unsigned i = 0; i < 200000; ++i) {
+    uint64_t key = rng() % 50000;
+    switch (rng() % 4) {
+      case 0:
+      case 1: {
+        auto [it, inserted] = dt_.Insert(key, key * 2);
+        ASSERT_EQ(inserted, expected.emplace(key, key * 2).second);
+        ASSERT_EQ(it->first, key);
+        break;
+      }
+      case 2:
+        ASSERT_EQ(dt_.Erase(key), expected.erase(key));
+        break;
+      case 3: {
+        auto it = dt_.Find(key);
+        ASSERT_EQ(it.is_done(), !expected.contains(key)) << key;
+        if (!it.is_done())
+          ASSERT_EQ(it->second, key * 2);
+        break;
+      }
+    }
+    ASSERT_EQ(dt_.size(), expected.size());
+    pending |= dt_.HasPendingSplit();
+  }
+  EXPECT_TRUE(pending);
+
+  // Traversal covers keys that are not moved yet.
+  while (!dt_.HasPendingSplit()) {
+    uint64_t key = rng();
+    dt_.Insert(key, key * 2);
+    expected.emplace(key, key * 2);
+  }
+
+  set<uint64_t> traversed;
+  Dash64::Cursor cursor;
+  do {
+    cursor = dt_.Traverse(cursor, [&](Dash64::iterator it) { traversed.insert(it->first); });
+  } while (cursor);
+  EXPECT_EQ(traversed.size(), expected.size());
+
+  dt_.FinishSplit();
+  EXPECT_FALSE(dt_.HasPendingSplit());
+  for (const auto& [key, value] : expected) {
+    auto it = dt_.Find(key);
+    ASSERT_FALSE(it.is_done()) << key;
+    EXPECT_EQ(it->second, value);
+  }
+}
+
 TEST_F(DashTest, Merge) {
   set<Segment::Key_t> keys = FillSegment(0);
   Segment s2{2};  // segment with local depth 2.
@@ -496,6 +570,50 @@ TEST_F(DashTest, FindByValue) {
   EXPECT_EQ(segment.Value(it.index, it.slot), 2);
 }
 
+TEST_F(DashTest, FindBatch) {
+  constexpr size_t kNumItems = 10000;
+  for (uint64_t i = 0; i < kNumItems; ++i) {
+    dt_.Insert(i, i * 2);
+  }
+
+  // Keys past kNumItems are missing, the count is not a multiple of the batch size
+  vector<uint64_t> keys;
+  for (uint64_t i = 0; i < kNumItems * 2; i += 2)
+    keys.push_back(i * 3 + 1);
+  keys.resize(keys.size() - 3);
+
+  vector<size_t> indices;
+  dt_.FindBatch(keys.data(), keys.size(), [&](size_t index, Dash64::iterator it) {
+    indices.push_back(index);
+    if (keys[index] < kNumItems) {
+      ASSERT_FALSE(it.is_done());
+      EXPECT_EQ(it->first, keys[index]);
+      EXPECT_EQ(it->second, keys[index] * 2);
+    } else {
+      EXPECT_TRUE(it.is_done());
+    }
+  });
+
+  ASSERT_EQ(indices.size(), keys.size());
+  for (size_t i = 0; i < indices.size(); ++i)
+    EXPECT_EQ(indices[i], i);
+}
+
+TEST_F(DashTest, FindWithHash) {
+  constexpr size_t kNumItems = 1000;
+  for (uint64_t i = 0; i < kNumItems; ++i) {
+    dt_.Insert(i, i * 2);
+  }
+
+  uint64_t hashes[2] = {dt_.DoHash(uint64_t(7)), dt_.DoHash(kNumItems + 7)};
+  dt_.Prefetch(hashes, 2);
+
+  auto it = dt_.Find(uint64_t(7), hashes[0]);
+  ASSERT_FALSE(it.is_done());
+  EXPECT_EQ(it->second, 14);
+  EXPECT_TRUE(dt_.Find(kNumItems + 7, hashes[1]).is_done());
+}
+
 TEST_F(DashTest, Reserve) {
   unsigned bc = dt_.capacity();
   for (unsigned i = 0; i <= bc * 2; ++i) {
@@ -1194,6 +1312,25 @@ static void BM_FindExisting(benchmark::State& state) {
 }
 BENCHMARK(BM_FindExisting)->Arg(1000000)->Arg(2000000);
 
+static void BM_FindBatch(benchmark::State& state) {
+  unsigned count = state.range(0);
+
+  Dash64 dt;
+  for (unsigned i = 0; i < count; ++i) {
+    dt.Insert(i, 0);
+  }
+
+  uint64_t keys[100];
+  uint64_t next = 0;
+  while (state.KeepRunning()) {
+    for (unsigned i = 0; i < 100; ++i) {
+      keys[i] = next++ % count;
+    }
+    dt.FindBatch(keys, 100, [](size_t, Dash64::iterator it) { benchmark::DoNotOptimize(it); });
+  }
+}
+BENCHMARK(BM_FindBatch)->Arg(1000000)->Arg(2000000);
+
 // dict memory usage is in [32*n + 8*n, 32*n + 16*n], or
 // per entry usage is [40, 48].
 static void BM_RedisDictFind(benchmark::State& state) {
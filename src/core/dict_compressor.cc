@@ -0,0 +1,156 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/dict_compressor.h"
+
+#include <zdict.h>
+#include <zstd.h>
+
+#include <thread>
+
+#include "base/logging.h"
+#include "util/fibers/synchronization.h"
+
+namespace dfly {
+
+using namespace std;
+
+namespace {
+
+constexpr int kCompressionLevel = 3;
+
+// zstd recommends training on about 100 times the size of the dictionary. Samples are copies of
+// values kept outside of the shard's memory accounting, so their total size is bounded
+constexpr size_t kSamplesPerDictByte = 100;
+constexpr size_t kMaxSamplesSize = 16 * 1024 * 1024;
+
+// Compressed values are used only if they're at least 1/8 smaller, otherwise the cost of
+// decompression on every read is not worth it
+bool IsWorthIt(size_t compressed, size_t raw) {
+  return compressed + raw / 8 <= raw;
+}
+
+}  // namespace
+
+DictCompressor::DictCompressor(size_t dict_size) : dict_size_{dict_size} {
+  DCHECK_LE(dict_size, kMaxDictSize);
+}
+
+DictCompressor::~DictCompressor() {
+  train_fiber_.JoinIfNeeded();
+
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+  ZSTD_freeCCtx(cctx_);
+  ZSTD_freeDCtx(dctx_);
+}
+
+string_view DictCompressor::Compress(string_view value, string* scratch) {
+  if (value.size() < kMinValueSize || value.size() > kMaxValueSize)
+    return {};
+
+  if (!cdict_) {
+    if (!training_) {
+      samples_.append(value);
+      sample_sizes_.push_back(value.size());
+      if (samples_.size() >= min(dict_size_ * kSamplesPerDictByte, kMaxSamplesSize))
+        StartTraining();
+    }
+    return {};
+  }
+
+  scratch->resize(ZSTD_compressBound(value.size()));
+  size_t res = ZSTD_compress2(cctx_, scratch->data(), scratch->size(), value.data(), value.size());
+  if (ZSTD_isError(res) || !IsWorthIt(res, value.size()))
+    return {};
+
+  return string_view{scratch->data(), res};
+}
+
+bool DictCompressor::Decompress(string_view blob, size_t raw_size, char* dest) {
+  DCHECK(ddict_);
+  size_t res =
+      ZSTD_decompress_usingDDict(dctx_, dest, raw_size, blob.data(), blob.size(), ddict_);
+  return res == raw_size;
+}
+
+bool DictCompressor::LoadDict(string_view dict) {
+  if (cdict_)
+    return true;
+
+  if (ZDICT_getDictID(dict.data(), dict.size()) == 0) {
+    LOG(WARNING) << "Invalid value dictionary of " << dict.size() << " bytes";
+    return false;
+  }
+  return UseDict(dict);
+}
+
+void DictCompressor::StartTraining() {
+  training_ = true;
+
+  // Training takes up to seconds, so it runs on a helper thread while a fiber waits for it.
+  // Posted, as Compress() is called from callbacks that must not be preempted
+  auto train = [this, samples = std::move(samples_), sample_sizes = std::move(sample_sizes_)] {
+    string dict(dict_size_, '\0');
+    size_t res = 0;
+    util::fb2::Done done;
+    thread trainer{[&] {
+      res = ZDICT_trainFromBuffer(dict.data(), dict.size(), samples.data(), sample_sizes.data(),
+                                  sample_sizes.size());
+      done.Notify();
+    }};
+    done.Wait();
+    trainer.join();
+
+    if (ZDICT_isError(res)) {
+      LOG(WARNING) << "Failed to train value dictionary from " << sample_sizes.size()
+                   << " samples: " << ZDICT_getErrorName(res);
+      return;
+    }
+
+    // A dictionary could have been loaded in the meantime
+    if (cdict_)
+      return;
+
+    VLOG(1) << "Trained value dictionary of " << res << " bytes from " << sample_sizes.size()
+            << " samples";
+    dict.resize(res);
+    UseDict(dict);
+  };
+  train_fiber_ = util::fb2::Fiber(util::fb2::Launch::post, "dict_train", std::move(train));
+
+  // Free the memory of samples, they're owned by the fiber now
+  string{}.swap(samples_);
+  vector<size_t>{}.swap(sample_sizes_);
+}
+
+bool DictCompressor::UseDict(string_view dict) {
+  DCHECK(!cdict_);
+  cdict_ = ZSTD_createCDict(dict.data(), dict.size(), kCompressionLevel);
+  ddict_ = ZSTD_createDDict(dict.data(), dict.size());
+  if (!cdict_ || !ddict_) {
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+    cdict_ = nullptr;
+    ddict_ = nullptr;
+    return false;
+  }
+
+  cctx_ = ZSTD_createCCtx();
+  dctx_ = ZSTD_createDCtx();
+  ZSTD_CCtx_refCDict(cctx_, cdict_);
+
+  // Sizes are stored by CompactObj and the dictionary is implied, so leave them out of frames
+  ZSTD_CCtx_setParameter(cctx_, ZSTD_c_contentSizeFlag, 0);
+  ZSTD_CCtx_setParameter(cctx_, ZSTD_c_dictIDFlag, 0);
+
+  dict_.assign(dict);
+
+  // Samples of a dictionary that was being trained are not needed anymore
+  string{}.swap(samples_);
+  vector<size_t>{}.swap(sample_sizes_);
+  return true;
+}
+
+}  // namespace dfly
@@ -0,0 +1,75 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/fibers/fibers.h"
+
+typedef struct ZSTD_CCtx_s ZSTD_CCtx;
+typedef struct ZSTD_DCtx_s ZSTD_DCtx;
+typedef struct ZSTD_CDict_s ZSTD_CDict;
+typedef struct ZSTD_DDict_s ZSTD_DDict;
+
+namespace dfly {
+
+// Compresses small string values with a zstd dictionary. The dictionary is trained once from the
+// first values passed to Compress() or loaded from a snapshot, and never replaced afterwards, as
+// compressed values depend on it. Owned by a single shard. Training runs on a helper thread and
+// the dictionary is installed by a fiber of the owning thread once it's ready.
+class DictCompressor {
+ public:
+  // Only values within these bounds are compressed. Smaller ones gain too little, larger ones
+  // compress well enough without a dictionary and are expensive to decompress on every read.
+  static constexpr size_t kMinValueSize = 64;
+  static constexpr size_t kMaxValueSize = 4096;
+
+  // Larger dictionaries need more samples than are kept for training, zstd defaults to 110KB
+  static constexpr size_t kMaxDictSize = 256 * 1024;
+
+  explicit DictCompressor(size_t dict_size);
+  ~DictCompressor();
+
+  DictCompressor(const DictCompressor&) = delete;
+  DictCompressor& operator=(const DictCompressor&) = delete;
+
+  // Compress value into scratch. Returns empty view if there is no dictionary yet or compression
+  // doesn't reduce the size substantially. Until the dictionary is trained, values are sampled
+  // and training starts in the background once there are enough samples.
+  std::string_view Compress(std::string_view value, std::string* scratch);
+
+  // Decompress blob into dest of raw_size bytes. Returns false if blob is corrupted
+  bool Decompress(std::string_view blob, size_t raw_size, char* dest);
+
+  // Use dict instead of training one. Ignored if there is a dictionary already, a running training
+  // is discarded. Returns false if dict is not a valid dictionary
+  bool LoadDict(std::string_view dict);
+
+  // Dictionary in use, empty if there is none yet
+  std::string_view dict() const {
+    return dict_;
+  }
+
+ private:
+  void StartTraining();
+  bool UseDict(std::string_view dict);
+
+  size_t dict_size_;
+  bool training_ = false;  // samples are not collected anymore once training started
+  util::fb2::Fiber train_fiber_;
+
+  std::string samples_;  // concatenated samples for training
+  std::vector<size_t> sample_sizes_;
+
+  std::string dict_;
+  ZSTD_CCtx* cctx_ = nullptr;
+  ZSTD_DCtx* dctx_ = nullptr;
+  ZSTD_CDict* cdict_ = nullptr;
+  ZSTD_DDict* ddict_ = nullptr;
+};
+
+}  // namespace dfly
@@ -0,0 +1,103 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/dict_compressor.h"
+
+#include <absl/strings/str_cat.h>
+
+#include <random>
+
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "util/fibers/fibers.h"
+
+namespace dfly {
+
+using namespace std;
+
+class DictCompressorTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kDictSize = 4096;
+
+  // JSON-ish session blob of about 300 bytes
+  string MakeValue() {
+    return absl::StrCat(R"({"user_id":)", rng_() % 1000000, R"(,"session":")", rng_(),
+                        R"(","roles":["reader",")", rng_() % 2 ? "writer" : "admin",
+                        R"("],"preferences":{"theme":")", rng_() % 2 ? "dark" : "light",
+                        R"(","language":"en-US","notifications":)", rng_() % 2 ? "true" : "false",
+                        R"(},"cart":{"items":)", rng_() % 10, R"(,"total":)", rng_() % 1000,
+                        R"(},"last_page":"/products/)", rng_() % 100000,
+                        R"(","user_agent":"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36"})");
+  }
+
+  // Compress values until the dictionary is trained, yielding to the fiber that installs it
+  void Train(DictCompressor* dc) {
+    while (dc->dict().empty()) {
+      ASSERT_TRUE(dc->Compress(MakeValue(), &scratch_).empty());
+      util::ThisFiber::Yield();
+    }
+  }
+
+  mt19937_64 rng_{42};
+  string scratch_;
+};
+
+TEST_F(DictCompressorTest, Basic) {
+  DictCompressor dc{kDictSize};
+  Train(&dc);
+  EXPECT_LE(dc.dict().size(), kDictSize);
+
+  size_t raw_size = 0, compressed_size = 0;
+  for (unsigned i = 0; i < 100; ++i) {
+    string value = MakeValue();
+    string_view blob = dc.Compress(value, &scratch_);
+    ASSERT_FALSE(blob.empty());
+
+    raw_size += value.size();
+    compressed_size += blob.size();
+
+    string res(value.size(), '\0');
+    ASSERT_TRUE(dc.Decompress(blob, value.size(), res.data()));
+    EXPECT_EQ(value, res);
+  }
+  EXPECT_GT(raw_size, compressed_size * 2);
+
+  // Too small, too large and incompressible values
+  EXPECT_TRUE(dc.Compress(string(DictCompressor::kMinValueSize - 1, 'a'), &scratch_).empty());
+  EXPECT_TRUE(dc.Compress(string(DictCompressor::kMaxValueSize + 1, 'a'), &scratch_).empty());
+
+  string random(256, '\0');
+  for (char& c : random)
+    c = rng_();
+  EXPECT_TRUE(dc.Compress(random, &scratch_).empty());
+}
+
+TEST_F(DictCompressorTest, LoadDict) {
+  DictCompressor dc{kDictSize};
+  Train(&dc);
+
+  string value = MakeValue();
+  string blob{dc.Compress(value, &scratch_)};
+  ASSERT_FALSE(blob.empty());
+
+  DictCompressor dc2{kDictSize};
+  EXPECT_FALSE(dc2.LoadDict("not a dictionary"));
+  EXPECT_TRUE(dc2.dict().empty());
+
+  ASSERT_TRUE(dc2.LoadDict(dc.dict()));
+  EXPECT_EQ(dc.dict(), dc2.dict());
+
+  string res(value.size(), '\0');
+  ASSERT_TRUE(dc2.Decompress(blob, value.size(), res.data()));
+  EXPECT_EQ(value, res);
+  EXPECT_FALSE(dc2.Decompress(blob, value.size() - 1, res.data()));
+
+  // Dictionary in use is never replaced
+  DictCompressor dc3{kDictSize};
+  Train(&dc3);
+  dc2.LoadDict(dc3.dict());
+  EXPECT_EQ(dc.dict(), dc2.dict());
+}
+
+}  // namespace dfly
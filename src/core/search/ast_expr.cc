@@ -19,6 +19,16 @@ namespace dfly::search {
 AstTermNode::AstTermNode(string term) : term{term} {
 }
 
+AstPrefixNode::AstPrefixNode(string prefix) : prefix{std::move(prefix)} {
+}
+
+AstSuffixNode::AstSuffixNode(string suffix) : suffix{std::move(suffix)} {
+}
+
+AstFuzzyNode::AstFuzzyNode(string term, uint32_t distance)
+    : term{std::move(term)}, distance{distance} {
+}
+
 AstRangeNode::AstRangeNode(double lo, bool lo_excl, double hi, bool hi_excl)
     : lo{lo_excl ? nextafter(lo, hi) : lo}, hi{hi_excl ? nextafter(hi, lo) : hi} {
 }
@@ -45,16 +55,17 @@ AstFieldNode::AstFieldNode(string field, AstNode&& node)
     : field{field.substr(1)}, node{make_unique<AstNode>(std::move(node))} {
 }
 
-AstTagsNode::AstTagsNode(std::string tag) {
-  tags = {std::move(tag)};
+AstTagsNode::AstTagsNode(std::string tag, bool prefix) {
+  (prefix ? prefixes : tags) = {std::move(tag)};
 }
 
-AstTagsNode::AstTagsNode(AstExpr&& l, std::string tag) {
+AstTagsNode::AstTagsNode(AstExpr&& l, std::string tag, bool prefix) {
   DCHECK(holds_alternative<AstTagsNode>(l));
   auto& tags_node = get<AstTagsNode>(l);
 
   tags = std::move(tags_node.tags);
-  tags.push_back(std::move(tag));
+  prefixes = std::move(tags_node.prefixes);
+  (prefix ? prefixes : tags).push_back(std::move(tag));
 }
 
 AstKnnNode::AstKnnNode(uint32_t limit, std::string_view field, OwnedFtVector vec,
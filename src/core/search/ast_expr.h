@@ -29,6 +29,33 @@ struct AstTermNode {
   std::string term;
 };
 
+// Matches all terms in text fields starting with prefix
+struct AstPrefixNode {
+  AstPrefixNode(std::string prefix);
+
+  std::string prefix;
+};
+
+// Matches all terms in text fields ending with suffix
+struct AstSuffixNode {
+  AstSuffixNode(std::string suffix);
+
+  std::string suffix;
+};
+
+// Matches all terms in text fields within a Levenshtein distance of term
+struct AstFuzzyNode {
+  AstFuzzyNode() = default;  // required by parser symbol storage
+  AstFuzzyNode(std::string term, uint32_t distance);
+
+  friend std::ostream& operator<<(std::ostream& stream, const AstFuzzyNode& node) {
+    return stream;
+  }
+
+  std::string term;
+  uint32_t distance = 0;
+};
+
 // Matches numeric range
 struct AstRangeNode {
   AstRangeNode(double lo, bool lo_excl, double hi, bool hi_excl);
@@ -64,10 +91,11 @@ struct AstFieldNode {
 
 // Stores a list of tags for a tag query
 struct AstTagsNode {
-  AstTagsNode(std::string tag);
-  AstTagsNode(AstNode&& l, std::string tag);
+  AstTagsNode(std::string tag, bool prefix = false);
+  AstTagsNode(AstNode&& l, std::string tag, bool prefix = false);
 
   std::vector<std::string> tags;
+  std::vector<std::string> prefixes;  // match all tags starting with any of them
 };
 
 // Applies nearest neighbor search to the final result set
@@ -97,8 +125,9 @@ struct AstSortNode {
 };
 
 using NodeVariants =
-    std::variant<std::monostate, AstStarNode, AstTermNode, AstRangeNode, AstNegateNode,
-                 AstLogicalNode, AstFieldNode, AstTagsNode, AstKnnNode, AstSortNode>;
+    std::variant<std::monostate, AstStarNode, AstTermNode, AstPrefixNode, AstSuffixNode,
+                 AstFuzzyNode, AstRangeNode, AstNegateNode, AstLogicalNode, AstFieldNode,
+                 AstTagsNode, AstKnnNode, AstSortNode>;
 
 struct AstNode : public NodeVariants {
   using variant::variant;
@@ -21,7 +21,10 @@ namespace dfly::search {
 
 using DocId = uint32_t;
 
-enum class VectorSimilarity { L2, COSINE };
+enum class VectorSimilarity { L2, COSINE, IP };
+
+// Scalar quantization of vectors stored by vector indices
+enum class VectorQuantization { NONE, FP16, INT8 };
 
 using OwnedFtVector = std::pair<std::unique_ptr<float[]>, size_t /* dimension (size) */>;
 
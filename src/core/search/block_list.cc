@@ -1,18 +1,139 @@
 #include "core/search/block_list.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 namespace dfly::search {
 
 using namespace std;
 
+namespace {
+
+// Kernels write matches to dst and return the past-the-end pointer. dst must have space for
+// min(l.size(), r.size()) + kIntersectSlack elements, as kernels write whole vector registers.
+constexpr size_t kIntersectSlack = 8;
+
+using IntersectFn = DocId* (*)(absl::Span<const DocId>, absl::Span<const DocId>, DocId* dst);
+
+DocId* IntersectScalar(absl::Span<const DocId> l, absl::Span<const DocId> r, DocId* dst) {
+  size_t i = 0, j = 0;
+  while (i < l.size() && j < r.size()) {
+    DocId lv = l[i], rv = r[j];
+    *dst = lv;
+    dst += lv == rv;
+    i += lv <= rv;
+    j += rv <= lv;
+  }
+  return dst;
+}
+
+#if defined(__x86_64__)
+
+// Compare a window of l with all rotations of a window of r, every set bit of the resulting mask
+// is an element of the l window present in the r window. The window with the smaller maximum is
+// advanced, both if equal. Because ids are unique, a match is never reported twice.
+
+DocId* IntersectSse(absl::Span<const DocId> l, absl::Span<const DocId> r, DocId* dst) {
+  size_t i = 0, j = 0;
+  while (i + 4 <= l.size() && j + 4 <= r.size()) {
+    __m128i lv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l.data() + i));
+    __m128i rv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r.data() + j));
+
+    __m128i eq = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(lv, rv),
+                     _mm_cmpeq_epi32(lv, _mm_shuffle_epi32(rv, _MM_SHUFFLE(0, 3, 2, 1)))),
+        _mm_or_si128(_mm_cmpeq_epi32(lv, _mm_shuffle_epi32(rv, _MM_SHUFFLE(1, 0, 3, 2))),
+                     _mm_cmpeq_epi32(lv, _mm_shuffle_epi32(rv, _MM_SHUFFLE(2, 1, 0, 3)))));
+
+    for (unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(eq)); mask; mask &= mask - 1)
+      *dst++ = l[i + __builtin_ctz(mask)];
+
+    DocId lmax = l[i + 3], rmax = r[j + 3];
+    i += lmax <= rmax ? 4 : 0;
+    j += rmax <= lmax ? 4 : 0;
+  }
+  return IntersectScalar(l.subspan(i), r.subspan(j), dst);
+}
+
+// For every 8 bit match mask, the lane indices of its set bits in ascending order. Used to compact
+// matches without branching on individual bits.
+struct CompactTable {
+  constexpr CompactTable() : lanes{} {
+    for (unsigned mask = 0; mask < 256; mask++) {
+      unsigned pos = 0;
+      for (unsigned lane = 0; lane < 8; lane++) {
+        if (mask & (1u << lane))
+          lanes[mask][pos++] = lane;
+      }
+    }
+  }
+
+  uint8_t lanes[256][8];
+};
+
+constexpr CompactTable kCompactTable{};
+
+__attribute__((target("avx2"))) DocId* IntersectAvx2(absl::Span<const DocId> l,
+                                                     absl::Span<const DocId> r, DocId* dst) {
+  const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+
+  size_t i = 0, j = 0;
+  while (i + 8 <= l.size() && j + 8 <= r.size()) {
+    __m256i lv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(l.data() + i));
+    __m256i rv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r.data() + j));
+
+    __m256i eq = _mm256_cmpeq_epi32(lv, rv);
+    for (unsigned k = 1; k < 8; k++) {
+      rv = _mm256_permutevar8x32_epi32(rv, rotate);
+      eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(lv, rv));
+    }
+
+    unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+    __m256i lanes = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(kCompactTable.lanes[mask])));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permutevar8x32_epi32(lv, lanes));
+    dst += __builtin_popcount(mask);
+
+    DocId lmax = l[i + 7], rmax = r[j + 7];
+    i += lmax <= rmax ? 8 : 0;
+    j += rmax <= lmax ? 8 : 0;
+  }
+  return IntersectSse(l.subspan(i), r.subspan(j), dst);
+}
+
+#endif
+
+IntersectFn SelectIntersectKernel() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return IntersectAvx2;
+  return IntersectSse;
+#else
+  return IntersectScalar;
+#endif
+}
+
+IntersectFn GetIntersectKernel() {
+  static const IntersectFn kernel = SelectIntersectKernel();
+  return kernel;
+}
+
+}  // namespace
+
 template <typename C> bool BlockList<C>::Insert(DocId t) {
   auto block = FindBlock(t);
-  if (block == blocks_.end())
+  if (block == blocks_.end()) {
     block = blocks_.insert(blocks_.end(), C{blocks_.get_allocator().resource()});
+    bounds_.push_back({t, t});
+  }
 
   if (!block->Insert(t))
     return false;
 
   size_++;
+  UpdateBounds(block);
   TrySplit(block);
   return true;
 }
@@ -20,6 +141,8 @@ template <typename C> bool BlockList<C>::Insert(DocId t) {
 template <typename C> bool BlockList<C>::Remove(DocId t) {
   if (auto block = FindBlock(t); block != blocks_.end() && block->Remove(t)) {
     size_--;
+    if (block->Size() > 0)
+      UpdateBounds(block);
     TryMerge(block);
     return true;
   }
@@ -29,26 +152,30 @@ template <typename C> bool BlockList<C>::Remove(DocId t) {
 
 template <typename C> typename BlockList<C>::BlockIt BlockList<C>::FindBlock(DocId t) {
   DCHECK(blocks_.empty() || blocks_.back().Size() > 0u);
+  DCHECK_EQ(blocks_.size(), bounds_.size());
 
-  if (!blocks_.empty() && t >= *blocks_.back().begin())
+  if (!bounds_.empty() && t >= bounds_.back().min)
     return --blocks_.end();
 
   // Find first block that can't contain t
-  auto it = std::upper_bound(blocks_.begin(), blocks_.end(), t,
-                             [](DocId t, const C& l) { return *l.begin() > t; });
+  auto it = std::upper_bound(bounds_.begin(), bounds_.end(), t,
+                             [](DocId t, const BlockBounds& b) { return b.min > t; });
 
   // Move to previous if possible
-  if (it != blocks_.begin())
+  if (it != bounds_.begin())
     --it;
 
-  DCHECK(it == blocks_.begin() || it->Size() * 2 >= block_size_);
-  DCHECK(it == blocks_.end() || it->Size() <= 2 * block_size_);
-  return it;
+  auto block = blocks_.begin() + (it - bounds_.begin());
+  DCHECK(block == blocks_.begin() || block->Size() * 2 >= block_size_);
+  DCHECK(block == blocks_.end() || block->Size() <= 2 * block_size_);
+  return block;
 }
 
 template <typename C> void BlockList<C>::TryMerge(BlockIt block) {
+  size_t idx = std::distance(blocks_.begin(), block);
   if (block->Size() == 0) {
     blocks_.erase(block);
+    bounds_.erase(bounds_.begin() + idx);
     return;
   }
 
@@ -56,9 +183,10 @@ template <typename C> void BlockList<C>::TryMerge(BlockIt block) {
     return;
 
   // Merge strictly right with left to benefit from tail insert optimizations
-  size_t idx = std::distance(blocks_.begin(), block);
   blocks_[idx - 1].Merge(std::move(*block));
   blocks_.erase(block);
+  bounds_[idx - 1].max = bounds_[idx].max;
+  bounds_.erase(bounds_.begin() + idx);
 
   TrySplit(blocks_.begin() + (idx - 1));  // to not overgrow it
 }
@@ -70,7 +198,17 @@ template <typename C> void BlockList<C>::TrySplit(BlockIt block) {
   auto [left, right] = std::move(*block).Split();
 
   *block = std::move(right);
-  blocks_.insert(block, std::move(left));
+  block = blocks_.insert(block, std::move(left));
+
+  size_t idx = std::distance(blocks_.begin(), block);
+  bounds_.insert(bounds_.begin() + idx, BlockBounds{});
+  UpdateBounds(block);
+  UpdateBounds(block + 1);
+}
+
+template <typename C> void BlockList<C>::UpdateBounds(BlockIt block) {
+  DCHECK_GT(block->Size(), 0u);
+  bounds_[std::distance(blocks_.begin(), block)] = {*block->begin(), block->Back()};
 }
 
 template <typename C>
@@ -78,6 +216,7 @@ typename BlockList<C>::BlockListIterator& BlockList<C>::BlockListIterator::opera
   ++*block_it;
   if (block_it == block_end) {
     ++it;
+    ++bounds_it;
     if (it != it_end) {
       block_it = it->begin();
       block_end = it->end();
@@ -89,6 +228,41 @@ typename BlockList<C>::BlockListIterator& BlockList<C>::BlockListIterator::opera
   return *this;
 }
 
+template <typename C>
+typename BlockList<C>::BlockListIterator& BlockList<C>::BlockListIterator::SeekGE(DocId t) {
+  if (it == it_end || **block_it >= t)
+    return *this;
+
+  if (bounds_it->max < t) {
+    // Binary search for the first following block that can contain t
+    auto bounds_end = bounds_it + (it_end - it);
+    auto next = std::lower_bound(bounds_it + 1, bounds_end, t,
+                                 [](const BlockBounds& b, DocId t) { return b.max < t; });
+    it += next - bounds_it;
+    bounds_it = next;
+
+    if (it == it_end) {
+      block_it = std::nullopt;
+      block_end = std::nullopt;
+      return *this;
+    }
+
+    block_it = it->begin();
+    block_end = it->end();
+    if (bounds_it->min >= t)
+      return *this;
+  }
+
+  // The current block contains an element >= t, so we never run past its end
+  if constexpr (std::is_same_v<C, SortedVector>) {
+    block_it = std::lower_bound(*block_it, *block_end, t);
+  } else {
+    while (**block_it < t)
+      ++*block_it;
+  }
+  return *this;
+}
+
 template class BlockList<CompressedSortedSet>;
 template class BlockList<SortedVector>;
 
@@ -130,4 +304,37 @@ std::pair<SortedVector, SortedVector> SortedVector::Split() && {
   return std::make_pair(std::move(*this), SortedVector{std::move(tail)});
 }
 
+vector<absl::Span<const DocId>> BlockViews(const BlockList<SortedVector>& list) {
+  vector<absl::Span<const DocId>> out(list.blocks_.size());
+  for (size_t i = 0; i < out.size(); i++)
+    out[i] = list.blocks_[i].View();
+  return out;
+}
+
+void IntersectBlocks(absl::Span<const absl::Span<const DocId>> l,
+                     absl::Span<const absl::Span<const DocId>> r, vector<DocId>* out) {
+  IntersectFn kernel = GetIntersectKernel();
+
+  size_t i = 0, j = 0;
+  while (i < l.size() && j < r.size()) {
+    auto lb = l[i], rb = r[j];
+    if (lb.empty()) {
+      i++;
+    } else if (rb.empty()) {
+      j++;
+    } else if (lb.back() < rb.front()) {
+      i++;
+    } else if (rb.back() < lb.front()) {
+      j++;
+    } else {
+      size_t pos = out->size();
+      out->resize(pos + min(lb.size(), rb.size()) + kIntersectSlack);
+      out->resize(kernel(lb, rb, out->data() + pos) - out->data());
+      // Advance the block that ends first, it can't overlap with any following block
+      i += lb.back() <= rb.back();
+      j += rb.back() <= lb.back();
+    }
+  }
+}
+
 }  // namespace dfly::search
@@ -12,6 +12,9 @@
 #include "core/search/compressed_sorted_set.h"
 
 namespace dfly::search {
+
+struct SortedVector;
+
 // BlockList is a container wrapper for CompressedSortedSet / vector<DocId>
 // to divide the full sorted id range into separate blocks. This reduces modification
 // complexity from O(N) to O(logN + K), where K is the max block size.
@@ -22,9 +25,17 @@ template <typename Container /* underlying container */> class BlockList {
   using BlockIt = typename PMR_NS::vector<Container>::iterator;
   using ConstBlockIt = typename PMR_NS::vector<Container>::const_iterator;
 
+  // Smallest and largest element of a block, kept next to the blocks so lookups and skips don't
+  // need to decode them
+  struct BlockBounds {
+    DocId min, max;
+  };
+
+  using ConstBoundsIt = typename PMR_NS::vector<BlockBounds>::const_iterator;
+
  public:
   BlockList(PMR_NS::memory_resource* mr, size_t block_size = 1000)
-      : block_size_{block_size}, blocks_(mr) {
+      : block_size_{block_size}, blocks_(mr), bounds_(mr) {
   }
 
   // Insert element, returns true if inserted, false if already present.
@@ -55,6 +66,9 @@ template <typename Container /* underlying container */> class BlockList {
 
     BlockListIterator& operator++();
 
+    // Advance to the first element not less than t, whole blocks are skipped by their bounds
+    BlockListIterator& SeekGE(DocId t);
+
     friend class BlockList;
 
     bool operator==(const BlockListIterator& other) const {
@@ -66,7 +80,8 @@ template <typename Container /* underlying container */> class BlockList {
     }
 
    private:
-    BlockListIterator(ConstBlockIt begin, ConstBlockIt end) : it(begin), it_end(end) {
+    BlockListIterator(ConstBlockIt begin, ConstBlockIt end, ConstBoundsIt bounds)
+        : it(begin), it_end(end), bounds_it(bounds) {
       if (it != it_end) {
         block_it = it->begin();
         block_end = it->end();
@@ -74,17 +89,21 @@ template <typename Container /* underlying container */> class BlockList {
     }
 
     ConstBlockIt it, it_end;
+    ConstBoundsIt bounds_it;
     std::optional<typename Container::iterator> block_it, block_end;
   };
 
   BlockListIterator begin() const {
-    return BlockListIterator{blocks_.begin(), blocks_.end()};
+    return BlockListIterator{blocks_.begin(), blocks_.end(), bounds_.begin()};
   }
 
   BlockListIterator end() const {
-    return BlockListIterator{blocks_.end(), blocks_.end()};
+    return BlockListIterator{blocks_.end(), blocks_.end(), bounds_.end()};
   }
 
+  // Contiguous views of all blocks in order, only for uncompressed containers
+  friend std::vector<absl::Span<const DocId>> BlockViews(const BlockList<SortedVector>& list);
+
  private:
   // Find block that should contain t. Returns end() only if empty
   BlockIt FindBlock(DocId t);
@@ -92,10 +111,13 @@ template <typename Container /* underlying container */> class BlockList {
   void TryMerge(BlockIt block);  // If needed, merge with previous block
   void TrySplit(BlockIt block);  // If needed, split into two blocks
 
+  void UpdateBounds(BlockIt block);  // Recompute bounds after block was modified
+
  private:
   const size_t block_size_ = 1000;
   size_t size_ = 0;
   PMR_NS::vector<Container> blocks_;
+  PMR_NS::vector<BlockBounds> bounds_;  // bounds_[i] belongs to blocks_[i]
 };
 
 // Supports Insert and Remove operations for keeping a sorted vector internally.
@@ -113,6 +135,14 @@ struct SortedVector {
     return entries_.size();
   }
 
+  DocId Back() const {
+    return entries_.back();
+  }
+
+  absl::Span<const DocId> View() const {
+    return {entries_.data(), entries_.size()};
+  }
+
   using iterator = typename PMR_NS::vector<DocId>::const_iterator;
 
   iterator begin() const {
@@ -130,6 +160,14 @@ struct SortedVector {
   PMR_NS::vector<DocId> entries_;
 };
 
+std::vector<absl::Span<const DocId>> BlockViews(const BlockList<SortedVector>& list);
+
+// Append the intersection of two sorted id sequences, given as ordered lists of contiguous blocks,
+// to out. Pairs of blocks with disjoint ranges are skipped, overlapping ones are intersected with
+// a SIMD kernel if the CPU supports it.
+void IntersectBlocks(absl::Span<const absl::Span<const DocId>> l,
+                     absl::Span<const absl::Span<const DocId>> r, std::vector<DocId>* out);
+
 extern template class BlockList<CompressedSortedSet>;
 extern template class BlockList<SortedVector>;
 
@@ -103,6 +103,77 @@ TYPED_TEST(BlockListTest, RandomNumbers) {
   }
 }
 
+TYPED_TEST(BlockListTest, SeekGE) {
+  auto list = this->Make();
+  std::set<DocId> list_copy;
+  for (size_t i = 0; i < 500; i++) {
+    DocId t = rand() % 10'000;
+    list.Insert(t);
+    list_copy.insert(t);
+  }
+
+  for (size_t i = 0; i < 100; i++) {
+    DocId start = rand() % 10'000, target = start + rand() % 1'000;
+
+    auto it = list.begin().SeekGE(start);
+    it.SeekGE(target);
+
+    auto expected = list_copy.lower_bound(target);
+    if (expected == list_copy.end()) {
+      EXPECT_TRUE(it == list.end());
+    } else {
+      ASSERT_FALSE(it == list.end());
+      EXPECT_EQ(*it, *expected);
+    }
+  }
+
+  // Seeking backwards is a no-op
+  auto it = list.begin().SeekGE(5'000);
+  DocId value = *it;
+  EXPECT_EQ(*it.SeekGE(0), value);
+}
+
+TEST(BlockListIntersectTest, Random) {
+  for (size_t iter = 0; iter < 100; iter++) {
+    BlockList<SortedVector> l{PMR_NS::get_default_resource(), 10}, r{PMR_NS::get_default_resource(), 10};
+    std::set<DocId> l_copy, r_copy;
+
+    DocId range = 100 + rand() % 5'000;
+    for (size_t i = 0; i < 300; i++) {
+      DocId lv = rand() % range, rv = rand() % range;
+      l.Insert(lv);
+      l_copy.insert(lv);
+      r.Insert(rv);
+      r_copy.insert(rv);
+    }
+
+    vector<DocId> out, expected;
+    IntersectBlocks(BlockViews(l), BlockViews(r), &out);
+    set_intersection(l_copy.begin(), l_copy.end(), r_copy.begin(), r_copy.end(),
+                     back_inserter(expected));
+    EXPECT_EQ(out, expected);
+  }
+}
+
+static void BM_IntersectBlocks(benchmark::State& state) {
+  BlockList<SortedVector> l{PMR_NS::get_default_resource()}, r{PMR_NS::get_default_resource()};
+  for (DocId i = 0; i < 100'000; i++) {
+    if (rand() % 2 == 0)
+      l.Insert(i);
+    if (rand() % 3 == 0)
+      r.Insert(i);
+  }
+
+  auto lv = BlockViews(l), rv = BlockViews(r);
+  vector<DocId> out;
+  while (state.KeepRunning()) {
+    out.clear();
+    IntersectBlocks(lv, rv, &out);
+    benchmark::DoNotOptimize(out.data());
+  }
+}
+BENCHMARK(BM_IntersectBlocks);
+
 static void BM_Erase90PctTail(benchmark::State& state) {
   BlockList<CompressedSortedSet> bl{PMR_NS::get_default_resource()};
 
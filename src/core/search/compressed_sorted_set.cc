@@ -214,7 +214,9 @@ std::pair<CompressedSortedSet, CompressedSortedSet> CompressedSortedSet::Split()
 
   // Move iterator to middle position and save size of diffs tail
   auto it = begin();
-  std::advance(it, size_ / 2);
+  std::advance(it, size_ / 2 - 1);
+  IntType last_kept = *it;
+  ++it;
   size_t keep_bytes = it.last_read_.data() - diffs_.data();
 
   // Copy second half into second set
@@ -223,7 +225,7 @@ std::pair<CompressedSortedSet, CompressedSortedSet> CompressedSortedSet::Split()
 
   // Erase diffs tail
   diffs_.resize(keep_bytes);
-  tail_value_ = std::nullopt;
+  tail_value_ = last_kept;
   size_ -= second.Size();
 
   return std::make_pair(std::move(*this), std::move(second));
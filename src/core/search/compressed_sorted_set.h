@@ -63,6 +63,12 @@ class CompressedSortedSet {
   size_t Size() const;
   size_t ByteSize() const;
 
+  // Largest element, set must not be empty
+  IntType Back() const {
+    DCHECK(tail_value_);
+    return *tail_value_;
+  }
+
   // Add all values from other
   void Merge(CompressedSortedSet&& other);
 
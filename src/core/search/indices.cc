@@ -6,6 +6,7 @@
 
 #include <absl/container/flat_hash_set.h>
 #include <absl/strings/ascii.h>
+#include <absl/strings/match.h>
 #include <absl/strings/numbers.h>
 #include <absl/strings/str_join.h>
 #include <absl/strings/str_split.h>
@@ -20,9 +21,16 @@
 #include <uni_algo/ranges_word.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
+#include <cstring>
+#include <thread>
 
 #include "base/logging.h"
+#include "core/search/vector_utils.h"
+#include "util/fibers/fiberqueue_threadpool.h"
+#include "util/fibers/synchronization.h"
 
 namespace dfly::search {
 
@@ -38,6 +46,13 @@ string ToLower(string_view word) {
   return IsAllAscii(word) ? absl::AsciiStrToLower(word) : una::cases::to_lowercase_utf8(word);
 }
 
+// Worker threads for HNSW batch insertions, shared by all shards. Created on first use and never
+// destroyed, as batches can still be running on shutdown
+util::fb2::FiberQueueThreadPool* BatchPool() {
+  static auto* pool = new util::fb2::FiberQueueThreadPool(max(thread::hardware_concurrency(), 1u));
+  return pool;
+}
+
 // Get all words from text as matched by the ICU library
 absl::flat_hash_set<std::string> TokenizeWords(std::string_view text) {
   absl::flat_hash_set<std::string> words;
@@ -46,6 +61,16 @@ absl::flat_hash_set<std::string> TokenizeWords(std::string_view text) {
   return words;
 }
 
+// Count occurrences of all words in text, returns total number of words
+uint32_t CountWords(string_view text, absl::flat_hash_map<string, uint32_t>* counts) {
+  uint32_t total = 0;
+  for (string_view word : una::views::word_only::utf8(text)) {
+    (*counts)[una::cases::to_lowercase_utf8(word)]++;
+    total++;
+  }
+  return total;
+}
+
 // Split taglist, remove duplicates and convert all to lowercase
 // TODO: introduce unicode support if needed
 absl::flat_hash_set<string> NormalizeTags(string_view taglist, bool case_sensitive,
@@ -65,61 +90,303 @@ absl::flat_hash_set<string> NormalizeTags(string_view taglist, bool case_sensiti
 
 };  // namespace
 
-NumericIndex::NumericIndex(PMR_NS::memory_resource* mr) : entries_{mr} {
+NumericIndex::NumericIndex(PMR_NS::memory_resource* mr) : blocks_{mr}, block_max_{mr} {
 }
 
 void NumericIndex::Add(DocId id, DocumentAccessor* doc, string_view field) {
+  size_t added = 0;
   for (auto str : doc->GetStrings(field)) {
     double num;
-    if (absl::SimpleAtod(str, &num))
-      entries_.emplace(num, id);
+    if (!absl::SimpleAtod(str, &num))
+      continue;
+
+    Entry entry{num, id};
+    if (blocks_.empty()) {
+      blocks_.emplace_back().push_back(entry);
+      block_max_.push_back(entry);
+      added++;
+      continue;
+    }
+
+    // Insert into the first block with a larger maximum, or append to the last one
+    size_t bi = lower_bound(block_max_.begin(), block_max_.end(), entry) - block_max_.begin();
+    bi = min(bi, blocks_.size() - 1);
+
+    Block& block = blocks_[bi];
+    auto it = lower_bound(block.begin(), block.end(), entry);
+    if (it != block.end() && *it == entry)
+      continue;
+
+    block.insert(it, entry);
+    block_max_[bi] = block.back();
+    added++;
+
+    if (block.size() > kMaxBlockSize) {
+      Block tail{block.begin() + block.size() / 2, block.end(), block.get_allocator()};
+      block.resize(block.size() / 2);
+      block_max_[bi] = block.back();
+      block_max_.insert(block_max_.begin() + bi + 1, tail.back());
+      blocks_.insert(blocks_.begin() + bi + 1, std::move(tail));
+    }
   }
+
+  max_id_ = max(max_id_, id);
+  multi_value_docs_ += added > 1;
 }
 
 void NumericIndex::Remove(DocId id, DocumentAccessor* doc, string_view field) {
+  size_t removed = 0;
   for (auto str : doc->GetStrings(field)) {
     double num;
-    if (absl::SimpleAtod(str, &num))
-      entries_.erase({num, id});
+    if (!absl::SimpleAtod(str, &num))
+      continue;
+
+    Entry entry{num, id};
+    size_t bi = lower_bound(block_max_.begin(), block_max_.end(), entry) - block_max_.begin();
+    if (bi == blocks_.size())
+      continue;
+
+    Block& block = blocks_[bi];
+    auto it = lower_bound(block.begin(), block.end(), entry);
+    if (it == block.end() || *it != entry)
+      continue;
+
+    block.erase(it);
+    removed++;
+
+    if (block.empty()) {
+      blocks_.erase(blocks_.begin() + bi);
+      block_max_.erase(block_max_.begin() + bi);
+    } else {
+      block_max_[bi] = block.back();
+    }
   }
+
+  multi_value_docs_ -= removed > 1;
+}
+
+pair<size_t, size_t> NumericIndex::FindBlocks(double l, double r) const {
+  auto first = lower_bound(block_max_.begin(), block_max_.end(), Entry{l, 0});
+  auto last = lower_bound(first, block_max_.end(), Entry{r, numeric_limits<DocId>::max()});
+  return {first - block_max_.begin(), min<size_t>(last - block_max_.begin() + 1, blocks_.size())};
 }
 
 vector<DocId> NumericIndex::Range(double l, double r) const {
-  auto it_l = entries_.lower_bound({l, 0});
-  auto it_r = entries_.lower_bound({r, numeric_limits<DocId>::max()});
+  if (l > r)
+    return {};
+
+  auto [first, last] = FindBlocks(l, r);
+  Entry lo{l, 0}, hi{r, numeric_limits<DocId>::max()};
 
+  // Matching entries of a block, only the outer ones have to be searched
+  auto matching = [&](size_t bi) {
+    const Block& block = blocks_[bi];
+    auto begin = bi == first ? lower_bound(block.begin(), block.end(), lo) : block.begin();
+    auto end = bi + 1 == last ? upper_bound(begin, block.end(), hi) : block.end();
+    return make_pair(begin, end);
+  };
+
+  size_t candidates = 0;
+  for (size_t bi = first; bi < last; bi++)
+    candidates += blocks_[bi].size();
+
+  // Large results are ordered with a bitmap over all ids, which also removes duplicates of
+  // documents with multiple values. Small ones are sorted.
   vector<DocId> out;
-  for (auto it = it_l; it != it_r; ++it)
-    out.push_back(it->second);
+  if (candidates * 32 >= max_id_) {
+    vector<uint64_t> bitmap(max_id_ / 64 + 1, 0);
+    size_t matched = 0;
+    for (size_t bi = first; bi < last; bi++) {
+      auto [begin, end] = matching(bi);
+      for (auto it = begin; it != end; ++it)
+        bitmap[it->second / 64] |= uint64_t(1) << (it->second % 64);
+      matched += end - begin;
+    }
+
+    out.reserve(matched);
+    for (size_t i = 0; i < bitmap.size(); i++) {
+      for (uint64_t word = bitmap[i]; word != 0; word &= word - 1)
+        out.push_back(i * 64 + __builtin_ctzll(word));
+    }
+    return out;
+  }
+
+  out.reserve(candidates);
+  for (size_t bi = first; bi < last; bi++) {
+    auto [begin, end] = matching(bi);
+    for (auto it = begin; it != end; ++it)
+      out.push_back(it->second);
+  }
 
   sort(out.begin(), out.end());
-  out.erase(unique(out.begin(), out.end()), out.end());
+  if (multi_value_docs_ > 0)
+    out.erase(unique(out.begin(), out.end()), out.end());
   return out;
 }
 
+size_t NumericIndex::Count(double l, double r) const {
+  // Documents with multiple values can match more than once
+  if (multi_value_docs_ > 0)
+    return Range(l, r).size();
+
+  if (l > r)
+    return 0;
+
+  auto [first, last] = FindBlocks(l, r);
+  Entry lo{l, 0}, hi{r, numeric_limits<DocId>::max()};
+
+  size_t count = 0;
+  for (size_t bi = first; bi < last; bi++)
+    count += blocks_[bi].size();
+
+  if (first < last) {
+    const Block& front = blocks_[first];
+    count -= lower_bound(front.begin(), front.end(), lo) - front.begin();
+
+    const Block& back = blocks_[last - 1];
+    count -= back.end() - upper_bound(back.begin(), back.end(), hi);
+  }
+  return count;
+}
+
 template <typename C>
 BaseStringIndex<C>::BaseStringIndex(PMR_NS::memory_resource* mr, bool case_sensitive)
-    : case_sensitive_{case_sensitive}, entries_{mr} {
+    : case_sensitive_{case_sensitive}, entries_{mr}, reversed_terms_{mr} {
 }
 
 template <typename C>
-const typename BaseStringIndex<C>::Container* BaseStringIndex<C>::Matching(string_view str) const {
+string_view BaseStringIndex<C>::Normalize(string_view str, string* tmp) const {
   str = absl::StripAsciiWhitespace(str);
+  if (case_sensitive_)
+    return str;
+
+  *tmp = ToLower(str);
+  return *tmp;
+}
 
+template <typename C>
+const typename BaseStringIndex<C>::Container* BaseStringIndex<C>::Matching(string_view str) const {
+  string tmp;
+  auto it = entries_.find(Normalize(str, &tmp));
+  return (it != entries_.end()) ? &it->second : nullptr;
+}
+
+template <typename C>
+vector<const typename BaseStringIndex<C>::Container*> BaseStringIndex<C>::MatchingPrefix(
+    string_view prefix, size_t max_terms) const {
+  string tmp;
+  prefix = Normalize(prefix, &tmp);
+
+  vector<const Container*> out;
+  for (auto it = entries_.lower_bound(prefix);
+       it != entries_.end() && out.size() < max_terms && absl::StartsWith(it->first, prefix); ++it)
+    out.push_back(&it->second);
+  return out;
+}
+
+template <typename C>
+vector<const typename BaseStringIndex<C>::Container*> BaseStringIndex<C>::MatchingSuffix(
+    string_view suffix, size_t max_terms) const {
   string tmp;
-  if (!case_sensitive_) {
-    tmp = ToLower(str);
-    str = tmp;
+  suffix = Normalize(suffix, &tmp);
+  string reversed{suffix.rbegin(), suffix.rend()};
+
+  if (!reversed_terms_built_) {
+    for (const auto& [term, _] : entries_)
+      reversed_terms_.emplace(term.rbegin(), term.rend());
+    reversed_terms_built_ = true;
   }
 
-  auto it = entries_.find(str);
-  return (it != entries_.end()) ? &it->second : nullptr;
+  vector<const Container*> out;
+  string term;
+  for (auto it = reversed_terms_.lower_bound(reversed); it != reversed_terms_.end() &&
+                                                         out.size() < max_terms &&
+                                                         absl::StartsWith(*it, reversed);
+       ++it) {
+    term.assign(it->rbegin(), it->rend());
+    auto entry = entries_.find(term);
+    DCHECK(entry != entries_.end());
+    out.push_back(&entry->second);
+  }
+  return out;
+}
+
+// Terms are visited in sorted order like in a trie walk: rows of the Levenshtein matrix for a
+// prefix shared with the previous term are reused, and once all values of a row exceed the
+// distance, all terms with that prefix are skipped with a single seek.
+template <typename C>
+vector<const typename BaseStringIndex<C>::Container*> BaseStringIndex<C>::MatchingFuzzy(
+    string_view term, uint32_t distance, size_t max_terms) const {
+  string tmp;
+  term = Normalize(term, &tmp);
+
+  // rows[i * width + j] is the distance between the first i bytes of a key and first j of term
+  const size_t width = term.size() + 1;
+  vector<uint32_t> rows(width);
+  for (size_t j = 0; j < width; j++)
+    rows[j] = j;
+
+  vector<const Container*> out;
+  string_view prev;      // last visited key
+  size_t prev_rows = 0;  // number of computed rows for prefixes of prev
+
+  auto it = entries_.begin();
+  while (it != entries_.end() && out.size() < max_terms) {
+    string_view key = it->first;
+    size_t common = mismatch(key.begin(), key.end(), prev.begin(), prev.end()).first - key.begin();
+    common = min(common, prev_rows);
+
+    bool skipped = false;
+    for (size_t i = common; i < key.size() && !skipped; i++) {
+      rows.resize(max(rows.size(), (i + 2) * width));
+      const uint32_t* above = &rows[i * width];
+      uint32_t* row = &rows[(i + 1) * width];
+
+      row[0] = i + 1;
+      uint32_t row_min = row[0];
+      for (size_t j = 1; j < width; j++) {
+        row[j] = min({above[j] + 1, row[j - 1] + 1, above[j - 1] + (key[i] != term[j - 1])});
+        row_min = min(row_min, row[j]);
+      }
+
+      // No term starting with key[0, i] can match, seek past all of them
+      if (row_min > distance) {
+        prev = key;
+        prev_rows = i + 1;
+        skipped = true;
+
+        string next{key.substr(0, i + 1)};
+        while (!next.empty() && uint8_t(next.back()) == 0xFF)
+          next.pop_back();
+        if (next.empty()) {
+          it = entries_.end();
+        } else {
+          next.back()++;
+          it = entries_.lower_bound(next);
+        }
+      }
+    }
+
+    if (skipped)
+      continue;
+
+    if (rows[key.size() * width + term.size()] <= distance)
+      out.push_back(&it->second);
+
+    prev = key;
+    prev_rows = key.size();
+    ++it;
+  }
+  return out;
 }
 
 template <typename C>
 typename BaseStringIndex<C>::Container* BaseStringIndex<C>::GetOrCreate(string_view word) {
   auto* mr = entries_.get_allocator().resource();
-  return &entries_.try_emplace(PMR_NS::string{word, mr}, mr, 1000 /* block size */).first->second;
+  auto [it, inserted] = entries_.try_emplace(PMR_NS::string{word, mr}, mr, 1000 /* block size */);
+  if (inserted && reversed_terms_built_)
+    reversed_terms_.emplace(word.rbegin(), word.rend());
+  return &it->second;
 }
 
 template <typename C>
@@ -138,68 +405,234 @@ void BaseStringIndex<C>::Remove(DocId id, DocumentAccessor* doc, string_view fie
   for (string_view str : doc->GetStrings(field))
     tokens.merge(Tokenize(str));
 
-  for (const auto& token : tokens) {
-    auto it = entries_.find(token);
-    if (it == entries_.end())
-      continue;
+  for (const auto& token : tokens)
+    RemoveFromEntry(id, token);
+}
+
+template <typename C> void BaseStringIndex<C>::RemoveFromEntry(DocId id, string_view word) {
+  auto it = entries_.find(word);
+  if (it == entries_.end())
+    return;
 
-    it->second.Remove(id);
-    if (it->second.Size() == 0)
-      entries_.erase(it);
+  it->second.Remove(id);
+  if (it->second.Size() == 0) {
+    if (reversed_terms_built_)
+      reversed_terms_.erase(string{word.rbegin(), word.rend()});
+    entries_.erase(it);
   }
 }
 
 template struct BaseStringIndex<CompressedSortedSet>;
 template struct BaseStringIndex<SortedVector>;
 
+void TextIndex::Add(DocId id, DocumentAccessor* doc, string_view field) {
+  absl::flat_hash_map<string, uint32_t> counts;
+  uint32_t length = 0;
+  for (string_view str : doc->GetStrings(field))
+    length += CountWords(str, &counts);
+
+  auto* mr = frequencies_.get_allocator().resource();
+  for (const auto& [word, count] : counts) {
+    GetOrCreate(word)->Insert(id);
+    if (count > 1)
+      frequencies_.try_emplace(PMR_NS::string{word, mr}).first->second[id] = count;
+  }
+
+  if (length > 0) {
+    doc_lengths_[id] = length;
+    total_length_ += length;
+  }
+}
+
+void TextIndex::Remove(DocId id, DocumentAccessor* doc, string_view field) {
+  absl::flat_hash_map<string, uint32_t> counts;
+  for (string_view str : doc->GetStrings(field))
+    CountWords(str, &counts);
+
+  for (const auto& [word, count] : counts) {
+    RemoveFromEntry(id, word);
+    if (count == 1)
+      continue;
+
+    if (auto it = frequencies_.find(word); it != frequencies_.end()) {
+      it->second.erase(id);
+      if (it->second.empty())
+        frequencies_.erase(it);
+    }
+  }
+
+  if (auto it = doc_lengths_.find(id); it != doc_lengths_.end()) {
+    total_length_ -= it->second;
+    doc_lengths_.erase(it);
+  }
+}
+
 absl::flat_hash_set<std::string> TextIndex::Tokenize(std::string_view value) const {
   return TokenizeWords(value);
 }
 
+const TextIndex::TermFrequencies* TextIndex::Frequencies(string_view term) const {
+  string tmp;
+  auto it = frequencies_.find(Normalize(term, &tmp));
+  return it != frequencies_.end() ? &it->second : nullptr;
+}
+
+uint32_t TextIndex::DocLength(DocId id) const {
+  auto it = doc_lengths_.find(id);
+  return it != doc_lengths_.end() ? it->second : 0;
+}
+
 absl::flat_hash_set<std::string> TagIndex::Tokenize(std::string_view value) const {
   return NormalizeTags(value, case_sensitive_, separator_);
 }
 
-BaseVectorIndex::BaseVectorIndex(size_t dim, VectorSimilarity sim) : dim_{dim}, sim_{sim} {
+BaseVectorIndex::BaseVectorIndex(const SchemaField::VectorParams& params)
+    : dim_{params.dim},
+      sim_{params.sim},
+      quant_{params.quantization},
+      rerank_factor_{params.rerank_factor} {
 }
 
 std::pair<size_t /*dim*/, VectorSimilarity> BaseVectorIndex::Info() const {
   return {dim_, sim_};
 }
 
+std::pair<VectorQuantization, size_t /*rerank factor*/> BaseVectorIndex::QuantizationInfo() const {
+  return {quant_, rerank_factor_};
+}
+
 FlatVectorIndex::FlatVectorIndex(const SchemaField::VectorParams& params,
                                  PMR_NS::memory_resource* mr)
-    : BaseVectorIndex{params.dim, params.sim}, entries_{mr} {
+    : BaseVectorIndex{params},
+      entry_floats_{(QuantizedSize(params.dim, params.quantization) + sizeof(float) - 1) /
+                    sizeof(float)},
+      entries_{mr} {
   DCHECK(!params.use_hnsw);
-  entries_.reserve(params.capacity * params.dim);
+  entries_.reserve(params.capacity * entry_floats_);
 }
 
 void FlatVectorIndex::Add(DocId id, DocumentAccessor* doc, string_view field) {
-  DCHECK_LE(id * dim_, entries_.size());
-  if (id * dim_ == entries_.size())
-    entries_.resize((id + 1) * dim_);
+  DCHECK_LE(id * entry_floats_, entries_.size());
+  if (id * entry_floats_ == entries_.size())
+    entries_.resize((id + 1) * entry_floats_);
 
   // TODO: Let get vector write to buf itself
   auto [ptr, size] = doc->GetVector(field);
 
-  if (size == dim_)
-    memcpy(&entries_[id * dim_], ptr.get(), dim_ * sizeof(float));
+  if (size == dim_) {
+    if (sim_ == VectorSimilarity::COSINE)
+      NormalizeVector(ptr.get(), dim_);
+    QuantizeVector(ptr.get(), dim_, quant_, reinterpret_cast<char*>(&entries_[id * entry_floats_]));
+  }
 }
 
 void FlatVectorIndex::Remove(DocId id, DocumentAccessor* doc, string_view field) {
   // noop
 }
 
-const float* FlatVectorIndex::Get(DocId doc) const {
-  return &entries_[doc * dim_];
+const char* FlatVectorIndex::Get(DocId doc) const {
+  return reinterpret_cast<const char*>(&entries_[doc * entry_floats_]);
+}
+
+size_t FlatVectorIndex::SerializedSize() const {
+  return 3 * sizeof(uint64_t) + entries_.size() * sizeof(float);
+}
+
+// Cursor is the offset into stored entries
+bool FlatVectorIndex::SerializeChunk(size_t* cursor, size_t chunk_bytes, string* out) {
+  if (*cursor == 0) {
+    const uint64_t header[] = {dim_, uint64_t(quant_), entry_floats_};
+    out->append(reinterpret_cast<const char*>(header), sizeof(header));
+  }
+
+  size_t total = entries_.size() * sizeof(float);
+  size_t len = min(chunk_bytes, total - *cursor);
+  out->append(reinterpret_cast<const char*>(entries_.data()) + *cursor, len);
+  *cursor += len;
+  return *cursor < total;
+}
+
+bool FlatVectorIndex::Restore(string_view data) {
+  DCHECK(entries_.empty());
+
+  uint64_t header[3];
+  if (data.size() < sizeof(header))
+    return false;
+  memcpy(header, data.data(), sizeof(header));
+  data.remove_prefix(sizeof(header));
+
+  if (header[0] != dim_ || header[1] != uint64_t(quant_) || header[2] != entry_floats_ ||
+      data.size() % (entry_floats_ * sizeof(float)) != 0)
+    return false;
+
+  entries_.resize(data.size() / sizeof(float));
+  memcpy(entries_.data(), data.data(), data.size());
+  return true;
+}
+
+size_t FlatVectorIndex::KnnBlockSize() const {
+  constexpr size_t kBlockBytes = 16 * 1024;
+  return max<size_t>(1, kBlockBytes / (entry_floats_ * sizeof(float)));
+}
+
+void FlatVectorIndex::KnnBlock(const vector<const char*>& targets, size_t k,
+                               absl::Span<const DocId> block, KnnResults* heaps) const {
+  for (size_t t = 0; t < targets.size(); t++) {
+    auto& heap = (*heaps)[t];
+    for (DocId id : block) {
+      float dist = QuantizedDistance(targets[t], Get(id), dim_, quant_, sim_);
+      if (heap.size() < k) {
+        heap.emplace_back(dist, id);
+        push_heap(heap.begin(), heap.end());
+      } else if (k > 0 && dist < heap.front().first) {
+        pop_heap(heap.begin(), heap.end());
+        heap.back() = {dist, id};
+        push_heap(heap.begin(), heap.end());
+      }
+    }
+  }
 }
 
+// Space for hnswlib that computes distances directly on quantized vectors
+struct QuantizedSpace : public hnswlib::SpaceInterface<float> {
+  QuantizedSpace(size_t dim, VectorSimilarity sim, VectorQuantization quant)
+      : params_{dim, sim, quant} {
+  }
+
+  size_t get_data_size() override {
+    return QuantizedSize(params_.dim, params_.quant);
+  }
+
+  hnswlib::DISTFUNC<float> get_dist_func() override {
+    return &Distance;
+  }
+
+  void* get_dist_func_param() override {
+    return &params_;
+  }
+
+ private:
+  struct Params {
+    size_t dim;
+    VectorSimilarity sim;
+    VectorQuantization quant;
+  };
+
+  static float Distance(const void* u, const void* v, const void* param) {
+    auto* params = static_cast<const Params*>(param);
+    return QuantizedDistance(static_cast<const char*>(u), static_cast<const char*>(v), params->dim,
+                             params->quant, params->sim);
+  }
+
+  Params params_;
+};
+
 struct HnswlibAdapter {
   // Default setting of hnswlib/hnswalg
   constexpr static size_t kDefaultEfRuntime = 10;
 
   HnswlibAdapter(const SchemaField::VectorParams& params)
-      : space_{MakeSpace(params.dim, params.sim)}, world_{GetSpacePtr(),
+      : space_{MakeSpace(params)}, world_{GetSpacePtr(),
                                                           params.capacity,
                                                           params.hnsw_m,
                                                           params.hnsw_ef_construction,
@@ -207,9 +640,15 @@ struct HnswlibAdapter {
                                                           true} {
   }
 
-  void Add(float* data, DocId id) {
-    if (world_.cur_element_count + 1 >= world_.max_elements_)
-      world_.resizeIndex(world_.cur_element_count * 2);
+  // Grow graph to fit n more elements
+  void Reserve(size_t n) {
+    size_t count = world_.cur_element_count;
+    if (count + n >= world_.max_elements_)
+      world_.resizeIndex(max(count * 2, count + n + 1));
+  }
+
+  // Thread safe as long as enough space was reserved
+  void Add(const void* data, DocId id) {
     world_.addPoint(data, id);
   }
 
@@ -217,42 +656,274 @@ struct HnswlibAdapter {
     world_.markDelete(id);
   }
 
-  vector<pair<float, DocId>> Knn(float* target, size_t k, std::optional<size_t> ef) {
+  vector<pair<float, DocId>> Knn(const void* target, size_t k, std::optional<size_t> ef) {
     world_.setEf(ef.value_or(kDefaultEfRuntime));
     return QueueToVec(world_.searchKnn(target, k));
   }
 
-  vector<pair<float, DocId>> Knn(float* target, size_t k, std::optional<size_t> ef,
-                                 const vector<DocId>& allowed) {
-    struct BinsearchFilter : hnswlib::BaseFilterFunctor {
-      virtual bool operator()(hnswlib::labeltype id) {
-        return binary_search(allowed->begin(), allowed->end(), id);
-      }
+  // Filtered search should brute force over allowed ids if there are so few of them that graph
+  // search would compute more distances
+  bool PreferBruteForce(size_t k, std::optional<size_t> ef, size_t allowed) {
+    size_t ef_value = ef.value_or(kDefaultEfRuntime);
+
+    // Graph search computes about max(ef, k) * M * log(N) distances to find enough candidates, and
+    // visits N / allowed times more nodes when most of them are filtered out
+    size_t total = world_.getCurrentElementCount() - world_.getDeletedCount();
+    double graph_cost = double(max(ef_value, k)) * world_.M_ * log2(max<size_t>(total, 2)) *
+                        total / max<size_t>(allowed, 1);
+    return allowed <= graph_cost;
+  }
 
-      BinsearchFilter(const vector<DocId>* allowed) : allowed{allowed} {
+  // Graph search that skips all but allowed ids
+  vector<pair<float, DocId>> Knn(const void* target, size_t k, std::optional<size_t> ef,
+                                 const vector<DocId>& allowed) {
+    struct BitmapFilter : hnswlib::BaseFilterFunctor {
+      bool operator()(hnswlib::labeltype id) override {
+        return id / 64 < words.size() && (words[id / 64] >> (id % 64)) & 1;
       }
-      const vector<DocId>* allowed;
+      vector<uint64_t> words;
     };
 
+    BitmapFilter filter;
+    filter.words.resize(allowed.empty() ? 0 : allowed.back() / 64 + 1);
+    for (DocId id : allowed)
+      filter.words[id / 64] |= uint64_t(1) << (id % 64);
+
     world_.setEf(ef.value_or(kDefaultEfRuntime));
-    BinsearchFilter filter{&allowed};
     return QueueToVec(world_.searchKnn(target, k, &filter));
   }
 
+  // Exact closest k of allowed ids with the distance function of the graph. Reads stored vectors
+  // directly, so ids that are being inserted must be skipped
+  vector<pair<float, DocId>> BruteForceKnn(const void* target, size_t k,
+                                           const vector<DocId>& allowed,
+                                           const absl::flat_hash_set<DocId>* skip) {
+    vector<pair<hnswlib::tableint, DocId>> nodes;
+    nodes.reserve(allowed.size());
+    {
+      std::unique_lock lk{world_.label_lookup_lock};
+      for (DocId id : allowed) {
+        if (skip && skip->contains(id))
+          continue;
+        auto it = world_.label_lookup_.find(id);
+        if (it != world_.label_lookup_.end() && !world_.isMarkedDeleted(it->second))
+          nodes.emplace_back(it->second, id);
+      }
+    }
+
+    auto* space = GetSpacePtr();
+    auto dist_func = space->get_dist_func();
+    void* dist_param = space->get_dist_func_param();
+
+    vector<pair<float, DocId>> heap;
+    heap.reserve(min(k, nodes.size()) + 1);
+    for (auto [node, id] : nodes) {
+      float dist = dist_func(target, world_.getDataByInternalId(node), dist_param);
+      if (heap.size() < k) {
+        heap.emplace_back(dist, id);
+        push_heap(heap.begin(), heap.end());
+      } else if (k > 0 && dist < heap.front().first) {
+        pop_heap(heap.begin(), heap.end());
+        heap.back() = {dist, id};
+        push_heap(heap.begin(), heap.end());
+      }
+    }
+    sort_heap(heap.begin(), heap.end());
+    return heap;
+  }
+
+  const char* Get(DocId id) const {
+    std::unique_lock lk{world_.label_lookup_lock};
+    return world_.getDataByInternalId(world_.label_lookup_.at(id));
+  }
+
+  size_t SerializedSize() const {
+    size_t size = (LayoutHeader().size() + 3) * sizeof(uint64_t) +
+                  world_.cur_element_count * world_.size_data_per_element_;
+    for (size_t i = 0; i < world_.cur_element_count; i++)
+      size += sizeof(uint64_t) + world_.element_levels_[i] * world_.size_links_per_element_;
+    return size;
+  }
+
+  // Same layout as hnswlib's saveIndex(): layout parameters, level 0 data of all elements with
+  // their vectors and labels, then links of upper levels. Written to memory instead of a file.
+  // Cursor counts elements, first for level 0 data and then again for upper links
+  bool SerializeChunk(size_t* cursor, size_t chunk_bytes, string* out) {
+    const size_t count = world_.cur_element_count;
+    if (*cursor == 0) {
+      for (uint64_t value : LayoutHeader())
+        Append(value, out);
+      Append(count, out);
+      Append(world_.maxlevel_, out);
+      Append(world_.enterpoint_node_, out);
+    }
+
+    if (*cursor < count) {
+      size_t per_chunk = max<size_t>(1, chunk_bytes / world_.size_data_per_element_);
+      size_t elements = min(count - *cursor, per_chunk);
+      out->append(world_.data_level0_memory_ + *cursor * world_.size_data_per_element_,
+                  elements * world_.size_data_per_element_);
+      *cursor += elements;
+      return true;
+    }
+
+    for (size_t limit = out->size() + chunk_bytes; *cursor < 2 * count && out->size() < limit;
+         ++*cursor) {
+      size_t i = *cursor - count;
+      uint64_t level = world_.element_levels_[i];
+      Append(level, out);
+      out->append(world_.linkLists_[i], level * world_.size_links_per_element_);
+    }
+    return *cursor < 2 * count;
+  }
+
+  // Restore graph into empty index. Layout parameters must match, as they're derived from the
+  // index parameters. All sizes and links are checked, as searches don't validate them
+  bool Restore(string_view data) {
+    DCHECK_EQ(world_.cur_element_count, 0u);
+
+    auto read = [&data](void* dest, size_t size) {
+      if (data.size() < size)
+        return false;
+      memcpy(dest, data.data(), size);
+      data.remove_prefix(size);
+      return true;
+    };
+
+    for (uint64_t expected : LayoutHeader()) {
+      uint64_t value;
+      if (!read(&value, sizeof(value)) || value != expected)
+        return false;
+    }
+
+    uint64_t count, max_level, entry_point;
+    if (!read(&count, sizeof(count)) || !read(&max_level, sizeof(max_level)) ||
+        !read(&entry_point, sizeof(entry_point)))
+      return false;
+    if (count > 0 && (entry_point >= count || max_level > kMaxLevel))
+      return false;
+
+    // Check that level 0 data is complete before growing the graph for it
+    if (count > data.size() / world_.size_data_per_element_)
+      return false;
+
+    Reserve(count);
+    if (!read(world_.data_level0_memory_, count * world_.size_data_per_element_))
+      return false;
+
+    auto cleanup = [this](size_t restored) {
+      for (size_t i = 0; i < restored; i++) {
+        free(world_.linkLists_[i]);
+        world_.linkLists_[i] = nullptr;
+        world_.element_levels_[i] = 0;
+      }
+    };
+
+    for (size_t i = 0; i < count; i++) {
+      uint64_t level;
+      if (!read(&level, sizeof(level)) || level > max_level) {
+        cleanup(i);
+        return false;
+      }
+
+      world_.element_levels_[i] = level;
+      world_.linkLists_[i] = nullptr;
+      if (level == 0)
+        continue;
+
+      size_t size = level * world_.size_links_per_element_;
+      world_.linkLists_[i] = static_cast<char*>(malloc(size));
+      if (world_.linkLists_[i] == nullptr)
+        throw std::bad_alloc{};
+      if (!read(world_.linkLists_[i], size)) {
+        cleanup(i + 1);
+        return false;
+      }
+    }
+
+    if (!data.empty() || !ValidLinks(count, max_level, entry_point) || !ValidLabels(count)) {
+      cleanup(count);
+      return false;
+    }
+
+    world_.cur_element_count = count;
+    world_.maxlevel_ = count > 0 ? int(max_level) : -1;
+    world_.enterpoint_node_ = count > 0 ? hnswlib::tableint(entry_point) : -1;
+
+    std::unique_lock lk{world_.label_lookup_lock};
+    for (size_t i = 0; i < count; i++) {
+      world_.label_lookup_[world_.getExternalLabel(i)] = i;
+      if (world_.isMarkedDeleted(i)) {
+        world_.num_deleted_++;
+        if (world_.allow_replace_deleted_)
+          world_.deleted_elements.insert(i);
+      }
+    }
+    return true;
+  }
+
  private:
-  using SpaceUnion = std::variant<hnswlib::L2Space, hnswlib::InnerProductSpace>;
+  using SpaceUnion = std::variant<hnswlib::L2Space, hnswlib::InnerProductSpace, QuantizedSpace>;
+
+  // Neighbour lists must fit their blocks and point to restored elements only. The entry point
+  // must be on the top level, as searches start from there
+  bool ValidLinks(size_t count, uint64_t max_level, uint64_t entry_point) const {
+    if (count > 0 && uint64_t(world_.element_levels_[entry_point]) != max_level)
+      return false;
+
+    auto valid = [this, count](hnswlib::linklistsizeint* list, size_t max_size) {
+      size_t size = world_.getListCount(list);
+      auto* ids = reinterpret_cast<const hnswlib::tableint*>(list + 1);
+      return size <= max_size && all_of(ids, ids + size, [count](auto id) { return id < count; });
+    };
+    for (size_t i = 0; i < count; i++) {
+      if (!valid(world_.get_linklist0(i), world_.maxM0_))
+        return false;
+      for (int level = 1; level <= world_.element_levels_[i]; level++) {
+        if (!valid(world_.get_linklist(i, level), world_.maxM_))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  // Labels are document ids, so they must be unique
+  bool ValidLabels(size_t count) const {
+    absl::flat_hash_set<hnswlib::labeltype> labels;
+    labels.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      if (!labels.insert(world_.getExternalLabel(i)).second)
+        return false;
+    }
+    return true;
+  }
 
-  static SpaceUnion MakeSpace(size_t dim, VectorSimilarity sim) {
-    if (sim == VectorSimilarity::L2)
-      return hnswlib::L2Space{dim};
+  static SpaceUnion MakeSpace(const SchemaField::VectorParams& params) {
+    if (params.quantization != VectorQuantization::NONE)
+      return QuantizedSpace{params.dim, params.sim, params.quantization};
+    if (params.sim == VectorSimilarity::L2)
+      return hnswlib::L2Space{params.dim};
     else
-      return hnswlib::InnerProductSpace{dim};
+      return hnswlib::InnerProductSpace{params.dim};
   }
 
   hnswlib::SpaceInterface<float>* GetSpacePtr() {
     return visit([](auto& space) -> hnswlib::SpaceInterface<float>* { return &space; }, space_);
   }
 
+  // Levels are drawn from an exponential distribution, so anything larger is corrupted data
+  static constexpr uint64_t kMaxLevel = 64;
+
+  static void Append(uint64_t value, string* out) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  std::array<uint64_t, 7> LayoutHeader() const {
+    return {world_.offsetLevel0_, world_.size_data_per_element_,  world_.label_offset_,
+            world_.offsetData_,   world_.size_links_per_element_, world_.maxM0_,
+            world_.M_};
+  }
+
   template <typename Q> static vector<pair<float, DocId>> QueueToVec(Q queue) {
     vector<pair<float, DocId>> out(queue.size());
     size_t idx = out.size();
@@ -268,31 +939,188 @@ struct HnswlibAdapter {
 };
 
 HnswVectorIndex::HnswVectorIndex(const SchemaField::VectorParams& params, PMR_NS::memory_resource*)
-    : BaseVectorIndex{params.dim, params.sim}, adapter_{make_unique<HnswlibAdapter>(params)} {
+    : BaseVectorIndex{params}, adapter_{make_unique<HnswlibAdapter>(params)} {
   DCHECK(params.use_hnsw);
   // TODO: Patch hnsw to use MR
 }
 
+// Batch of vectors inserted by workers. Workers access the index only until they decrement the
+// number of running workers, the last one notifies finished and calls done
+struct HnswVectorIndex::Batch {
+  vector<pair<DocId, OwnedFtVector>> items;
+  absl::flat_hash_set<DocId> ids;  // being inserted, their vectors can be incomplete
+  atomic_size_t next = 0;
+  atomic_uint workers = 0;
+  util::fb2::Done finished;
+  function<void()> done;
+};
+
 HnswVectorIndex::~HnswVectorIndex() {
+  // Posted workers use the graph until they finish
+  if (batch_ && batch_->workers.load(memory_order_acquire) > 0)
+    batch_->finished.Wait();
 }
 
 void HnswVectorIndex::Add(DocId id, DocumentAccessor* doc, string_view field) {
   auto [ptr, size] = doc->GetVector(field);
-  if (size == dim_)
-    adapter_->Add(ptr.get(), id);
+  if (size != dim_)
+    return;
+
+  if (BatchRunning()) {
+    pending_ids_.insert(id);
+    pending_.emplace_back(id, std::move(ptr));
+    return;
+  }
+
+  adapter_->Reserve(1);
+  AddVector(id, ptr.get());
 }
 
-std::vector<std::pair<float, DocId>> HnswVectorIndex::Knn(float* target, size_t k,
+void HnswVectorIndex::AddVector(DocId id, float* vec) {
+  // Cosine distance is computed with the inner product space, so vectors must be normalized
+  if (sim_ == VectorSimilarity::COSINE)
+    NormalizeVector(vec, dim_);
+
+  if (quant_ == VectorQuantization::NONE) {
+    adapter_->Add(vec, id);
+  } else {
+    auto encoded = make_unique<char[]>(QuantizedSize(dim_, quant_));
+    QuantizeVector(vec, dim_, quant_, encoded.get());
+    adapter_->Add(encoded.get(), id);
+  }
+}
+
+void HnswVectorIndex::AddBatch(vector<pair<DocId, OwnedFtVector>> batch, unsigned num_threads,
+                               function<void()> done) {
+  FinishBatch();
+
+  if (batch.empty()) {
+    done();
+    return;
+  }
+
+  // hnswlib supports concurrent insertions and searches, but not resizing
+  adapter_->Reserve(batch.size());
+
+  batch_ = make_shared<Batch>();
+  batch_->items = std::move(batch);
+  batch_->done = std::move(done);
+  for (const auto& [id, _] : batch_->items)
+    batch_->ids.insert(id);
+
+  num_threads = clamp<size_t>(num_threads, 1, batch_->items.size());
+  batch_->workers.store(num_threads, memory_order_release);
+
+  for (unsigned i = 0; i < num_threads; i++) {
+    BatchPool()->Add([this, state = batch_] {
+      size_t idx;
+      while ((idx = state->next.fetch_add(1, memory_order_relaxed)) < state->items.size()) {
+        auto& [id, vec] = state->items[idx];
+        if (vec.second == dim_)
+          AddVector(id, vec.first.get());
+      }
+
+      if (state->workers.fetch_sub(1, memory_order_acq_rel) > 1)
+        return;
+      state->finished.Notify();
+      state->done();
+    });
+  }
+}
+
+void HnswVectorIndex::FinishBatch() {
+  if (!batch_)  // already finished by an update
+    return;
+
+  DCHECK_EQ(batch_->workers.load(memory_order_acquire), 0u);
+  batch_.reset();
+
+  for (auto& [id, vec] : pending_) {
+    if (vec) {
+      adapter_->Reserve(1);
+      AddVector(id, vec.get());
+    } else {
+      adapter_->Remove(id);
+    }
+  }
+  pending_.clear();
+  pending_ids_.clear();
+}
+
+bool HnswVectorIndex::BatchRunning() {
+  if (!batch_)
+    return false;
+  if (batch_->workers.load(memory_order_acquire) > 0)
+    return true;
+  FinishBatch();
+  return false;
+}
+
+void HnswVectorIndex::DropPending(vector<pair<float, DocId>>* results) const {
+  if (pending_ids_.empty())
+    return;
+  auto pending = [this](const auto& p) { return pending_ids_.contains(p.second); };
+  results->erase(remove_if(results->begin(), results->end(), pending), results->end());
+}
+
+const char* HnswVectorIndex::Get(DocId doc) const {
+  return adapter_->Get(doc);
+}
+
+std::vector<std::pair<float, DocId>> HnswVectorIndex::Knn(const char* target, size_t k,
                                                           std::optional<size_t> ef) const {
-  return adapter_->Knn(target, k, ef);
+  auto results = adapter_->Knn(target, k, ef);
+  DropPending(&results);
+  return results;
 }
-std::vector<std::pair<float, DocId>> HnswVectorIndex::Knn(float* target, size_t k,
+
+std::vector<std::pair<float, DocId>> HnswVectorIndex::Knn(const char* target, size_t k,
                                                           std::optional<size_t> ef,
                                                           const std::vector<DocId>& allowed) const {
-  return adapter_->Knn(target, k, ef, allowed);
+  vector<pair<float, DocId>> results;
+  if (adapter_->PreferBruteForce(k, ef, allowed.size())) {
+    // Vectors of a running batch may be registered before they're written, which graph search
+    // handles, but brute force doesn't. They're skipped, as if they weren't inserted yet
+    bool running = batch_ && batch_->workers.load(memory_order_acquire) > 0;
+    results = adapter_->BruteForceKnn(target, k, allowed, running ? &batch_->ids : nullptr);
+  } else {
+    results = adapter_->Knn(target, k, ef, allowed);
+  }
+  DropPending(&results);
+  return results;
+}
+
+vector<vector<pair<float, DocId>>> HnswVectorIndex::Knn(const vector<const char*>& targets,
+                                                        size_t k, std::optional<size_t> ef) const {
+  vector<vector<pair<float, DocId>>> out(targets.size());
+  for (size_t t = 0; t < targets.size(); t++)
+    out[t] = Knn(targets[t], k, ef);
+  return out;
+}
+
+size_t HnswVectorIndex::SerializedSize() const {
+  return adapter_->SerializedSize();
+}
+
+bool HnswVectorIndex::SerializeChunk(size_t* cursor, size_t chunk_bytes, string* out) {
+  // Batches run only while indices are rebuilt, and those are not serialized
+  bool running = BatchRunning();
+  DCHECK(!running);
+  return adapter_->SerializeChunk(cursor, chunk_bytes, out);
+}
+
+bool HnswVectorIndex::Restore(string_view data) {
+  bool running = BatchRunning();
+  DCHECK(!running);
+  return adapter_->Restore(data);
 }
 
 void HnswVectorIndex::Remove(DocId id, DocumentAccessor* doc, string_view field) {
+  if (BatchRunning()) {
+    pending_ids_.insert(id);
+    pending_.emplace_back(id, nullptr);
+    return;
+  }
   adapter_->Remove(id);
 }
 
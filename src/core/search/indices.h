@@ -2,13 +2,18 @@
 // See LICENSE for licensing terms.
 //
 
+#include <absl/container/btree_map.h>
 #include <absl/container/btree_set.h>
 #include <absl/container/flat_hash_map.h>
 #include <absl/container/flat_hash_set.h>
+#include <absl/types/span.h>
 
+#include <algorithm>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "base/pmr/memory_resource.h"
@@ -21,19 +26,34 @@
 
 namespace dfly::search {
 
-// Index for integer fields.
-// Range bounds are queried in logarithmic time, iteration is constant.
+// Index for numeric fields.
+// Values are kept sorted in contiguous blocks with their bounds stored separately, so range bounds
+// are found with a binary search over the bounds and all blocks in between are fully matched.
 struct NumericIndex : public BaseIndex {
   explicit NumericIndex(PMR_NS::memory_resource* mr);
 
   void Add(DocId id, DocumentAccessor* doc, std::string_view field) override;
   void Remove(DocId id, DocumentAccessor* doc, std::string_view field) override;
 
+  // Sorted ids of documents with a value in [l, r]
   std::vector<DocId> Range(double l, double r) const;
 
+  // Number of documents with a value in [l, r], without collecting them
+  size_t Count(double l, double r) const;
+
  private:
   using Entry = std::pair<double, DocId>;
-  absl::btree_set<Entry, std::less<Entry>, PMR_NS::polymorphic_allocator<Entry>> entries_;
+  using Block = PMR_NS::vector<Entry>;
+
+  static constexpr size_t kMaxBlockSize = 1024;
+
+  // Range of blocks that contain entries of [l, r], the first and last ones only partially
+  std::pair<size_t, size_t> FindBlocks(double l, double r) const;
+
+  PMR_NS::vector<Block> blocks_;      // sorted entries, split into blocks of at most kMaxBlockSize
+  PMR_NS::vector<Entry> block_max_;   // largest entry of every block
+  DocId max_id_ = 0;                  // bound for bitmaps over ids
+  size_t multi_value_docs_ = 0;       // documents with more than one value, counted only once
 };
 
 // Base index for string based indices.
@@ -51,8 +71,19 @@ template <typename C> struct BaseStringIndex : public BaseIndex {
   // Pointer is valid as long as index is not mutated. Nullptr if not found
   const Container* Matching(std::string_view str) const;
 
+  // Expand terms starting with prefix, ending with suffix or within a Levenshtein distance (over
+  // bytes) of term. Return at most max_terms pointers, valid as long as index is not mutated.
+  std::vector<const Container*> MatchingPrefix(std::string_view prefix, size_t max_terms) const;
+  std::vector<const Container*> MatchingSuffix(std::string_view suffix, size_t max_terms) const;
+  std::vector<const Container*> MatchingFuzzy(std::string_view term, uint32_t distance,
+                                              size_t max_terms) const;
+
  protected:
+  // Strip whitespace and lowercase if not case sensitive, tmp is used as storage if needed
+  std::string_view Normalize(std::string_view str, std::string* tmp) const;
+
   Container* GetOrCreate(std::string_view word);
+  void RemoveFromEntry(DocId id, std::string_view word);  // Remove id, drop entry if empty
 
   struct PmrEqual {
     using is_transparent = void;
@@ -74,24 +105,73 @@ template <typename C> struct BaseStringIndex : public BaseIndex {
     }
   };
 
+  struct PmrLess {
+    using is_transparent = void;
+    bool operator()(std::string_view lhs, std::string_view rhs) const {
+      return lhs < rhs;
+    }
+  };
+
   bool case_sensitive_ = false;
 
-  absl::flat_hash_map<PMR_NS::string, Container, PmrHash, PmrEqual,
-                      PMR_NS::polymorphic_allocator<std::pair<PMR_NS::string, Container>>>
+  // Term dictionary. Terms are sorted for prefix and fuzzy expansion.
+  absl::btree_map<PMR_NS::string, Container, PmrLess,
+                  PMR_NS::polymorphic_allocator<std::pair<const PMR_NS::string, Container>>>
       entries_;
+
+  // Reversed terms for suffix expansion. Built by the first suffix query and maintained from then
+  // on, so that indices without suffix queries don't store every term twice.
+  mutable absl::btree_set<PMR_NS::string, PmrLess, PMR_NS::polymorphic_allocator<PMR_NS::string>>
+      reversed_terms_;
+  mutable bool reversed_terms_built_ = false;
 };
 
 // Index for text fields.
-// Hashmap based lookup per word.
+// Sorted term dictionary with a posting list per word. Besides membership it keeps term
+// frequencies and document lengths for relevance scoring.
 struct TextIndex : public BaseStringIndex<CompressedSortedSet> {
-  TextIndex(PMR_NS::memory_resource* mr) : BaseStringIndex(mr, false) {
+  // Occurrences of a term per document. Only counts above one are stored, as most terms occur once
+  using TermFrequencies =
+      absl::flat_hash_map<DocId, uint32_t, absl::Hash<DocId>, std::equal_to<DocId>,
+                          PMR_NS::polymorphic_allocator<std::pair<const DocId, uint32_t>>>;
+
+  TextIndex(PMR_NS::memory_resource* mr)
+      : BaseStringIndex(mr, false), frequencies_{mr}, doc_lengths_{mr} {
   }
 
+  void Add(DocId id, DocumentAccessor* doc, std::string_view field) override;
+  void Remove(DocId id, DocumentAccessor* doc, std::string_view field) override;
+
   absl::flat_hash_set<std::string> Tokenize(std::string_view value) const override;
+
+  // Frequencies of term above one. Nullptr if it occurs at most once in every document
+  const TermFrequencies* Frequencies(std::string_view term) const;
+
+  // Number of words in document, zero if it's not indexed
+  uint32_t DocLength(DocId id) const;
+
+  // Number of indexed documents with at least one word
+  size_t NumDocs() const {
+    return doc_lengths_.size();
+  }
+
+  double AvgDocLength() const {
+    return doc_lengths_.empty() ? 0 : double(total_length_) / doc_lengths_.size();
+  }
+
+ private:
+  absl::flat_hash_map<PMR_NS::string, TermFrequencies, PmrHash, PmrEqual,
+                      PMR_NS::polymorphic_allocator<std::pair<PMR_NS::string, TermFrequencies>>>
+      frequencies_;
+
+  absl::flat_hash_map<DocId, uint32_t, absl::Hash<DocId>, std::equal_to<DocId>,
+                      PMR_NS::polymorphic_allocator<std::pair<const DocId, uint32_t>>>
+      doc_lengths_;
+  size_t total_length_ = 0;
 };
 
-// Index for text fields.
-// Hashmap based lookup per word.
+// Index for tag fields.
+// Sorted term dictionary with a posting list per tag.
 struct TagIndex : public BaseStringIndex<SortedVector> {
   TagIndex(PMR_NS::memory_resource* mr, SchemaField::TagParams params)
       : BaseStringIndex(mr, params.case_sensitive), separator_{params.separator} {
@@ -103,14 +183,33 @@ struct TagIndex : public BaseStringIndex<SortedVector> {
   char separator_;
 };
 
+// Vectors are stored encoded with QuantizeVector() and normalized for cosine similarity.
 struct BaseVectorIndex : public BaseIndex {
   std::pair<size_t /*dim*/, VectorSimilarity> Info() const;
+  std::pair<VectorQuantization, size_t /*rerank factor*/> QuantizationInfo() const;
+
+  // Encoded vector of a document
+  virtual const char* Get(DocId doc) const = 0;
+
+  // Total size of data written by SerializeChunk()
+  virtual size_t SerializedSize() const = 0;
+
+  // Append next chunk of about chunk_bytes of stored vectors to out, so that the index can be
+  // restored without inserting them again. Starts with *cursor set to 0 and returns false once
+  // all data was written. The index must not change in between
+  virtual bool SerializeChunk(size_t* cursor, size_t chunk_bytes, std::string* out) = 0;
+
+  // Restore empty index from data written by SerializeChunk() of an index with the same
+  // parameters. Return false if data doesn't match or is corrupted
+  virtual bool Restore(std::string_view data) = 0;
 
  protected:
-  BaseVectorIndex(size_t dim, VectorSimilarity sim);
+  BaseVectorIndex(const SchemaField::VectorParams& params);
 
   size_t dim_;
   VectorSimilarity sim_;
+  VectorQuantization quant_;
+  size_t rerank_factor_;
 };
 
 // Index for vector fields.
@@ -121,9 +220,46 @@ struct FlatVectorIndex : public BaseVectorIndex {
   void Add(DocId id, DocumentAccessor* doc, std::string_view field) override;
   void Remove(DocId id, DocumentAccessor* doc, std::string_view field) override;
 
-  const float* Get(DocId doc) const;
+  const char* Get(DocId doc) const override;
+
+  size_t SerializedSize() const override;
+  bool SerializeChunk(size_t* cursor, size_t chunk_bytes, std::string* out) override;
+  bool Restore(std::string_view data) override;
+
+  using KnnResults = std::vector<std::vector<std::pair<float, DocId>>>;
+
+  // Closest k documents out of ids for each of the encoded targets. Ids can be any range of
+  // documents, i.e. a borrowed index result. They're read in blocks, so that stored vectors are
+  // reused by all targets while they're in cache
+  template <typename Ids>
+  KnnResults Knn(const std::vector<const char*>& targets, size_t k, const Ids& ids) const {
+    KnnResults heaps(targets.size());
+    const size_t block_size = KnnBlockSize();
+    std::vector<DocId> block;
+    block.reserve(block_size);
+    for (DocId id : ids) {
+      block.push_back(id);
+      if (block.size() == block_size) {
+        KnnBlock(targets, k, block, &heaps);
+        block.clear();
+      }
+    }
+    KnnBlock(targets, k, block, &heaps);
+
+    for (auto& heap : heaps)
+      std::sort_heap(heap.begin(), heap.end());
+    return heaps;
+  }
 
  private:
+  // Number of documents whose stored vectors fit into L1 cache
+  size_t KnnBlockSize() const;
+
+  // Update max heaps of closest k documents of every target with documents from block
+  void KnnBlock(const std::vector<const char*>& targets, size_t k, absl::Span<const DocId> block,
+                KnnResults* heaps) const;
+
+  size_t entry_floats_;  // encoded vector size rounded up to whole floats to keep them aligned
   PMR_NS::vector<float> entries_;
 };
 
@@ -136,12 +272,55 @@ struct HnswVectorIndex : public BaseVectorIndex {
   void Add(DocId id, DocumentAccessor* doc, std::string_view field) override;
   void Remove(DocId id, DocumentAccessor* doc, std::string_view field) override;
 
-  std::vector<std::pair<float, DocId>> Knn(float* target, size_t k, std::optional<size_t> ef) const;
-  std::vector<std::pair<float, DocId>> Knn(float* target, size_t k, std::optional<size_t> ef,
+  const char* Get(DocId doc) const override;
+
+  // Graph is serialized with the same layout as hnswlib's saveIndex()
+  size_t SerializedSize() const override;
+  bool SerializeChunk(size_t* cursor, size_t chunk_bytes, std::string* out) override;
+  bool Restore(std::string_view data) override;
+
+  // Target must be encoded in the same way as stored vectors
+  std::vector<std::pair<float, DocId>> Knn(const char* target, size_t k,
+                                           std::optional<size_t> ef) const;
+  std::vector<std::pair<float, DocId>> Knn(const char* target, size_t k, std::optional<size_t> ef,
                                            const std::vector<DocId>& allowed) const;
 
+  // Batched version for multiple targets. Graph searches can't share traversals, so targets are
+  // searched one by one
+  std::vector<std::vector<std::pair<float, DocId>>> Knn(const std::vector<const char*>& targets,
+                                                        size_t k, std::optional<size_t> ef) const;
+
+  // Insert vectors of multiple documents with num_threads workers of a shared thread pool. Returns
+  // immediately and calls done from a worker thread once all of them are inserted. Searches run
+  // concurrently, other updates are queued until then and applied by FinishBatch().
+  void AddBatch(std::vector<std::pair<DocId, OwnedFtVector>> batch, unsigned num_threads,
+                std::function<void()> done);
+
+  // Apply updates queued while the last batch was running. Must be called only after done was
+  // called, usually by the caller of AddBatch
+  void FinishBatch();
+
  private:
+  struct Batch;
+
+  // Normalize and encode vector and insert it. Doesn't grow the graph
+  void AddVector(DocId id, float* vec);
+
+  // Whether workers of the last batch are still running. If they're not, queued updates are
+  // applied. Never blocks, as updates arrive from callbacks that must not be preempted
+  bool BatchRunning();
+
+  // Drop documents with queued updates, as their vectors in the graph are outdated
+  void DropPending(std::vector<std::pair<float, DocId>>* results) const;
+
   std::unique_ptr<HnswlibAdapter> adapter_;
+
+  std::shared_ptr<Batch> batch_;  // last batch, shared with its workers
+
+  // Updates received while a batch is running, applied in order once it's finished. Removals have
+  // no vector
+  std::vector<std::pair<DocId, std::unique_ptr<float[]>>> pending_;
+  absl::flat_hash_set<DocId> pending_ids_;
 };
 
 }  // namespace dfly::search
@@ -66,7 +66,8 @@ using namespace std;
 
 // Needed 0 at the end to satisfy bison 3.5.1
 %token YYEOF 0
-%token <std::string> TERM "term" PARAM "param" FIELD "field"
+%token <std::string> TERM "term" PARAM "param" FIELD "field" PREFIX "prefix" SUFFIX "suffix"
+%token <AstFuzzyNode> FUZZY "fuzzy"
 
 %precedence TERM
 %left OR_OP
@@ -129,11 +130,17 @@ search_unary_expr:
   | NOT_OP search_unary_expr          { $$ = AstNegateNode(std::move($2)); }
   | TERM                              { $$ = AstTermNode(std::move($1)); }
   | UINT32                            { $$ = AstTermNode(to_string($1)); }
+  | PREFIX                            { $$ = AstPrefixNode(std::move($1)); }
+  | SUFFIX                            { $$ = AstSuffixNode(std::move($1)); }
+  | FUZZY                             { $$ = std::move($1); }
   | FIELD COLON field_cond            { $$ = AstFieldNode(std::move($1), std::move($3)); }
 
 field_cond:
   TERM                                                  { $$ = AstTermNode(std::move($1)); }
   | UINT32                                              { $$ = AstTermNode(to_string($1)); }
+  | PREFIX                                              { $$ = AstPrefixNode(std::move($1)); }
+  | SUFFIX                                              { $$ = AstSuffixNode(std::move($1)); }
+  | FUZZY                                               { $$ = std::move($1); }
   | NOT_OP field_cond                                   { $$ = AstNegateNode(std::move($2)); }
   | LPAREN field_cond_expr RPAREN                       { $$ = std::move($2); }
   | LBRACKET numeric_filter_expr RBRACKET               { $$ = std::move($2); }
@@ -168,12 +175,17 @@ field_unary_expr:
   | NOT_OP field_unary_expr                      { $$ = AstNegateNode(std::move($2)); };
   | TERM                                         { $$ = AstTermNode(std::move($1)); }
   | UINT32                                       { $$ = AstTermNode(to_string($1)); }
+  | PREFIX                                       { $$ = AstPrefixNode(std::move($1)); }
+  | SUFFIX                                       { $$ = AstSuffixNode(std::move($1)); }
+  | FUZZY                                        { $$ = std::move($1); }
 
 tag_list:
   TERM                       { $$ = AstTagsNode(std::move($1)); }
   | UINT32                   { $$ = AstTagsNode(to_string($1)); }
+  | PREFIX                   { $$ = AstTagsNode(std::move($1), true); }
   | tag_list OR_OP TERM      { $$ = AstTagsNode(std::move($1), std::move($3)); }
   | tag_list OR_OP DOUBLE    { $$ = AstTagsNode(std::move($1), to_string($3)); }
+  | tag_list OR_OP PREFIX    { $$ = AstTagsNode(std::move($1), std::move($3), true); }
 
 
 %%
@@ -10,6 +10,7 @@
 #include <absl/strings/str_join.h>
 
 #include <chrono>
+#include <cmath>
 #include <type_traits>
 #include <variant>
 
@@ -113,6 +114,93 @@ struct IndexResult {
       value_;
 };
 
+// Collect text terms that contribute to relevance: all that are not negated, with their active
+// field or an empty field for terms matching all text fields. KNN and sorted queries are not scored.
+void CollectScoredTerms(const AstNode& node, string_view field,
+                        vector<pair<string_view, string_view>>* out) {
+  Overloaded ov{
+      [&](const AstTermNode& n) { out->emplace_back(field, n.term); },
+      [&](const AstLogicalNode& n) {
+        for (const auto& sub : n.nodes)
+          CollectScoredTerms(sub, field, out);
+      },
+      [&](const AstFieldNode& n) { CollectScoredTerms(*n.node, n.field, out); },
+      [](const auto&) {},
+  };
+  visit(ov, node.Variant());
+}
+
+// Views of an uncompressed result as ordered contiguous blocks, nullopt for compressed ones
+optional<vector<absl::Span<const DocId>>> ContiguousBlocks(const IndexResult& result) {
+  using Views = optional<vector<absl::Span<const DocId>>>;
+  Overloaded ov{
+      [](const IndexResult::DocVec* v) -> Views { return vector{absl::MakeConstSpan(*v)}; },
+      [](const BlockList<SortedVector>* l) -> Views { return BlockViews(*l); },
+      [](const BlockList<CompressedSortedSet>*) -> Views { return nullopt; },
+  };
+  return visit(ov, result.Borrowed());
+}
+
+// Forward cursor over a borrowed result set. Besides stepping, it can skip directly to the first
+// id not less than a target, which lets intersections leapfrog over large posting lists.
+class PostingCursor {
+  template <typename It> struct Range {
+    It it, end;
+  };
+
+  using DocIt = IndexResult::DocVec::const_iterator;
+
+ public:
+  explicit PostingCursor(IndexResult::BorrowedView view) {
+    visit([this](auto* set) { range_ = Range<decltype(set->begin())>{set->begin(), set->end()}; },
+          view);
+  }
+
+  bool Done() const {
+    return visit([](const auto& r) { return r.it == r.end; }, range_);
+  }
+
+  DocId Value() const {
+    return visit([](const auto& r) -> DocId { return *r.it; }, range_);
+  }
+
+  void Next() {
+    visit([](auto& r) { ++r.it; }, range_);
+  }
+
+  // Advance to first id not less than t
+  void SeekGE(DocId t) {
+    visit([t](auto& r) { SeekGE(&r, t); }, range_);
+  }
+
+ private:
+  // Plain vectors are searched by galloping: probe exponentially growing steps, then binary search
+  // the last one. Cost is logarithmic in the skipped distance, not in the vector size.
+  static void SeekGE(Range<DocIt>* r, DocId t) {
+    if (r->it == r->end || *r->it >= t)
+      return;
+
+    auto lo = r->it;
+    ptrdiff_t step = 1;
+    while (r->end - lo > step && lo[step] < t) {
+      lo += step;
+      step *= 2;
+    }
+    auto hi = r->end - lo > step ? lo + step : r->end;
+    r->it = lower_bound(lo + 1, hi, t);
+  }
+
+  // Block lists skip whole blocks first
+  template <typename It> static void SeekGE(Range<It>* r, DocId t) {
+    if (r->it != r->end)
+      r->it.SeekGE(t);
+  }
+
+  variant<Range<DocIt>, Range<BlockList<CompressedSortedSet>::BlockListIterator>,
+          Range<BlockList<SortedVector>::BlockListIterator>>
+      range_;
+};
+
 struct ProfileBuilder {
   string GetNodeInfo(const AstNode& node) {
     Overloaded node_info{
@@ -123,7 +211,16 @@ struct ProfileBuilder {
           auto op = n.op == AstLogicalNode::AND ? "and" : "or";
           return absl::StrCat("Logical{n=", n.nodes.size(), ",o=", op, "}");
         },
-        [](const AstTagsNode& n) { return absl::StrCat("Tags{", absl::StrJoin(n.tags, ","), "}"); },
+        [](const AstPrefixNode& n) { return absl::StrCat("Prefix{", n.prefix, "}"); },
+        [](const AstSuffixNode& n) { return absl::StrCat("Suffix{", n.suffix, "}"); },
+        [](const AstFuzzyNode& n) { return absl::StrCat("Fuzzy{", n.term, ",d=", n.distance, "}"); },
+        [](const AstTagsNode& n) {
+          auto prefixes = absl::StrJoin(n.prefixes, ",", [](string* out, const string& p) {
+            absl::StrAppend(out, p, "*");
+          });
+          return absl::StrCat("Tags{", absl::StrJoin(n.tags, ","),
+                              n.tags.empty() || prefixes.empty() ? "" : ",", prefixes, "}");
+        },
         [](const AstFieldNode& n) { return absl::StrCat("Field{", n.field, "}"); },
         [](const AstKnnNode& n) { return absl::StrCat("KNN{l=", n.limit, "}"); },
         [](const AstNegateNode& n) { return absl::StrCat("Negate{}"); },
@@ -161,15 +258,30 @@ struct ProfileBuilder {
 
 struct BasicSearch {
   using LogicOp = AstLogicalNode::LogicOp;
+  using DocVec = IndexResult::DocVec;
+
+  // Max size ratio of two uncompressed sets for them to be intersected block-wise
+  static constexpr size_t kMaxBlockwiseRatio = 32;
+
+  // Max number of terms a prefix, suffix or fuzzy term expands to per index
+  static constexpr size_t kMaxTermExpansions = 200;
+
+  // BM25 parameters: term frequency saturation and document length normalization
+  static constexpr double kBm25K1 = 1.2;
+  static constexpr double kBm25B = 0.75;
 
   BasicSearch(const FieldIndices* indices, size_t limit)
-      : indices_{indices}, limit_{limit}, tmp_vec_{} {
+      : indices_{indices}, limit_{limit} {
   }
 
   void EnableProfiling() {
     profile_builder_ = ProfileBuilder{};
   }
 
+  void EnableScoring() {
+    scoring_ = true;
+  }
+
   // Get casted sub index by field
   template <typename T> T* GetIndex(string_view field) {
     static_assert(is_base_of_v<BaseIndex, T>);
@@ -208,41 +320,118 @@ struct BasicSearch {
     return sub_results;
   }
 
-  void Merge(IndexResult matched, IndexResult* current_ptr, LogicOp op) {
-    IndexResult& current = *current_ptr;
-    tmp_vec_.clear();
+  // Leapfrog intersection: the cursor of the smallest set proposes candidates, all others skip
+  // forward to it and propose a larger candidate on mismatch. Only the first limit ids are stored,
+  // all following are only counted. Returns the total number of matches.
+  static size_t Intersect(absl::Span<PostingCursor> cursors, size_t limit, DocVec* out) {
+    size_t total = 0;
+    while (!cursors[0].Done()) {
+      DocId candidate = cursors[0].Value();
+
+      bool matched = true;
+      for (auto& cursor : cursors.subspan(1)) {
+        cursor.SeekGE(candidate);
+        if (cursor.Done())
+          return total;
+
+        if (cursor.Value() != candidate) {
+          cursors[0].SeekGE(cursor.Value());
+          matched = false;
+          break;
+        }
+      }
 
-    if (op == LogicOp::AND) {
-      tmp_vec_.reserve(min(matched.Size(), current.Size()));
-      auto cb = [this](auto* s1, auto* s2) {
-        set_intersection(s1->begin(), s1->end(), s2->begin(), s2->end(), back_inserter(tmp_vec_));
-      };
-      visit(cb, matched.Borrowed(), current.Borrowed());
-    } else {
-      tmp_vec_.reserve(matched.Size() + current.Size());
-      auto cb = [this](auto* s1, auto* s2) {
-        set_union(s1->begin(), s1->end(), s2->begin(), s2->end(), back_inserter(tmp_vec_));
-      };
-      visit(cb, matched.Borrowed(), current.Borrowed());
+      if (matched) {
+        if (out->size() < limit)
+          out->push_back(candidate);
+        total++;
+        cursors[0].Next();
+      }
+    }
+    return total;
+  }
+
+  // K-way union with a min heap of cursors. Same storage rules as for Intersect.
+  static size_t Unite(absl::Span<PostingCursor> cursors, size_t limit, DocVec* out) {
+    auto cmp = [&cursors](size_t l, size_t r) { return cursors[l].Value() > cursors[r].Value(); };
+    vector<size_t> heap;
+    for (size_t i = 0; i < cursors.size(); i++) {
+      if (!cursors[i].Done())
+        heap.push_back(i);
     }
+    make_heap(heap.begin(), heap.end(), cmp);
+
+    size_t total = 0;
+    optional<DocId> last;
+    while (!heap.empty()) {
+      pop_heap(heap.begin(), heap.end(), cmp);
+      PostingCursor& cursor = cursors[heap.back()];
+
+      if (DocId value = cursor.Value(); last != value) {
+        if (out->size() < limit)
+          out->push_back(value);
+        total++;
+        last = value;
+      }
 
-    current = std::move(tmp_vec_);
+      cursor.Next();
+      if (cursor.Done())
+        heap.pop_back();
+      else
+        push_heap(heap.begin(), heap.end(), cmp);
+    }
+    return total;
   }
 
-  // Efficiently unify multiple sub results with specified logical op
-  IndexResult UnifyResults(vector<IndexResult>&& sub_results, LogicOp op) {
+  // Efficiently unify multiple sub results with specified logical op. If the result is capped,
+  // only the first cap ids are stored and the total number of matches is saved in capped_total_.
+  IndexResult UnifyResults(vector<IndexResult>&& sub_results, LogicOp op,
+                           size_t cap = numeric_limits<size_t>::max()) {
     if (sub_results.empty())
       return vector<DocId>{};
 
-    // Unifying from smallest to largest is more efficient.
-    // AND: the result only shrinks, so starting with the smallest is most optimal.
-    // OR: unifying smaller sets first reduces the number of element traversals on average.
+    // AND: leading with the smallest set produces the fewest candidates.
     sort(sub_results.begin(), sub_results.end(),
          [](const auto& l, const auto& r) { return l.Size() < r.Size(); });
 
-    IndexResult out{std::move(sub_results[0])};
-    for (auto& matched : absl::MakeSpan(sub_results).subspan(1))
-      Merge(std::move(matched), &out, op);
+    if (op == LogicOp::AND && sub_results[0].Size() == 0)
+      return vector<DocId>{};
+
+    // Uncompressed sets of comparable size are intersected block-wise with SIMD kernels. The
+    // leapfrog intersection handles all others, as it skips over the larger set.
+    while (op == LogicOp::AND && sub_results.size() > 1 &&
+           sub_results[1].Size() <= sub_results[0].Size() * kMaxBlockwiseRatio) {
+      auto l = ContiguousBlocks(sub_results[0]), r = ContiguousBlocks(sub_results[1]);
+      if (!l || !r)
+        break;
+
+      DocVec matched;
+      matched.reserve(sub_results[0].Size());
+      IntersectBlocks(*l, *r, &matched);
+      sub_results[0] = std::move(matched);
+      sub_results.erase(sub_results.begin() + 1);
+    }
+
+    if (sub_results.size() == 1)
+      return std::move(sub_results[0]);
+
+    vector<PostingCursor> cursors;
+    cursors.reserve(sub_results.size());
+    for (const auto& result : sub_results)
+      cursors.emplace_back(result.Borrowed());
+
+    DocVec out;
+    size_t total = 0;
+    if (op == LogicOp::AND) {
+      out.reserve(min(sub_results[0].Size(), cap));
+      total = Intersect(absl::MakeSpan(cursors), cap, &out);
+    } else {
+      out.reserve(min(sub_results.back().Size(), cap));
+      total = Unite(absl::MakeSpan(cursors), cap, &out);
+    }
+
+    if (total > out.size())
+      capped_total_ = total;
     return out;
   }
 
@@ -257,6 +446,7 @@ struct BasicSearch {
 
   // "term": access field's text index or unify results from all text indices if no field is set
   IndexResult Search(const AstTermNode& node, string_view active_field) {
+    size_t cap = result_cap_;
     if (!active_field.empty()) {
       if (auto* index = GetIndex<TextIndex>(active_field); index)
         return index->Matching(node.term);
@@ -266,14 +456,60 @@ struct BasicSearch {
     vector<TextIndex*> selected_indices = indices_->GetAllTextIndices();
     auto mapping = [&node](TextIndex* index) { return index->Matching(node.term); };
 
-    return UnifyResults(GetSubResults(selected_indices, mapping), LogicOp::OR);
+    return UnifyResults(GetSubResults(selected_indices, mapping), LogicOp::OR, cap);
+  }
+
+  // Unify posting lists of all terms expand(index) returns from the field's text index or from
+  // all text indices if no field is set
+  template <typename F> IndexResult SearchExpanded(string_view active_field, const F& expand) {
+    size_t cap = result_cap_;
+    vector<TextIndex*> selected_indices;
+    if (active_field.empty())
+      selected_indices = indices_->GetAllTextIndices();
+    else if (auto* index = GetIndex<TextIndex>(active_field); index)
+      selected_indices = {index};
+
+    vector<IndexResult> sub_results;
+    for (TextIndex* index : selected_indices) {
+      for (const auto* container : expand(index))
+        sub_results.emplace_back(container);
+    }
+    return UnifyResults(std::move(sub_results), LogicOp::OR, cap);
+  }
+
+  // term*: all terms starting with prefix
+  IndexResult Search(const AstPrefixNode& node, string_view active_field) {
+    return SearchExpanded(active_field, [&node](TextIndex* index) {
+      return index->MatchingPrefix(node.prefix, kMaxTermExpansions);
+    });
+  }
+
+  // *term: all terms ending with suffix
+  IndexResult Search(const AstSuffixNode& node, string_view active_field) {
+    return SearchExpanded(active_field, [&node](TextIndex* index) {
+      return index->MatchingSuffix(node.suffix, kMaxTermExpansions);
+    });
+  }
+
+  // %term%: all terms within Levenshtein distance
+  IndexResult Search(const AstFuzzyNode& node, string_view active_field) {
+    return SearchExpanded(active_field, [&node](TextIndex* index) {
+      return index->MatchingFuzzy(node.term, node.distance, kMaxTermExpansions);
+    });
   }
 
   // [range]: access field's numeric index
   IndexResult Search(const AstRangeNode& node, string_view active_field) {
     DCHECK(!active_field.empty());
-    if (auto* index = GetIndex<NumericIndex>(active_field); index)
+    size_t cap = result_cap_;
+    if (auto* index = GetIndex<NumericIndex>(active_field); index) {
+      // Only the number of matches is needed, i.e. for LIMIT 0 0
+      if (cap == 0) {
+        capped_total_ = index->Count(node.lo, node.hi);
+        return IndexResult{};
+      }
       return index->Range(node.lo, node.hi);
+    }
     return IndexResult{};
   }
 
@@ -293,22 +529,31 @@ struct BasicSearch {
 
   // logical query: unify all sub results
   IndexResult Search(const AstLogicalNode& node, string_view active_field) {
+    size_t cap = result_cap_;  // read before descending, children reset it
     auto mapping = [&](auto& node) { return SearchGeneric(node, active_field); };
-    return UnifyResults(GetSubResults(node.nodes, mapping), node.op);
+    return UnifyResults(GetSubResults(node.nodes, mapping), node.op, cap);
   }
 
   // @field: set active field for sub tree
   IndexResult Search(const AstFieldNode& node, string_view active_field) {
     DCHECK(active_field.empty());
     DCHECK(node.node);
-    return SearchGeneric(*node.node, node.field);
+    // Field nodes only select the field, so a capped result can be passed through
+    bool top_level = result_cap_ != numeric_limits<size_t>::max();
+    return SearchGeneric(*node.node, node.field, top_level);
   }
 
   // {tags | ...}: Unify results for all tags
   IndexResult Search(const AstTagsNode& node, string_view active_field) {
+    size_t cap = result_cap_;
     if (auto* tag_index = GetIndex<TagIndex>(active_field); tag_index) {
       auto mapping = [tag_index](string_view tag) { return tag_index->Matching(tag); };
-      return UnifyResults(GetSubResults(node.tags, mapping), LogicOp::OR);
+      auto sub_results = GetSubResults(node.tags, mapping);
+      for (string_view prefix : node.prefixes) {
+        for (const auto* container : tag_index->MatchingPrefix(prefix, kMaxTermExpansions))
+          sub_results.emplace_back(container);
+      }
+      return UnifyResults(std::move(sub_results), LogicOp::OR, cap);
     }
     return IndexResult{};
   }
@@ -334,29 +579,35 @@ struct BasicSearch {
     return IndexResult{};
   }
 
-  void SearchKnnFlat(FlatVectorIndex* vec_index, const AstKnnNode& knn, IndexResult&& sub_results) {
-    knn_distances_.reserve(sub_results.Size());
-    auto cb = [&](auto* set) {
-      auto [dim, sim] = vec_index->Info();
-      for (DocId matched_doc : *set) {
-        float dist = VectorDistance(knn.vec.first.get(), vec_index->Get(matched_doc), dim, sim);
-        knn_distances_.emplace_back(dist, matched_doc);
-      }
-    };
-    visit(cb, sub_results.Borrowed());
-
-    size_t prefix_size = min(knn.limit, knn_distances_.size());
-    partial_sort(knn_distances_.begin(), knn_distances_.begin() + prefix_size,
-                 knn_distances_.end());
-    knn_distances_.resize(prefix_size);
+  void SearchKnnFlat(FlatVectorIndex* vec_index, const char* target, size_t limit,
+                     IndexResult&& sub_results) {
+    // Filtered documents are read in place, without copying them out of the result
+    auto cb = [&](auto* set) { return std::move(vec_index->Knn({target}, limit, *set).front()); };
+    knn_distances_ = visit(cb, sub_results.Borrowed());
   }
 
-  void SearchKnnHnsw(HnswVectorIndex* vec_index, const AstKnnNode& knn, IndexResult&& sub_results) {
+  void SearchKnnHnsw(HnswVectorIndex* vec_index, const AstKnnNode& knn, const char* target,
+                     size_t limit, IndexResult&& sub_results) {
     if (indices_->GetAllDocs().size() == sub_results.Size())
-      knn_distances_ = vec_index->Knn(knn.vec.first.get(), knn.limit, knn.ef_runtime);
+      knn_distances_ = vec_index->Knn(target, limit, knn.ef_runtime);
     else
-      knn_distances_ =
-          vec_index->Knn(knn.vec.first.get(), knn.limit, knn.ef_runtime, sub_results.Take());
+      knn_distances_ = vec_index->Knn(target, limit, knn.ef_runtime, sub_results.Take());
+  }
+
+  // Recompute distances of quantized results with the exact query vector and keep closest `limit`
+  void RerankKnn(const BaseVectorIndex& vec_index, const float* target, size_t limit) {
+    auto [dim, sim] = vec_index.Info();
+    auto [quant, _] = vec_index.QuantizationInfo();
+    vector<float> stored(dim);
+    for (auto& [dist, doc] : knn_distances_) {
+      DequantizeVector(vec_index.Get(doc), dim, quant, stored.data());
+      dist = VectorDistance(target, stored.data(), dim, sim);
+    }
+
+    size_t prefix_size = min(limit, knn_distances_.size());
+    partial_sort(knn_distances_.begin(), knn_distances_.begin() + prefix_size,
+                 knn_distances_.end());
+    knn_distances_.resize(prefix_size);
   }
 
   // [KNN limit @field vec]: Compute distance from `vec` to all vectors keep closest `limit`
@@ -368,18 +619,41 @@ struct BasicSearch {
     if (!vec_index)
       return IndexResult{};
 
-    if (auto [dim, _] = vec_index->Info(); dim != knn.vec.second) {
+    auto [dim, sim] = vec_index->Info();
+    if (dim != knn.vec.second) {
       error_ =
           absl::StrCat("Wrong vector index dimensions, got: ", knn.vec.second, ", expected: ", dim);
       return IndexResult{};
     }
 
+    // Indexed vectors are stored normalized for cosine similarity, so must be the query vector
+    const float* target = knn.vec.first.get();
+    unique_ptr<float[]> normalized;
+    if (sim == VectorSimilarity::COSINE) {
+      normalized = make_unique<float[]>(dim);
+      memcpy(normalized.get(), target, dim * sizeof(float));
+      NormalizeVector(normalized.get(), dim);
+      target = normalized.get();
+    }
+
+    // Compare with stored vectors in their encoded form, fetch more results if they're re-ranked
+    auto [quant, rerank_factor] = vec_index->QuantizationInfo();
+    auto encoded = make_unique<char[]>(QuantizedSize(dim, quant));
+    QuantizeVector(target, dim, quant, encoded.get());
+
+    bool rerank = quant != VectorQuantization::NONE && rerank_factor > 0;
+    size_t limit = rerank ? knn.limit * rerank_factor : knn.limit;
+
     preagg_total_ = sub_results.Size();
     scores_.clear();
     if (auto hnsw_index = dynamic_cast<HnswVectorIndex*>(vec_index); hnsw_index)
-      SearchKnnHnsw(hnsw_index, knn, std::move(sub_results));
+      SearchKnnHnsw(hnsw_index, knn, encoded.get(), limit, std::move(sub_results));
     else
-      SearchKnnFlat(dynamic_cast<FlatVectorIndex*>(vec_index), knn, std::move(sub_results));
+      SearchKnnFlat(dynamic_cast<FlatVectorIndex*>(vec_index), encoded.get(), limit,
+                    std::move(sub_results));
+
+    if (rerank)
+      RerankKnn(*vec_index, target, knn.limit);
 
     vector<DocId> out(knn_distances_.size());
     scores_.reserve(knn_distances_.size());
@@ -399,6 +673,10 @@ struct BasicSearch {
 
     ProfileBuilder::Tp start = profile_builder_ ? profile_builder_->Start() : ProfileBuilder::Tp{};
 
+    // Top level results are returned as is, so only limit_ ids have to be stored. Nested results
+    // are needed in full by their parents (negation, sorting, knn), as are ranked results.
+    result_cap_ = top_level && scored_terms_.empty() ? limit_ : numeric_limits<size_t>::max();
+
     auto cb = [this, active_field](const auto& inner) { return Search(inner, active_field); };
     auto result = visit(cb, node.Variant());
 
@@ -413,17 +691,104 @@ struct BasicSearch {
     return result;
   }
 
+  // BM25 relevance of every id over all scored terms, ids must be sorted. Terms are scored one by
+  // one, with a cursor over the term's documents that skips ahead to the next id.
+  vector<float> ScoreBm25(const vector<DocId>& ids) {
+    vector<float> scores(ids.size(), 0.0f);
+    for (auto [field, term] : scored_terms_) {
+      vector<TextIndex*> selected_indices;
+      if (field.empty())
+        selected_indices = indices_->GetAllTextIndices();
+      else if (auto* index = dynamic_cast<TextIndex*>(indices_->GetIndex(field)); index)
+        selected_indices.push_back(index);
+
+      for (const TextIndex* index : selected_indices) {
+        const auto* docs = index->Matching(term);
+        if (docs == nullptr)
+          continue;
+
+        const auto* freqs = index->Frequencies(term);
+        double num_docs = index->NumDocs(), df = docs->Size();
+        double idf = log(1 + (num_docs - df + 0.5) / (df + 0.5));
+        double avg_length = max(index->AvgDocLength(), 1.0);
+
+        PostingCursor cursor{docs};
+        for (size_t i = 0; i < ids.size(); i++) {
+          if (cursor.SeekGE(ids[i]); cursor.Done())
+            break;
+          if (cursor.Value() != ids[i])
+            continue;
+
+          double tf = 1;
+          if (freqs != nullptr) {
+            if (auto it = freqs->find(ids[i]); it != freqs->end())
+              tf = it->second;
+          }
+
+          double norm = 1 - kBm25B + kBm25B * index->DocLength(ids[i]) / avg_length;
+          scores[i] += idf * tf * (kBm25K1 + 1) / (tf + kBm25K1 * norm);
+        }
+      }
+    }
+    return scores;
+  }
+
+  // Keep only limit_ best scored ids with a bounded heap, order them by descending score
+  void RankTopK(vector<DocId>* ids) {
+    vector<float> scores = ScoreBm25(*ids);
+
+    // Higher score wins, lower id breaks ties. The heap top is the worst of the best entries.
+    using Entry = pair<float, DocId>;
+    auto better = [](const Entry& l, const Entry& r) {
+      return l.first > r.first || (l.first == r.first && l.second < r.second);
+    };
+
+    vector<Entry> heap;
+    heap.reserve(min(limit_, ids->size()) + 1);
+    for (size_t i = 0; i < ids->size() && limit_ > 0; i++) {
+      Entry entry{scores[i], (*ids)[i]};
+      if (heap.size() == limit_) {
+        if (!better(entry, heap.front()))
+          continue;
+        pop_heap(heap.begin(), heap.end(), better);
+        heap.pop_back();
+      }
+      heap.push_back(entry);
+      push_heap(heap.begin(), heap.end(), better);
+    }
+    sort_heap(heap.begin(), heap.end(), better);
+
+    ids->resize(heap.size());
+    scores_.resize(heap.size());
+    for (size_t i = 0; i < heap.size(); i++) {
+      scores_[i] = heap[i].first;
+      (*ids)[i] = heap[i].second;
+    }
+  }
+
   SearchResult Search(const AstNode& query) {
+    if (scoring_)
+      CollectScoredTerms(query, "", &scored_terms_);
+
     IndexResult result = SearchGeneric(query, "", true);
 
     // Extract profile if enabled
     optional<AlgorithmProfile> profile =
         profile_builder_ ? make_optional(profile_builder_->Take()) : nullopt;
 
-    size_t total = result.Size();
+    size_t total = capped_total_.value_or(result.Size());
+
+    vector<DocId> ids;
+    if (scored_terms_.empty()) {
+      ids = result.Take(limit_);
+    } else {
+      ids = result.Take();
+      RankTopK(&ids);
+    }
+
     return SearchResult{total,
                         max(total, preagg_total_),
-                        result.Take(limit_),
+                        std::move(ids),
                         std::move(scores_),
                         std::move(profile),
                         std::move(error_)};
@@ -438,7 +803,12 @@ struct BasicSearch {
 
   std::vector<ResultScore> scores_;
 
-  vector<DocId> tmp_vec_;
+  bool scoring_ = false;
+  vector<pair<string_view /*field*/, string_view /*term*/>> scored_terms_;
+
+  size_t result_cap_ = numeric_limits<size_t>::max();
+  optional<size_t> capped_total_;  // total number of matches if the top level result was capped
+
   vector<pair<float, DocId>> knn_distances_;
 };
 
@@ -514,9 +884,13 @@ void FieldIndices::CreateSortIndices(PMR_NS::memory_resource* mr) {
   }
 }
 
-void FieldIndices::Add(DocId doc, DocumentAccessor* access) {
-  for (auto& [field, index] : indices_)
-    index->Add(doc, access, field);
+void FieldIndices::Add(DocId doc, DocumentAccessor* access, DeferredVectors* deferred) {
+  for (auto& [field, index] : indices_) {
+    if (auto* hnsw_index = dynamic_cast<HnswVectorIndex*>(index.get()); hnsw_index && deferred)
+      (*deferred)[hnsw_index].emplace_back(doc, access->GetVector(field));
+    else
+      index->Add(doc, access, field);
+  }
   for (auto& [field, sort_index] : sort_indices_)
     sort_index->Add(doc, access, field);
 
@@ -534,6 +908,48 @@ void FieldIndices::Remove(DocId doc, DocumentAccessor* access) {
   all_ids_.erase(it);
 }
 
+vector<pair<string_view, BaseVectorIndex*>> FieldIndices::GetVectorIndices() const {
+  vector<pair<string_view, BaseVectorIndex*>> out;
+  for (auto& [field, index] : indices_) {
+    if (auto* vector_index = dynamic_cast<BaseVectorIndex*>(index.get()); vector_index)
+      out.emplace_back(field, vector_index);
+  }
+  return out;
+}
+
+bool FieldIndices::RestoreVectors(const vector<pair<string_view, string_view>>& data) {
+  for (auto& [field, index] : indices_) {
+    auto* vector_index = dynamic_cast<BaseVectorIndex*>(index.get());
+    if (!vector_index)
+      continue;
+
+    auto it = find_if(data.begin(), data.end(),
+                      [&field = field](const auto& p) { return p.first == field; });
+    if (it == data.end() || !vector_index->Restore(it->second))
+      return false;
+  }
+  return true;
+}
+
+void FieldIndices::AddRestored(DocId doc, DocumentAccessor* access) {
+  for (auto& [field, index] : indices_) {
+    if (!dynamic_cast<BaseVectorIndex*>(index.get()))
+      index->Add(doc, access, field);
+  }
+  for (auto& [field, sort_index] : sort_indices_)
+    sort_index->Add(doc, access, field);
+
+  all_ids_.insert(upper_bound(all_ids_.begin(), all_ids_.end(), doc), doc);
+}
+
+void FieldIndices::RemoveRestored(DocId doc) {
+  // Vector indices don't access documents on removal
+  for (auto& [field, index] : indices_) {
+    if (dynamic_cast<BaseVectorIndex*>(index.get()))
+      index->Remove(doc, nullptr, field);
+  }
+}
+
 BaseIndex* FieldIndices::GetIndex(string_view field) const {
   auto it = indices_.find(schema_.LookupAlias(field));
   return it != indices_.end() ? it->second.get() : nullptr;
@@ -599,6 +1015,8 @@ SearchResult SearchAlgorithm::Search(const FieldIndices* index, size_t limit) co
   auto bs = BasicSearch{index, limit};
   if (profiling_enabled_)
     bs.EnableProfiling();
+  if (scoring_enabled_)
+    bs.EnableScoring();
   return bs.Search(*query_);
 }
 
@@ -616,6 +1034,14 @@ optional<AggregationInfo> SearchAlgorithm::HasAggregation() const {
     return AggregationInfo{nullopt, alias, sort->descending};
   }
 
+  // Ranked results are ordered by descending relevance
+  if (scoring_enabled_) {
+    vector<pair<string_view, string_view>> terms;
+    CollectScoredTerms(*query_, "", &terms);
+    if (!terms.empty())
+      return AggregationInfo{nullopt, "", true};
+  }
+
   return nullopt;
 }
 
@@ -623,4 +1049,8 @@ void SearchAlgorithm::EnableProfiling() {
   profiling_enabled_ = true;
 }
 
+void SearchAlgorithm::EnableScoring() {
+  scoring_enabled_ = true;
+}
+
 }  // namespace dfly::search
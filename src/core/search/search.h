@@ -34,6 +34,9 @@ struct SchemaField {
     size_t capacity = 1000;                       // initial capacity
     size_t hnsw_ef_construction = 200;
     size_t hnsw_m = 16;
+
+    VectorQuantization quantization = VectorQuantization::NONE;
+    size_t rerank_factor = 0;  // re-rank limit * factor quantized results with the exact query
   };
 
   struct TagParams {
@@ -61,15 +64,34 @@ struct Schema {
   std::string_view LookupAlias(std::string_view alias) const;
 };
 
+struct BaseVectorIndex;
+struct HnswVectorIndex;
+
 // Collection of indices for all fields in schema
 class FieldIndices {
  public:
+  // Vectors of HNSW indices collected for bulk insertion with HnswVectorIndex::AddBatch
+  using DeferredVectors =
+      absl::flat_hash_map<HnswVectorIndex*, std::vector<std::pair<DocId, OwnedFtVector>>>;
+
   // Create indices based on schema
   FieldIndices(Schema schema, PMR_NS::memory_resource* mr);
 
-  void Add(DocId doc, DocumentAccessor* access);
+  // If deferred is set, vectors of HNSW indices are collected into it instead of being inserted
+  void Add(DocId doc, DocumentAccessor* access, DeferredVectors* deferred = nullptr);
   void Remove(DocId doc, DocumentAccessor* access);
 
+  // Vector indices by field, serialized with BaseVectorIndex::SerializeChunk()
+  std::vector<std::pair<std::string_view, BaseVectorIndex*>> GetVectorIndices() const;
+
+  // Restore all vector indices from serialized data. Return false if any of them is missing or
+  // can't be restored. Restored documents are then added to all other indices with AddRestored()
+  bool RestoreVectors(const std::vector<std::pair<std::string_view, std::string_view>>& data);
+  void AddRestored(DocId doc, DocumentAccessor* access);
+
+  // Remove restored document that wasn't added with AddRestored() from vector indices
+  void RemoveRestored(DocId doc);
+
   BaseIndex* GetIndex(std::string_view field) const;
   BaseSortIndex* GetSortIndex(std::string_view field) const;
   std::vector<TextIndex*> GetAllTextIndices() const;
@@ -145,8 +167,13 @@ class SearchAlgorithm {
 
   void EnableProfiling();
 
+  // Rank results of text queries by BM25 relevance. Only the best limit results are returned,
+  // ordered by descending score. Queries with KNN or SORTBY are not ranked.
+  void EnableScoring();
+
  private:
   bool profiling_enabled_ = false;
+  bool scoring_enabled_ = false;
   std::unique_ptr<AstNode> query_;
 };
 
@@ -142,6 +142,24 @@ TEST_F(SearchParserTest, Numeric) {
   NEXT_EQ(TOK_TERM, string, "22");
 }
 
+TEST_F(SearchParserTest, Wildcards) {
+  SetInput("hel* *llo %word% %%word%% %%%word%%%");
+  NEXT_EQ(TOK_PREFIX, string, "hel");
+  NEXT_EQ(TOK_SUFFIX, string, "llo");
+  for (uint32_t distance = 1; distance <= 3; distance++) {
+    auto tok = Lex();
+    ASSERT_EQ(tok.type_get(), Parser::token::TOK_FUZZY);
+    EXPECT_EQ(tok.value.as<AstFuzzyNode>().term, "word");
+    EXPECT_EQ(tok.value.as<AstFuzzyNode>().distance, distance);
+  }
+  NEXT_TOK(TOK_YYEOF);
+
+  EXPECT_EQ(0, Parse("hel* | *llo %word%"));
+  EXPECT_EQ(0, Parse("@title:(hel* *llo) @name:%%word%%"));
+  EXPECT_EQ(0, Parse("@tags:{ red | bl* }"));
+  EXPECT_EQ(0, Parse("*"));
+}
+
 TEST_F(SearchParserTest, KNN) {
   SetInput("*=>[KNN 1 @vector field_vec]");
   NEXT_TOK(TOK_STAR);
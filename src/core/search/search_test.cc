@@ -8,6 +8,7 @@
 #include <absl/container/flat_hash_map.h>
 #include <absl/strings/escaping.h>
 #include <absl/strings/numbers.h>
+#include <absl/strings/str_cat.h>
 #include <absl/strings/str_split.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -19,6 +20,7 @@
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "core/search/base.h"
+#include "core/search/indices.h"
 #include "core/search/query_driver.h"
 #include "core/search/vector_utils.h"
 
@@ -372,6 +374,72 @@ TEST_F(SearchTest, IntegerTerms) {
   EXPECT_TRUE(Check()) << GetError();
 }
 
+TEST_F(SearchTest, MatchPrefixSuffix) {
+  PrepareQuery("hel*");
+  ExpectAll("hello", "Helium", "hel", "the helicopter");
+  ExpectNone("shell", "he", "hallo");
+  EXPECT_TRUE(Check()) << GetError();
+
+  PrepareQuery("*ing");
+  ExpectAll("sing", "ringing bells", "ing", "Thing");
+  ExpectNone("singer", "in", "ringo");
+  EXPECT_TRUE(Check()) << GetError();
+
+  PrepareSchema({{"title", SchemaField::TEXT}, {"body", SchemaField::TEXT}});
+  PrepareQuery("@title:(car* -*ing)");
+  ExpectAll(Map{{"title", "cars"}, {"body", "racing"}}, Map{{"title", "carpet"}});
+  ExpectNone(Map{{"title", "caring"}}, Map{{"title", "cars racing"}},
+             Map{{"title", "scar"}, {"body", "cars"}});
+  EXPECT_TRUE(Check()) << GetError();
+}
+
+TEST_F(SearchTest, SuffixAfterUpdates) {
+  auto schema = MakeSimpleSchema({{"title", SchemaField::TEXT}});
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+  MockedDocument sing{Map{{"title", "sing"}}}, ring{Map{{"title", "ringing"}}};
+  indices.Add(0, &sing);
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+  algo.Init("*ing", &params);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(0));
+
+  // Terms are found by suffix after they're added or removed following the first suffix query
+  indices.Add(1, &ring);
+  indices.Remove(0, &sing);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(1));
+}
+
+TEST_F(SearchTest, MatchFuzzy) {
+  PrepareQuery("%hello%");
+  ExpectAll("hello", "hallo", "hell", "helloo", "jello world");
+  ExpectNone("help", "hola", "yellow", "he");
+  EXPECT_TRUE(Check()) << GetError();
+
+  PrepareQuery("%%hello%%");
+  ExpectAll("hello", "help", "yellow", "hel", "hallo");
+  ExpectNone("hola", "he", "world");
+  EXPECT_TRUE(Check()) << GetError();
+
+  PrepareSchema({{"title", SchemaField::TEXT}, {"body", SchemaField::TEXT}});
+  PrepareQuery("@title:%fox%");
+  ExpectAll(Map{{"title", "box"}}, Map{{"title", "the fx"}}, Map{{"title", "foxy"}});
+  ExpectNone(Map{{"body", "fox"}}, Map{{"title", "boxy"}});
+  EXPECT_TRUE(Check()) << GetError();
+}
+
+TEST_F(SearchTest, CheckTagPrefix) {
+  PrepareSchema({{"color", SchemaField::TAG}});
+
+  PrepareQuery("@color:{bl* | red}");
+  ExpectAll(Map{{"color", "blue"}}, Map{{"color", "black"}}, Map{{"color", "red"}},
+            Map{{"color", "green, Blond"}});
+  ExpectNone(Map{{"color", "green"}}, Map{{"color", "redish"}}, Map{{"color", "b"}});
+
+  EXPECT_TRUE(Check()) << GetError();
+}
+
 std::string ToBytes(absl::Span<const float> vec) {
   return string{reinterpret_cast<const char*>(vec.data()), sizeof(float) * vec.size()};
 }
@@ -399,6 +467,155 @@ TEST_F(SearchTest, Errors) {
   EXPECT_THAT(algo.Search(&indices).error, HasSubstr("Wrong vector index dimensions"));
 }
 
+TEST_F(SearchTest, LargeRanges) {
+  auto schema = MakeSimpleSchema({{"n", SchemaField::NUMERIC}});
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+  // Values are a permutation of ids spanning many blocks
+  auto value = [](size_t id) { return (id * 7919) % 5000; };
+  vector<MockedDocument> docs;
+  for (size_t i = 0; i < 5000; i++)
+    docs.emplace_back(Map{{"n", absl::StrCat(value(i))}});
+  for (size_t i = 0; i < docs.size(); i++)
+    indices.Add(i, &docs[i]);
+
+  // Remove every third document
+  for (size_t i = 0; i < docs.size(); i += 3)
+    indices.Remove(i, &docs[i]);
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+  for (auto [lo, hi] : {pair{1000, 1999}, pair{0, 4999}, pair{4990, 6000}, pair{17, 17}}) {
+    vector<DocId> expected;
+    for (size_t i = 0; i < docs.size(); i++) {
+      if (i % 3 != 0 && value(i) >= size_t(lo) && value(i) <= size_t(hi))
+        expected.push_back(i);
+    }
+
+    algo.Init(absl::StrCat("@n:[", lo, " ", hi, "]"), &params);
+    auto res = algo.Search(&indices);
+    EXPECT_EQ(res.ids, expected);
+
+    // Only count matches
+    res = algo.Search(&indices, 0);
+    EXPECT_EQ(res.total, expected.size());
+    EXPECT_TRUE(res.ids.empty());
+  }
+}
+
+TEST_F(SearchTest, LimitedLogicalQueries) {
+  auto schema = MakeSimpleSchema({{"even", SchemaField::TAG}, {"third", SchemaField::TAG}});
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+  for (size_t i = 0; i < 3000; i++) {
+    Map values{{{"even", i % 2 == 0 ? "yes" : "no"}, {"third", i % 3 == 0 ? "yes" : "no"}}};
+    MockedDocument doc{values};
+    indices.Add(i, &doc);
+  }
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+
+  // Only the first ids are stored, but the total is still exact
+  algo.Init("@even:{yes} @third:{yes}", &params);
+  auto res = algo.Search(&indices, 3);
+  EXPECT_EQ(res.total, 500u);
+  EXPECT_THAT(res.ids, testing::ElementsAre(0, 6, 12));
+
+  algo.Init("@even:{yes} | @third:{yes}", &params);
+  res = algo.Search(&indices, 4);
+  EXPECT_EQ(res.total, 2000u);
+  EXPECT_THAT(res.ids, testing::ElementsAre(0, 2, 3, 4));
+
+  // Tags inside a single field node are limited the same way
+  algo.Init("@even:{yes | no}", &params);
+  res = algo.Search(&indices, 2);
+  EXPECT_EQ(res.total, 3000u);
+  EXPECT_THAT(res.ids, testing::ElementsAre(0, 1));
+
+  // Nested results are never cut
+  algo.Init("-(@even:{yes} @third:{yes})", &params);
+  res = algo.Search(&indices, 2);
+  EXPECT_EQ(res.total, 2500u);
+  EXPECT_THAT(res.ids, testing::ElementsAre(1, 2));
+}
+
+TEST_F(SearchTest, MultiTagIntersection) {
+  auto schema = MakeSimpleSchema({{"tags", SchemaField::TAG}, {"text", SchemaField::TEXT}});
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+  vector<DocId> expected;
+  for (size_t i = 0; i < 5000; i++) {
+    string tags = absl::StrCat("t", i % 2, ",u", i % 3, ",v", i % 5);
+    Map values{{{"tags", tags}, {"text", i % 7 == 0 ? "seven" : "other"}}};
+    MockedDocument doc{values};
+    indices.Add(i, &doc);
+
+    if (i % 2 == 0 && i % 3 == 1 && i % 5 == 2)
+      expected.push_back(i);
+  }
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+
+  algo.Init("@tags:{t0} @tags:{u1} @tags:{v2}", &params);
+  EXPECT_EQ(algo.Search(&indices).ids, expected);
+
+  // Mixed with compressed text results
+  expected.erase(remove_if(expected.begin(), expected.end(), [](DocId id) { return id % 7 != 0; }),
+                 expected.end());
+  algo.Init("@tags:{t0} @tags:{u1} @tags:{v2} @text:seven", &params);
+  EXPECT_EQ(algo.Search(&indices).ids, expected);
+}
+
+TEST_F(SearchTest, Bm25Ranking) {
+  auto schema = MakeSimpleSchema({{"title", SchemaField::TEXT}, {"body", SchemaField::TEXT}});
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+  vector<pair<string, string>> docs = {
+      {"red apple", "an apple a day keeps the doctor away"},
+      {"green pear", "pears are green and sweet"},
+      {"apple pie", "apple apple apple pie with apple filling"},
+      {"red car", "a fast red car"},
+      {"fruit", "a long text about fruit that mentions an apple only once, but has many other "
+                "words to make it longer than all other documents"},
+  };
+  for (size_t i = 0; i < docs.size(); i++) {
+    MockedDocument doc{Map{{"title", docs[i].first}, {"body", docs[i].second}}};
+    indices.Add(i, &doc);
+  }
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+  algo.EnableScoring();
+
+  // Frequent occurrences rank higher, long documents rank lower
+  algo.Init("apple", &params);
+  auto res = algo.Search(&indices);
+  EXPECT_EQ(res.total, 3u);
+  EXPECT_THAT(res.ids, testing::ElementsAre(2, 0, 4));
+  ASSERT_EQ(res.scores.size(), 3u);
+  EXPECT_GT(get<float>(res.scores[0]), get<float>(res.scores[1]));
+  EXPECT_GT(get<float>(res.scores[1]), get<float>(res.scores[2]));
+
+  // Top-k keeps only the best, but counts all matches
+  res = algo.Search(&indices, 1);
+  EXPECT_EQ(res.total, 3u);
+  EXPECT_THAT(res.ids, testing::ElementsAre(2));
+
+  // Negated terms don't contribute, field restricted terms score only their field
+  algo.Init("@title:red -apple", &params);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(3));
+  algo.Init("@title:apple", &params);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(0, 2));
+
+  // Removed documents are not counted
+  MockedDocument doc{Map{{"title", docs[2].first}, {"body", docs[2].second}}};
+  indices.Remove(2, &doc);
+  algo.Init("apple", &params);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(0, 4));
+}
+
 class KnnTest : public SearchTest, public testing::WithParamInterface<bool /* hnsw */> {};
 
 TEST_P(KnnTest, Simple1D) {
@@ -580,6 +797,200 @@ TEST_P(KnnTest, AutoResize) {
   EXPECT_EQ(indices.GetAllDocs().size(), 100);
 }
 
+TEST_P(KnnTest, FilterSelectivity) {
+  // Both very selective and broad filters must return exact closest documents, whether they are
+  // checked one by one or while traversing the graph
+  auto schema = MakeSimpleSchema({{"n", SchemaField::NUMERIC}, {"pos", SchemaField::VECTOR}});
+  schema.fields["pos"].special_params = SchemaField::VectorParams{GetParam(), 1};
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+  for (size_t i = 0; i < 2000; i++) {
+    MockedDocument doc{Map{{"n", to_string(i)}, {"pos", ToBytes({float(i)})}}};
+    indices.Add(i, &doc);
+  }
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+  params["vec"] = ToBytes({1000.2});
+
+  algo.Init("@n:[1500 1510] =>[KNN 3 @pos $vec]", &params);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(1500, 1501, 1502));
+
+  algo.Init("@n:[10 1990] =>[KNN 3 @pos $vec]", &params);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(1000, 1001, 999));
+
+  // Removed documents are skipped
+  MockedDocument doc{Map{{"n", "1500"}, {"pos", ToBytes({1500.0f})}}};
+  indices.Remove(1500, &doc);
+  algo.Init("@n:[1500 1510] =>[KNN 3 @pos $vec]", &params);
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(1501, 1502, 1503));
+}
+
+TEST_P(KnnTest, SerializeRestore) {
+  auto schema = MakeSimpleSchema({{"even", SchemaField::TAG}, {"pos", SchemaField::VECTOR}});
+  schema.fields["pos"].special_params = SchemaField::VectorParams{GetParam(), 2};
+
+  vector<Map> docs;
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+  for (size_t i = 0; i < 200; i++) {
+    docs.push_back(Map{{"even", i % 2 == 0 ? "YES" : "NO"},
+                       {"pos", ToBytes({float(i % 20), float(i / 20)})}});
+    MockedDocument doc{docs.back()};
+    indices.Add(i, &doc);
+  }
+
+  MockedDocument removed{docs[42]};
+  indices.Remove(42, &removed);
+
+  auto vector_indices = indices.GetVectorIndices();
+  ASSERT_EQ(vector_indices.size(), 1u);
+
+  // Serialize in small chunks
+  string serialized;
+  size_t cursor = 0, chunks = 1;
+  while (vector_indices[0].second->SerializeChunk(&cursor, 512, &serialized))
+    chunks++;
+  EXPECT_GT(chunks, 2u);
+  EXPECT_EQ(serialized.size(), vector_indices[0].second->SerializedSize());
+  vector<pair<string_view, string_view>> data = {{"pos", serialized}};
+
+  // Corrupted data is rejected
+  {
+    FieldIndices restored{schema, PMR_NS::get_default_resource()};
+    string_view truncated = string_view{serialized}.substr(0, serialized.size() / 2);
+    EXPECT_FALSE(restored.RestoreVectors({{"pos", truncated}}));
+  }
+  if (GetParam()) {
+    // First neighbour of the first element points outside of the graph. Header has 10 fields,
+    // level 0 data starts with the neighbour count
+    string corrupted = serialized;
+    uint32_t bad_id = 1000;
+    memcpy(corrupted.data() + 10 * sizeof(uint64_t) + sizeof(uint32_t), &bad_id, sizeof(bad_id));
+    FieldIndices restored{schema, PMR_NS::get_default_resource()};
+    EXPECT_FALSE(restored.RestoreVectors({{"pos", corrupted}}));
+  }
+
+  FieldIndices restored{schema, PMR_NS::get_default_resource()};
+  ASSERT_TRUE(restored.RestoreVectors(data));
+  for (size_t i = 0; i < docs.size(); i++) {
+    MockedDocument doc{docs[i]};
+    if (i != 42)
+      restored.AddRestored(i, &doc);
+  }
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+  for (string_view query : {"* =>[KNN 5 @pos $vec]", "@even:{yes} =>[KNN 5 @pos $vec]"}) {
+    params["vec"] = ToBytes({2.1, 2.0});
+    algo.Init(query, &params);
+    EXPECT_EQ(algo.Search(&restored).ids, algo.Search(&indices).ids) << query;
+  }
+
+  // Restored index keeps accepting updates
+  MockedDocument doc{Map{{"even", "YES"}, {"pos", ToBytes({2.1, 2.0})}}};
+  restored.Add(200, &doc);
+  algo.Init("* =>[KNN 1 @pos $vec]", &params);
+  EXPECT_THAT(algo.Search(&restored).ids, testing::ElementsAre(200));
+}
+
+TEST_F(SearchTest, VectorDistance) {
+  // Check kernels against plain loops for all remainders of vectorized loops
+  default_random_engine rng{42};
+  uniform_real_distribution<float> dist{-1.0f, 1.0f};
+  for (size_t dims = 1; dims <= 67; dims++) {
+    vector<float> u(dims), v(dims);
+    for (size_t i = 0; i < dims; i++) {
+      u[i] = dist(rng);
+      v[i] = dist(rng);
+    }
+
+    float l2 = 0;
+    for (size_t i = 0; i < dims; i++)
+      l2 += (u[i] - v[i]) * (u[i] - v[i]);
+    EXPECT_NEAR(VectorDistance(u.data(), v.data(), dims, VectorSimilarity::L2), sqrt(l2), 1e-4);
+
+    float uv = 0, uu = 0, vv = 0;
+    for (size_t i = 0; i < dims; i++) {
+      uv += u[i] * v[i];
+      uu += u[i] * u[i];
+      vv += v[i] * v[i];
+    }
+    NormalizeVector(u.data(), dims);
+    NormalizeVector(v.data(), dims);
+    EXPECT_NEAR(VectorDistance(u.data(), v.data(), dims, VectorSimilarity::COSINE),
+                1 - uv / sqrt(uu * vv), 1e-4);
+
+    // Quantized distances must stay close to exact ones
+    for (auto quant : {VectorQuantization::FP16, VectorQuantization::INT8}) {
+      vector<char> qu(QuantizedSize(dims, quant)), qv(QuantizedSize(dims, quant));
+      QuantizeVector(u.data(), dims, quant, qu.data());
+      QuantizeVector(v.data(), dims, quant, qv.data());
+      for (auto sim : {VectorSimilarity::L2, VectorSimilarity::COSINE}) {
+        EXPECT_NEAR(QuantizedDistance(qu.data(), qv.data(), dims, quant, sim),
+                    VectorDistance(u.data(), v.data(), dims, sim), 0.05);
+      }
+
+      vector<float> restored(dims);
+      DequantizeVector(qu.data(), dims, quant, restored.data());
+      for (size_t i = 0; i < dims; i++)
+        EXPECT_NEAR(restored[i], u[i], 0.01);
+    }
+  }
+}
+
+TEST_P(KnnTest, Quantized) {
+  // Points on a line, closest ones must be found with both quantizations and re-ranking
+  for (auto quant : {VectorQuantization::FP16, VectorQuantization::INT8}) {
+    for (size_t rerank_factor : {0, 3}) {
+      SchemaField::VectorParams params{GetParam(), 2, VectorSimilarity::L2};
+      params.quantization = quant;
+      params.rerank_factor = rerank_factor;
+
+      auto schema = MakeSimpleSchema({{"pos", SchemaField::VECTOR}});
+      schema.fields["pos"].special_params = params;
+      FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+      for (size_t i = 0; i < 100; i++) {
+        MockedDocument doc{Map{{"pos", ToBytes({float(i), 1.0f})}}};
+        indices.Add(i, &doc);
+      }
+
+      SearchAlgorithm algo{};
+      QueryParams query_params;
+      query_params["vec"] = ToBytes({50.1, 1.0});
+      algo.Init("* =>[KNN 3 @pos $vec]", &query_params);
+      EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(50, 51, 49));
+    }
+  }
+}
+
+TEST_P(KnnTest, BatchedInnerProduct) {
+  // Inner product distance is 1 - x for all points, so larger x is closer to (1, 0)
+  SchemaField::VectorParams params{GetParam(), 2, VectorSimilarity::IP};
+  unique_ptr<BaseVectorIndex> index;
+  if (GetParam())
+    index = make_unique<HnswVectorIndex>(params, PMR_NS::get_default_resource());
+  else
+    index = make_unique<FlatVectorIndex>(params, PMR_NS::get_default_resource());
+
+  vector<DocId> ids;
+  for (DocId i = 0; i < 10; i++) {
+    MockedDocument doc{Map{{"pos", ToBytes({float(i), 1.0f})}}};
+    index->Add(i, &doc, "pos");
+    ids.push_back(i);
+  }
+
+  const float kRight[] = {1.0f, 0.0f}, kLeft[] = {-1.0f, 0.0f};
+  vector<const char*> targets = {reinterpret_cast<const char*>(kRight),
+                                 reinterpret_cast<const char*>(kLeft)};
+  auto results = GetParam() ? static_cast<HnswVectorIndex*>(index.get())->Knn(targets, 3, nullopt)
+                            : static_cast<FlatVectorIndex*>(index.get())->Knn(targets, 3, ids);
+
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_THAT(results[0], testing::ElementsAre(pair{-8.0f, 9u}, pair{-7.0f, 8u}, pair{-6.0f, 7u}));
+  EXPECT_THAT(results[1], testing::ElementsAre(pair{1.0f, 0u}, pair{2.0f, 1u}, pair{3.0f, 2u}));
+}
+
 INSTANTIATE_TEST_SUITE_P(KnnFlat, KnnTest, testing::Values(false));
 INSTANTIATE_TEST_SUITE_P(KnnHnsw, KnnTest, testing::Values(true));
 
@@ -619,6 +1030,40 @@ static void BM_VectorSearch(benchmark::State& state) {
 
 BENCHMARK(BM_VectorSearch)->Args({120, 10'000});
 
+static void BM_VectorSearchBatched(benchmark::State& state) {
+  unsigned ndims = state.range(0);
+  unsigned nvecs = state.range(1);
+  unsigned nqueries = state.range(2);
+
+  auto random_vec = [ndims]() {
+    vector<float> coords;
+    for (size_t j = 0; j < ndims; j++)
+      coords.push_back(static_cast<float>(rand()) / static_cast<float>(RAND_MAX));
+    return coords;
+  };
+
+  SchemaField::VectorParams params{false, ndims, VectorSimilarity::IP};
+  FlatVectorIndex index{params, PMR_NS::get_default_resource()};
+  vector<DocId> ids;
+  for (size_t i = 0; i < nvecs; i++) {
+    MockedDocument doc{Map{{"pos", ToBytes(random_vec())}}};
+    index.Add(i, &doc, "pos");
+    ids.push_back(i);
+  }
+
+  vector<vector<float>> queries;
+  vector<const char*> targets;
+  for (size_t i = 0; i < nqueries; i++) {
+    queries.push_back(random_vec());
+    targets.push_back(reinterpret_cast<const char*>(queries.back().data()));
+  }
+
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(index.Knn(targets, 10, ids));
+}
+
+BENCHMARK(BM_VectorSearchBatched)->Args({120, 10'000, 1})->Args({120, 10'000, 32});
+
 }  // namespace search
 
 }  // namespace dfly
@@ -4,6 +4,13 @@
 
 #include "core/search/vector_utils.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <absl/base/casts.h>
+
+#include <algorithm>
 #include <cmath>
 #include <memory>
 
@@ -15,28 +22,225 @@ using namespace std;
 
 namespace {
 
-// Euclidean vector distance: sqrt( sum: (u[i] - v[i])^2  )
-__attribute__((optimize("fast-math"))) float L2Distance(const float* u, const float* v,
-                                                        size_t dims) {
+// Squared euclidean distance: sum: (u[i] - v[i])^2
+__attribute__((optimize("fast-math"))) float L2SqrScalar(const float* u, const float* v,
+                                                         size_t dims) {
   float sum = 0;
   for (size_t i = 0; i < dims; i++)
     sum += (u[i] - v[i]) * (u[i] - v[i]);
-  return sqrt(sum);
+  return sum;
 }
 
-// TODO: Normalize vectors ahead if cosine distance is used
-__attribute__((optimize("fast-math"))) float CosineDistance(const float* u, const float* v,
-                                                            size_t dims) {
-  float sum_uv = 0, sum_uu = 0, sum_vv = 0;
+// Inner product: sum: u[i] * v[i]
+__attribute__((optimize("fast-math"))) float DotScalar(const float* u, const float* v,
+                                                       size_t dims) {
+  float sum = 0;
+  for (size_t i = 0; i < dims; i++)
+    sum += u[i] * v[i];
+  return sum;
+}
+
+float HalfToFloat(uint16_t h) {
+  uint32_t sign = uint32_t(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+  if (exp == 0) {  // zero or subnormal
+    float f = ldexp(float(mant), -24);
+    return sign ? -f : f;
+  }
+  if (exp == 0x1f)  // inf or nan
+    return absl::bit_cast<float>(sign | 0x7f800000 | (mant << 13));
+  return absl::bit_cast<float>(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+// Round to nearest even, overflows to infinity
+uint16_t FloatToHalf(float f) {
+  uint32_t bits = absl::bit_cast<uint32_t>(f);
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t abs = bits & 0x7fffffff;
+  if (abs > 0x7f800000)  // nan
+    return sign | 0x7e00;
+  if (abs >= 0x47800000)  // >= 2^16 or inf
+    return sign | 0x7c00;
+  if (abs < 0x38800000)  // below smallest normal half 2^-14, encode as subnormal
+    return sign | uint16_t(lrint(absl::bit_cast<float>(abs) * 16777216.0f /* 2^24 */));
+
+  uint32_t h = (abs - 0x38000000) >> 13;  // rebias exponent from 127 to 15
+  uint32_t rem = abs & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+    h++;
+  return sign | h;
+}
+
+float L2SqrF16Scalar(const uint16_t* u, const uint16_t* v, size_t dims) {
+  float sum = 0;
   for (size_t i = 0; i < dims; i++) {
-    sum_uv += u[i] * v[i];
-    sum_uu += u[i] * u[i];
-    sum_vv += v[i] * v[i];
+    float d = HalfToFloat(u[i]) - HalfToFloat(v[i]);
+    sum += d * d;
   }
+  return sum;
+}
 
-  if (float denom = sum_uu * sum_vv; denom != 0.0f)
-    return 1 - sum_uv / sqrt(denom);
-  return 0.0f;
+float DotF16Scalar(const uint16_t* u, const uint16_t* v, size_t dims) {
+  float sum = 0;
+  for (size_t i = 0; i < dims; i++)
+    sum += HalfToFloat(u[i]) * HalfToFloat(v[i]);
+  return sum;
+}
+
+int32_t DotI8Scalar(const int8_t* u, const int8_t* v, size_t dims) {
+  int32_t sum = 0;
+  for (size_t i = 0; i < dims; i++)
+    sum += int32_t(u[i]) * v[i];
+  return sum;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2,fma"))) float HorizontalSum(__m256 x) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+  return _mm_cvtss_f32(sum);
+}
+
+// Two independent accumulators hide the latency of dependent fma instructions
+__attribute__((target("avx2,fma"))) float L2SqrAvx2(const float* u, const float* v, size_t dims) {
+  __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= dims; i += 16) {
+    __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i));
+    __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(u + i + 8), _mm256_loadu_ps(v + i + 8));
+    sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+    sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+  }
+  if (i + 8 <= dims) {
+    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i));
+    sum0 = _mm256_fmadd_ps(d, d, sum0);
+    i += 8;
+  }
+  return HorizontalSum(_mm256_add_ps(sum0, sum1)) + L2SqrScalar(u + i, v + i, dims - i);
+}
+
+__attribute__((target("avx2,fma"))) float DotAvx2(const float* u, const float* v, size_t dims) {
+  __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= dims; i += 16) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i), sum0);
+    sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(u + i + 8), _mm256_loadu_ps(v + i + 8), sum1);
+  }
+  if (i + 8 <= dims) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i), sum0);
+    i += 8;
+  }
+  return HorizontalSum(_mm256_add_ps(sum0, sum1)) + DotScalar(u + i, v + i, dims - i);
+}
+
+// AVX-512 handles the tail with masked loads, which return zeros for masked out lanes
+__attribute__((target("avx512f"))) float L2SqrAvx512(const float* u, const float* v,
+                                                     size_t dims) {
+  __m512 sum = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= dims; i += 16) {
+    __m512 d = _mm512_sub_ps(_mm512_loadu_ps(u + i), _mm512_loadu_ps(v + i));
+    sum = _mm512_fmadd_ps(d, d, sum);
+  }
+  if (i < dims) {
+    __mmask16 mask = (1u << (dims - i)) - 1;
+    __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, u + i), _mm512_maskz_loadu_ps(mask, v + i));
+    sum = _mm512_fmadd_ps(d, d, sum);
+  }
+  return _mm512_reduce_add_ps(sum);
+}
+
+__attribute__((target("avx512f"))) float DotAvx512(const float* u, const float* v, size_t dims) {
+  __m512 sum = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= dims; i += 16)
+    sum = _mm512_fmadd_ps(_mm512_loadu_ps(u + i), _mm512_loadu_ps(v + i), sum);
+  if (i < dims) {
+    __mmask16 mask = (1u << (dims - i)) - 1;
+    sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, u + i), _mm512_maskz_loadu_ps(mask, v + i),
+                          sum);
+  }
+  return _mm512_reduce_add_ps(sum);
+}
+
+// Half precision vectors are converted to floats with F16C, 8 values at a time
+__attribute__((target("avx2,fma,f16c"))) float L2SqrF16Avx2(const uint16_t* u, const uint16_t* v,
+                                                            size_t dims) {
+  __m256 sum = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= dims; i += 8) {
+    __m256 a = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i)));
+    __m256 b = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+    __m256 d = _mm256_sub_ps(a, b);
+    sum = _mm256_fmadd_ps(d, d, sum);
+  }
+  return HorizontalSum(sum) + L2SqrF16Scalar(u + i, v + i, dims - i);
+}
+
+__attribute__((target("avx2,fma,f16c"))) float DotF16Avx2(const uint16_t* u, const uint16_t* v,
+                                                          size_t dims) {
+  __m256 sum = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= dims; i += 8) {
+    __m256 a = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i)));
+    __m256 b = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+    sum = _mm256_fmadd_ps(a, b, sum);
+  }
+  return HorizontalSum(sum) + DotF16Scalar(u + i, v + i, dims - i);
+}
+
+// Bytes are widened to 16 bits and multiplied pairwise into 32 bit sums, which can't overflow
+// for values in [-127, 127]
+__attribute__((target("avx2"))) int32_t DotI8Avx2(const int8_t* u, const int8_t* v, size_t dims) {
+  __m256i sum = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 16 <= dims; i += 16) {
+    __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i)));
+    __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, b));
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+  return _mm_cvtsi128_si32(s) + DotI8Scalar(u + i, v + i, dims - i);
+}
+
+#endif
+
+struct Kernels {
+  float (*l2sqr)(const float*, const float*, size_t);
+  float (*dot)(const float*, const float*, size_t);
+  float (*l2sqr_f16)(const uint16_t*, const uint16_t*, size_t);
+  float (*dot_f16)(const uint16_t*, const uint16_t*, size_t);
+  int32_t (*dot_i8)(const int8_t*, const int8_t*, size_t);
+};
+
+Kernels SelectKernels() {
+  Kernels kernels{L2SqrScalar, DotScalar, L2SqrF16Scalar, DotF16Scalar, DotI8Scalar};
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    kernels.l2sqr = L2SqrAvx2;
+    kernels.dot = DotAvx2;
+    kernels.dot_i8 = DotI8Avx2;
+    if (__builtin_cpu_supports("f16c")) {
+      kernels.l2sqr_f16 = L2SqrF16Avx2;
+      kernels.dot_f16 = DotF16Avx2;
+    }
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    kernels.l2sqr = L2SqrAvx512;
+    kernels.dot = DotAvx512;
+  }
+#endif
+  return kernels;
+}
+
+const Kernels& GetKernels() {
+  static const Kernels kernels = SelectKernels();
+  return kernels;
 }
 
 }  // namespace
@@ -53,14 +257,122 @@ OwnedFtVector BytesToFtVector(string_view value) {
   return {std::move(out), size};
 }
 
+void NormalizeVector(float* v, size_t dims) {
+  float norm = sqrt(GetKernels().dot(v, v, dims));
+  if (norm == 0.0f)
+    return;
+
+  for (size_t i = 0; i < dims; i++)
+    v[i] /= norm;
+}
+
 float VectorDistance(const float* u, const float* v, size_t dims, VectorSimilarity sim) {
   switch (sim) {
     case VectorSimilarity::L2:
-      return L2Distance(u, v, dims);
+      return sqrt(GetKernels().l2sqr(u, v, dims));
     case VectorSimilarity::COSINE:
-      return CosineDistance(u, v, dims);
+    case VectorSimilarity::IP:
+      return 1 - GetKernels().dot(u, v, dims);
   };
   return 0.0f;
 }
 
+size_t QuantizedSize(size_t dims, VectorQuantization quant) {
+  switch (quant) {
+    case VectorQuantization::NONE:
+      return dims * sizeof(float);
+    case VectorQuantization::FP16:
+      return dims * sizeof(uint16_t);
+    case VectorQuantization::INT8:
+      return 2 * sizeof(float) + dims;
+  }
+  return 0;
+}
+
+void QuantizeVector(const float* v, size_t dims, VectorQuantization quant, char* dest) {
+  switch (quant) {
+    case VectorQuantization::NONE:
+      memcpy(dest, v, dims * sizeof(float));
+      return;
+    case VectorQuantization::FP16:
+      for (size_t i = 0; i < dims; i++) {
+        uint16_t h = FloatToHalf(v[i]);
+        memcpy(dest + i * sizeof(h), &h, sizeof(h));
+      }
+      return;
+    case VectorQuantization::INT8: {
+      float max_abs = 0;
+      for (size_t i = 0; i < dims; i++)
+        max_abs = max(max_abs, fabs(v[i]));
+
+      float scale = max_abs / 127;
+      int8_t* q = reinterpret_cast<int8_t*>(dest + 2 * sizeof(float));
+      int32_t sum_qq = 0;
+      for (size_t i = 0; i < dims; i++) {
+        q[i] = scale == 0 ? 0 : int8_t(clamp(lrint(v[i] / scale), -127l, 127l));
+        sum_qq += int32_t(q[i]) * q[i];
+      }
+
+      // Norm of the dequantized vector, used to compute L2 distance from the inner product
+      float sq_norm = scale * scale * sum_qq;
+      memcpy(dest, &scale, sizeof(float));
+      memcpy(dest + sizeof(float), &sq_norm, sizeof(float));
+      return;
+    }
+  }
+}
+
+void DequantizeVector(const char* src, size_t dims, VectorQuantization quant, float* dest) {
+  switch (quant) {
+    case VectorQuantization::NONE:
+      memcpy(dest, src, dims * sizeof(float));
+      return;
+    case VectorQuantization::FP16:
+      for (size_t i = 0; i < dims; i++) {
+        uint16_t h;
+        memcpy(&h, src + i * sizeof(h), sizeof(h));
+        dest[i] = HalfToFloat(h);
+      }
+      return;
+    case VectorQuantization::INT8: {
+      float scale;
+      memcpy(&scale, src, sizeof(float));
+      const int8_t* q = reinterpret_cast<const int8_t*>(src + 2 * sizeof(float));
+      for (size_t i = 0; i < dims; i++)
+        dest[i] = scale * q[i];
+      return;
+    }
+  }
+}
+
+float QuantizedDistance(const char* u, const char* v, size_t dims, VectorQuantization quant,
+                        VectorSimilarity sim) {
+  const Kernels& kernels = GetKernels();
+  switch (quant) {
+    case VectorQuantization::NONE:
+      return VectorDistance(reinterpret_cast<const float*>(u), reinterpret_cast<const float*>(v),
+                            dims, sim);
+    case VectorQuantization::FP16: {
+      auto* hu = reinterpret_cast<const uint16_t*>(u);
+      auto* hv = reinterpret_cast<const uint16_t*>(v);
+      if (sim == VectorSimilarity::L2)
+        return sqrt(kernels.l2sqr_f16(hu, hv, dims));
+      return 1 - kernels.dot_f16(hu, hv, dims);
+    }
+    case VectorQuantization::INT8: {
+      float header_u[2], header_v[2];  // scale and squared norm
+      memcpy(header_u, u, sizeof(header_u));
+      memcpy(header_v, v, sizeof(header_v));
+
+      int32_t dot_q = kernels.dot_i8(reinterpret_cast<const int8_t*>(u + sizeof(header_u)),
+                                     reinterpret_cast<const int8_t*>(v + sizeof(header_v)), dims);
+      float dot = header_u[0] * header_v[0] * dot_q;
+      if (sim == VectorSimilarity::L2)
+        return sqrt(max(header_u[1] + header_v[1] - 2 * dot, 0.0f));
+      return 1 - dot;
+    }
+  }
+  return 0.0f;
+}
+
 }  // namespace dfly::search
@@ -10,6 +10,27 @@ namespace dfly::search {
 
 OwnedFtVector BytesToFtVector(std::string_view value);
 
+// Scale vector to unit length in place, zero vectors are left unchanged.
+// Vectors compared with COSINE similarity are normalized ahead, so that their distance
+// reduces to an inner product.
+void NormalizeVector(float* v, size_t dims);
+
+// Distance between two vectors. For COSINE, both vectors must be normalized, so that both COSINE
+// and IP (inner product) distances are computed as 1 - <u, v>.
+// Kernels are chosen at runtime based on supported CPU features.
 float VectorDistance(const float* u, const float* v, size_t dims, VectorSimilarity sim);
 
+// Vectors are stored by indices in an encoded form of QuantizedSize() bytes:
+// NONE as floats, FP16 as half precision floats and INT8 as [float scale][float squared norm]
+// followed by dims signed bytes, so that v[i] ~ scale * q[i].
+size_t QuantizedSize(size_t dims, VectorQuantization quant);
+
+void QuantizeVector(const float* v, size_t dims, VectorQuantization quant, char* dest);
+
+void DequantizeVector(const char* src, size_t dims, VectorQuantization quant, float* dest);
+
+// Distance between two encoded vectors, computed directly on their quantized representation
+float QuantizedDistance(const char* u, const char* v, size_t dims, VectorQuantization quant,
+                        VectorSimilarity sim);
+
 }  // namespace dfly::search
@@ -9,6 +9,7 @@
 #include <vecintrin.h>
 #else
 #include <emmintrin.h>
+#include <immintrin.h>
 #include <tmmintrin.h>
 #endif
 
@@ -32,6 +32,8 @@ std::string_view StatusToMsg(OpStatus status) {
       return "at least 1 input key is needed for this command";
     case OpStatus::MEMBER_NOTFOUND:
       return kKeyNotFoundErr;
+    case OpStatus::CANCELLED:
+      return "-TRYAGAIN operation was cancelled, retry it";
     default:
       LOG(ERROR) << "Unsupported status " << status;
       return "Internal error";
@@ -258,18 +258,25 @@ bool ParseDouble(string_view src, double* value) {
 #define ADD(x) (x) += o.x
 
 TieredStats& TieredStats::operator+=(const TieredStats& o) {
-  static_assert(sizeof(TieredStats) == 112);
+  static_assert(sizeof(TieredStats) == 168);
 
   ADD(total_stashes);
   ADD(total_fetches);
   ADD(total_cancels);
   ADD(total_deletes);
   ADD(total_defrags);
+  ADD(total_relocations);
+  ADD(total_hits);
+  ADD(total_misses);
+  ADD(total_promotes);
+  ADD(total_hot_skips);
   ADD(total_heap_buf_allocs);
   ADD(total_registered_buf_allocs);
+  ADD(total_disk_reads);
 
   ADD(allocated_bytes);
   ADD(capacity_bytes);
+  ADD(reclaimed_bytes);
 
   ADD(pending_read_cnt);
   ADD(pending_stash_cnt);
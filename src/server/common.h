@@ -66,14 +66,21 @@ struct TieredStats {
   uint64_t total_cancels = 0;
   uint64_t total_deletes = 0;
   uint64_t total_defrags = 0;
+  uint64_t total_relocations = 0;  // values moved out of underutilized pages
+  uint64_t total_hits = 0;         // lookups of values stored in memory
+  uint64_t total_misses = 0;       // lookups of offloaded values
+  uint64_t total_promotes = 0;     // fetched values that were kept in memory
+  uint64_t total_hot_skips = 0;    // values not offloaded because they're accessed frequently
   uint64_t total_registered_buf_allocs = 0;
   uint64_t total_heap_buf_allocs = 0;
+  uint64_t total_disk_reads = 0;  // reads of the backing file, merged reads are counted once
 
   // How many times the system did not perform Stash call (disjoint with total_stashes).
   uint64_t total_stash_overflows = 0;
 
   size_t allocated_bytes = 0;
   size_t capacity_bytes = 0;
+  size_t reclaimed_bytes = 0;  // released by punching holes in the backing file
 
   uint32_t pending_read_cnt = 0;
   uint32_t pending_stash_cnt = 0;
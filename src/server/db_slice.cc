@@ -34,6 +34,11 @@ ABSL_FLAG(double, table_growth_margin, 0.4,
           "Prevents table from growing if number of free slots x average object size x this ratio "
           "is larger than memory budget.");
 
+ABSL_FLAG(uint32_t, table_split_step, 0,
+          "If positive, full segments of the main table are split incrementally by moving entries "
+          "of this many buckets on every insertion and heartbeat, to reduce latency spikes of "
+          "writes. Splits are done at once while snapshots are taken.");
+
 ABSL_FLAG(std::string, notify_keyspace_events, "",
           "notify-keyspace-events. Only Ex is supported for now");
 
@@ -425,16 +430,59 @@ OpResult<DbSlice::ConstIterator> DbSlice::FindReadOnly(const Context& cntx, stri
   return res.status();
 }
 
+void DbSlice::FindReadOnlyBatch(const Context& cntx, absl::Span<const string_view> keys,
+                                unsigned req_obj_type,
+                                absl::FunctionRef<void(size_t, OpResult<ConstIterator>)> cb) const {
+  if (IsDbValid(cntx.db_index)) {
+    const PrimeTable& prime = db_arr_[cntx.db_index]->prime;
+    uint64_t hashes[PrimeTable::kFindBatchSize];
+    for (size_t start = 0; start < keys.size(); start += PrimeTable::kFindBatchSize) {
+      size_t batch = min(PrimeTable::kFindBatchSize, keys.size() - start);
+      for (size_t i = 0; i < batch; ++i)
+        hashes[i] = prime.DoHash(keys[start + i]);
+      prime.Prefetch(hashes, batch);
+
+      for (size_t i = start; i < start + batch; ++i) {
+        auto res = FindInternal(cntx, keys[i], req_obj_type, UpdateStatsMode::kReadStats,
+                                hashes[i - start]);
+        if (res.ok())
+          cb(i, ConstIterator(res->it, StringOrView::FromView(keys[i])));
+        else
+          cb(i, res.status());
+      }
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < keys.size(); ++i)
+    cb(i, OpStatus::KEY_NOTFOUND);
+}
+
+void DbSlice::PrefetchKeys(DbIndex db_ind, absl::Span<const string_view> keys) const {
+  if (!IsDbValid(db_ind))
+    return;
+
+  const PrimeTable& prime = db_arr_[db_ind]->prime;
+  uint64_t hashes[PrimeTable::kFindBatchSize];
+  for (size_t start = 0; start < keys.size(); start += PrimeTable::kFindBatchSize) {
+    size_t batch = min(PrimeTable::kFindBatchSize, keys.size() - start);
+    for (size_t i = 0; i < batch; ++i)
+      hashes[i] = prime.DoHash(keys[start + i]);
+    prime.Prefetch(hashes, batch);
+  }
+}
+
 OpResult<DbSlice::PrimeItAndExp> DbSlice::FindInternal(const Context& cntx, std::string_view key,
                                                        std::optional<unsigned> req_obj_type,
-                                                       UpdateStatsMode stats_mode) const {
+                                                       UpdateStatsMode stats_mode,
+                                                       std::optional<uint64_t> key_hash) const {
   if (!IsDbValid(cntx.db_index)) {
     return OpStatus::KEY_NOTFOUND;
   }
 
   DbSlice::PrimeItAndExp res;
   auto& db = *db_arr_[cntx.db_index];
-  res.it = db.prime.Find(key);
+  res.it = key_hash ? db.prime.Find(key, *key_hash) : db.prime.Find(key);
 
   absl::Cleanup update_stats_on_miss = [&]() {
     switch (stats_mode) {
@@ -455,6 +503,16 @@ OpResult<DbSlice::PrimeItAndExp> DbSlice::FindInternal(const Context& cntx, std:
     return OpStatus::WRONG_TYPE;
   }
 
+  // Offloaded containers can't be accessed in place. Transactions load the containers of their
+  // keys once they're locked (see Transaction::LoadOffloadedContainers), so only keys that weren't
+  // declared (i.e. accessed by global transactions) can end up here. Loading would block and
+  // invalidate the caller's iterators, so it's only started and the operation fails.
+  if (res.it->second.IsExternal() && res.it->second.ObjType() != OBJ_STRING) {
+    LOG_FIRST_N(WARNING, 10) << "Offloaded container accessed before loading, key: " << key;
+    owner_->tiered_storage()->StartLoad(cntx.db_index, key, res.it->second);
+    return OpStatus::CANCELLED;
+  }
+
   FiberAtomicGuard fg;
   if (res.it->second.HasExpire()) {  // check expiry state
     res = ExpireIfNeeded(cntx, res.it);
@@ -480,6 +538,8 @@ OpResult<DbSlice::PrimeItAndExp> DbSlice::FindInternal(const Context& cntx, std:
   }
 
   db.top_keys.Touch(key);
+  if (auto* ts = owner_->tiered_storage(); ts)
+    ts->Touch(key, res.it->second);
 
   std::move(update_stats_on_miss).Cancel();
   switch (stats_mode) {
@@ -496,6 +556,23 @@ OpResult<DbSlice::PrimeItAndExp> DbSlice::FindInternal(const Context& cntx, std:
   return res;
 }
 
+bool DbSlice::IsOffloadedContainer(DbIndex db_ind, string_view key) const {
+  if (!IsDbValid(db_ind))
+    return false;
+  auto it = db_arr_[db_ind]->prime.Find(key);
+  return IsValid(it) && it->second.IsExternal() && it->second.ObjType() != OBJ_STRING;
+}
+
+void DbSlice::LoadOffloadedContainer(DbIndex db_ind, string_view key) {
+  TieredStorage* tiered_storage = owner_->tiered_storage();
+  if (!tiered_storage || !IsDbValid(db_ind))
+    return;
+
+  auto it = db_arr_[db_ind]->prime.Find(key);
+  if (IsValid(it) && it->second.IsExternal() && it->second.ObjType() != OBJ_STRING)
+    tiered_storage->Load(db_ind, key, it->second);
+}
+
 OpResult<DbSlice::AddOrFindResult> DbSlice::AddOrFind(const Context& cntx, string_view key) {
   return AddOrFindInternal(cntx, key);
 }
@@ -527,6 +604,8 @@ OpResult<DbSlice::AddOrFindResult> DbSlice::AddOrFindInternal(const Context& cnt
     }
   }
   auto status = res.status();
+  if (status == OpStatus::CANCELLED)  // offloaded container, see FindInternal
+    return status;
   CHECK(status == OpStatus::KEY_NOTFOUND || status == OpStatus::OUT_OF_MEMORY) << status;
 
   // It's a new entry.
@@ -1100,6 +1179,7 @@ uint64_t DbSlice::RegisterOnChange(ChangeCallback cb) {
   change_cb_.emplace_back(ver, std::move(cb));
   DCHECK(std::is_sorted(change_cb_.begin(), change_cb_.end(),
                         [](auto& a, auto& b) { return a.first < b.first; }));
+  UpdateSplitStep();  // finishes pending splits
 
   return ver;
 }
@@ -1129,6 +1209,7 @@ void DbSlice::UnregisterOnChange(uint64_t id) {
   for (auto it = change_cb_.begin(); it != change_cb_.end(); ++it) {
     if (it->first == id) {
       change_cb_.erase(it);
+      UpdateSplitStep();
       return;
     }
   }
@@ -1275,6 +1356,15 @@ void DbSlice::CreateDb(DbIndex db_ind) {
   auto& db = db_arr_[db_ind];
   if (!db) {
     db.reset(new DbTable{owner_->memory_resource(), db_ind});
+    db->prime.SetSplitStep(change_cb_.empty() ? GetFlag(FLAGS_table_split_step) : 0);
+  }
+}
+
+void DbSlice::UpdateSplitStep() {
+  unsigned step = change_cb_.empty() ? GetFlag(FLAGS_table_split_step) : 0;
+  for (auto& db : db_arr_) {
+    if (db)
+      db->prime.SetSplitStep(step);
   }
 }
 
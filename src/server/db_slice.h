@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <absl/functional/function_ref.h>
+#include <absl/types/span.h>
+
 #include "core/mi_memory_resource.h"
 #include "core/string_or_view.h"
 #include "facade/dragonfly_connection.h"
@@ -286,6 +289,23 @@ class DbSlice {
   OpResult<ConstIterator> FindReadOnly(const Context& cntx, std::string_view key,
                                        unsigned req_obj_type) const;
 
+  // Same as FindReadOnly() for multiple keys, calls cb(index, result) in order of keys.
+  // Buckets of every group of keys are prefetched before they're looked up, so that their cache
+  // misses overlap. Lookups still run one by one, as each of them can update the table.
+  void FindReadOnlyBatch(const Context& cntx, absl::Span<const std::string_view> keys,
+                         unsigned req_obj_type,
+                         absl::FunctionRef<void(size_t, OpResult<ConstIterator>)> cb) const;
+
+  // Prefetch buckets of keys in db_ind ahead of looking them up, i.e. by a batch of commands.
+  void PrefetchKeys(DbIndex db_ind, absl::Span<const std::string_view> keys) const;
+
+  // Load offloaded container stored under key back to memory. Blocks until it's read, so it must
+  // not be called from transaction callbacks, which hold iterators.
+  void LoadOffloadedContainer(DbIndex db_ind, std::string_view key);
+
+  // Returns true if key holds a container that is offloaded to tiered storage
+  bool IsOffloadedContainer(DbIndex db_ind, std::string_view key) const;
+
   struct AddOrFindResult {
     Iterator it;
     ExpIterator exp_it;
@@ -503,6 +523,10 @@ class DbSlice {
   void SendInvalidationTrackingMessage(std::string_view key);
 
   void CreateDb(DbIndex index);
+
+  // Set split step of prime tables. Incremental splits don't maintain bucket versions, so they're
+  // disabled while change callbacks are registered.
+  void UpdateSplitStep();
   size_t EvictObjects(size_t memory_to_free, Iterator it, DbTable* table);
 
   enum class UpdateStatsMode {
@@ -519,9 +543,11 @@ class DbSlice {
 
   OpResult<AddOrFindResult> AddOrFindInternal(const Context& cntx, std::string_view key);
 
+  // key_hash can be passed if it was already computed by PrimeTable::DoHash().
   OpResult<PrimeItAndExp> FindInternal(const Context& cntx, std::string_view key,
                                        std::optional<unsigned> req_obj_type,
-                                       UpdateStatsMode stats_mode) const;
+                                       UpdateStatsMode stats_mode,
+                                       std::optional<uint64_t> key_hash = std::nullopt) const;
   OpResult<ItAndUpdater> FindMutableInternal(const Context& cntx, std::string_view key,
                                              std::optional<unsigned> req_obj_type);
 
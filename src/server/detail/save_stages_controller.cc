@@ -269,7 +269,8 @@ void SaveStagesController::SaveDfsSingle(EngineShard* shard) {
   auto& [snapshot, filename] = snapshots_[shard ? shard->shard_id() : shard_set->size()];
 
   SaveMode mode = shard == nullptr ? SaveMode::SUMMARY : SaveMode::SINGLE_SHARD;
-  auto glob_data = shard == nullptr ? RdbSaver::GetGlobalData(service_) : RdbSaver::GlobalData{};
+  auto glob_data =
+      shard == nullptr ? RdbSaver::GetGlobalData(service_) : RdbSaver::GetShardData(shard);
 
   if (auto err = snapshot->Start(mode, filename, glob_data); err) {
     shared_err_ = err;
@@ -17,6 +17,7 @@ extern "C" {
 
 #include "base/flags.h"
 #include "base/logging.h"
+#include "core/dict_compressor.h"
 #include "io/proc_reader.h"
 #include "server/blocking_controller.h"
 #include "server/cluster/cluster_defs.h"
@@ -73,6 +74,12 @@ ABSL_FLAG(string, shard_round_robin_prefix, "",
 ABSL_FLAG(uint32_t, mem_defrag_check_sec_interval, 10,
           "Number of seconds between every defragmentation necessity check");
 
+ABSL_FLAG(dfly::MemoryBytesFlag, value_dict_size, dfly::MemoryBytesFlag{},
+          "If non zero, every shard trains a zstd dictionary of this size from the first string "
+          "values it stores, and keeps values of 64-4096 bytes compressed with it. Dictionaries "
+          "are saved in DF snapshots. At most 256KB, 0 - disables compression of values in "
+          "memory.");
+
 namespace dfly {
 
 using namespace tiering::literals;
@@ -422,6 +429,15 @@ void EngineShard::InitThreadLocal(ProactorBase* pb, bool update_db_time, size_t
   CompactObj::InitThreadLocal(shard_->memory_resource());
   SmallString::InitThreadLocal(data_heap);
 
+  if (size_t dict_size = GetFlag(FLAGS_value_dict_size).value; dict_size > 0) {
+    if (dict_size > DictCompressor::kMaxDictSize) {
+      LOG(ERROR) << "value_dict_size must be at most " << DictCompressor::kMaxDictSize;
+      exit(1);
+    }
+    shard_->dict_compressor_ = make_unique<DictCompressor>(dict_size);
+    CompactObj::InitDictCompressor(shard_->dict_compressor_.get());
+  }
+
   if (string backing_prefix = GetFlag(FLAGS_tiered_prefix); !backing_prefix.empty()) {
     LOG_IF(FATAL, pb->GetKind() != ProactorBase::IOURING)
         << "Only ioring based backing storage is supported. Exiting...";
@@ -454,6 +470,7 @@ void EngineShard::DestroyThreadLocal() {
   mi_free(shard_);
   shard_ = nullptr;
   CompactObj::InitThreadLocal(nullptr);
+  CompactObj::InitDictCompressor(nullptr);
   mi_heap_delete(tlh);
   RoundRobinSharder::Destroy();
   VLOG(1) << "Shard reset " << index;
@@ -611,6 +628,10 @@ void EngineShard::Heartbeat() {
 
     db_cntx.db_index = i;
     auto [pt, expt] = db_slice_.GetTables(i);
+
+    // Pending segment splits progress with insertions, make sure they finish on idle shards too.
+    pt->SplitStep();
+
     if (expt->size() > pt->size() / 4) {
       DbSlice::DeleteExpiredStats stats = db_slice_.DeleteExpiredStep(db_cntx, ttl_delete_target);
 
@@ -626,6 +647,11 @@ void EngineShard::Heartbeat() {
     if (tiered_storage_ && UsedMemory() > tiering_redline) {
       tiered_storage_->RunOffloading(i);
     }
+
+    if (tiered_storage_) {
+      size_t memory_headroom = max<ssize_t>(db_slice_.memory_budget() - eviction_redline, 0);
+      tiered_storage_->RunCompaction(i, memory_headroom);
+    }
   }
 
   // Journal entries for expired entries are not writen to socket in the loop above.
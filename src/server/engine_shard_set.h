@@ -28,6 +28,7 @@ class Journal;
 class TieredStorage;
 class ShardDocIndices;
 class BlockingController;
+class DictCompressor;
 
 class EngineShard {
  public:
@@ -121,6 +122,11 @@ class EngineShard {
     return shard_search_indices_.get();
   }
 
+  // Compressor of string values, nullptr if compression is disabled
+  DictCompressor* dict_compressor() const {
+    return dict_compressor_.get();
+  }
+
   BlockingController* EnsureBlockingController();
 
   BlockingController* blocking_controller() {
@@ -259,6 +265,7 @@ class EngineShard {
   DefragTaskState defrag_state_;
   std::unique_ptr<TieredStorage> tiered_storage_;
   std::unique_ptr<ShardDocIndices> shard_search_indices_;
+  std::unique_ptr<DictCompressor> dict_compressor_;
   std::unique_ptr<BlockingController> blocking_controller_;
 
   using Counter = util::SlidingCounter<7>;
@@ -30,6 +30,28 @@ template <typename F> void IterateKeys(CmdArgList args, KeyIndex keys, F&& f) {
     f(args[*keys.bonus]);
 }
 
+// Prefetch buckets of keys of the first commands until at least PrimeTable::kFindBatchSize keys
+// are covered, so that their lookups don't miss cache one by one. Returns the number of commands.
+size_t PrefetchCmdKeys(absl::Span<StoredCmd* const> cmds, DbIndex db_ind, const DbSlice& db_slice) {
+  absl::InlinedVector<MutableSlice, 4> arg_vec;
+  absl::InlinedVector<string_view, PrimeTable::kFindBatchSize> keys;
+
+  size_t num_cmds = 0;
+  while (num_cmds < cmds.size() && keys.size() < PrimeTable::kFindBatchSize) {
+    StoredCmd* cmd = cmds[num_cmds++];
+    arg_vec.resize(cmd->NumArgs());
+    auto args = absl::MakeSpan(arg_vec);
+    cmd->Fill(args);
+
+    // Arguments point to the buffer of the stored command, so keys stay valid.
+    if (auto key_index = DetermineKeys(cmd->Cid(), args); key_index.ok())
+      IterateKeys(args, *key_index, [&keys](MutableSlice key) { keys.push_back(ToSV(key)); });
+  }
+
+  db_slice.PrefetchKeys(db_ind, keys);
+  return num_cmds;
+}
+
 void CheckConnStateClean(const ConnectionState& state) {
   DCHECK_EQ(state.exec_info.state, ConnectionState::ExecInfo::EXEC_INACTIVE);
   DCHECK(state.exec_info.body.empty());
@@ -164,7 +186,16 @@ OpStatus MultiCommandSquasher::SquashedHopCb(Transaction* parent_tx, EngineShard
   }
   absl::InlinedVector<MutableSlice, 4> arg_vec;
 
-  for (auto* cmd : sinfo.cmds) {
+  DbIndex db_ind = local_cntx.conn_state.db_index;
+  size_t prefetched = 0;
+  for (size_t i = 0; i < sinfo.cmds.size(); ++i) {
+    // Keys of the next group of commands are prefetched together, ahead of running them.
+    if (i == prefetched) {
+      auto rest = absl::MakeSpan(sinfo.cmds).subspan(i);
+      prefetched += PrefetchCmdKeys(rest, db_ind, es->db_slice());
+    }
+
+    auto* cmd = sinfo.cmds[i];
     arg_vec.resize(cmd->NumArgs());
     auto args = absl::MakeSpan(arg_vec);
     cmd->Fill(args);
@@ -182,7 +213,7 @@ OpStatus MultiCommandSquasher::SquashedHopCb(Transaction* parent_tx, EngineShard
     local_cntx.cid = cmd->Cid();
     crb.SetReplyMode(cmd->ReplyMode());
 
-    local_tx->InitByArgs(local_cntx.conn_state.db_index, args);
+    local_tx->InitByArgs(db_ind, args);
     service_->InvokeCmd(cmd->Cid(), args, &local_cntx);
 
     sinfo.replies.emplace_back(crb.Take());
@@ -31,6 +31,7 @@ extern "C" {
 #include "base/flags.h"
 #include "base/logging.h"
 #include "core/bloom.h"
+#include "core/dict_compressor.h"
 #include "core/json/json_object.h"
 #include "core/sorted_map.h"
 #include "core/string_map.h"
@@ -910,7 +911,7 @@ void RdbLoaderBase::OpaqueObjLoader::CreateStream(const LoadTrace* ltrace) {
 
 void RdbLoaderBase::OpaqueObjLoader::HandleBlob(string_view blob) {
   if (rdb_type_ == RDB_TYPE_STRING) {
-    pv_->SetString(blob);
+    pv_->SetCompressibleString(blob);
     return;
   }
 
@@ -2395,6 +2396,10 @@ error_code RdbLoader::HandleAux() {
     /* Just ignored. */
   } else if (auxkey == "search-index") {
     LoadSearchIndexDefFromAux(std::move(auxval));
+  } else if (auxkey == "search-index-data") {
+    LoadSearchIndexDataFromAux(std::move(auxval));
+  } else if (auxkey == "value-dict") {
+    LoadValueDictFromAux(std::move(auxval));
   } else {
     /* We ignore fields we don't understand, as by AUX field
      * contract. */
@@ -2595,6 +2600,31 @@ void RdbLoader::LoadSearchIndexDefFromAux(string&& def) {
   }
 }
 
+void RdbLoader::LoadSearchIndexDataFromAux(string&& data) {
+  // Document ids are shard local, so data is only valid with the same number of shards
+  auto sid = ShardDocIndices::GetSerializedShard(data);
+  if (!sid) {
+    LOG(WARNING) << "Ignoring search index data of a different shard layout, index will be rebuilt";
+    return;
+  }
+
+  shard_set->Add(*sid, [data = std::move(data)] {
+    EngineShard::tlocal()->search_indices()->StashSerialized(data);
+  });
+}
+
+void RdbLoader::LoadValueDictFromAux(string&& dict) {
+  // Any dictionary is valid for any shard, so shards without one use the first they get to
+  // compress values loaded after it
+  auto shared_dict = make_shared<string>(std::move(dict));
+  for (ShardId sid = 0; sid < shard_set->size(); ++sid) {
+    shard_set->Add(sid, [shared_dict] {
+      if (DictCompressor* dc = EngineShard::tlocal()->dict_compressor(); dc)
+        dc->LoadDict(*shared_dict);
+    });
+  }
+}
+
 void RdbLoader::PerformPreLoad(Service* service) {
   const CommandId* cmd = service->FindCmd("FT.DROPINDEX");
   if (cmd == nullptr)
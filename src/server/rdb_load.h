@@ -267,6 +267,12 @@ class RdbLoader : protected RdbLoaderBase {
   // issues an FT.CREATE call, but does not start indexing
   void LoadSearchIndexDefFromAux(std::string&& value);
 
+  // Pass serialized index data to its shard, where it's used to restore the index after loading
+  void LoadSearchIndexDataFromAux(std::string&& value);
+
+  // Pass value dictionary to shards that don't have one yet
+  void LoadValueDictFromAux(std::string&& value);
+
  private:
   Service* service_;
   ScriptMgr* script_mgr_;
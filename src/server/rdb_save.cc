@@ -28,6 +28,7 @@ extern "C" {
 #include "base/flags.h"
 #include "base/logging.h"
 #include "core/bloom.h"
+#include "core/dict_compressor.h"
 #include "core/json/json_object.h"
 #include "core/sorted_map.h"
 #include "core/string_map.h"
@@ -1070,7 +1071,8 @@ class RdbSaver::Impl {
 
   ~Impl();
 
-  void StartSnapshotting(bool stream_journal, const Cancellation* cll, EngineShard* shard);
+  void StartSnapshotting(bool stream_journal, const Cancellation* cll, EngineShard* shard,
+                         bool save_search_indices);
   void StartIncrementalSnapshotting(Context* cntx, EngineShard* shard, LSN start_lsn);
 
   void StopSnapshotting(EngineShard* shard);
@@ -1249,11 +1251,11 @@ error_code RdbSaver::Impl::ConsumeChannel(const Cancellation* cll) {
 }
 
 void RdbSaver::Impl::StartSnapshotting(bool stream_journal, const Cancellation* cll,
-                                       EngineShard* shard) {
+                                       EngineShard* shard, bool save_search_indices) {
   auto& s = GetSnapshot(shard);
   s = std::make_unique<SliceSnapshot>(&shard->db_slice(), &channel_, compression_mode_);
 
-  s->Start(stream_journal, cll);
+  s->Start(stream_journal, cll, save_search_indices);
 }
 
 void RdbSaver::Impl::StartIncrementalSnapshotting(Context* cntx, EngineShard* shard,
@@ -1353,6 +1355,16 @@ RdbSaver::GlobalData RdbSaver::GetGlobalData(const Service* service) {
   return RdbSaver::GlobalData{std::move(script_bodies), std::move(search_indices)};
 }
 
+RdbSaver::GlobalData RdbSaver::GetShardData(EngineShard* shard) {
+  // The value dictionary is saved along with the shard's data, to compress loaded values without
+  // training it again. Search indices are written by the shard's snapshot, see SliceSnapshot
+  string value_dict;
+  if (DictCompressor* dc = shard->dict_compressor(); dc)
+    value_dict = dc->dict();
+
+  return RdbSaver::GlobalData{{}, {}, std::move(value_dict)};
+}
+
 void RdbSaver::Impl::FillFreqMap(RdbTypeFreqMap* dest) const {
   for (auto& ptr : shard_snapshots_) {
     const RdbTypeFreqMap& src_map = ptr->freq_map();
@@ -1406,7 +1418,9 @@ RdbSaver::~RdbSaver() {
 
 void RdbSaver::StartSnapshotInShard(bool stream_journal, const Cancellation* cll,
                                     EngineShard* shard) {
-  impl_->StartSnapshotting(stream_journal, cll, shard);
+  // Index data is only saved to per shard files of a snapshot, replicas rebuild their indices
+  bool save_search_indices = save_mode_ == SaveMode::SINGLE_SHARD && !stream_journal;
+  impl_->StartSnapshotting(stream_journal, cll, shard, save_search_indices);
 }
 
 void RdbSaver::StartIncrementalSnapshotInShard(Context* cntx, EngineShard* shard, LSN start_lsn) {
@@ -1486,6 +1500,9 @@ error_code RdbSaver::SaveAux(const GlobalData& glob_state) {
       RETURN_ON_ERR(impl_->SaveAuxFieldStrStr("search-index", s));
   }
 
+  if (!glob_state.value_dict.empty())
+    RETURN_ON_ERR(impl_->SaveAuxFieldStrStr("value-dict", glob_state.value_dict));
+
   // TODO: "repl-stream-db", "repl-id", "repl-offset"
   return error_code{};
 }
@@ -74,6 +74,9 @@ class RdbSaver {
   struct GlobalData {
     const StringVec lua_scripts;     // bodies of lua scripts
     const StringVec search_indices;  // ft.create commands to re-create search indices
+
+    // Dictionary of compressed string values of a single shard, see DictCompressor
+    const std::string value_dict = {};
   };
 
   // single_shard - true means that we run RdbSaver on a single shard and we do not use
@@ -122,6 +125,10 @@ class RdbSaver {
   // Fetch global data to be serialized in summary part of a snapshot / full sync.
   static GlobalData GetGlobalData(const Service* service);
 
+  // Fetch data of a single shard to be serialized in its file of a snapshot.
+  // Must be called in the shard's thread.
+  static GlobalData GetShardData(EngineShard* shard);
+
  private:
   class Impl;
 
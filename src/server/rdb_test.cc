@@ -16,6 +16,7 @@ extern "C" {
 #include "base/flags.h"
 #include "base/gtest.h"
 #include "base/logging.h"
+#include "core/dict_compressor.h"
 #include "facade/facade_test.h"  // needed to find operator== for RespExpr.
 #include "io/file.h"
 #include "server/engine_shard_set.h"
@@ -33,6 +34,7 @@ using absl::StrCat;
 ABSL_DECLARE_FLAG(int32, list_compress_depth);
 ABSL_DECLARE_FLAG(int32, list_max_listpack_size);
 ABSL_DECLARE_FLAG(dfly::CompressionMode, compression_mode);
+ABSL_DECLARE_FLAG(dfly::MemoryBytesFlag, value_dict_size);
 
 namespace dfly {
 
@@ -535,6 +537,43 @@ TEST_F(RdbTest, RedisJson) {
             "dragondlydb.io\",\"years-active\":[2021,2022,2023,2024,\"and more!\"]}");
 }
 
+TEST_F(RdbTest, SearchVectorIndex) {
+  // Vector indices are restored from the snapshot, all other indices are rebuilt
+  for (string_view algo : {"HNSW", "FLAT"}) {
+    string name = StrCat("idx-", algo);
+    auto resp = Run({"ft.create", name, "ON", "HASH", "PREFIX", "1", StrCat(algo, ":"), "SCHEMA",
+                     "tag", "TAG", "vector", "VECTOR", algo, "4", "DIM", "2", "DISTANCE_METRIC",
+                     "L2"});
+    ASSERT_EQ(resp, "OK");
+
+    for (unsigned i = 0; i < 100; i++) {
+      float coords[2] = {float(i), 0.0f};
+      Run({"hset", StrCat(algo, ":", i), "tag", i % 2 ? "odd" : "even", "vector",
+           string_view{reinterpret_cast<char*>(coords), sizeof(coords)}});
+    }
+    Run({"del", StrCat(algo, ":", 50)});
+  }
+
+  Run({"debug", "reload"});
+
+  float query[2] = {50.0f, 0.0f};
+  string_view query_vec{reinterpret_cast<char*>(query), sizeof(query)};
+  for (string_view algo : {"HNSW", "FLAT"}) {
+    string name = StrCat("idx-", algo);
+    auto resp = Run({"ft.search", name, "*=>[KNN 3 @vector $vec]", "NOCONTENT", "PARAMS", "2",
+                     "vec", query_vec});
+    ASSERT_THAT(resp, ArrLen(4));
+    EXPECT_THAT(resp.GetVec()[0], IntArg(3));
+    EXPECT_THAT(resp.GetVec()[1], AnyOf(StrCat(algo, ":49"), StrCat(algo, ":51")));
+    EXPECT_THAT(resp.GetVec()[3], AnyOf(StrCat(algo, ":48"), StrCat(algo, ":52")));
+
+    resp = Run({"ft.search", name, "@tag:{odd}=>[KNN 2 @vector $vec]", "NOCONTENT", "PARAMS", "2",
+                "vec", query_vec});
+    ASSERT_THAT(resp, ArrLen(3));
+    EXPECT_THAT(resp.GetVec()[1], AnyOf(StrCat(algo, ":49"), StrCat(algo, ":51")));
+  }
+}
+
 TEST_F(RdbTest, SBF) {
   EXPECT_THAT(Run({"BF.ADD", "k", "1"}), IntArg(1));
   Run({"debug", "reload"});
@@ -542,4 +581,52 @@ TEST_F(RdbTest, SBF) {
   EXPECT_THAT(Run({"BF.EXISTS", "k", "1"}), IntArg(1));
 }
 
+class RdbValueDictTest : public RdbTest {
+ protected:
+  void SetUp() {
+    SetFlag(&FLAGS_value_dict_size, MemoryBytesFlag{1024});
+    RdbTest::SetUp();
+  }
+
+  absl::FlagSaver saver_;
+};
+
+TEST_F(RdbValueDictTest, Reload) {
+  auto make_value = [](unsigned i) {
+    return StrCat(R"({"user_id":)", i * 7919, R"(,"roles":["reader","writer"],"preferences":)",
+                  R"({"theme":"dark","language":"en-US","notifications":true},"last_page":)",
+                  R"("/products/)", i, R"(","agent":"Mozilla/5.0 X11; Linux x86_64"})");
+  };
+
+  // Enough values for every shard to train its dictionary in the background
+  constexpr unsigned kNumKeys = 3000;
+  for (unsigned i = 0; i < kNumKeys; i++)
+    Run({"set", StrCat("key:", i), make_value(i)});
+
+  ExpectConditionWithinTimeout([] {
+    atomic_bool trained = true;
+    shard_set->RunBriefInParallel([&](EngineShard* es) {
+      if (es->dict_compressor()->dict().empty())
+        trained = false;
+    });
+    return trained.load();
+  });
+
+  ASSERT_EQ(Run({"save", "df"}), "OK");
+  auto save_info = service_->server_family().GetLastSaveInfo();
+
+  // Load into fresh shards, which have no dictionaries to compress loaded values with unless they
+  // are restored from the snapshot
+  ResetService();
+  ASSERT_EQ(Run({"debug", "load", save_info.file_name}), "OK");
+
+  // Dictionaries are restored before values, so all loaded values are compressed
+  for (unsigned i = 0; i < kNumKeys; i += 99) {
+    string key = StrCat("key:", i);
+    string value = make_value(i);
+    EXPECT_EQ(Run({"get", key}), value);
+    EXPECT_LT(*Run({"memory", "usage", key}).GetInt(), int64_t(value.size() / 2));
+  }
+}
+
 }  // namespace dfly
@@ -10,101 +10,240 @@ namespace dfly::aggregate {
 
 namespace {
 
-struct GroupStep {
-  PipelineResult operator()(std::vector<DocValues> values) {
-    // Separate items into groups
-    absl::flat_hash_map<absl::FixedArray<Value>, std::vector<DocValues>> groups;
-    for (auto& value : values) {
-      groups[Extract(value)].push_back(std::move(value));
-    }
-
-    // Restore DocValues and apply reducers
-    std::vector<DocValues> out;
-    while (!groups.empty()) {
-      auto node = groups.extract(groups.begin());
-      DocValues doc = Unpack(std::move(node.key()));
-      for (auto& reducer : reducers_) {
-        doc[reducer.result_field] = reducer.func({reducer.source_field, node.mapped()});
-      }
-      out.push_back(std::move(doc));
-    }
-    return out;
+// Order by field, values without it come first
+struct FieldLess {
+  bool operator()(const DocValues& l, const DocValues& r) const {
+    auto it1 = l.find(field);
+    auto it2 = r.find(field);
+    return it2 != r.end() && (it1 == l.end() || it1->second < it2->second);
   }
 
-  absl::FixedArray<Value> Extract(const DocValues& dv) {
-    absl::FixedArray<Value> out(fields_.size());
-    for (size_t i = 0; i < fields_.size(); i++) {
-      auto it = dv.find(fields_[i]);
-      out[i] = (it != dv.end()) ? it->second : Value{};
+  std::string_view field;
+};
+
+const std::vector<Value> kEmptyColumn;
+
+}  // namespace
+
+ColumnBatch::ColumnBatch(std::vector<std::string> fields)
+    : fields{std::move(fields)}, columns(this->fields.size()) {
+}
+
+ColumnBatch ColumnBatch::FromRows(std::vector<std::string> fields,
+                                  absl::Span<const DocValues> rows) {
+  ColumnBatch batch{std::move(fields)};
+  for (size_t i = 0; i < batch.fields.size(); i++) {
+    auto& column = batch.columns[i];
+    column.reserve(rows.size());
+    for (const DocValues& row : rows) {
+      auto it = row.find(batch.fields[i]);
+      column.push_back(it != row.end() ? it->second : Value{});
     }
-    return out;
   }
+  return batch;
+}
 
-  DocValues Unpack(absl::FixedArray<Value>&& values) {
-    DCHECK_EQ(values.size(), fields_.size());
-    DocValues out;
-    for (size_t i = 0; i < fields_.size(); i++)
-      out[fields_[i]] = std::move(values[i]);
-    return out;
-  }
+const std::vector<Value>* ColumnBatch::Column(std::string_view field) const {
+  auto it = std::find(fields.begin(), fields.end(), field);
+  return it != fields.end() ? &columns[it - fields.begin()] : nullptr;
+}
 
-  std::vector<std::string> fields_;
-  std::vector<Reducer> reducers_;
-};
+void ColumnBatch::Clear() {
+  for (auto& column : columns)
+    column.clear();
+}
 
-const Value kEmptyValue = Value{};
+void Reducer::State::Merge(Func func, State&& other) {
+  if (other.count == 0)
+    return;
 
-}  // namespace
+  if (func == MAX || func == MIN) {
+    if (count == 0 || (func == MAX ? extreme < other.extreme : other.extreme < extreme))
+      extreme = std::move(other.extreme);
+  }
 
-const Value& ValueIterator::operator*() const {
-  auto it = values_.front().find(field_);
-  return it == values_.front().end() ? kEmptyValue : it->second;
+  count += other.count;
+  sum += other.sum;
+  if (distinct.empty())
+    distinct = std::move(other.distinct);
+  else
+    distinct.insert(std::make_move_iterator(other.distinct.begin()),
+                    std::make_move_iterator(other.distinct.end()));
 }
 
-ValueIterator& ValueIterator::operator++() {
-  values_.remove_prefix(1);
-  return *this;
+Reducer::Func FindReducerFunc(std::string_view name) {
+  static const std::unordered_map<std::string_view, Reducer::Func> kReducers = {
+      {"COUNT", Reducer::COUNT}, {"COUNT_DISTINCT", Reducer::COUNT_DISTINCT},
+      {"SUM", Reducer::SUM},     {"AVG", Reducer::AVG},
+      {"MAX", Reducer::MAX},     {"MIN", Reducer::MIN}};
+
+  auto it = kReducers.find(name);
+  return it != kReducers.end() ? it->second : Reducer::NONE;
 }
 
-Reducer::Func FindReducerFunc(std::string_view name) {
-  const static auto kCountReducer = [](ValueIterator it) -> double {
-    return std::distance(it, it.end());
+void GroupBatch(const GroupParams& params, const ColumnBatch& batch, PartialGroups* groups) {
+  auto column = [&batch](std::string_view field) {
+    auto* column = batch.Column(field);
+    return column && !column->empty() ? column : &kEmptyColumn;
   };
-
-  const static auto kSumReducer = [](ValueIterator it) -> double {
-    double sum = 0;
-    for (; it != it.end(); ++it)
-      sum += std::holds_alternative<double>(*it) ? std::get<double>(*it) : 0.0;
-    return sum;
+  auto value = [](const std::vector<Value>* column, size_t row) -> const Value& {
+    static const Value kEmptyValue{};
+    return column->empty() ? kEmptyValue : (*column)[row];
   };
 
-  static const std::unordered_map<std::string_view, std::function<Value(ValueIterator)>> kReducers =
-      {{"COUNT", [](auto it) { return kCountReducer(it); }},
-       {"COUNT_DISTINCT",
-        [](auto it) { return double(std::unordered_set<Value>(it, it.end()).size()); }},
-       {"SUM", [](auto it) { return kSumReducer(it); }},
-       {"AVG", [](auto it) { return kSumReducer(it) / kCountReducer(it); }},
-       {"MAX", [](auto it) { return *std::max_element(it, it.end()); }},
-       {"MIN", [](auto it) { return *std::min_element(it, it.end()); }}};
+  std::vector<const std::vector<Value>*> key_columns, source_columns;
+  for (const auto& field : params.fields)
+    key_columns.push_back(column(field));
+  for (const auto& reducer : params.reducers)
+    source_columns.push_back(column(reducer.source_field));
 
-  auto it = kReducers.find(name);
-  return it != kReducers.end() ? it->second : Reducer::Func{};
+  // The key is reused across rows, so it's copied only for new groups
+  absl::FixedArray<Value> key(params.fields.size());
+  for (size_t row = 0; row < batch.Rows(); row++) {
+    for (size_t i = 0; i < key.size(); i++)
+      key[i] = value(key_columns[i], row);
+
+    auto it = groups->find(key);
+    if (it == groups->end())
+      it = groups->emplace(key, std::vector<Reducer::State>(params.reducers.size())).first;
+
+    for (size_t i = 0; i < params.reducers.size(); i++) {
+      auto& state = it->second[i];
+      const Value& source = value(source_columns[i], row);
+      switch (params.reducers[i].func) {
+        case Reducer::SUM:
+        case Reducer::AVG:
+          state.sum += std::holds_alternative<double>(source) ? std::get<double>(source) : 0.0;
+          break;
+        case Reducer::MAX:
+          if (state.count == 0 || state.extreme < source)
+            state.extreme = source;
+          break;
+        case Reducer::MIN:
+          if (state.count == 0 || source < state.extreme)
+            state.extreme = source;
+          break;
+        case Reducer::COUNT_DISTINCT:
+          state.distinct.insert(source);
+          break;
+        default:
+          break;
+      }
+      state.count++;
+    }
+  }
+}
+
+void MergeGroups(const GroupParams& params, PartialGroups&& other, PartialGroups* groups) {
+  if (groups->empty()) {
+    *groups = std::move(other);
+    return;
+  }
+
+  while (!other.empty()) {
+    auto node = other.extract(other.begin());
+    auto [it, inserted] = groups->try_emplace(std::move(node.key()));
+    if (inserted) {
+      it->second = std::move(node.mapped());
+      continue;
+    }
+    for (size_t i = 0; i < params.reducers.size(); i++)
+      it->second[i].Merge(params.reducers[i].func, std::move(node.mapped()[i]));
+  }
+}
+
+std::vector<DocValues> FinalizeGroups(const GroupParams& params, PartialGroups groups) {
+  std::vector<DocValues> out;
+  out.reserve(groups.size());
+  while (!groups.empty()) {
+    auto node = groups.extract(groups.begin());
+
+    DocValues doc;
+    for (size_t i = 0; i < params.fields.size(); i++)
+      doc[params.fields[i]] = std::move(node.key()[i]);
+
+    for (size_t i = 0; i < params.reducers.size(); i++) {
+      auto& state = node.mapped()[i];
+      Value& result = doc[params.reducers[i].result_field];
+      switch (params.reducers[i].func) {
+        case Reducer::COUNT:
+          result = state.count;
+          break;
+        case Reducer::COUNT_DISTINCT:
+          result = double(state.distinct.size());
+          break;
+        case Reducer::SUM:
+          result = state.sum;
+          break;
+        case Reducer::AVG:
+          result = state.sum / state.count;
+          break;
+        case Reducer::MAX:
+        case Reducer::MIN:
+          result = std::move(state.extreme);
+          break;
+        case Reducer::NONE:
+          break;
+      }
+    }
+    out.push_back(std::move(doc));
+  }
+  return out;
 }
 
 PipelineStep MakeGroupStep(absl::Span<const std::string_view> fields,
                            std::vector<Reducer> reducers) {
-  return GroupStep{std::vector<std::string>(fields.begin(), fields.end()), std::move(reducers)};
+  return MakeGroupStep(
+      GroupParams{std::vector<std::string>(fields.begin(), fields.end()), std::move(reducers)});
+}
+
+PipelineStep MakeGroupStep(GroupParams params) {
+  return [params = std::move(params)](std::vector<DocValues> values) -> PipelineResult {
+    std::vector<std::string> fields = params.fields;
+    for (const auto& reducer : params.reducers)
+      fields.push_back(reducer.source_field);
+
+    PartialGroups groups;
+    GroupBatch(params, ColumnBatch::FromRows(std::move(fields), values), &groups);
+    return FinalizeGroups(params, std::move(groups));
+  };
+}
+
+void SortValues(const SortParams& params, std::vector<DocValues>* values) {
+  size_t prefix = std::min(params.limit, values->size());
+  FieldLess less{params.field};
+  if (params.descending) {
+    std::partial_sort(values->begin(), values->begin() + prefix, values->end(),
+                      [&less](const auto& l, const auto& r) { return less(r, l); });
+  } else {
+    std::partial_sort(values->begin(), values->begin() + prefix, values->end(), less);
+  }
+  values->resize(prefix);
+}
+
+std::vector<DocValues> MergeSortedValues(const SortParams& params,
+                                         std::vector<std::vector<DocValues>> shard_values) {
+  std::vector<absl::Span<DocValues>> spans(shard_values.begin(), shard_values.end());
+
+  FieldLess less{params.field};
+  auto merged = params.descending
+                    ? MergeSorted<DocValues>(spans, params.limit,
+                                             [&less](const auto& l, const auto& r) {
+                                               return less(r, l);
+                                             })
+                    : MergeSorted<DocValues>(spans, params.limit, less);
+
+  std::vector<DocValues> out;
+  out.reserve(merged.size());
+  for (DocValues* value : merged)
+    out.push_back(std::move(*value));
+  return out;
 }
 
 PipelineStep MakeSortStep(std::string_view field, bool descending) {
-  return [field = std::string(field), descending](std::vector<DocValues> values) -> PipelineResult {
-    std::sort(values.begin(), values.end(), [field](const DocValues& l, const DocValues& r) {
-      auto it1 = l.find(field);
-      auto it2 = r.find(field);
-      return it1 == l.end() || (it2 != r.end() && it1->second < it2->second);
-    });
-    if (descending)
-      std::reverse(values.begin(), values.end());
+  return [params = SortParams{std::string(field), descending}](
+             std::vector<DocValues> values) -> PipelineResult {
+    SortValues(params, &values);
     return values;
   };
 }
@@ -4,9 +4,13 @@
 
 #pragma once
 
+#include <absl/container/fixed_array.h>
 #include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
 #include <absl/types/span.h>
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <variant>
 
@@ -24,54 +28,112 @@ using DocValues = absl::flat_hash_map<std::string, Value>;  // documents sent th
 using PipelineResult = io::Result<std::vector<DocValues>, facade::ErrorReply>;
 using PipelineStep = std::function<PipelineResult(std::vector<DocValues>)>;  // Group, Sort, etc.
 
-// Iterator over Span<DocValues> that yields doc[field] or monostate if not present.
-// Extra clumsy for STL compatibility!
-struct ValueIterator {
-  using iterator_category = std::forward_iterator_tag;
-  using difference_type = std::ptrdiff_t;
-  using value_type = const Value;
-  using pointer = const Value*;
-  using reference = const Value&;
-
-  ValueIterator(std::string_view field, absl::Span<const DocValues> values)
-      : field_{field}, values_{values} {
-  }
-
-  const Value& operator*() const;
-
-  ValueIterator& operator++();
+// Documents in columnar layout: values of every field are stored contiguously, so a field is
+// found once per batch instead of once per document. Missing values are monostate.
+struct ColumnBatch {
+  explicit ColumnBatch(std::vector<std::string> fields);
 
-  bool operator==(const ValueIterator& other) const {
-    return values_.size() == other.values_.size();
-  }
+  // Build from rows, taking only values of the batch fields
+  static ColumnBatch FromRows(std::vector<std::string> fields, absl::Span<const DocValues> rows);
 
-  bool operator!=(const ValueIterator& other) const {
-    return !operator==(other);
-  }
+  // Column of field, nullptr if it's not part of the batch
+  const std::vector<Value>* Column(std::string_view field) const;
 
-  static ValueIterator end() {
-    return ValueIterator{};
+  size_t Rows() const {
+    return columns.empty() ? 0 : columns.front().size();
   }
 
- private:
-  ValueIterator() = default;
+  void Clear();
 
-  std::string_view field_;
-  absl::Span<const DocValues> values_;
+  std::vector<std::string> fields;
+  std::vector<std::vector<Value>> columns;  // columns[i] holds values of fields[i]
 };
 
 struct Reducer {
-  using Func = std::function<Value(ValueIterator)>;
+  enum Func { NONE, COUNT, COUNT_DISTINCT, SUM, AVG, MAX, MIN };
+
+  // Accumulated state of a reducer over a set of documents. States over different sets of the
+  // same group, i.e. from different shards, can be merged before the final value is computed.
+  struct State {
+    void Merge(Func func, State&& other);
+
+    double count = 0;
+    double sum = 0;
+    Value extreme;                        // MAX or MIN
+    absl::flat_hash_set<Value> distinct;  // COUNT_DISTINCT
+  };
+
   std::string source_field, result_field;
   Func func;
 };
 
-// Find reducer function by uppercase name (COUNT, MAX, etc...), empty functor if not found
+// Find reducer function by uppercase name (COUNT, MAX, etc...), NONE if not found
 Reducer::Func FindReducerFunc(std::string_view name);
 
+// GROUPBY fields with reducers
+struct GroupParams {
+  std::vector<std::string> fields;
+  std::vector<Reducer> reducers;
+};
+
+// Groups keyed by values of the group fields with reducer states in order of reducers
+using PartialGroups = absl::flat_hash_map<absl::FixedArray<Value>, std::vector<Reducer::State>>;
+
+// Accumulate documents of batch into groups. The batch must include the group fields and reducer
+// source fields, missing ones are treated as monostate
+void GroupBatch(const GroupParams& params, const ColumnBatch& batch, PartialGroups* groups);
+
+// Merge groups accumulated from a disjoint set of documents into groups
+void MergeGroups(const GroupParams& params, PartialGroups&& other, PartialGroups* groups);
+
+// Compute reducer values and build documents with group fields and reducer results
+std::vector<DocValues> FinalizeGroups(const GroupParams& params, PartialGroups groups);
+
+// SORTBY at the start of a pipeline with the offset + num of a directly following LIMIT. Shards
+// apply it to their own values, so only the first limit values of every shard are merged.
+struct SortParams {
+  std::string field;
+  bool descending = false;
+  size_t limit = std::numeric_limits<size_t>::max();
+};
+
+// Sort values by field, values without it come first (last if descending). Keep first limit
+void SortValues(const SortParams& params, std::vector<DocValues>* values);
+
+// Merge values of all shards that were sorted with SortValues, keep first limit
+std::vector<DocValues> MergeSortedValues(const SortParams& params,
+                                         std::vector<std::vector<DocValues>> shard_values);
+
+// Merge spans that are each ordered by less into its first limit elements with a k-way heap merge
+template <typename T, typename Less>
+std::vector<T*> MergeSorted(absl::Span<const absl::Span<T>> sorted, size_t limit, Less less) {
+  using Cursor = std::pair<T* /*current*/, T* /*end*/>;
+  auto heap_less = [&less](const Cursor& l, const Cursor& r) { return less(*r.first, *l.first); };
+
+  std::vector<Cursor> heap;
+  for (absl::Span<T> span : sorted) {
+    if (!span.empty())
+      heap.emplace_back(span.data(), span.data() + span.size());
+  }
+  std::make_heap(heap.begin(), heap.end(), heap_less);
+
+  std::vector<T*> out;
+  while (!heap.empty() && out.size() < limit) {
+    std::pop_heap(heap.begin(), heap.end(), heap_less);
+    auto& [current, end] = heap.back();
+    out.push_back(current);
+    if (++current == end)
+      heap.pop_back();
+    else
+      std::push_heap(heap.begin(), heap.end(), heap_less);
+  }
+  return out;
+}
+
 // Make `GROUPBY [fields...]`  with REDUCE step
 PipelineStep MakeGroupStep(absl::Span<const std::string_view> fields,
                            std::vector<Reducer> reducers);
+PipelineStep MakeGroupStep(GroupParams params);
 
 // Make `SORYBY field [DESC]` step
 PipelineStep MakeSortStep(std::string_view field, bool descending = false);
@@ -43,6 +43,27 @@ TEST(AggregatorTest, Limit) {
   EXPECT_EQ(result->at(1)["i"], Value(3.0));
 }
 
+TEST(AggregatorTest, MergeSorted) {
+  SortParams params{"a", true, 4};
+
+  std::vector<std::vector<DocValues>> shard_values(3);
+  for (size_t i = 0; i < 9; i++)
+    shard_values[i % 3].push_back(DocValues{{"a", double(i)}});
+  shard_values[1].push_back(DocValues{{"b", 1.0}});
+
+  for (auto& values : shard_values)
+    SortValues(params, &values);
+
+  EXPECT_EQ(shard_values[0].size(), 3u);
+  EXPECT_EQ(shard_values[1].size(), 4u);
+  EXPECT_EQ(shard_values[1].back().count("a"), 0u);  // missing values are last if descending
+
+  auto merged = MergeSortedValues(params, std::move(shard_values));
+  ASSERT_EQ(merged.size(), 4u);
+  for (size_t i = 0; i < merged.size(); i++)
+    EXPECT_EQ(merged[i]["a"], Value(8.0 - i));
+}
+
 TEST(AggregatorTest, SimpleGroup) {
   std::vector<DocValues> values = {
       DocValues{{"i", 1.0}, {"tag", "odd"}},
@@ -103,4 +124,45 @@ TEST(AggregatorTest, GroupWithReduce) {
   EXPECT_EQ(result->at(1).at("distinct-null"), Value{(double)1});
 }
 
+TEST(AggregatorTest, MergePartialGroups) {
+  GroupParams params{{"tag"},
+                     {Reducer{"", "count", Reducer::COUNT}, Reducer{"i", "avg-i", Reducer::AVG},
+                      Reducer{"i", "max-i", Reducer::MAX}, Reducer{"i", "min-i", Reducer::MIN},
+                      Reducer{"i", "distinct-i", Reducer::COUNT_DISTINCT}}};
+
+  // Group two halves of the values separately, as if they were on different shards
+  PartialGroups shard_groups[2];
+  for (size_t shard = 0; shard < 2; shard++) {
+    ColumnBatch batch{{"tag", "i"}};
+    for (size_t i = shard; i < 10; i += 2) {
+      batch.columns[0].push_back(i % 3 == 0 ? "three" : "other");
+      batch.columns[1].push_back(double(i % 5));
+    }
+    GroupBatch(params, batch, &shard_groups[shard]);
+  }
+
+  PartialGroups groups;
+  for (auto& shard : shard_groups)
+    MergeGroups(params, std::move(shard), &groups);
+
+  auto result = FinalizeGroups(params, std::move(groups));
+  ASSERT_EQ(result.size(), 2u);
+  if (result[0]["tag"] == Value("other"))
+    std::swap(result[0], result[1]);
+
+  // 0, 3, 6, 9 -> i % 5 = 0, 3, 1, 4
+  EXPECT_EQ(result[0]["count"], Value(4.0));
+  EXPECT_EQ(result[0]["avg-i"], Value(2.0));
+  EXPECT_EQ(result[0]["max-i"], Value(4.0));
+  EXPECT_EQ(result[0]["min-i"], Value(0.0));
+  EXPECT_EQ(result[0]["distinct-i"], Value(4.0));
+
+  // 1, 2, 4, 5, 7, 8 -> i % 5 = 1, 2, 4, 0, 2, 3
+  EXPECT_EQ(result[1]["count"], Value(6.0));
+  EXPECT_EQ(result[1]["avg-i"], Value(2.0));
+  EXPECT_EQ(result[1]["max-i"], Value(4.0));
+  EXPECT_EQ(result[1]["min-i"], Value(0.0));
+  EXPECT_EQ(result[1]["distinct-i"], Value(5.0));
+}
+
 }  // namespace dfly::aggregate
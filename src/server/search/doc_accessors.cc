@@ -9,6 +9,7 @@
 
 #include "server/search/doc_accessors.h"
 
+#include <absl/functional/function_ref.h>
 #include <absl/strings/str_cat.h>
 #include <absl/strings/str_join.h>
 
@@ -114,21 +115,16 @@ SearchDocData StringMapAccessor::Serialize(const search::Schema& schema) const {
 }
 
 struct JsonAccessor::JsonPathContainer {
-  vector<JsonType> Evaluate(const JsonType& json) const {
-    vector<JsonType> res;
-
+  // Call cb with every match. Values are passed by reference instead of being copied out of the
+  // document, so they're only valid during the call
+  void Evaluate(const JsonType& json, absl::FunctionRef<void(const JsonType&)> cb) const {
     visit(Overloaded{[&](const json::Path& path) {
-                       json::EvaluatePath(path, json,
-                                          [&](auto, const JsonType& v) { res.push_back(v); });
+                       json::EvaluatePath(path, json, [&](auto, const JsonType& v) { cb(v); });
                      },
                      [&](const jsoncons::jsonpath::jsonpath_expression<JsonType>& path) {
-                       auto json_arr = path.evaluate(json);
-                       for (const auto& v : json_arr.array_range())
-                         res.push_back(v);
+                       path.evaluate(json, [&](string_view, const JsonType& v) { cb(v); });
                      }},
           val);
-
-    return res;
   }
 
   variant<json::Path, jsoncons::jsonpath::jsonpath_expression<JsonType>> val;
@@ -139,23 +135,14 @@ BaseAccessor::StringList JsonAccessor::GetStrings(string_view active_field) cons
   if (!path)
     return {};
 
-  auto path_res = path->Evaluate(json_);
-  if (path_res.empty())
-    return {};
-
-  if (path_res.size() == 1) {
-    buf_ = path_res[0].as_string();
-    return {buf_};
-  }
-  buf_.clear();
-
   // First, grow buffer and compute string sizes
+  buf_.clear();
   vector<size_t> sizes;
-  for (const auto& element : path_res) {
+  path->Evaluate(json_, [&](const JsonType& element) {
     size_t start = buf_.size();
     buf_ += element.as_string();
     sizes.push_back(buf_.size() - start);
-  }
+  });
 
   // Reposition start pointers to the most recent allocation of buf
   StringList out(sizes.size());
@@ -174,18 +161,20 @@ BaseAccessor::VectorInfo JsonAccessor::GetVector(string_view active_field) const
   if (!path)
     return {};
 
-  auto res = path->Evaluate(json_);
-  if (res.empty())
-    return {nullptr, 0};
+  // Only the first match is used
+  VectorInfo out{nullptr, 0};
+  path->Evaluate(json_, [&out](const JsonType& element) {
+    if (out.first)
+      return;
 
-  size_t size = res[0].size();
-  auto ptr = make_unique<float[]>(size);
+    size_t size = element.size();
+    out = {make_unique<float[]>(size), size};
 
-  size_t i = 0;
-  for (const auto& v : res[0].array_range())
-    ptr[i++] = v.as<float>();
-
-  return {std::move(ptr), size};
+    size_t i = 0;
+    for (const auto& v : element.array_range())
+      out.first[i++] = v.as<float>();
+  });
+  return out;
 }
 
 JsonAccessor::JsonPathContainer* JsonAccessor::GetPath(std::string_view field) const {
@@ -230,10 +219,16 @@ SearchDocData JsonAccessor::Serialize(const search::Schema& schema,
                                       const SearchParams::FieldReturnList& fields) const {
   SearchDocData out{};
   for (const auto& [ident, name] : fields) {
-    if (auto* path = GetPath(ident); path) {
-      if (auto res = path->Evaluate(json_); !res.empty())
-        out[name] = res[0].to_string();
-    }
+    auto* path = GetPath(ident);
+    if (!path)
+      continue;
+
+    // Only the first match is returned
+    bool found = false;
+    path->Evaluate(json_, [&](const JsonType& value) {
+      if (!std::exchange(found, true))
+        out[name] = value.to_string();
+    });
   }
   return out;
 }
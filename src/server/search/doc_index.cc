@@ -4,47 +4,46 @@
 
 #include "server/search/doc_index.h"
 
+#include <absl/base/internal/endian.h>
 #include <absl/strings/str_join.h>
 
 #include <memory>
 
+#include "base/flags.h"
 #include "base/logging.h"
 #include "core/overloaded.h"
+#include "core/search/indices.h"
 #include "server/engine_shard_set.h"
 #include "server/search/doc_accessors.h"
 #include "server/server_state.h"
 
+ABSL_FLAG(uint32_t, search_index_build_threads, 0,
+          "Number of worker threads per shard that insert vectors into HNSW indices when "
+          "existing documents are indexed. If 0, vectors are inserted on the shard thread.");
+
+ABSL_FLAG(bool, search_json_stored_fields, false,
+          "If true, serialized values of SORTABLE fields of JSON indices are kept next to the "
+          "index, so that returning them doesn't evaluate their paths on every result.");
+
 namespace dfly {
 
 using namespace std;
+using namespace util;
 
 namespace {
 
-template <typename F>
-void TraverseAllMatching(const DocIndex& index, const OpArgs& op_args, F&& f) {
-  auto& db_slice = op_args.shard->db_slice();
-  DCHECK(db_slice.IsDbValid(op_args.db_cntx.db_index));
-  auto [prime_table, _] = db_slice.GetTables(op_args.db_cntx.db_index);
-
-  string scratch;
-  auto cb = [&](PrimeTable::iterator it) {
-    const PrimeValue& pv = it->second;
-    if (pv.ObjType() != index.GetObjCode())
-      return;
+// Number of keys traversed by a single rebuild step, between yields
+constexpr size_t kRebuildStepKeys = 1000;
 
-    string_view key = it->first.GetSlice(&scratch);
-    if (key.rfind(index.prefix, 0) != 0)
-      return;
+// Documents grouped at once by aggregations
+constexpr size_t kAggregateBatchSize = 1024;
 
-    auto accessor = GetAccessor(op_args.db_cntx, pv);
-    f(key, accessor.get());
-  };
+// Version of serialized index data in snapshots. Data of other versions is ignored and indices
+// are rebuilt from documents
+constexpr uint64_t kSerializationVersion = 1;
 
-  PrimeTable::Cursor cursor;
-  do {
-    cursor = prime_table->Traverse(cursor, cb);
-  } while (cursor);
-}
+// Approximate size of serialized index data chunks in snapshots
+constexpr size_t kSerializeChunkBytes = 1 << 20;
 
 const absl::flat_hash_map<string_view, search::SchemaField::FieldType> kSchemaTypes = {
     {"TAG"sv, search::SchemaField::TAG},
@@ -52,6 +51,57 @@ const absl::flat_hash_map<string_view, search::SchemaField::FieldType> kSchemaTy
     {"NUMERIC"sv, search::SchemaField::NUMERIC},
     {"VECTOR"sv, search::SchemaField::VECTOR}};
 
+void AppendInt(uint64_t value, string* out) {
+  char buf[8];
+  absl::little_endian::Store64(buf, value);
+  out->append(buf, sizeof(buf));
+}
+
+void AppendString(string_view value, string* out) {
+  AppendInt(value.size(), out);
+  out->append(value);
+}
+
+bool ReadInt(string_view* in, uint64_t* value) {
+  if (in->size() < 8)
+    return false;
+  *value = absl::little_endian::Load64(in->data());
+  in->remove_prefix(8);
+  return true;
+}
+
+bool ReadString(string_view* in, string_view* value) {
+  uint64_t size;
+  if (!ReadInt(in, &size) || in->size() < size)
+    return false;
+  *value = in->substr(0, size);
+  in->remove_prefix(size);
+  return true;
+}
+
+// Header of every chunk of serialized index data, see ShardDocIndices::SerializeStep
+struct SerializedHeader {
+  uint64_t shard_count, shard_id;
+  string_view name;
+};
+
+void AppendSerializedHeader(string_view name, string* out) {
+  AppendInt(kSerializationVersion, out);
+  AppendInt(shard_set->size(), out);
+  AppendInt(EngineShard::tlocal()->shard_id(), out);
+  AppendString(name, out);
+}
+
+optional<SerializedHeader> ReadSerializedHeader(string_view* in) {
+  uint64_t version;
+  SerializedHeader header;
+  if (!ReadInt(in, &version) || version != kSerializationVersion ||
+      !ReadInt(in, &header.shard_count) || !ReadInt(in, &header.shard_id) ||
+      !ReadString(in, &header.name))
+    return nullopt;
+  return header;
+}
+
 }  // namespace
 
 bool SerializedSearchDoc::operator<(const SerializedSearchDoc& other) const {
@@ -107,9 +157,21 @@ string DocIndexInfo::BuildRestoreCommand() const {
     Overloaded info{
         [](monostate) {},
         [out = &out](const search::SchemaField::VectorParams& params) {
-          auto sim = params.sim == search::VectorSimilarity::L2 ? "L2" : "COSINE";
-          absl::StrAppend(out, " ", params.use_hnsw ? "HNSW" : "FLAT", " 6 ", "DIM ", params.dim,
-                          " DISTANCE_METRIC ", sim, " INITIAL_CAP ", params.capacity);
+          string_view sim = "L2";
+          if (params.sim == search::VectorSimilarity::COSINE)
+            sim = "COSINE";
+          else if (params.sim == search::VectorSimilarity::IP)
+            sim = "IP";
+          string args = absl::StrCat("DIM ", params.dim, " DISTANCE_METRIC ", sim,
+                                     " INITIAL_CAP ", params.capacity);
+          unsigned num_args = 6;
+          if (params.quantization != search::VectorQuantization::NONE) {
+            bool fp16 = params.quantization == search::VectorQuantization::FP16;
+            absl::StrAppend(&args, " QUANTIZATION ", fp16 ? "FP16" : "INT8", " RERANK ",
+                            params.rerank_factor);
+            num_args += 4;
+          }
+          absl::StrAppend(out, " ", params.use_hnsw ? "HNSW" : "FLAT", " ", num_args, " ", args);
         },
         [out = &out](const search::SchemaField::TagParams& params) {
           absl::StrAppend(out, " ", "SEPARATOR", " ", string{params.separator});
@@ -159,6 +221,33 @@ string_view ShardDocIndex::DocKeyIndex::Get(DocId id) const {
   return keys_[id];
 }
 
+bool ShardDocIndex::DocKeyIndex::Contains(string_view key) const {
+  return ids_.contains(key);
+}
+
+optional<ShardDocIndex::DocId> ShardDocIndex::DocKeyIndex::Find(string_view key) const {
+  auto it = ids_.find(key);
+  return it != ids_.end() ? make_optional(it->second) : nullopt;
+}
+
+bool ShardDocIndex::DocKeyIndex::Assign(vector<string> keys) {
+  *this = DocKeyIndex{};
+  keys_ = std::move(keys);
+  last_id_ = keys_.size();
+
+  for (DocId id = 0; id < last_id_; id++) {
+    if (keys_[id].empty())
+      free_ids_.push_back(id);
+    else if (!ids_.emplace(keys_[id], id).second)
+      return false;
+  }
+  return true;
+}
+
+const vector<string>& ShardDocIndex::DocKeyIndex::Keys() const {
+  return keys_;
+}
+
 size_t ShardDocIndex::DocKeyIndex::Size() const {
   return ids_.size();
 }
@@ -175,24 +264,266 @@ ShardDocIndex::ShardDocIndex(shared_ptr<DocIndex> index)
     : base_{std::move(index)}, indices_{{}, nullptr}, key_index_{} {
 }
 
-void ShardDocIndex::Rebuild(const OpArgs& op_args, PMR_NS::memory_resource* mr) {
+ShardDocIndex::~ShardDocIndex() {
+  CancelRebuild();
+}
+
+void ShardDocIndex::Rebuild(const OpArgs& op_args, PMR_NS::memory_resource* mr,
+                            string_view snapshot_data) {
+  CancelRebuild();
   key_index_ = DocKeyIndex{};
   indices_ = search::FieldIndices{base_->schema, mr};
 
-  auto cb = [this](string_view key, BaseAccessor* doc) { indices_.Add(key_index_.Add(key), doc); };
-  TraverseAllMatching(*base_, op_args, cb);
+  stored_fields_.clear();
+  if (base_->type == DocIndex::JSON && absl::GetFlag(FLAGS_search_json_stored_fields)) {
+    for (const auto& [ident, field] : base_->schema.fields) {
+      bool sortable = field.flags & search::SchemaField::SORTABLE;
+      if (sortable && field.type != search::SchemaField::VECTOR)
+        stored_fields_[ident];
+    }
+  }
+
+  absl::flat_hash_set<DocId> restored;
+  if (!snapshot_data.empty()) {
+    if (auto ids = Restore(snapshot_data); ids) {
+      restored = std::move(*ids);
+      VLOG(1) << "Restored " << restored.size() << " docs on " << base_->prefix;
+    } else {
+      LOG(WARNING) << "Can't restore index on " << base_->prefix << " from snapshot, rebuilding";
+      key_index_ = DocKeyIndex{};
+      indices_ = search::FieldIndices{base_->schema, mr};
+    }
+  }
+
+  auto& db_slice = op_args.shard->db_slice();
+  DCHECK(db_slice.IsDbValid(op_args.db_cntx.db_index));
+  auto [prime_table, _] = db_slice.GetTables(op_args.db_cntx.db_index);
+  rebuild_.emplace(
+      RebuildState{op_args.db_cntx, {}, 0, prime_table->size(), false, std::move(restored)});
+
+  // Called from a transaction callback, so don't block on vector insertion or loading
+  bool traversing = RebuildStep(op_args.shard, 0);
+  if (!traversing && rebuild_->offloaded.empty()) {
+    FinishRebuild();
+    return;
+  }
+
+  rebuild_fb_ = fb2::Fiber("index_rebuild", [this, traversing, shard = op_args.shard] {
+    unsigned num_threads = absl::GetFlag(FLAGS_search_index_build_threads);
+    if (traversing) {
+      while (!rebuild_->cancelled && RebuildStep(shard, num_threads))
+        ThisFiber::Yield();
+    }
+
+    if (!rebuild_->cancelled)
+      RebuildOffloaded(shard);
+
+    if (!rebuild_->cancelled)
+      FinishRebuild();
+  });
+}
+
+optional<absl::flat_hash_set<search::DocId>> ShardDocIndex::Restore(string_view data) {
+  string_view definition;
+  uint64_t num_fields, num_keys;
+  if (!ReadString(&data, &definition) || definition != GetInfo().BuildRestoreCommand() ||
+      !ReadInt(&data, &num_fields) || !ReadInt(&data, &num_keys))
+    return nullopt;
+
+  vector<string> keys;
+  keys.reserve(min<uint64_t>(num_keys, data.size() / 8));
+  for (uint64_t i = 0; i < num_keys; i++) {
+    string_view key;
+    if (!ReadString(&data, &key))
+      return nullopt;
+    keys.emplace_back(key);
+  }
+
+  vector<pair<string_view, string_view>> vectors;
+  for (uint64_t i = 0; i < num_fields; i++) {
+    auto& [field, field_data] = vectors.emplace_back();
+    if (!ReadString(&data, &field) || !ReadString(&data, &field_data))
+      return nullopt;
+  }
+
+  if (!data.empty() || !key_index_.Assign(std::move(keys)) || !indices_.RestoreVectors(vectors))
+    return nullopt;
+
+  absl::flat_hash_set<DocId> restored;
+  const auto& restored_keys = key_index_.Keys();
+  for (DocId id = 0; id < restored_keys.size(); id++) {
+    if (!restored_keys[id].empty())
+      restored.insert(id);
+  }
+  return restored;
+}
+
+void ShardDocIndex::StoreFields(DocId id, const BaseAccessor& accessor) {
+  for (auto& [ident, column] : stored_fields_) {
+    if (column.size() <= id)
+      column.resize(id + 1);
+
+    // Empty values stand for missing ones, as serialized json values are never empty
+    auto values = accessor.Serialize(base_->schema, {{ident, ident}});
+    column[id] = values.empty() ? string{} : std::move(values.begin()->second);
+  }
+}
+
+void ShardDocIndex::RemoveStoredFields(DocId id) {
+  for (auto& [_, column] : stored_fields_) {
+    if (id < column.size())
+      string{}.swap(column[id]);
+  }
+}
+
+SearchDocData ShardDocIndex::SerializeFields(DocId id, const DbContext& db_cntx,
+                                             const PrimeValue& pv,
+                                             const SearchParams::FieldReturnList& fields) const {
+  if (stored_fields_.empty())
+    return GetAccessor(db_cntx, pv)->Serialize(base_->schema, fields);
+
+  SearchDocData out;
+  SearchParams::FieldReturnList rest;
+  for (const auto& [ident, name] : fields) {
+    if (auto it = stored_fields_.find(ident); it == stored_fields_.end())
+      rest.emplace_back(ident, name);
+    else if (id < it->second.size() && !it->second[id].empty())
+      out[name] = it->second[id];
+  }
+
+  if (!rest.empty())
+    out.merge(GetAccessor(db_cntx, pv)->Serialize(base_->schema, rest));
+  return out;
+}
+
+void ShardDocIndex::FinishRebuild() {
+  // Restored documents that were not traversed don't exist anymore, i.e. expired while loading
+  for (DocId id : rebuild_->restored) {
+    indices_.RemoveRestored(id);
+    key_index_.Remove(string{key_index_.Get(id)});
+  }
 
   VLOG(1) << "Indexed " << key_index_.Size() << " docs on " << base_->prefix;
+  rebuild_.reset();
+}
+
+bool ShardDocIndex::RebuildStep(EngineShard* shard, unsigned num_threads) {
+  auto& db_slice = shard->db_slice();
+  if (!db_slice.IsDbValid(rebuild_->db_cntx.db_index))
+    return false;
+
+  auto [prime_table, _] = db_slice.GetTables(rebuild_->db_cntx.db_index);
+  rebuild_->db_cntx.time_now_ms = GetCurrentTimeMs();
+
+  search::FieldIndices::DeferredVectors deferred;
+  string scratch;
+  auto cb = [&](PrimeTable::iterator it) {
+    rebuild_->traversed++;
+    const PrimeValue& pv = it->second;
+    string_view key = it->first.GetSlice(&scratch);
+
+    if (!base_->Matches(key, pv.ObjType()))
+      return;
+
+    // Offloaded containers can't be read in place and loading them blocks
+    if (pv.IsExternal()) {
+      rebuild_->offloaded.emplace_back(key);
+      return;
+    }
+
+    RebuildDoc(key, pv, num_threads > 0 ? &deferred : nullptr);
+  };
+
+  size_t start = rebuild_->traversed;
+  do {
+    rebuild_->cursor = prime_table->Traverse(rebuild_->cursor, cb);
+  } while (rebuild_->cursor && rebuild_->traversed - start < kRebuildStepKeys);
+
+  // Graph insertion is the most expensive part, so it's offloaded to worker threads while the
+  // fiber waits. Updates of the index during that time are queued until the batch is inserted
+  if (!deferred.empty()) {
+    fb2::BlockingCounter bc{unsigned(deferred.size())};
+    auto done = [bc, proactor = ProactorBase::me()]() mutable {
+      proactor->DispatchBrief([bc]() mutable { bc->Dec(); });
+    };
+    for (auto& [index, vectors] : deferred)
+      index->AddBatch(std::move(vectors), num_threads, done);
+    bc->Wait();
+
+    for (auto& [index, _] : deferred)
+      index->FinishBatch();
+  }
+
+  return bool(rebuild_->cursor);
+}
+
+void ShardDocIndex::RebuildDoc(string_view key, const PrimeValue& pv,
+                               search::FieldIndices::DeferredVectors* deferred) {
+  // Documents updated while rebuilding are already indexed, restored ones only in vector indices
+  if (auto id = key_index_.Find(key); id) {
+    if (rebuild_->restored.erase(*id)) {
+      auto accessor = GetAccessor(rebuild_->db_cntx, pv);
+      indices_.AddRestored(*id, accessor.get());
+      StoreFields(*id, *accessor);
+    }
+    return;
+  }
+
+  auto accessor = GetAccessor(rebuild_->db_cntx, pv);
+  DocId id = key_index_.Add(key);
+  indices_.Add(id, accessor.get(), deferred);
+  StoreFields(id, *accessor);
+}
+
+void ShardDocIndex::RebuildOffloaded(EngineShard* shard) {
+  auto& db_slice = shard->db_slice();
+  DbIndex db_ind = rebuild_->db_cntx.db_index;
+
+  // Documents could've been deleted, updated or loaded by commands while waiting
+  for (const string& key : rebuild_->offloaded) {
+    db_slice.LoadOffloadedContainer(db_ind, key);
+    if (rebuild_->cancelled || !db_slice.IsDbValid(db_ind))
+      return;
+
+    auto [prime_table, _] = db_slice.GetTables(db_ind);
+    auto it = prime_table->Find(key);
+    if (!IsValid(it) || it->second.IsExternal() || !base_->Matches(key, it->second.ObjType()))
+      continue;
+
+    rebuild_->db_cntx.time_now_ms = GetCurrentTimeMs();
+    RebuildDoc(key, it->second, nullptr);
+  }
+}
+
+void ShardDocIndex::CancelRebuild() {
+  if (rebuild_)
+    rebuild_->cancelled = true;
+  if (rebuild_fb_.IsJoinable())
+    rebuild_fb_.Join();
+  rebuild_.reset();
 }
 
 void ShardDocIndex::AddDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
+  DCHECK(!pv.IsExternal());  // indexed containers are not offloaded
   auto accessor = GetAccessor(db_cntx, pv);
-  indices_.Add(key_index_.Add(key), accessor.get());
+  DocId id = key_index_.Add(key);
+  indices_.Add(id, accessor.get());
+  StoreFields(id, *accessor);
 }
 
 void ShardDocIndex::RemoveDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
-  auto accessor = GetAccessor(db_cntx, pv);
+  if (rebuild_ && !key_index_.Contains(key))  // not reached by rebuild yet
+    return;
+
   DocId id = key_index_.Remove(key);
+  RemoveStoredFields(id);
+  if (rebuild_ && rebuild_->restored.erase(id)) {  // restored, but not reached by rebuild yet
+    indices_.RemoveRestored(id);
+    return;
+  }
+
+  DCHECK(!pv.IsExternal());  // only documents not reached by rebuild can be offloaded
+  auto accessor = GetAccessor(db_cntx, pv);
   indices_.Remove(id, accessor.get());
 }
 
@@ -221,9 +552,11 @@ SearchResult ShardDocIndex::Search(const OpArgs& op_args, const SearchParams& pa
       continue;
     }
 
-    auto accessor = GetAccessor(op_args.db_cntx, (*it)->second);
-    auto doc_data = params.return_fields ? accessor->Serialize(base_->schema, *params.return_fields)
-                                         : accessor->Serialize(base_->schema);
+    const PrimeValue& pv = (*it)->second;
+    auto doc_data = params.return_fields
+                        ? SerializeFields(search_results.ids[i], op_args.db_cntx, pv,
+                                          *params.return_fields)
+                        : GetAccessor(op_args.db_cntx, pv)->Serialize(base_->schema);
 
     auto score = search_results.scores.empty() ? monostate{} : std::move(search_results.scores[i]);
     out.push_back(SerializedSearchDoc{string{key}, std::move(doc_data), std::move(score)});
@@ -233,8 +566,9 @@ SearchResult ShardDocIndex::Search(const OpArgs& op_args, const SearchParams& pa
                       std::move(search_results.profile)};
 }
 
-vector<absl::flat_hash_map<string, search::SortableValue>> ShardDocIndex::SearchForAggregator(
-    const OpArgs& op_args, ArgSlice load_fields, search::SearchAlgorithm* search_algo) const {
+vector<aggregate::DocValues> ShardDocIndex::SearchForAggregator(
+    const OpArgs& op_args, ArgSlice load_fields, const aggregate::SortParams* sort,
+    search::SearchAlgorithm* search_algo) const {
   auto& db_slice = op_args.shard->db_slice();
   auto search_results = search_algo->Search(&indices_);
 
@@ -246,7 +580,7 @@ vector<absl::flat_hash_map<string, search::SortableValue>> ShardDocIndex::Search
   for (string_view load_field : load_fields)
     return_fields.emplace_back(indices_.GetSchema().LookupAlias(load_field), load_field);
 
-  vector<absl::flat_hash_map<string, search::SortableValue>> out;
+  vector<aggregate::DocValues> out;
   for (DocId doc : search_results.ids) {
     auto key = key_index_.Get(doc);
     auto it = db_slice.FindReadOnly(op_args.db_cntx, key, base_->GetObjCode());
@@ -254,19 +588,124 @@ vector<absl::flat_hash_map<string, search::SortableValue>> ShardDocIndex::Search
     if (!it || !IsValid(*it))  // Item must have expired
       continue;
 
-    auto accessor = GetAccessor(op_args.db_cntx, (*it)->second);
     auto extracted = indices_.ExtractStoredValues(doc);
-    auto loaded = accessor->Serialize(base_->schema, return_fields);
+    auto loaded = SerializeFields(doc, op_args.db_cntx, (*it)->second, return_fields);
 
     out.emplace_back(make_move_iterator(extracted.begin()), make_move_iterator(extracted.end()));
     out.back().insert(make_move_iterator(loaded.begin()), make_move_iterator(loaded.end()));
   }
 
+  if (sort)
+    aggregate::SortValues(*sort, &out);
   return out;
 }
 
+aggregate::PartialGroups ShardDocIndex::SearchForAggregatorGroups(
+    const OpArgs& op_args, ArgSlice load_fields, const aggregate::GroupParams& group,
+    search::SearchAlgorithm* search_algo) const {
+  auto& db_slice = op_args.shard->db_slice();
+  auto search_results = search_algo->Search(&indices_);
+
+  if (!search_results.error.empty())
+    return {};
+
+  // Columns of group and reducer fields. Values are taken from sort indices if possible, otherwise
+  // from loaded fields
+  vector<string> fields = group.fields;
+  for (const auto& reducer : group.reducers) {
+    if (find(fields.begin(), fields.end(), reducer.source_field) == fields.end())
+      fields.push_back(reducer.source_field);
+  }
+
+  vector<const search::BaseSortIndex*> sort_indices(fields.size());
+  SearchParams::FieldReturnList return_fields;
+  for (size_t i = 0; i < fields.size(); i++) {
+    sort_indices[i] = indices_.GetSortIndex(fields[i]);
+    bool loaded = find(load_fields.begin(), load_fields.end(), fields[i]) != load_fields.end();
+    if (!sort_indices[i] && loaded)
+      return_fields.emplace_back(indices_.GetSchema().LookupAlias(fields[i]), fields[i]);
+  }
+
+  aggregate::PartialGroups groups;
+  aggregate::ColumnBatch batch{std::move(fields)};
+  for (size_t i = 0; i < search_results.ids.size(); i++) {
+    DocId doc = search_results.ids[i];
+    auto key = key_index_.Get(doc);
+    auto it = db_slice.FindReadOnly(op_args.db_cntx, key, base_->GetObjCode());
+    if (!it || !IsValid(*it))  // Item must have expired
+      continue;
+
+    SearchDocData loaded;
+    if (!return_fields.empty())
+      loaded = SerializeFields(doc, op_args.db_cntx, (*it)->second, return_fields);
+
+    for (size_t j = 0; j < batch.fields.size(); j++) {
+      auto& column = batch.columns[j];
+      if (sort_indices[j]) {
+        column.push_back(sort_indices[j]->Lookup(doc));
+      } else if (auto lit = loaded.find(batch.fields[j]); lit != loaded.end()) {
+        column.push_back(std::move(lit->second));
+      } else {
+        column.emplace_back();
+      }
+    }
+
+    if (batch.Rows() == kAggregateBatchSize) {
+      aggregate::GroupBatch(group, batch, &groups);
+      batch.Clear();
+    }
+  }
+
+  if (batch.Rows() > 0)
+    aggregate::GroupBatch(group, batch, &groups);
+  return groups;
+}
+
 DocIndexInfo ShardDocIndex::GetInfo() const {
-  return {*base_, key_index_.Size()};
+  DocIndexInfo info{*base_, key_index_.Size()};
+  if (rebuild_) {
+    info.indexing = true;
+    info.percent_indexed =
+        rebuild_->total ? min(double(rebuild_->traversed) / rebuild_->total, 0.99) : 0.0;
+  }
+  return info;
+}
+
+bool ShardDocIndex::CanSerialize() const {
+  // Partially built indices are missing documents, so they're rebuilt from scratch on load
+  return !rebuild_ && !indices_.GetVectorIndices().empty();
+}
+
+// Data consists of the index definition, number of vector fields and keys by id, followed by the
+// data of every vector index prefixed with its field and size
+bool ShardDocIndex::SerializeChunk(SerializeCursor* cursor, string* out) {
+  const auto& keys = key_index_.Keys();
+  auto vectors = indices_.GetVectorIndices();
+  const size_t limit = out->size() + kSerializeChunkBytes;
+
+  if (!cursor->started) {
+    AppendString(GetInfo().BuildRestoreCommand(), out);
+    AppendInt(vectors.size(), out);
+    AppendInt(keys.size(), out);
+    cursor->started = true;
+  }
+
+  for (; cursor->keys < keys.size() && out->size() < limit; cursor->keys++)
+    AppendString(keys[cursor->keys], out);
+
+  while (cursor->keys == keys.size() && cursor->fields < vectors.size() && out->size() < limit) {
+    auto [field, index] = vectors[cursor->fields];
+    if (!cursor->field_cursor) {
+      AppendString(field, out);
+      AppendInt(index->SerializedSize(), out);
+      cursor->field_cursor = 0;
+    }
+    if (!index->SerializeChunk(&*cursor->field_cursor, kSerializeChunkBytes, out)) {
+      cursor->fields++;
+      cursor->field_cursor.reset();
+    }
+  }
+  return cursor->keys < keys.size() || cursor->fields < vectors.size();
 }
 
 ShardDocIndices::ShardDocIndices() : local_mr_{ServerState::tlocal()->data_heap()} {
@@ -279,6 +718,7 @@ ShardDocIndex* ShardDocIndices::GetIndex(string_view name) {
 
 void ShardDocIndices::InitIndex(const OpArgs& op_args, std::string_view name,
                                 shared_ptr<DocIndex> index_ptr) {
+  FlushSerialize();
   auto shard_index = make_unique<ShardDocIndex>(index_ptr);
   auto [it, _] = indices_.emplace(name, std::move(shard_index));
 
@@ -294,6 +734,7 @@ void ShardDocIndices::InitIndex(const OpArgs& op_args, std::string_view name,
 }
 
 bool ShardDocIndices::DropIndex(string_view name) {
+  FlushSerialize();
   auto it = indices_.find(name);
   if (it == indices_.end())
     return false;
@@ -308,8 +749,68 @@ bool ShardDocIndices::DropIndex(string_view name) {
 }
 
 void ShardDocIndices::RebuildAllIndices(const OpArgs& op_args) {
-  for (auto& [_, ptr] : indices_)
-    ptr->Rebuild(op_args, &local_mr_);
+  FlushSerialize();
+  for (auto& [name, ptr] : indices_) {
+    auto it = stashed_.find(name);
+    ptr->Rebuild(op_args, &local_mr_, it != stashed_.end() ? it->second : "");
+  }
+  stashed_.clear();
+}
+
+bool ShardDocIndices::StartSerialize(std::function<void(std::string_view)> write) {
+  if (serialization_)  // only one snapshot at a time saves index data
+    return false;
+
+  Serialization serialization{std::move(write), {}, {}};
+  for (auto& [name, ptr] : indices_) {
+    if (ptr->CanSerialize())
+      serialization.names.push_back(name);
+  }
+
+  if (serialization.names.empty())
+    return false;
+  serialization_ = std::move(serialization);
+  return true;
+}
+
+bool ShardDocIndices::SerializeStep() {
+  if (!serialization_)
+    return false;
+
+  auto& [write, names, cursor] = *serialization_;
+  string chunk;
+  AppendSerializedHeader(names.back(), &chunk);
+  if (!indices_.at(names.back())->SerializeChunk(&cursor, &chunk)) {
+    names.pop_back();
+    cursor = {};
+  }
+  write(chunk);
+
+  if (names.empty())
+    serialization_.reset();
+  return serialization_.has_value();
+}
+
+void ShardDocIndices::StopSerialize() {
+  serialization_.reset();
+}
+
+void ShardDocIndices::FlushSerialize() {
+  while (SerializeStep()) {
+  }
+}
+
+optional<ShardId> ShardDocIndices::GetSerializedShard(string_view chunk) {
+  auto header = ReadSerializedHeader(&chunk);
+  if (!header || header->shard_count != shard_set->size() ||
+      header->shard_id >= header->shard_count)
+    return nullopt;
+  return ShardId(header->shard_id);
+}
+
+void ShardDocIndices::StashSerialized(string_view chunk) {
+  if (auto header = ReadSerializedHeader(&chunk); header)
+    stashed_[header->name].append(chunk);
 }
 
 vector<string> ShardDocIndices::GetIndexNames() const {
@@ -320,7 +821,16 @@ vector<string> ShardDocIndices::GetIndexNames() const {
   return names;
 }
 
+bool ShardDocIndices::IsIndexed(string_view key, unsigned obj_type) const {
+  for (const auto& [_, index] : indices_) {
+    if (index->Matches(key, obj_type))
+      return true;
+  }
+  return false;
+}
+
 void ShardDocIndices::AddDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
+  FlushSerialize();
   for (auto& [_, index] : indices_) {
     if (index->Matches(key, pv.ObjType()))
       index->AddDoc(key, db_cntx, pv);
@@ -328,6 +838,7 @@ void ShardDocIndices::AddDoc(string_view key, const DbContext& db_cntx, const Pr
 }
 
 void ShardDocIndices::RemoveDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
+  FlushSerialize();
   for (auto& [_, index] : indices_) {
     if (index->Matches(key, pv.ObjType()))
       index->RemoveDoc(key, db_cntx, pv);
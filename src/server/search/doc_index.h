@@ -5,7 +5,9 @@
 #pragma once
 
 #include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
@@ -16,7 +18,10 @@
 #include "core/mi_memory_resource.h"
 #include "core/search/search.h"
 #include "server/common.h"
+#include "server/search/aggregator.h"
 #include "server/table.h"
+#include "server/tx_base.h"
+#include "util/fibers/fibers.h"
 
 namespace dfly {
 
@@ -66,6 +71,9 @@ struct SearchParams {
   std::optional<search::SortOption> sort_option;
   search::QueryParams query_params;
 
+  bool with_scores = false;  // WITHSCORES: reply with score after every key
+  bool ranked = false;       // SCORER or SORTBY __score: order text results by relevance
+
   bool IdsOnly() const {
     return return_fields && return_fields->empty();
   }
@@ -92,11 +100,15 @@ struct DocIndexInfo {
   DocIndex base_index;
   size_t num_docs = 0;
 
+  bool indexing = false;          // whether existing documents are still being indexed
+  double percent_indexed = 1.0;  // approximate progress of indexing
+
   // Build original ft.create command that can be used to re-create this index
   std::string BuildRestoreCommand() const;
 };
 
 class ShardDocIndices;
+struct BaseAccessor;
 
 // Stores internal search indices for documents of a document index on a specific shard.
 class ShardDocIndex {
@@ -107,6 +119,12 @@ class ShardDocIndex {
   struct DocKeyIndex {
     DocId Add(std::string_view key);
     DocId Remove(std::string_view key);
+    bool Contains(std::string_view key) const;
+    std::optional<DocId> Find(std::string_view key) const;
+
+    // Restore mapping from keys of all ids, with empty keys for free ids. False on duplicate keys
+    bool Assign(std::vector<std::string> keys);
+    const std::vector<std::string>& Keys() const;
 
     std::string_view Get(DocId id) const;
     size_t Size() const;
@@ -121,14 +139,23 @@ class ShardDocIndex {
  public:
   // Index must be rebuilt at least once after intialization
   ShardDocIndex(std::shared_ptr<DocIndex> index);
+  ~ShardDocIndex();
 
   // Perform search on all indexed documents and return results.
   SearchResult Search(const OpArgs& op_args, const SearchParams& params,
                       search::SearchAlgorithm* search_algo) const;
 
   // Perform search and load requested values - note params might be interpreted differently.
-  std::vector<absl::flat_hash_map<std::string, search::SortableValue>> SearchForAggregator(
-      const OpArgs& op_args, ArgSlice load_fields, search::SearchAlgorithm* search_algo) const;
+  // If sort is set, only its first limit values are returned in sorted order.
+  std::vector<aggregate::DocValues> SearchForAggregator(const OpArgs& op_args, ArgSlice load_fields,
+                                                        const aggregate::SortParams* sort,
+                                                        search::SearchAlgorithm* search_algo) const;
+
+  // Perform search and group all matched documents, the first step of the aggregation pipeline.
+  // Only group and reducer fields are extracted in columnar batches.
+  aggregate::PartialGroups SearchForAggregatorGroups(const OpArgs& op_args, ArgSlice load_fields,
+                                                     const aggregate::GroupParams& group,
+                                                     search::SearchAlgorithm* search_algo) const;
 
   // Return whether base index matches
   bool Matches(std::string_view key, unsigned obj_code) const;
@@ -138,14 +165,84 @@ class ShardDocIndex {
 
   DocIndexInfo GetInfo() const;
 
+  // Position of chunked serialization, see SerializeChunk()
+  struct SerializeCursor {
+    bool started = false;
+    size_t keys = 0;                     // number of written keys
+    size_t fields = 0;                   // number of written vector indices
+    std::optional<size_t> field_cursor;  // cursor of vector index being written
+  };
+
+  // Whether document ids and vector indices can be serialized for snapshots, see
+  // ShardDocIndices::StartSerialize. False if index has no vector fields or is still being built
+  bool CanSerialize() const;
+
+  // Append next chunk of serialized data to out. Returns false once all data was written
+  bool SerializeChunk(SerializeCursor* cursor, std::string* out);
+
  private:
+  // Progress of traversing existing documents
+  struct RebuildState {
+    DbContext db_cntx;
+    PrimeTable::Cursor cursor;
+    size_t traversed = 0, total = 0;  // number of keys
+    bool cancelled = false;
+
+    // Documents with restored vectors that are not yet added to other indices
+    absl::flat_hash_set<DocId> restored;
+
+    // Keys of offloaded documents, that are loaded and indexed once traversal is finished
+    std::vector<std::string> offloaded;
+  };
+
   // Clears internal data. Traverses all matching documents and assigns ids.
-  void Rebuild(const OpArgs& op_args, PMR_NS::memory_resource* mr);
+  // If snapshot data is given and valid, ids and vector indices are restored from it, so that
+  // only other indices are built during traversal.
+  // The first step runs inline, so that small datasets are indexed right away. Following steps
+  // run in a fiber that yields in between, so that the shard keeps serving traffic.
+  void Rebuild(const OpArgs& op_args, PMR_NS::memory_resource* mr,
+               std::string_view snapshot_data = {});
+
+  // Restore ids and vector indices from concatenated chunks of SerializeChunk(). Return restored
+  // ids
+  std::optional<absl::flat_hash_set<DocId>> Restore(std::string_view data);
+
+  // Drop restored documents that were not traversed and reset rebuild state
+  void FinishRebuild();
+
+  // Add or remove values of stored fields of a document
+  void StoreFields(DocId id, const BaseAccessor& accessor);
+  void RemoveStoredFields(DocId id);
+
+  // Serialize selected fields of a document. Stored fields are taken from their columns
+  SearchDocData SerializeFields(DocId id, const DbContext& db_cntx, const PrimeValue& pv,
+                                const SearchParams::FieldReturnList& fields) const;
+
+  // Index documents of next buckets, inserting HNSW vectors with num_threads worker threads if
+  // it's not zero. Return false once traversal is finished.
+  bool RebuildStep(EngineShard* shard, unsigned num_threads);
+
+  // Index traversed document, unless it was indexed already. Vectors are added to deferred if set
+  void RebuildDoc(std::string_view key, const PrimeValue& pv,
+                  search::FieldIndices::DeferredVectors* deferred);
+
+  // Load offloaded documents skipped by traversal back to memory and index them. Blocks
+  void RebuildOffloaded(EngineShard* shard);
+
+  // Stop running rebuild, if any
+  void CancelRebuild();
 
  private:
   std::shared_ptr<const DocIndex> base_;
   search::FieldIndices indices_;
   DocKeyIndex key_index_;
+
+  // Serialized values of SORTABLE fields of JSON documents by field identifier, indexed by id.
+  // Returned from them instead of evaluating paths on documents, if enabled
+  absl::flat_hash_map<std::string, std::vector<std::string>> stored_fields_;
+
+  std::optional<RebuildState> rebuild_;  // set while rebuild is running
+  util::fb2::Fiber rebuild_fb_;
 };
 
 // Stores shard doc indices by name on a specific shard.
@@ -163,11 +260,32 @@ class ShardDocIndices {
   // Drop index, return true if it existed and was dropped
   bool DropIndex(std::string_view name);
 
-  // Rebuild all indices
+  // Rebuild all indices. Indices with stashed snapshot data are restored from it
   void RebuildAllIndices(const OpArgs& op_args);
 
+  // Start serializing state of indices with vector fields, so that they can be restored after
+  // loading a snapshot with the same number of shards instead of inserting all vectors again.
+  // Chunks are passed to write by SerializeStep(). All remaining chunks are written before any
+  // index changes, so data matches the point in time of this call. False if there's nothing to do
+  bool StartSerialize(std::function<void(std::string_view)> write);
+
+  // Write next chunk of serialized data. Returns false once all data was written
+  bool SerializeStep();
+
+  // Stop serialization without writing the remaining data
+  void StopSerialize();
+
+  // Shard that serialized chunk belongs to, if it was saved with the current number of shards
+  static std::optional<ShardId> GetSerializedShard(std::string_view chunk);
+
+  // Keep serialized chunk to restore index on next rebuild. Index might not exist yet
+  void StashSerialized(std::string_view chunk);
+
   std::vector<std::string> GetIndexNames() const;
 
+  // Returns true if any index matches key with value of obj_type
+  bool IsIndexed(std::string_view key, unsigned obj_type) const;
+
   void AddDoc(std::string_view key, const DbContext& db_cnt, const PrimeValue& pv);
   void RemoveDoc(std::string_view key, const DbContext& db_cnt, const PrimeValue& pv);
 
@@ -175,8 +293,19 @@ class ShardDocIndices {
   SearchStats GetStats() const;  // combines stats for all indices
 
  private:
+  // Write all remaining serialized data, called before indices change
+  void FlushSerialize();
+
+  struct Serialization {
+    std::function<void(std::string_view)> write;
+    std::vector<std::string> names;  // indices left to serialize, the current one is last
+    ShardDocIndex::SerializeCursor cursor;
+  };
+
   MiMemoryResource local_mr_;
   absl::flat_hash_map<std::string, std::unique_ptr<ShardDocIndex>> indices_;
+  absl::flat_hash_map<std::string, std::string> stashed_;  // serialized data by index name
+  std::optional<Serialization> serialization_;             // set while serializing
 };
 
 }  // namespace dfly
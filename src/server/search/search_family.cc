@@ -38,6 +38,9 @@ namespace {
 
 static const set<string_view> kIgnoredOptions = {"WEIGHT", "SEPARATOR"};
 
+// Pseudo field for sorting by relevance score
+constexpr string_view kScoreField = "__score";
+
 bool IsValidJsonPath(string_view path) {
   error_code ec;
   MakeJsonPathExpr(path, ec);
@@ -60,7 +63,8 @@ search::SchemaField::VectorParams ParseVectorParams(CmdArgParser* parser) {
 
     if (parser->Check("DISTANCE_METRIC").ExpectTail(1)) {
       params.sim = parser->ToUpper().Switch("L2", search::VectorSimilarity::L2, "COSINE",
-                                            search::VectorSimilarity::COSINE);
+                                            search::VectorSimilarity::COSINE, "IP",
+                                            search::VectorSimilarity::IP);
       continue;
     }
 
@@ -79,6 +83,18 @@ search::SchemaField::VectorParams ParseVectorParams(CmdArgParser* parser) {
       continue;
     }
 
+    if (parser->Check("QUANTIZATION").ExpectTail(1)) {
+      params.quantization = parser->ToUpper().Switch(
+          "NONE", search::VectorQuantization::NONE, "FP16", search::VectorQuantization::FP16,
+          "INT8", search::VectorQuantization::INT8);
+      continue;
+    }
+
+    if (parser->Check("RERANK").ExpectTail(1)) {
+      params.rerank_factor = parser->Next<size_t>();
+      continue;
+    }
+
     if (parser->Check("EF_RUNTIME").ExpectTail(1)) {
       parser->Next<size_t>();
       LOG(WARNING) << "EF_RUNTIME not supported";
@@ -256,9 +272,27 @@ optional<SearchParams> ParseSearchParamsOrReply(CmdArgParser parser, ConnectionC
       continue;
     }
 
+    if (parser.Check("WITHSCORES")) {
+      params.with_scores = true;
+      continue;
+    }
+
+    // [SCORER name]: all scorers rank text queries with BM25
+    if (parser.Check("SCORER").ExpectTail(1)) {
+      parser.Skip(1);
+      params.ranked = true;
+      continue;
+    }
+
     if (parser.Check("SORTBY").ExpectTail(1)) {
-      params.sort_option =
-          search::SortOption{string{parser.Next()}, bool(parser.Check("DESC").IgnoreCase())};
+      string field{parser.Next()};
+      bool desc = bool(parser.Check("DESC").IgnoreCase());
+
+      // Sorting by relevance ranks results, always in descending order
+      if (absl::EqualsIgnoreCase(field, kScoreField))
+        params.ranked = true;
+      else
+        params.sort_option = search::SortOption{std::move(field), desc};
       continue;
     }
 
@@ -280,6 +314,16 @@ struct AggregateParams {
 
   vector<string_view> load_fields;
   vector<aggregate::PipelineStep> steps;
+
+  // Leading SORTBY (and LIMIT) of the pipeline, applied by shards and merged instead of a step
+  optional<aggregate::SortParams> sort;
+
+  // Leading GROUPBY of the pipeline, reduced partially by shards and merged instead of a step
+  optional<aggregate::GroupParams> group;
+
+  bool PipelineEmpty() const {
+    return steps.empty() && !sort && !group;
+  }
 };
 
 optional<AggregateParams> ParseAggregatorParamsOrReply(CmdArgParser parser,
@@ -302,7 +346,7 @@ optional<AggregateParams> ParseAggregatorParamsOrReply(CmdArgParser parser,
       for (string_view& field : fields)
         field = parser.Next();
 
-      vector<aggregate::Reducer> reducers;
+      aggregate::GroupParams group{vector<string>(fields.begin(), fields.end()), {}};
       while (parser.ToUpper().Check("REDUCE").ExpectTail(2)) {
         parser.ToUpper();  // uppercase for func_name
         auto [func_name, nargs] = parser.Next<string_view, size_t>();
@@ -321,10 +365,13 @@ optional<AggregateParams> ParseAggregatorParamsOrReply(CmdArgParser parser,
         parser.ExpectTag("AS");
         string result_field = parser.Next<string>();
 
-        reducers.push_back(aggregate::Reducer{source_field, result_field, std::move(func)});
+        group.reducers.push_back(aggregate::Reducer{source_field, result_field, func});
       }
 
-      params.steps.push_back(aggregate::MakeGroupStep(fields, std::move(reducers)));
+      if (params.PipelineEmpty())
+        params.group = std::move(group);
+      else
+        params.steps.push_back(aggregate::MakeGroupStep(std::move(group)));
       continue;
     }
 
@@ -334,13 +381,20 @@ optional<AggregateParams> ParseAggregatorParamsOrReply(CmdArgParser parser,
       string_view field = parser.Next();
       bool desc = bool(parser.Check("DESC").IgnoreCase());
 
-      params.steps.push_back(aggregate::MakeSortStep(field, desc));
+      if (params.PipelineEmpty())
+        params.sort = aggregate::SortParams{string{field}, desc};
+      else
+        params.steps.push_back(aggregate::MakeSortStep(field, desc));
       continue;
     }
 
     // LIMIT
     if (parser.Check("LIMIT").ExpectTail(2)) {
       auto [offset, num] = parser.Next<size_t, size_t>();
+      // Shards need to return only the first offset + num values if nothing preceded the sort
+      if (params.steps.empty() && params.sort &&
+          params.sort->limit == numeric_limits<size_t>::max())
+        params.sort->limit = offset + num;
       params.steps.push_back(aggregate::MakeLimitStep(offset, num));
       continue;
     }
@@ -363,9 +417,19 @@ optional<AggregateParams> ParseAggregatorParamsOrReply(CmdArgParser parser,
   return params;
 }
 
-void SendSerializedDoc(const SerializedSearchDoc& doc, ConnectionContext* cntx) {
+// Send relevance score of document for WITHSCORES. Only ranked text queries and knn queries have
+// float scores, all others score zero
+void SendScore(const SerializedSearchDoc& doc, ConnectionContext* cntx) {
+  auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
+  float score = holds_alternative<float>(doc.score) ? get<float>(doc.score) : 0.0f;
+  rb->SendBulkString(absl::StrCat(score));
+}
+
+void SendSerializedDoc(const SerializedSearchDoc& doc, bool with_score, ConnectionContext* cntx) {
   auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
   rb->SendBulkString(doc.key);
+  if (with_score)
+    SendScore(doc, cntx);
   rb->StartCollection(doc.values.size(), RedisReplyBuilder::MAP);
   for (const auto& [k, v] : doc.values) {
     rb->SendBulkString(k);
@@ -373,6 +437,11 @@ void SendSerializedDoc(const SerializedSearchDoc& doc, ConnectionContext* cntx)
   }
 }
 
+// Number of reply entries per document
+size_t DocReplySize(const SearchParams& params) {
+  return (params.IdsOnly() ? 1 : 2) + (params.with_scores ? 1 : 0);
+}
+
 void ReplyWithResults(const SearchParams& params, absl::Span<SearchResult> results,
                       ConnectionContext* cntx) {
   size_t total_count = 0;
@@ -385,7 +454,7 @@ void ReplyWithResults(const SearchParams& params, absl::Span<SearchResult> resul
   facade::SinkReplyBuilder::ReplyAggregator agg{cntx->reply_builder()};
 
   bool ids_only = params.IdsOnly();
-  size_t reply_size = ids_only ? (result_count + 1) : (result_count * 2 + 1);
+  size_t reply_size = result_count * DocReplySize(params) + 1;
 
   auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
   rb->StartArray(reply_size);
@@ -395,7 +464,7 @@ void ReplyWithResults(const SearchParams& params, absl::Span<SearchResult> resul
   size_t to_skip = params.limit_offset;
   for (const auto& shard_docs : results) {
     for (const auto& serialized_doc : shard_docs.docs) {
-      // Scoring is not implemented yet, so we just cut them in the order they were retrieved
+      // Unranked results are cut in the order they were retrieved
       if (to_skip > 0) {
         to_skip--;
         continue;
@@ -404,39 +473,45 @@ void ReplyWithResults(const SearchParams& params, absl::Span<SearchResult> resul
       if (sent++ >= result_count)
         return;
 
-      if (ids_only)
+      if (ids_only) {
         rb->SendBulkString(serialized_doc.key);
-      else
-        SendSerializedDoc(serialized_doc, cntx);
+        if (params.with_scores)
+          SendScore(serialized_doc, cntx);
+      } else {
+        SendSerializedDoc(serialized_doc, params.with_scores, cntx);
+      }
     }
   }
 }
 
+// Shards return only their first offset + limit documents in aggregation order, so the reply is
+// built from a k-way merge of them
 void ReplySorted(search::AggregationInfo agg, const SearchParams& params,
                  absl::Span<SearchResult> results, ConnectionContext* cntx) {
+  auto less = [desc = agg.descending](const SerializedSearchDoc& l, const SerializedSearchDoc& r) {
+    return desc ? r < l : l < r;
+  };
+
   size_t total = 0;
-  vector<SerializedSearchDoc*> docs;
+  vector<absl::Span<SerializedSearchDoc>> sorted;
   for (auto& shard_results : results) {
     total += shard_results.total_hits;
-    for (auto& doc : shard_results.docs) {
-      docs.push_back(&doc);
-    }
+
+    // Shard order can differ from aggregation order, i.e. for KNN results sorted in reverse
+    auto& docs = shard_results.docs;
+    if (!is_sorted(docs.begin(), docs.end(), less))
+      sort(docs.begin(), docs.end(), less);
+    sorted.emplace_back(absl::MakeSpan(docs));
   }
 
   size_t agg_limit = agg.limit.value_or(total);
   size_t prefix = min(params.limit_offset + params.limit_total, agg_limit);
-
-  partial_sort(docs.begin(), docs.begin() + min(docs.size(), prefix), docs.end(),
-               [desc = agg.descending](const auto* l, const auto* r) {
-                 return desc ? (*l >= *r) : (*l < *r);
-               });
-
-  docs.resize(min(docs.size(), agg_limit));
+  auto docs = aggregate::MergeSorted<SerializedSearchDoc>(sorted, prefix, less);
 
   size_t start_idx = min(params.limit_offset, docs.size());
   size_t result_count = min(docs.size() - start_idx, params.limit_total);
   bool ids_only = params.IdsOnly();
-  size_t reply_size = ids_only ? (result_count + 1) : (result_count * 2 + 1);
+  size_t reply_size = result_count * DocReplySize(params) + 1;
 
   // Clear score alias if it's excluded from return values
   if (!params.ShouldReturnField(agg.alias))
@@ -449,13 +524,15 @@ void ReplySorted(search::AggregationInfo agg, const SearchParams& params,
   for (auto* doc : absl::MakeSpan(docs).subspan(start_idx, result_count)) {
     if (ids_only) {
       rb->SendBulkString(doc->key);
+      if (params.with_scores)
+        SendScore(*doc, cntx);
       continue;
     }
 
     if (!agg.alias.empty() && holds_alternative<float>(doc->score))
       doc->values[agg.alias] = absl::StrCat(get<float>(doc->score));
 
-    SendSerializedDoc(*doc, cntx);
+    SendSerializedDoc(*doc, params.with_scores, cntx);
   }
 }
 
@@ -620,14 +697,20 @@ void SearchFamily::FtInfo(CmdArgList args, ConnectionContext* cntx) {
          infos.back().base_index.schema.fields.size());
 
   size_t total_num_docs = 0;
-  for (const auto& info : infos)
+  bool indexing = false;
+  double percent_indexed = 0;
+  for (const auto& info : infos) {
     total_num_docs += info.num_docs;
+    indexing |= info.indexing;
+    percent_indexed += info.percent_indexed;
+  }
+  percent_indexed /= infos.size();
 
   const auto& info = infos.front();
   const auto& schema = info.base_index.schema;
 
   auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
-  rb->StartCollection(4, RedisReplyBuilder::MAP);
+  rb->StartCollection(6, RedisReplyBuilder::MAP);
 
   rb->SendSimpleString("index_name");
   rb->SendSimpleString(idx_name);
@@ -662,6 +745,12 @@ void SearchFamily::FtInfo(CmdArgList args, ConnectionContext* cntx) {
 
   rb->SendSimpleString("num_docs");
   rb->SendLong(total_num_docs);
+
+  rb->SendSimpleString("indexing");
+  rb->SendLong(indexing);
+
+  rb->SendSimpleString("percent_indexed");
+  rb->SendDouble(percent_indexed);
 }
 
 void SearchFamily::FtList(CmdArgList args, ConnectionContext* cntx) {
@@ -691,6 +780,10 @@ void SearchFamily::FtSearch(CmdArgList args, ConnectionContext* cntx) {
   if (!search_algo.Init(query_str, &params->query_params, sort_opt))
     return cntx->SendError("Query syntax error");
 
+  // Ranking is opt-in, as it scores every matched document instead of stopping at the limit
+  if (params->ranked || params->with_scores)
+    search_algo.EnableScoring();
+
   // Because our coordinator thread may not have a shard, we can't check ahead if the index exists.
   atomic<bool> index_not_found{false};
   vector<SearchResult> docs(shard_set->size());
@@ -807,22 +900,37 @@ void SearchFamily::FtAggregate(CmdArgList args, ConnectionContext* cntx) {
   if (!search_algo.Init(params->query, &params->params, nullptr))
     return cntx->SendError("Query syntax error");
 
-  using ResultContainer =
-      decltype(declval<ShardDocIndex>().SearchForAggregator(declval<OpArgs>(), {}, &search_algo));
-
-  vector<ResultContainer> query_results(shard_set->size());
+  vector<vector<aggregate::DocValues>> query_results(shard_set->size());
+  vector<aggregate::PartialGroups> group_results(params->group ? shard_set->size() : 0);
   cntx->transaction->ScheduleSingleHop([&](Transaction* t, EngineShard* es) {
-    if (auto* index = es->search_indices()->GetIndex(params->index); index) {
-      query_results[es->shard_id()] =
-          index->SearchForAggregator(t->GetOpArgs(es), params->load_fields, &search_algo);
+    auto* index = es->search_indices()->GetIndex(params->index);
+    if (!index)
+      return OpStatus::OK;
+
+    if (params->group) {
+      group_results[es->shard_id()] = index->SearchForAggregatorGroups(
+          t->GetOpArgs(es), params->load_fields, *params->group, &search_algo);
+    } else {
+      query_results[es->shard_id()] = index->SearchForAggregator(
+          t->GetOpArgs(es), params->load_fields, params->sort ? &*params->sort : nullptr,
+          &search_algo);
     }
     return OpStatus::OK;
   });
 
   vector<aggregate::DocValues> values;
-  for (auto& sub_results : query_results) {
-    values.insert(values.end(), make_move_iterator(sub_results.begin()),
-                  make_move_iterator(sub_results.end()));
+  if (params->group) {
+    aggregate::PartialGroups groups;
+    for (auto& shard_groups : group_results)
+      aggregate::MergeGroups(*params->group, std::move(shard_groups), &groups);
+    values = aggregate::FinalizeGroups(*params->group, std::move(groups));
+  } else if (params->sort) {
+    values = aggregate::MergeSortedValues(*params->sort, std::move(query_results));
+  } else {
+    for (auto& sub_results : query_results) {
+      values.insert(values.end(), make_move_iterator(sub_results.begin()),
+                    make_move_iterator(sub_results.end()));
+    }
   }
 
   auto agg_results = aggregate::Process(std::move(values), params->steps);
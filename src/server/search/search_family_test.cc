@@ -4,12 +4,17 @@
 
 #include "server/search/search_family.h"
 
+#include <absl/strings/numbers.h>
+
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "facade/facade_test.h"
 #include "server/command_registry.h"
 #include "server/test_utils.h"
 
+ABSL_DECLARE_FLAG(uint32_t, search_index_build_threads);
+ABSL_DECLARE_FLAG(bool, search_json_stored_fields);
+
 using namespace testing;
 using namespace std;
 using namespace util;
@@ -119,7 +124,7 @@ TEST_F(SearchFamilyTest, InfoIndex) {
   EXPECT_THAT(info,
               IsArray(_, _, _, IsArray("key_type", "HASH", "prefix", "doc-"), "attributes",
                       IsArray(IsArray("identifier", "name", "attribute", "name", "type", "TEXT")),
-                      "num_docs", IntArg(15)));
+                      "num_docs", IntArg(15), "indexing", IntArg(0), "percent_indexed", "1"));
 }
 
 TEST_F(SearchFamilyTest, Stats) {
@@ -302,6 +307,33 @@ TEST_F(SearchFamilyTest, JsonArrayValues) {
 }
 #endif
 
+TEST_F(SearchFamilyTest, JsonStoredFields) {
+  absl::FlagSaver saver;
+  absl::SetFlag(&FLAGS_search_json_stored_fields, true);
+
+  Run({"json.set", "k1", ".", R"({"name": "alex", "score": 10, "tags": ["a", "b"]})"});
+  Run({"json.set", "k2", ".", R"({"name": "bob", "tags": ["c"]})"});
+
+  auto resp = Run({"ft.create", "i1", "on", "json", "schema", "$.name", "as", "name", "text",
+                   "sortable", "$.score", "as", "score", "numeric", "sortable", "$.tags[*]",
+                   "as", "tags", "tag"});
+  EXPECT_EQ(resp, "OK");
+
+  // Stored and evaluated fields are returned in the same format
+  resp = Run({"ft.search", "i1", "@name:alex", "return", "3", "$.name", "$.score", "$.tags"});
+  EXPECT_THAT(resp.GetVec()[2], RespArray(UnorderedElementsAre("$.name", "\"alex\"", "$.score",
+                                                               "10", "$.tags", "[\"a\",\"b\"]")));
+
+  // Missing values are omitted
+  resp = Run({"ft.search", "i1", "@name:bob", "return", "2", "$.name", "$.score", "as", "s"});
+  EXPECT_THAT(resp.GetVec()[2], RespArray(ElementsAre("$.name", "\"bob\"")));
+
+  // Updates are reflected
+  Run({"json.set", "k2", ".", R"({"name": "bob", "score": 7})"});
+  resp = Run({"ft.search", "i1", "@name:bob", "return", "1", "$.score", "as", "s"});
+  EXPECT_THAT(resp.GetVec()[2], RespArray(ElementsAre("s", "7")));
+}
+
 TEST_F(SearchFamilyTest, Tags) {
   Run({"hset", "d:1", "color", "red, green"});
   Run({"hset", "d:2", "color", "green, blue"});
@@ -408,6 +440,46 @@ TEST_F(SearchFamilyTest, TestLimit) {
   EXPECT_THAT(resp, ArrLen(3 * 2 + 1));
 }
 
+TEST_F(SearchFamilyTest, WithScores) {
+  for (unsigned i = 0; i < 10; i++)
+    Run({"hset", absl::StrCat("d:", i), "text", "apple pie"});
+  Run({"hset", "d:10", "text", "apple apple apple"});
+  Run({"hset", "d:11", "text", "pear"});
+  Run({"ft.create", "i1", "SCHEMA", "text", "text"});
+
+  // Ranked by descending relevance, score follows every key
+  auto resp = Run({"ft.search", "i1", "apple", "NOCONTENT", "WITHSCORES", "LIMIT", "0", "5"});
+  ASSERT_THAT(resp, ArrLen(5 * 2 + 1));
+  auto vec = resp.GetVec();
+  EXPECT_THAT(vec[0], IntArg(11));
+
+  double prev_score = numeric_limits<double>::max();
+  for (size_t i = 1; i < vec.size(); i += 2) {
+    double score = 0;
+    ASSERT_TRUE(absl::SimpleAtod(vec[i + 1].GetString(), &score));
+    EXPECT_GT(score, 0);
+    EXPECT_LE(score, prev_score);
+    prev_score = score;
+  }
+
+  // Ranking is requested with SCORER or by sorting by score as well
+  resp = Run({"ft.search", "i1", "apple", "NOCONTENT", "SCORER", "BM25", "LIMIT", "0", "1"});
+  EXPECT_THAT(resp, IsArray(IntArg(11), "d:10"));
+  resp = Run({"ft.search", "i1", "apple", "NOCONTENT", "SORTBY", "__score", "LIMIT", "0", "1"});
+  EXPECT_THAT(resp, IsArray(IntArg(11), "d:10"));
+
+  // Documents are returned with their fields after the score
+  resp = Run({"ft.search", "i1", "pear", "WITHSCORES"});
+  ASSERT_THAT(resp, ArrLen(4));
+  EXPECT_EQ(resp.GetVec()[1], "d:11");
+  EXPECT_THAT(resp.GetVec()[3], IsArray("text", "pear"));
+
+  // Queries without text terms are not ranked and score zero
+  resp = Run({"ft.search", "i1", "*", "NOCONTENT", "WITHSCORES", "LIMIT", "0", "1"});
+  ASSERT_THAT(resp, ArrLen(3));
+  EXPECT_EQ(resp.GetVec()[2], "0");
+}
+
 TEST_F(SearchFamilyTest, TestReturn) {
   auto floatsv = [](const float* f) -> string_view {
     return {reinterpret_cast<const char*>(f), sizeof(float)};
@@ -685,10 +757,74 @@ TEST_F(SearchFamilyTest, AggregateLoadGroupBy) {
                                  IsUnordArray(IsArray("even", "true"))));
 }
 
+TEST_F(SearchFamilyTest, AggregateSortLimit) {
+  for (size_t i = 0; i < 100; i++)
+    Run({"hset", absl::StrCat("k", i), "value", absl::StrCat(i)});
+  Run({"ft.create", "i1", "schema", "value", "numeric", "sortable"});
+
+  // Every shard returns only its first 13 values, they're merged on the coordinator
+  auto resp = Run({"ft.aggregate", "i1", "*", "SORTBY", "1", "value", "DESC", "LIMIT", "10", "3"});
+  EXPECT_THAT(resp, IsArray(IsArray(IsArray("value", "89")), IsArray(IsArray("value", "88")),
+                            IsArray(IsArray("value", "87"))));
+
+  resp = Run({"ft.aggregate", "i1", "*", "SORTBY", "1", "value", "LIMIT", "0", "2"});
+  EXPECT_THAT(resp, IsArray(IsArray(IsArray("value", "0")), IsArray(IsArray("value", "1"))));
+}
+
 TEST_F(SearchFamilyTest, Vector) {
   auto resp = Run({"ft.create", "ann", "ON", "HASH", "SCHEMA", "vector", "VECTOR", "HNSW", "8",
                    "TYPE", "FLOAT32", "DIM", "100", "distance_metric", "cosine", "M", "64"});
   EXPECT_EQ(resp, "OK");
 }
 
+TEST_F(SearchFamilyTest, RebuildInBackground) {
+  absl::FlagSaver saver;
+  absl::SetFlag(&FLAGS_search_index_build_threads, 2);
+
+  // Enough documents for indexing to continue after FT.CREATE returns
+  const size_t kNumDocs = 5000;
+  for (size_t i = 0; i < kNumDocs; i++) {
+    float coords[2] = {float(i), 0.0f};
+    Run({"hset", absl::StrCat("k", i), "vector", string_view{(char*)coords, sizeof(coords)}});
+  }
+
+  auto resp = Run({"ft.create", "ann", "ON", "HASH", "SCHEMA", "vector", "VECTOR", "HNSW", "4",
+                   "DIM", "2", "distance_metric", "l2"});
+  EXPECT_EQ(resp, "OK");
+
+  // Updates and deletions while indexing must not break it
+  Run({"del", "k1"});
+  float coords[2] = {-1.0f, 0.0f};
+  Run({"hset", "k2", "vector", string_view{(char*)coords, sizeof(coords)}});
+
+  ExpectConditionWithinTimeout([this] {
+    auto info = Run({"ft.info", "ann"}).GetVec();
+    return info[10].GetString() == "indexing" && info[11].GetInt() == 0;
+  });
+
+  auto info = Run({"ft.info", "ann"}).GetVec();
+  EXPECT_THAT(info[9], IntArg(kNumDocs - 1));
+
+  float query[2] = {-1.0f, 0.0f};
+  resp = Run({"ft.search", "ann", "*=>[KNN 2 @vector $vec]", "PARAMS", "2", "vec",
+              string_view{(char*)query, sizeof(query)}});
+  EXPECT_THAT(resp, AreDocIds("k2", "k0"));
+}
+
+TEST_F(SearchFamilyTest, QuantizedVector) {
+  auto resp = Run({"ft.create", "ann", "ON", "HASH", "SCHEMA", "vector", "VECTOR", "FLAT", "8",
+                   "DIM", "2", "QUANTIZATION", "int8", "RERANK", "4", "distance_metric", "l2"});
+  EXPECT_EQ(resp, "OK");
+
+  for (unsigned i = 0; i < 10; i++) {
+    float coords[2] = {float(i), 0.0f};
+    Run({"hset", absl::StrCat("k", i), "vector", string_view{(char*)coords, sizeof(coords)}});
+  }
+
+  float query[2] = {3.9f, 0.0f};
+  resp = Run({"ft.search", "ann", "*=>[KNN 2 @vector $vec]", "PARAMS", "2", "vec",
+              string_view{(char*)query, sizeof(query)}});
+  EXPECT_THAT(resp, AreDocIds("k4", "k3"));
+}
+
 }  // namespace dfly
@@ -2176,11 +2176,18 @@ void ServerFamily::Info(CmdArgList args, ConnectionContext* cntx) {
     append("tiered_total_cancels", m.tiered_stats.total_cancels);
     append("tiered_total_deletes", m.tiered_stats.total_deletes);
     append("tiered_total_stash_overflows", m.tiered_stats.total_stash_overflows);
+    append("tiered_total_relocations", m.tiered_stats.total_relocations);
+    append("tiered_total_hits", m.tiered_stats.total_hits);
+    append("tiered_total_misses", m.tiered_stats.total_misses);
+    append("tiered_total_promotes", m.tiered_stats.total_promotes);
+    append("tiered_total_hot_skips", m.tiered_stats.total_hot_skips);
     append("tiered_heap_buf_allocations", m.tiered_stats.total_heap_buf_allocs);
     append("tiered_registered_buf_allocations", m.tiered_stats.total_registered_buf_allocs);
+    append("tiered_total_disk_reads", m.tiered_stats.total_disk_reads);
 
     append("tiered_allocated_bytes", m.tiered_stats.allocated_bytes);
     append("tiered_capacity_bytes", m.tiered_stats.capacity_bytes);
+    append("tiered_reclaimed_bytes", m.tiered_stats.reclaimed_bytes);
 
     append("tiered_pending_read_cnt", m.tiered_stats.pending_read_cnt);
     append("tiered_pending_stash_cnt", m.tiered_stats.pending_stash_cnt);
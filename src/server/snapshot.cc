@@ -15,7 +15,13 @@
 #include "server/journal/journal.h"
 #include "server/rdb_extensions.h"
 #include "server/rdb_save.h"
+#include "server/search/doc_index.h"
 #include "server/tiered_storage.h"
+#include "server/tiering/value_codec.h"
+
+extern "C" {
+#include "redis/rdb.h"
+}
 
 namespace dfly {
 
@@ -25,6 +31,15 @@ using namespace chrono_literals;
 
 namespace {
 thread_local absl::flat_hash_set<SliceSnapshot*> tl_slice_snapshots;
+
+// Number of buckets traversed at once. Reads of their offloaded values are submitted together,
+// so reads of adjacent pages can be merged
+constexpr unsigned kReadAheadBuckets = 16;
+
+// Limits for offloaded values that are read ahead of serialization
+constexpr size_t kMaxDelayedEntries = 512;
+constexpr size_t kMaxDelayedBytes = 32u << 20;
+
 }  // namespace
 
 size_t SliceSnapshot::DbRecord::size() const {
@@ -53,7 +68,7 @@ bool SliceSnapshot::IsSnaphotInProgress() {
   return tl_slice_snapshots.size() > 0;
 }
 
-void SliceSnapshot::Start(bool stream_journal, const Cancellation* cll) {
+void SliceSnapshot::Start(bool stream_journal, const Cancellation* cll, bool save_search_indices) {
   DCHECK(!snapshot_fb_.IsJoinable());
 
   auto db_cb = absl::bind_front(&SliceSnapshot::OnDbChange, this);
@@ -68,11 +83,25 @@ void SliceSnapshot::Start(bool stream_journal, const Cancellation* cll) {
 
   serializer_ = std::make_unique<RdbSerializer>(compression_mode_);
 
+  // Index data is captured at the same point as the entries. Chunks are written by the snapshot
+  // fiber, or all at once by the first index mutation that happens before it is done.
+  if (save_search_indices) {
+    auto write = [this](string_view chunk) {
+      CHECK(!serializer_->WriteOpcode(RDB_OPCODE_AUX));
+      CHECK(!serializer_->SaveString("search-index-data"));
+      CHECK(!serializer_->SaveString(chunk));
+    };
+    serializing_indices_ =
+        db_slice_->shard_owner()->search_indices()->StartSerialize(std::move(write));
+  }
+
   VLOG(1) << "DbSaver::Start - saving entries with version less than " << snapshot_version_;
 
   snapshot_fb_ = fb2::Fiber("snapshot", [this, stream_journal, cll] {
     IterateBucketsFb(cll, stream_journal);
     db_slice_->UnregisterOnChange(snapshot_version_);
+    if (serializing_indices_)
+      db_slice_->shard_owner()->search_indices()->StopSerialize();
     if (cll->IsCancelled()) {
       Cancel();
     } else if (!stream_journal) {
@@ -186,6 +215,14 @@ void SliceSnapshot::IterateBucketsFb(const Cancellation* cll, bool send_full_syn
     stats_.keys_total += db_slice_->DbSize(db_indx);
   }
 
+  if (serializing_indices_) {
+    auto* indices = db_slice_->shard_owner()->search_indices();
+    while (!cll->IsCancelled() && indices->SerializeStep()) {
+      PushSerializedToChannel(false);
+      ThisFiber::Yield();
+    }
+  }
+
   for (DbIndex db_indx = 0; db_indx < db_array_.size(); ++db_indx) {
     if (cll->IsCancelled())
       return;
@@ -195,6 +232,7 @@ void SliceSnapshot::IterateBucketsFb(const Cancellation* cll, bool send_full_syn
 
     uint64_t last_yield = 0;
     PrimeTable* pt = &db_array_[db_indx]->prime;
+    TieredStorage* tiered_storage = db_slice_->shard_owner()->tiered_storage();
     current_db_ = db_indx;
 
     VLOG(1) << "Start traversing " << pt->size() << " items for index " << db_indx;
@@ -202,9 +240,17 @@ void SliceSnapshot::IterateBucketsFb(const Cancellation* cll, bool send_full_syn
       if (cll->IsCancelled())
         return;
 
-      PrimeTable::Cursor next =
-          pt->Traverse(cursor, absl::bind_front(&SliceSnapshot::BucketSaveCb, this));
-      cursor = next;
+      // Reads of offloaded values are issued without blocking and awaited only once enough of
+      // them are in flight, overlapping disk reads with serialization of following buckets
+      if (tiered_storage)
+        tiered_storage->BeginReadBatch();
+      unsigned traversed = 0;
+      do {
+        cursor = pt->Traverse(cursor, absl::bind_front(&SliceSnapshot::BucketSaveCb, this));
+      } while (cursor && ++traversed < kReadAheadBuckets);
+      if (tiered_storage)
+        tiered_storage->EndReadBatch();
+
       PushSerializedToChannel(false);
 
       if (stats_.loop_serialized >= last_yield + 100) {
@@ -288,11 +334,17 @@ void SliceSnapshot::SerializeEntry(DbIndex db_indx, const PrimeKey& pk, const Pr
   if (pv.IsExternal()) {
     // We can't block, so we just schedule a tiered read and append it to the delayed entries
     util::fb2::Future<PrimeValue> future;
-    EngineShard::tlocal()->tiered_storage()->Read(
-        db_indx, pk.ToString(), pv,
-        [future](const std::string& v) mutable { future.Resolve(PrimeValue(v)); });
-    delayed_entries_.push_back({db_indx, PrimeKey(pk.ToString()), std::move(future), expire_time});
-    ++type_freq_map_[RDB_TYPE_STRING];
+    auto cb = [future, obj_type = pv.ObjType(), encoding = pv.Encoding()](
+                  const std::string& v) mutable {
+      PrimeValue restored;
+      tiering::Deserialize(obj_type, encoding, v, &restored);
+      future.Resolve(std::move(restored));
+    };
+    EngineShard::tlocal()->tiered_storage()->Read(db_indx, pk.ToString(), pv, std::move(cb));
+    delayed_entries_.push_back(
+        DelayedEntry{db_indx, PrimeKey(pk.ToString()), std::move(future), expire_time, pv.Size()});
+    delayed_bytes_ += pv.Size();
+    ++type_freq_map_[RdbObjectType(pv)];
   } else {
     io::Result<uint8_t> res = serializer->SaveEntry(pk, pv, expire_time, db_indx);
     CHECK(res);
@@ -300,14 +352,27 @@ void SliceSnapshot::SerializeEntry(DbIndex db_indx, const PrimeKey& pk, const Pr
   }
 }
 
+void SliceSnapshot::SerializeDelayedEntries(size_t max_pending) {
+  // Entries are only popped by the fiber holding the lock. Others may append entries while it
+  // blocks, which doesn't invalidate references to the front of the deque
+  lock_guard lk{delayed_mu_};
+  while (!delayed_entries_.empty() &&
+         (delayed_entries_.size() > max_pending || delayed_bytes_ > kMaxDelayedBytes)) {
+    if (auto* entry = get_if<DelayedEntry>(&delayed_entries_.front()); entry) {
+      serializer_->SaveEntry(entry->key, entry->value.Get(), entry->expire, entry->dbid);
+      delayed_bytes_ -= entry->size;
+    } else {
+      serializer_->WriteJournalEntry(get<string>(delayed_entries_.front()));
+    }
+    delayed_entries_.pop_front();
+  }
+}
+
 bool SliceSnapshot::PushSerializedToChannel(bool force) {
   // Bucket serialization might have accumulated some delayed values.
-  // Because we can finally block in this function, we'll await and serialize them
-  while (!delayed_entries_.empty()) {
-    auto& entry = delayed_entries_.back();
-    serializer_->SaveEntry(entry.key, entry.value.Get(), entry.expire, entry.dbid);
-    delayed_entries_.pop_back();
-  }
+  // Because we can finally block in this function, we'll await and serialize them. Unless forced,
+  // keep a window of reads in flight; the order of different keys in the snapshot doesn't matter
+  SerializeDelayedEntries(force ? 0 : kMaxDelayedEntries);
 
   if (!force && serializer_->SerializedLen() < 4096)
     return false;
@@ -360,12 +425,17 @@ void SliceSnapshot::OnJournalEntry(const journal::JournalItem& item, bool await)
   // TriggerJournalWriteToSink. This call uses the NOOP opcode with await=true. Since there is no
   // additional journal change to serialize, it simply invokes PushSerializedToChannel.
   if (item.opcode != journal::Op::NOOP) {
-    serializer_->WriteJournalEntry(item.data);
+    if (delayed_entries_.empty())
+      serializer_->WriteJournalEntry(item.data);
+    else
+      delayed_entries_.emplace_back(item.data);  // can't precede values that are being read
   }
 
   if (await) {
     // This is the only place that flushes in streaming mode
-    // once the iterate buckets fiber finished.
+    // once the iterate buckets fiber finished. Journal entries queued behind values that are
+    // being read are flushed too, so the read-ahead window doesn't hold them back.
+    SerializeDelayedEntries(0);
     PushSerializedToChannel(false);
   }
 }
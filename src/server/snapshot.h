@@ -6,6 +6,8 @@
 
 #include <atomic>
 #include <bitset>
+#include <deque>
+#include <variant>
 
 #include "base/pod_array.h"
 #include "core/size_tracking_channel.h"
@@ -66,7 +68,8 @@ class SliceSnapshot {
 
   // Initialize snapshot, start bucket iteration fiber, register listeners.
   // In journal streaming mode it needs to be stopped by either Stop or Cancel.
-  void Start(bool stream_journal, const Cancellation* cll);
+  // With save_search_indices, the shard's search index data is written first as aux fields.
+  void Start(bool stream_journal, const Cancellation* cll, bool save_search_indices = false);
 
   // Initialize a snapshot that sends only the missing journal updates
   // since start_lsn and then registers a callback switches into the
@@ -111,6 +114,10 @@ class SliceSnapshot {
   // Close dest channel if not closed yet.
   void CloseRecordChannel();
 
+  // Await and serialize delayed entries in order of arrival until at most max_pending are left,
+  // so that reads of values from following buckets stay in flight.
+  void SerializeDelayedEntries(size_t max_pending);
+
   // Push serializer's internal buffer to channel.
   // Push regardless of buffer size if force is true.
   // Return if pushed.
@@ -139,6 +146,7 @@ class SliceSnapshot {
     CompactObj key;
     util::fb2::Future<PrimeValue> value;
     time_t expire;
+    size_t size;  // size of the offloaded value
   };
 
   DbSlice* db_slice_;
@@ -150,10 +158,15 @@ class SliceSnapshot {
   DbIndex current_db_;
 
   std::unique_ptr<RdbSerializer> serializer_;
-  std::vector<DelayedEntry> delayed_entries_;  // collected during atomic bucket traversal
+  // Entries collected during atomic bucket traversal. Journal entries that arrive while values
+  // are pending are queued behind them to preserve order
+  std::deque<std::variant<DelayedEntry, std::string>> delayed_entries_;
+  size_t delayed_bytes_ = 0;      // total size of pending values
+  util::fb2::Mutex delayed_mu_;  // serializes awaiting of delayed entries
 
   // Used for sanity checks.
   bool serialize_bucket_running_ = false;
+  bool serializing_indices_ = false;  // search index data is being written, see Start
   util::fb2::Fiber snapshot_fb_;  // IterateEntriesFb
 
   CompressionMode compression_mode_;
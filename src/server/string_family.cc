@@ -102,7 +102,7 @@ OpResult<uint32_t> OpSetRange(const OpArgs& op_args, string_view key, size_t sta
   }
 
   memcpy(s.data() + start, value.data(), value.size());
-  res.it->second.SetString(s);
+  res.it->second.SetCompressibleString(s);
   return res.it->second.Size();
 }
 
@@ -147,7 +147,7 @@ size_t ExtendExisting(DbSlice::Iterator it, string_view key, string_view val, bo
   else
     new_val = absl::StrCat(slice, val);
 
-  it->second.SetString(new_val);
+  it->second.SetCompressibleString(new_val);
 
   return new_val.size();
 }
@@ -169,27 +169,32 @@ OpResult<double> OpIncrFloat(const OpArgs& op_args, string_view key, double val)
   RETURN_ON_BAD_STATUS(op_res);
   auto& add_res = *op_res;
 
-  char buf[128];
-
   if (add_res.is_new) {
-    char* str = RedisReplyBuilder::FormatDouble(val, buf, sizeof(buf));
-    add_res.it->second.SetString(str);
+    add_res.it->second.SetDouble(val);
 
     return val;
   }
 
-  if (add_res.it->second.ObjType() != OBJ_STRING)
+  PrimeValue& pv = add_res.it->second;
+  if (pv.ObjType() != OBJ_STRING)
     return OpStatus::WRONG_TYPE;
 
-  if (add_res.it->second.Size() == 0)
-    return OpStatus::INVALID_FLOAT;
+  // Numeric values are updated in place, without formatting and parsing them.
+  double base = 0;
+  if (auto opt_double = pv.TryGetDouble(); opt_double) {
+    base = *opt_double;
+  } else if (auto opt_int = pv.TryGetInt(); opt_int) {
+    base = *opt_int;
+  } else {
+    if (pv.Size() == 0)
+      return OpStatus::INVALID_FLOAT;
 
-  string tmp;
-  string_view slice = add_res.it->second.GetSlice(&tmp);
+    string tmp;
+    string_view slice = pv.GetSlice(&tmp);
 
-  double base = 0;
-  if (!ParseDouble(slice, &base)) {
-    return OpStatus::INVALID_FLOAT;
+    if (!ParseDouble(slice, &base)) {
+      return OpStatus::INVALID_FLOAT;
+    }
   }
 
   base += val;
@@ -198,9 +203,7 @@ OpResult<double> OpIncrFloat(const OpArgs& op_args, string_view key, double val)
     return OpStatus::INVALID_FLOAT;
   }
 
-  char* str = RedisReplyBuilder::FormatDouble(base, buf, sizeof(buf));
-
-  add_res.it->second.SetString(str);
+  pv.SetDouble(base);
 
   return base;
 }
@@ -419,20 +422,25 @@ SinkReplyBuilder::MGetResponse OpMGet(util::fb2::BlockingCounter wait_bc, bool f
   absl::InlinedVector<DbSlice::ConstIterator, 32> iters(keys.Size());
 
   // First, fetch all iterators and count total size ahead
+  absl::InlinedVector<string_view, 32> key_list(keys.begin(), keys.end());
   size_t total_size = 0;
-  unsigned index = 0;
-  for (string_view key : keys) {
-    auto it_res = db_slice.FindReadOnly(t->GetDbContext(), key, OBJ_STRING);
-    if (auto& dest = iters[index++]; it_res) {
-      dest = *it_res;
-      total_size += (*it_res)->second.Size();
-    }
-  }
+  db_slice.FindReadOnlyBatch(t->GetDbContext(), key_list, OBJ_STRING,
+                             [&](size_t index, OpResult<DbSlice::ConstIterator> it_res) {
+                               if (it_res) {
+                                 iters[index] = *it_res;
+                                 total_size += (*it_res)->second.Size();
+                               }
+                             });
 
   // Allocate enough for all values
   response.storage_list = SinkReplyBuilder::AllocMGetStorage(total_size);
   char* next = response.storage_list->data;
 
+  // Submit tiered reads of all keys at once, so reads of adjacent pages can be merged
+  TieredStorage* tiered_storage = shard->tiered_storage();
+  if (tiered_storage)
+    tiered_storage->BeginReadBatch();
+
   for (size_t i = 0; i < iters.size(); ++i) {
     auto it = iters[i];
     if (it.is_done())
@@ -468,6 +476,9 @@ SinkReplyBuilder::MGetResponse OpMGet(util::fb2::BlockingCounter wait_bc, bool f
     }
   }
 
+  if (tiered_storage)
+    tiered_storage->EndReadBatch();
+
   return response;
 }
 
@@ -482,7 +493,7 @@ OpResult<variant<size_t, util::fb2::Future<size_t>>> OpExtend(const OpArgs& op_a
   RETURN_ON_BAD_STATUS(it_res);
 
   if (it_res->is_new) {
-    it_res->it->second.SetString(value);
+    it_res->it->second.SetCompressibleString(value);
     return {it_res->it->second.Size()};
   }
 
@@ -628,7 +639,7 @@ OpStatus SetCmd::SetExisting(const SetParams& params, DbSlice::Iterator it,
   }
 
   // overwrite existing entry.
-  prime_value.SetString(value);
+  prime_value.SetCompressibleString(value);
 
   PostEdit(params, key, value, &prime_value);
   return OpStatus::OK;
@@ -640,7 +651,8 @@ void SetCmd::AddNew(const SetParams& params, DbSlice::Iterator it, DbSlice::ExpI
   auto& db_slice = shard->db_slice();
 
   // Adding new value.
-  PrimeValue tvalue{value};
+  PrimeValue tvalue;
+  tvalue.SetCompressibleString(value);
   tvalue.SetFlag(params.memcache_flags != 0);
   it->second = std::move(tvalue);
 
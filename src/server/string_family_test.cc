@@ -505,6 +505,15 @@ TEST_F(StringFamilyTest, IncrByFloat) {
   Run({"SET", "num", "2.566"});
   resp = Run({"INCRBYFLOAT", "num", "1.0"});
   EXPECT_EQ(resp, "3.566");
+
+  Run({"SET", "gauge", "0.10000000000000001"});
+  EXPECT_EQ(Run({"INCRBYFLOAT", "gauge", "0.2"}), "0.30000000000000004");
+  EXPECT_EQ(Run({"GET", "gauge"}), "0.30000000000000004");
+  EXPECT_EQ(Run({"INCRBYFLOAT", "gauge", "-0.30000000000000004"}), "0");
+  EXPECT_THAT(Run({"INCR", "gauge"}), IntArg(1));
+  EXPECT_EQ(Run({"INCRBYFLOAT", "gauge", "1e300"}), "1e+300");
+  EXPECT_THAT(Run({"INCRBYFLOAT", "gauge", "1.7976931348623157e308"}), ErrArg("not a valid float"));
+  EXPECT_EQ(Run({"GET", "gauge"}), "1e+300");
 }
 
 TEST_F(StringFamilyTest, SetNx) {
@@ -9,6 +9,7 @@
 #include <cstddef>
 #include <memory>
 #include <optional>
+#include <utility>
 #include <variant>
 
 #include "absl/cleanup/cleanup.h"
@@ -18,11 +19,15 @@
 #include "server/common.h"
 #include "server/db_slice.h"
 #include "server/engine_shard_set.h"
+#include "server/search/doc_index.h"
 #include "server/snapshot.h"
 #include "server/table.h"
 #include "server/tiering/common.h"
+#include "server/tiering/compression.h"
+#include "server/tiering/frequency_sketch.h"
 #include "server/tiering/op_manager.h"
 #include "server/tiering/small_bins.h"
+#include "server/tiering/value_codec.h"
 #include "server/tx_base.h"
 
 ABSL_FLAG(bool, tiered_storage_cache_fetched, true,
@@ -31,6 +36,24 @@ ABSL_FLAG(bool, tiered_storage_cache_fetched, true,
 ABSL_FLAG(unsigned, tiered_storage_write_depth, 50,
           "Maximum number of concurrent stash requests issued by background offload");
 
+ABSL_FLAG(bool, tiered_experimental_container_support, false,
+          "Experimental: offload listpack hashes/zsets, intsets and lists. Commands load offloaded "
+          "containers back to memory before they run. Documents of search indices are not "
+          "offloaded");
+
+ABSL_FLAG(float, tiered_storage_compaction_utilization, 0,
+          "Values stored in backing file pages with lower utilization, between 0 and 1, are "
+          "relocated, so the pages can be released. 0 disables compaction");
+
+ABSL_FLAG(dfly::tiering::CompressionKind, tiered_storage_compression,
+          dfly::tiering::CompressionKind::NONE,
+          "Compress offloaded values: none, lz4 or zstd. Values are stored compressed only if "
+          "it reduces their size substantially");
+
+ABSL_FLAG(unsigned, tiered_storage_hot_frequency, 0,
+          "Values with at least this estimated number of recent accesses are considered hot: "
+          "they're not offloaded and are kept in memory once read. 0 disables access tracking");
+
 namespace dfly {
 
 using namespace std;
@@ -46,9 +69,54 @@ bool OccupiesWholePages(size_t size) {
   return size >= TieredStorage::kMinOccupancySize;
 }
 
+// Compressed values are stored only if they take up less pages or fit into small bins
+bool SavesPages(size_t compressed_size, size_t raw_size) {
+  return !OccupiesWholePages(compressed_size) ||
+         tiering::DiskSegment{0, compressed_size}.ContainingPages().length <
+             tiering::DiskSegment{0, raw_size}.ContainingPages().length;
+}
+
+// Returns function restoring the original blob of an offloaded value if it was compressed
+tiering::OpManager::DecodeFn MakeDecoder(const PrimeValue& pv) {
+  auto kind = tiering::CompressionKind(pv.GetExternalCompression());
+  if (kind == tiering::CompressionKind::NONE)
+    return {};
+
+  return [kind, raw_size = pv.Size()](string* value) {
+    string raw;
+    if (!tiering::Decompress(kind, *value, raw_size, &raw))
+      LOG(DFATAL) << "Failed to decompress offloaded value";
+    *value = std::move(raw);
+  };
+}
+
+// Search indices read documents in place, so their containers are kept in memory
+bool IsIndexedContainer(string_view key, const PrimeValue& pv) {
+  if (pv.ObjType() == OBJ_STRING)
+    return false;
+  auto* indices = EngineShard::tlocal()->search_indices();
+  return indices && indices->IsIndexed(key, pv.ObjType());
+}
+
+// Transactions load containers of their keys after scheduling and access them in place (see
+// Transaction::LoadOffloadedContainers), so containers of locked keys are kept in memory
+bool IsLockedContainer(const DbSlice& db_slice, DbIndex dbid, string_view key,
+                       const PrimeValue& pv) {
+  if (pv.ObjType() == OBJ_STRING)
+    return false;
+  return !EngineShard::tlocal()->shard_lock()->Check(IntentLock::EXCLUSIVE) ||
+         !db_slice.CheckLock(IntentLock::EXCLUSIVE, dbid, key);
+}
+
+// Number of keys tracked by the access frequency sketch of each shard
+constexpr size_t kFrequencySketchCapacity = 1 << 15;
+
 // Stashed bins no longer have bin ids, so this sentinel is used to differentiate from regular reads
 constexpr auto kFragmentedBin = tiering::SmallBins::kInvalidBin - 1;
 
+// Sentinel for reads of whole bins that are relocated during compaction
+constexpr auto kRelocatedBin = tiering::SmallBins::kInvalidBin - 2;
+
 }  // anonymous namespace
 
 class TieredStorage::ShardOpManager : public tiering::OpManager {
@@ -64,10 +132,28 @@ class TieredStorage::ShardOpManager : public tiering::OpManager {
   // Update memory stats
   void SetExternal(OpManager::KeyRef key, tiering::DiskSegment segment) {
     if (auto pv = Find(key); pv) {
+      // Index could've been created or key locked while the stash was pending
+      if (IsIndexedContainer(key.second, *pv) ||
+          IsLockedContainer(*db_slice_, key.first, key.second, *pv)) {
+        pv->SetIoPending(false);
+        DeleteOffloaded(segment);
+        stats_.total_cancels++;
+        return;
+      }
+
       RecordAdded(db_slice_->MutableStats(key.first), *pv, segment.length);
+      if (pv->ObjType() != OBJ_STRING)
+        ts_->offloaded_containers_++;
 
+      // Values can't change while their stash is pending, so the stored blob is shorter only if
+      // it was compressed
+      size_t raw_size = tiering::SerializedSize(*pv);
       pv->SetIoPending(false);
-      pv->SetExternal(segment.offset, segment.length);
+      if (segment.length < raw_size)
+        pv->SetExternal(segment.offset, segment.length, uint8_t(ts_->compressor_->kind()),
+                        raw_size);
+      else
+        pv->SetExternal(segment.offset, segment.length);
 
       stats_.total_stashes++;
     }
@@ -95,9 +181,13 @@ class TieredStorage::ShardOpManager : public tiering::OpManager {
 
   // Set value to be an in-memory type again, either empty or with a value. Update memory stats
   void SetInMemory(PrimeValue* pv, DbIndex dbid, string_view value, tiering::DiskSegment segment) {
+    unsigned obj_type = pv->ObjType(), encoding = pv->Encoding();
+    if (obj_type != OBJ_STRING)
+      ts_->offloaded_containers_--;
+
     pv->Reset();
     if (!value.empty())
-      pv->SetString(value);
+      tiering::Deserialize(obj_type, encoding, value, pv);
 
     RecordDeleted(db_slice_->MutableStats(dbid), *pv, segment.length);
   }
@@ -112,6 +202,14 @@ class TieredStorage::ShardOpManager : public tiering::OpManager {
     return false;
   }
 
+  // Read value, or the small bin holding it, if it lies on an underutilized page. Once written to
+  // a new location by WriteRelocated(), values are switched to it and stay offloaded. Returns true
+  // if relocation was scheduled
+  bool TryRelocate(OpManager::KeyRef key, const PrimeValue& pv, float min_utilization);
+
+  // Write values read by TryRelocate to new locations. Can block to grow the backing file
+  void WriteRelocated();
+
   // Load all values from bin by their hashes
   void Defragment(tiering::DiskSegment segment, string_view value);
 
@@ -128,11 +226,15 @@ class TieredStorage::ShardOpManager : public tiering::OpManager {
                      bool modified) override;
 
   bool ReportDelete(tiering::DiskSegment segment) override {
-    if (OccupiesWholePages(segment.length))
+    // Relocations of freed pages are cancelled, as the pages can be reused
+    if (OccupiesWholePages(segment.length)) {
+      relocating_.erase(segment.offset);
       return true;
+    }
 
     auto bin = ts_->bins_->Delete(segment);
     if (bin.empty) {
+      relocating_.erase(bin.segment.offset);
       return true;
     }
 
@@ -155,9 +257,42 @@ class TieredStorage::ShardOpManager : public tiering::OpManager {
     return IsValid(it) ? &it->second : nullptr;
   }
 
+  // Value or small bin read by TryRelocate
+  struct Relocation {
+    uint64_t id;
+    std::optional<std::pair<DbIndex, std::string>> key;  // not set for small bins
+    tiering::DiskSegment segment;                        // whole page for small bins
+    std::string blob;                                    // stored as is, without decoding
+  };
+
+  // Stop tracking relocation. Returns false if it was cancelled
+  bool EndRelocation(const Relocation& relocation) {
+    auto it = relocating_.find(relocation.segment.offset);
+    if (it == relocating_.end() || it->second != relocation.id)
+      return false;
+    relocating_.erase(it);
+    return true;
+  }
+
+  // Switch values of relocated blob to the segment it was written to
+  void ReportRelocated(const Relocation& relocation, tiering::DiskSegment segment,
+                       error_code ec);
+
+  // Point offloaded value to a new offset, keeping its stored blob unchanged
+  static void MoveExternal(PrimeValue* pv, size_t offset) {
+    pv->SetExternal(offset, pv->GetExternalSlice().second, pv->GetExternalCompression(),
+                    pv->Size());
+  }
+
+  static bool IsListpackBlob(const PrimeValue& pv) {
+    return (pv.ObjType() == OBJ_HASH && pv.Encoding() == kEncodingListPack) ||
+           (pv.ObjType() == OBJ_ZSET && pv.Encoding() == OBJ_ENCODING_LISTPACK);
+  }
+
   // Called before overriding value with segment
   void RecordAdded(DbTableStats* stats, const PrimeValue& pv, size_t tiered_len) {
     stats->AddTypeMemoryUsage(pv.ObjType(), -pv.MallocUsed());
+    stats->listpack_blob_cnt -= IsListpackBlob(pv);
     stats->tiered_entries++;
     stats->tiered_used_bytes += tiered_len;
   }
@@ -165,15 +300,22 @@ class TieredStorage::ShardOpManager : public tiering::OpManager {
   // Called after setting new value in place of previous segment
   void RecordDeleted(DbTableStats* stats, const PrimeValue& pv, size_t tiered_len) {
     stats->AddTypeMemoryUsage(pv.ObjType(), pv.MallocUsed());
+    stats->listpack_blob_cnt += IsListpackBlob(pv);
     stats->tiered_entries--;
     stats->tiered_used_bytes -= tiered_len;
   }
 
   bool cache_fetched_ = false;
 
+  // Relocation ids by offset of the pages being relocated, see TryRelocate
+  absl::flat_hash_map<size_t, uint64_t> relocating_;
+  uint64_t last_relocation_id_ = 0;
+  std::vector<Relocation> relocated_;  // read and waiting to be written
+  size_t relocating_bytes_ = 0;        // read or being read into memory
+
   struct {
     size_t total_stashes = 0, total_cancels = 0, total_fetches = 0;
-    size_t total_defrags = 0;
+    size_t total_defrags = 0, total_relocations = 0, total_promotes = 0;
   } stats_;
 
   TieredStorage* ts_;
@@ -195,11 +337,121 @@ void TieredStorage::ShardOpManager::Defragment(tiering::DiskSegment segment, str
     stats_.total_defrags++;
 
     // Cut out relevant part of value and restore it to memory
-    string_view sub_value = value.substr(sub_segment.offset - segment.offset, sub_segment.length);
+    string sub_value{value.substr(sub_segment.offset - segment.offset, sub_segment.length)};
+    if (auto decode = MakeDecoder(it->second); decode)
+      decode(&sub_value);
     SetInMemory(&it->second, dbid, sub_value, sub_segment);
   }
 }
 
+bool TieredStorage::ShardOpManager::TryRelocate(OpManager::KeyRef key, const PrimeValue& pv,
+                                                float min_utilization) {
+  // Small values are relocated together with the other entries of their bin
+  tiering::DiskSegment segment = pv.GetExternalSlice();
+  bool whole_pages = OccupiesWholePages(segment.length);
+  if (!whole_pages)
+    segment = segment.ContainingPages();
+
+  if (relocating_.contains(segment.offset) || pending_reads_.contains(segment.offset))
+    return false;
+
+  if (!storage_.ShouldRelocate(segment, min_utilization))
+    return false;
+
+  uint64_t id = relocating_[segment.offset] = ++last_relocation_id_;
+  relocating_bytes_ += segment.length;
+
+  Relocation relocation{id, nullopt, segment, {}};
+  if (whole_pages)
+    relocation.key.emplace(key.first, key.second);
+
+  // Reads of the same value share decoding. If it was decoded for another read, relocation is
+  // skipped and retried by a following compaction run
+  auto cb = [this, relocation = std::move(relocation)](string* value) mutable {
+    if (value->size() == relocation.segment.length) {
+      relocation.blob = *value;
+      relocated_.push_back(std::move(relocation));
+    } else {
+      relocating_bytes_ -= relocation.segment.length;
+      EndRelocation(relocation);
+    }
+    return false;
+  };
+
+  if (whole_pages)
+    Enqueue(key, segment, std::move(cb));
+  else
+    Enqueue(kRelocatedBin, segment, std::move(cb));
+  return true;
+}
+
+void TieredStorage::ShardOpManager::WriteRelocated() {
+  // Stashes can block, new relocations are added to relocated_ in the meantime
+  for (Relocation& relocation : std::exchange(relocated_, {})) {
+    // Blobs are copied by Stash, only small bins keep theirs to locate their entries
+    relocating_bytes_ -= relocation.segment.length;
+    if (!relocating_.contains(relocation.segment.offset))
+      continue;  // cancelled
+
+    Relocation written{relocation.id, relocation.key, relocation.segment,
+                       relocation.key ? "" : relocation.blob};
+    auto cb = [this, written = std::move(written)](tiering::DiskSegment segment, error_code ec) {
+      ReportRelocated(written, segment, ec);
+    };
+
+    io::Bytes bytes{reinterpret_cast<const uint8_t*>(relocation.blob.data()),
+                    relocation.blob.size()};
+    if (auto ec = storage_.Stash(bytes, std::move(cb)); ec) {
+      LOG_FIRST_N(ERROR, 10) << "Relocation failed: " << ec.message();
+      EndRelocation(relocation);
+    }
+  }
+}
+
+void TieredStorage::ShardOpManager::ReportRelocated(const Relocation& relocation,
+                                                    tiering::DiskSegment segment, error_code ec) {
+  bool valid = EndRelocation(relocation);
+  if (ec)
+    return;
+
+  // Pending reads refer to the previous location, so the page is relocated by a later run
+  if (!valid || pending_reads_.contains(relocation.segment.offset)) {
+    storage_.MarkAsFree(segment);
+    return;
+  }
+
+  if (relocation.key) {
+    auto* pv = Find(KeyRef(relocation.key->first, relocation.key->second));
+    if (!pv || !pv->IsExternal() || !(relocation.segment == pv->GetExternalSlice())) {
+      storage_.MarkAsFree(segment);
+      return;
+    }
+
+    MoveExternal(pv, segment.offset);
+    DeleteOffloaded(relocation.segment);
+    stats_.total_relocations++;
+    return;
+  }
+
+  auto entries = ts_->bins_->MoveBin(relocation.segment, segment, relocation.blob);
+  if (entries.empty()) {
+    storage_.MarkAsFree(segment);
+    return;
+  }
+
+  // Entries of the bin are found the same way as for defragmentation, deleted ones are skipped
+  for (auto [dbid, hash, sub_segment] : entries) {
+    auto predicate = [sub_segment = sub_segment](const PrimeKey& key, const PrimeValue& probe) {
+      return probe.IsExternal() && tiering::DiskSegment{probe.GetExternalSlice()} == sub_segment;
+    };
+    auto it = db_slice_->GetDBTable(dbid)->prime.FindFirst(hash, predicate);
+    if (IsValid(it))
+      MoveExternal(&it->second, segment.offset + (sub_segment.offset - relocation.segment.offset));
+  }
+  storage_.MarkAsFree(relocation.segment);
+  stats_.total_relocations++;
+}
+
 bool TieredStorage::ShardOpManager::ReportFetched(EntryId id, string_view value,
                                                   tiering::DiskSegment segment, bool modified) {
   ++stats_.total_fetches;
@@ -209,20 +461,46 @@ bool TieredStorage::ShardOpManager::ReportFetched(EntryId id, string_view value,
     return true;  // delete
   }
 
+  if (id == EntryId{kRelocatedBin})  // bin is written to a new location by WriteRelocated
+    return false;
+
+  // Values being relocated stay offloaded unless they were modified
+  if (!modified && relocating_.contains(segment.offset))
+    return false;
+
   if (!modified && !cache_fetched_)
     return false;
 
   if (SliceSnapshot::IsSnaphotInProgress())
     return false;
 
-  SetInMemory(get<OpManager::KeyRef>(id), value, segment);
+  // Promoting values that are read only occasionally leads to them being offloaded again soon
+  auto key = get<OpManager::KeyRef>(id);
+  if (!modified && ts_->sketch_ && !ts_->IsHot(key.second))
+    return false;
+
+  if (SetInMemory(key, value, segment) && !modified)
+    stats_.total_promotes++;
   return true;
 }
 
 TieredStorage::TieredStorage(DbSlice* db_slice, size_t max_size)
     : op_manager_{make_unique<ShardOpManager>(this, db_slice, max_size)},
-      bins_{make_unique<tiering::SmallBins>()} {
+      bins_{make_unique<tiering::SmallBins>()},
+      compressor_{make_unique<tiering::ValueCompressor>(
+          absl::GetFlag(FLAGS_tiered_storage_compression))} {
   write_depth_limit_ = absl::GetFlag(FLAGS_tiered_storage_write_depth);
+  offload_containers_ = absl::GetFlag(FLAGS_tiered_experimental_container_support);
+  compaction_utilization_ = absl::GetFlag(FLAGS_tiered_storage_compaction_utilization);
+  if (compaction_utilization_ < 0 || compaction_utilization_ > 1) {
+    LOG(ERROR) << "Invalid value for tiered_storage_compaction_utilization - must be in (0, 1] "
+                  "or 0 to disable compaction";
+    exit(1);
+  }
+
+  hot_frequency_ = base_hot_frequency_ = absl::GetFlag(FLAGS_tiered_storage_hot_frequency);
+  if (hot_frequency_ > 0)
+    sketch_ = make_unique<tiering::FrequencySketch>(kFrequencySketchCapacity);
 }
 
 TieredStorage::~TieredStorage() {
@@ -244,7 +522,8 @@ util::fb2::Future<string> TieredStorage::Read(DbIndex dbid, string_view key,
     future.Resolve(*value);
     return false;
   };
-  op_manager_->Enqueue(KeyRef(dbid, key), value.GetExternalSlice(), std::move(cb));
+  op_manager_->Enqueue(KeyRef(dbid, key), value.GetExternalSlice(), std::move(cb),
+                       MakeDecoder(value));
   return future;
 }
 
@@ -255,7 +534,36 @@ void TieredStorage::Read(DbIndex dbid, std::string_view key, const PrimeValue& v
     readf(*value);
     return false;
   };
-  op_manager_->Enqueue(KeyRef(dbid, key), value.GetExternalSlice(), std::move(cb));
+  op_manager_->Enqueue(KeyRef(dbid, key), value.GetExternalSlice(), std::move(cb),
+                       MakeDecoder(value));
+}
+
+void TieredStorage::Load(DbIndex dbid, std::string_view key, const PrimeValue& value) {
+  DCHECK(value.IsExternal());
+  tiering::DiskSegment segment = value.GetExternalSlice();
+
+  // Report the value as modified, so it's restored to memory unconditionally once fetched
+  util::fb2::Future<string> future;
+  auto cb = [future](string* value) mutable {
+    future.Resolve(*value);
+    return true;
+  };
+  op_manager_->Enqueue(KeyRef(dbid, key), segment, std::move(cb), MakeDecoder(value));
+  string blob = future.Get();
+
+  // Restoring could've been skipped (i.e. because of an ongoing snapshot), so do it manually
+  if (auto* pv = op_manager_->Find(KeyRef(dbid, key));
+      pv && pv->IsExternal() && segment == pv->GetExternalSlice()) {
+    op_manager_->DeleteOffloaded(segment);
+    op_manager_->SetInMemory(pv, dbid, blob, segment);
+  }
+}
+
+void TieredStorage::StartLoad(DbIndex dbid, std::string_view key, const PrimeValue& value) {
+  DCHECK(value.IsExternal());
+  auto cb = [](string* value) { return true; };  // report as modified to restore it to memory
+  op_manager_->Enqueue(KeyRef(dbid, key), value.GetExternalSlice(), std::move(cb),
+                       MakeDecoder(value));
 }
 
 template <typename T>
@@ -268,7 +576,8 @@ util::fb2::Future<T> TieredStorage::Modify(DbIndex dbid, std::string_view key,
     future.Resolve(modf(value));
     return true;
   };
-  op_manager_->Enqueue(KeyRef(dbid, key), value.GetExternalSlice(), std::move(cb));
+  op_manager_->Enqueue(KeyRef(dbid, key), value.GetExternalSlice(), std::move(cb),
+                       MakeDecoder(value));
   return future;
 }
 
@@ -276,8 +585,16 @@ template util::fb2::Future<size_t> TieredStorage::Modify(DbIndex dbid, std::stri
                                                          const PrimeValue& value,
                                                          std::function<size_t(std::string*)> modf);
 
+void TieredStorage::BeginReadBatch() {
+  op_manager_->BeginReadBatch();
+}
+
+void TieredStorage::EndReadBatch() {
+  op_manager_->EndReadBatch();
+}
+
 bool TieredStorage::TryStash(DbIndex dbid, string_view key, PrimeValue* value) {
-  if (!ShouldStash(*value))
+  if (!ShouldStash(dbid, key, *value))
     return false;
 
   // This invariant should always hold because ShouldStash tests for IoPending flag.
@@ -290,13 +607,17 @@ bool TieredStorage::TryStash(DbIndex dbid, string_view key, PrimeValue* value) {
     return false;
   }
 
-  string buf;
-  string_view value_sv = value->GetSlice(&buf);
+  string buf, compressed_buf;
+  string_view value_sv = tiering::Serialize(*value, &buf);
+  if (string_view compressed = compressor_->Compress(value_sv, &compressed_buf);
+      !compressed.empty() && SavesPages(compressed.size(), value_sv.size())) {
+    value_sv = compressed;
+  }
   value->SetIoPending(true);
 
   tiering::OpManager::EntryId id;
   error_code ec;
-  if (OccupiesWholePages(value->Size())) {  // large enough for own page
+  if (OccupiesWholePages(value_sv.size())) {  // large enough for own page
     id = KeyRef(dbid, key);
     ec = op_manager_->Stash(id, value_sv);
   } else if (auto bin = bins_->Stash(dbid, key, value_sv); bin) {
@@ -324,7 +645,9 @@ void TieredStorage::Delete(DbIndex dbid, PrimeValue* value) {
 
 void TieredStorage::CancelStash(DbIndex dbid, std::string_view key, PrimeValue* value) {
   DCHECK(value->HasIoPending());
-  if (OccupiesWholePages(value->Size())) {
+  // Large values could've been compressed enough to be stashed in small bins
+  if (OccupiesWholePages(tiering::SerializedSize(*value)) &&
+      op_manager_->IsPendingStash(KeyRef(dbid, key))) {
     op_manager_->Delete(KeyRef(dbid, key));
   } else if (auto bin = bins_->Delete(dbid, key); bin) {
     op_manager_->Delete(*bin);
@@ -345,6 +668,8 @@ TieredStats TieredStorage::GetStats() const {
     stats.total_stashes = shard_stats.total_stashes;
     stats.total_cancels = shard_stats.total_cancels;
     stats.total_defrags = shard_stats.total_defrags;
+    stats.total_relocations = shard_stats.total_relocations;
+    stats.total_promotes = shard_stats.total_promotes;
   }
 
   {  // OpManager stats
@@ -355,6 +680,8 @@ TieredStats TieredStorage::GetStats() const {
     stats.capacity_bytes = op_stats.disk_stats.capacity_bytes;
     stats.total_heap_buf_allocs = op_stats.disk_stats.heap_buf_alloc_count;
     stats.total_registered_buf_allocs = op_stats.disk_stats.registered_buf_alloc_count;
+    stats.reclaimed_bytes = op_stats.disk_stats.reclaimed_bytes;
+    stats.total_disk_reads = op_stats.disk_stats.read_count;
   }
 
   {  // SmallBins stats
@@ -366,16 +693,25 @@ TieredStats TieredStorage::GetStats() const {
 
   {  // Own stats
     stats.total_stash_overflows = stats_.stash_overflow_cnt;
+    stats.total_hits = stats_.hit_cnt;
+    stats.total_misses = stats_.miss_cnt;
+    stats.total_hot_skips = stats_.hot_skip_cnt;
   }
   return stats;
 }
 
+void TieredStorage::Touch(string_view key, const PrimeValue& value) {
+  ++(value.IsExternal() ? stats_.miss_cnt : stats_.hit_cnt);
+  if (sketch_)
+    sketch_->Touch(CompactObj::HashCode(key));
+}
+
 void TieredStorage::RunOffloading(DbIndex dbid) {
   if (SliceSnapshot::IsSnaphotInProgress())
     return;
 
   auto cb = [this, dbid, tmp = std::string{}](PrimeIterator it) mutable {
-    TryStash(dbid, it->first.GetSlice(&tmp), &it->second);
+    offloading_pass_.stashed += TryStash(dbid, it->first.GetSlice(&tmp), &it->second);
   };
 
   PrimeTable& table = op_manager_->db_slice_->GetDBTable(dbid)->prime;
@@ -389,11 +725,84 @@ void TieredStorage::RunOffloading(DbIndex dbid) {
       break;
     offloading_cursor_ = table.TraverseBySegmentOrder(offloading_cursor_, cb);
   } while (offloading_cursor_ != start_cursor && iterations++ < 500);
+
+  if (offloading_cursor_ == start_cursor)
+    AdaptHotFrequency();
 }
 
-bool TieredStorage::ShouldStash(const PrimeValue& pv) const {
-  return !pv.IsExternal() && !pv.HasIoPending() && pv.ObjType() == OBJ_STRING &&
-         pv.Size() >= kMinValueSize;
+void TieredStorage::AdaptHotFrequency() {
+  if (sketch_) {
+    bool had_hot_skips = stats_.hot_skip_cnt > offloading_pass_.start_hot_skips;
+    if (offloading_pass_.stashed == 0 && had_hot_skips) {
+      // Only hot values are left, but memory is still above the offloading threshold
+      hot_frequency_ = min(hot_frequency_ + 1, tiering::FrequencySketch::kMaxFrequency + 1);
+    } else if (offloading_pass_.stashed > 0 && hot_frequency_ > base_hot_frequency_) {
+      hot_frequency_--;
+    }
+    VLOG(1) << "Hot frequency after offloading pass: " << hot_frequency_;
+  }
+  offloading_pass_ = {0, stats_.hot_skip_cnt};
+}
+
+void TieredStorage::RunCompaction(DbIndex dbid, size_t memory_headroom) {
+  // Pages are freed by regular deletes too, so they're released even if relocation doesn't run.
+  // Pages freed by relocations of this run are released by the next one
+  op_manager_->storage_.ReclaimUnusedPages();
+
+  if (compaction_utilization_ <= 0)
+    return;
+
+  // Values read by the previous run are written even during snapshots, as they don't change
+  op_manager_->WriteRelocated();
+
+  if (SliceSnapshot::IsSnaphotInProgress())
+    return;
+
+  auto cb = [this, dbid, tmp = std::string{}](PrimeIterator it) mutable {
+    if (it->second.IsExternal()) {
+      KeyRef key{dbid, it->first.GetSlice(&tmp)};
+      op_manager_->TryRelocate(key, it->second, compaction_utilization_);
+    }
+  };
+
+  PrimeTable& table = op_manager_->db_slice_->GetDBTable(dbid)->prime;
+  PrimeTable::Cursor start_cursor{};
+
+  // Relocated values are held in memory until they're written by the next run, so their number
+  // is limited the same way as for stashes and their size by the available memory
+  size_t iterations = 0;
+  do {
+    if (op_manager_->relocating_.size() >= write_depth_limit_ ||
+        op_manager_->relocating_bytes_ >= memory_headroom)
+      break;
+    compaction_cursor_ = table.TraverseBySegmentOrder(compaction_cursor_, cb);
+  } while (compaction_cursor_ != start_cursor && iterations++ < 500);
+}
+
+bool TieredStorage::ShouldStash(DbIndex dbid, string_view key, const PrimeValue& pv) {
+  if (pv.IsExternal() || pv.HasIoPending())
+    return false;
+
+  if (pv.ObjType() == OBJ_STRING) {
+    if (pv.Size() < kMinValueSize)
+      return false;
+  } else if (!offload_containers_ || !tiering::IsSerializable(pv) ||
+             tiering::SerializedSize(pv) < kMinValueSize || IsIndexedContainer(key, pv) ||
+             IsLockedContainer(*op_manager_->db_slice_, dbid, key, pv)) {
+    return false;
+  }
+
+  if (IsHot(key)) {
+    ++stats_.hot_skip_cnt;
+    return false;
+  }
+  return true;
+}
+
+bool TieredStorage::IsHot(string_view key) const {
+  if (!sketch_)
+    return false;
+  return sketch_->Estimate(CompactObj::HashCode(key)) >= hot_frequency_;
 }
 
 }  // namespace dfly
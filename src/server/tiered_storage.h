@@ -3,6 +3,7 @@
 //
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <utility>
 
@@ -21,7 +22,9 @@ namespace dfly {
 class DbSlice;
 
 namespace tiering {
+class FrequencySketch;
 class SmallBins;
+class ValueCompressor;
 };
 
 // Manages offloaded values
@@ -50,11 +53,23 @@ class TieredStorage {
   void Read(DbIndex dbid, std::string_view key, const PrimeValue& value,
             std::function<void(const std::string&)> readf);
 
+  // Load offloaded value back to memory. Blocks until the read finishes, so the value must be
+  // looked up again afterwards. Used for containers that can't be accessed in offloaded form
+  void Load(DbIndex dbid, std::string_view key, const PrimeValue& value);
+
+  // Start loading offloaded value back to memory without waiting for the read to finish
+  void StartLoad(DbIndex dbid, std::string_view key, const PrimeValue& value);
+
   // Apply modification to offloaded value, return generic result from callback
   template <typename T>
   util::fb2::Future<T> Modify(DbIndex dbid, std::string_view key, const PrimeValue& value,
                               std::function<T(std::string*)> modf);
 
+  // Reads issued between BeginReadBatch() and EndReadBatch() are submitted together, with
+  // reads of adjacent pages merged. Reads can't be awaited before the batch is ended.
+  void BeginReadBatch();
+  void EndReadBatch();
+
   // Stash value. Sets IO_PENDING flag and unsets it on error or when finished
   // Returns true if item was scheduled for stashing.
   bool TryStash(DbIndex dbid, std::string_view key, PrimeValue* value);
@@ -70,22 +85,60 @@ class TieredStorage {
 
   TieredStats GetStats() const;
 
+  // Record access to key. Frequently accessed values are considered hot: they're not offloaded
+  // and are kept in memory once read
+  void Touch(std::string_view key, const PrimeValue& value);
+
   // Run offloading loop until i/o device is loaded or all entries were traversed
   void RunOffloading(DbIndex dbid);
 
+  // Relocate values from underutilized pages of the backing file and release unused pages.
+  // Relocated values are buffered in memory only up to memory_headroom bytes
+  void RunCompaction(DbIndex dbid, size_t memory_headroom);
+
+  // Returns true if the shard has offloaded containers
+  bool HasOffloadedContainers() const {
+    return offloaded_containers_ > 0;
+  }
+
  private:
   // Returns if a value should be stashed
-  bool ShouldStash(const PrimeValue& pv) const;
+  bool ShouldStash(DbIndex dbid, std::string_view key, const PrimeValue& pv);
+
+  // Returns true if key is accessed frequently enough to be kept in memory. Always false if
+  // access tracking is disabled
+  bool IsHot(std::string_view key) const;
+
+  // Adjust hot_frequency_ after a full pass of RunOffloading
+  void AdaptHotFrequency();
 
  private:
   PrimeTable::Cursor offloading_cursor_{};  // where RunOffloading left off
+  PrimeTable::Cursor compaction_cursor_{};  // where RunCompaction left off
 
   std::unique_ptr<ShardOpManager> op_manager_;
   std::unique_ptr<tiering::SmallBins> bins_;
+  std::unique_ptr<tiering::ValueCompressor> compressor_;
+  std::unique_ptr<tiering::FrequencySketch> sketch_;  // null if access tracking is disabled
   unsigned write_depth_limit_ = 10;
+  bool offload_containers_ = false;
+  size_t offloaded_containers_ = 0;
+  float compaction_utilization_ = 0;
+
+  // Min estimated access frequency of hot values. Starts at the configured value and is raised
+  // if offloading can't find cold values, so that memory pressure can always be relieved
+  unsigned hot_frequency_ = 0, base_hot_frequency_ = 0;
+
+  struct {
+    size_t stashed = 0;
+    uint64_t start_hot_skips = 0;
+  } offloading_pass_;  // progress of current full traversal of RunOffloading
+
   struct {
     uint64_t stash_overflow_cnt = 0;
     uint64_t total_deletes = 0;
+    uint64_t hit_cnt = 0, miss_cnt = 0;
+    uint64_t hot_skip_cnt = 0;
   } stats_;
 };
 
@@ -125,6 +178,18 @@ class TieredStorage {
     return {};
   }
 
+  void Load(DbIndex dbid, std::string_view key, const PrimeValue& value) {
+  }
+
+  void StartLoad(DbIndex dbid, std::string_view key, const PrimeValue& value) {
+  }
+
+  void BeginReadBatch() {
+  }
+
+  void EndReadBatch() {
+  }
+
   template <typename T>
   util::fb2::Future<T> Modify(DbIndex dbid, std::string_view key, const PrimeValue& value,
                               std::function<T(std::string*)> modf) {
@@ -148,8 +213,18 @@ class TieredStorage {
     return {};
   }
 
+  void Touch(std::string_view key, const PrimeValue& value) {
+  }
+
   void RunOffloading(DbIndex dbid) {
   }
+
+  void RunCompaction(DbIndex dbid, size_t memory_headroom) {
+  }
+
+  bool HasOffloadedContainers() const {
+    return false;
+  }
 };
 
 }  // namespace dfly
@@ -16,6 +16,7 @@
 #include "gtest/gtest.h"
 #include "server/engine_shard_set.h"
 #include "server/test_utils.h"
+#include "server/tiering/compression.h"
 #include "util/fibers/fibers.h"
 
 using namespace std;
@@ -27,6 +28,10 @@ ABSL_DECLARE_FLAG(bool, tiered_storage_cache_fetched);
 ABSL_DECLARE_FLAG(bool, backing_file_direct);
 ABSL_DECLARE_FLAG(float, tiered_offload_threshold);
 ABSL_DECLARE_FLAG(unsigned, tiered_storage_write_depth);
+ABSL_DECLARE_FLAG(bool, tiered_experimental_container_support);
+ABSL_DECLARE_FLAG(float, tiered_storage_compaction_utilization);
+ABSL_DECLARE_FLAG(dfly::tiering::CompressionKind, tiered_storage_compression);
+ABSL_DECLARE_FLAG(unsigned, tiered_storage_hot_frequency);
 
 namespace dfly {
 
@@ -207,6 +212,27 @@ TEST_F(TieredStorageTest, BackgroundOffloading) {
   EXPECT_EQ(metrics.tiered_stats.allocated_bytes, kNum * 4096);
 }
 
+// Pages of deleted values are released even if compaction is disabled
+TEST_F(TieredStorageTest, ReclaimDeletedPages) {
+  absl::FlagSaver saver;
+  SetFlag(&FLAGS_tiered_offload_threshold, 0.0f);  // offload all values
+
+  const int kNum = 100;
+
+  max_memory_limit = kNum * 4096;
+  pp_->at(0)->AwaitBrief([] { EngineShard::tlocal()->TEST_EnableHeartbeat(); });
+
+  for (size_t i = 0; i < kNum; i++) {
+    Run({"SET", absl::StrCat("k", i), BuildString(3000)});
+  }
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == kNum; });
+
+  for (size_t i = 0; i < kNum; i++) {
+    Run({"DEL", absl::StrCat("k", i)});
+  }
+  ExpectConditionWithinTimeout([&] { return GetMetrics().tiered_stats.reclaimed_bytes > 0; });
+}
+
 TEST_F(TieredStorageTest, FlushAll) {
   absl::FlagSaver saver;
   SetFlag(&FLAGS_tiered_offload_threshold, 0.0f);  // offload all values
@@ -251,4 +277,200 @@ TEST_F(TieredStorageTest, FlushPending) {
   EXPECT_EQ(GetMetrics().tiered_stats.small_bins_filling_bytes, 0u);
 }
 
+TEST_F(TieredStorageTest, OffloadAndLoad) {
+  absl::FlagSaver saver;
+  SetFlag(&FLAGS_tiered_experimental_container_support, true);  // offload containers
+  ResetService();
+
+  SetFlag(&FLAGS_tiered_offload_threshold, 0.0f);  // offload all values
+
+  max_memory_limit = 100 * 4096;
+  pp_->at(0)->AwaitBrief([] { EngineShard::tlocal()->TEST_EnableHeartbeat(); });
+
+  for (size_t i = 0; i < 10; i++) {
+    Run({"HSET", "hash", absl::StrCat("f", i), BuildString(100, 'a' + i)});
+    Run({"ZADD", "zset", absl::StrCat(i), BuildString(100, 'a' + i)});
+    Run({"RPUSH", "list", BuildString(100, 'a' + i)});
+    Run({"SADD", "set", absl::StrCat(i * 1000)});
+  }
+  for (size_t i = 10; i < 50; i++)
+    Run({"SADD", "set", absl::StrCat(i * 1000)});
+
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == 4; });
+
+  EXPECT_EQ(Run({"TYPE", "hash"}), "hash");
+  EXPECT_EQ(Run({"HGET", "hash", "f3"}), BuildString(100, 'd'));
+  EXPECT_EQ(Run({"ZSCORE", "zset", BuildString(100, 'e')}), "4");
+  EXPECT_EQ(Run({"LINDEX", "list", "-1"}), BuildString(100, 'j'));
+  EXPECT_THAT(Run({"SISMEMBER", "set", "49000"}), IntArg(1));
+
+  // Wait for all containers to be offloaded again and modify them
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == 4; });
+  EXPECT_THAT(Run({"HSET", "hash", "f10", "v"}), IntArg(1));
+  EXPECT_THAT(Run({"HLEN", "hash"}), IntArg(11));
+
+  // Transactions load containers of all their keys after locking them
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == 4; });
+  Run({"MULTI"});
+  Run({"LLEN", "list"});
+  Run({"SCARD", "set"});
+  EXPECT_THAT(Run({"EXEC"}).GetVec(), ElementsAre(IntArg(10), IntArg(50)));
+  EXPECT_THAT(Run({"DEL", "zset", "list", "set"}), IntArg(3));
+}
+
+TEST_F(TieredStorageTest, IndexedHashes) {
+  absl::FlagSaver saver;
+  SetFlag(&FLAGS_tiered_experimental_container_support, true);  // offload containers
+  ResetService();
+
+  SetFlag(&FLAGS_tiered_offload_threshold, 0.0f);  // offload all values
+
+  max_memory_limit = 100 * 4096;
+  pp_->at(0)->AwaitBrief([] { EngineShard::tlocal()->TEST_EnableHeartbeat(); });
+
+  const size_t kNum = 10;
+  for (size_t i = 0; i < kNum; i++) {
+    Run({"HSET", absl::StrCat("doc:", i), "tag", i % 2 ? "odd" : "even", "text",
+         BuildString(100)});
+  }
+  Run({"PEXPIRE", "doc:0", "1000"});
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == kNum; });
+
+  // Offloaded documents are loaded back by the rebuild. Delete and expire them meanwhile
+  Run({"FT.CREATE", "idx", "ON", "HASH", "PREFIX", "1", "doc:", "SCHEMA", "tag", "TAG"});
+  EXPECT_THAT(Run({"DEL", "doc:1"}), IntArg(1));
+  ExpectConditionWithinTimeout([&] { return Run({"EXISTS", "doc:0"}).GetInt() == 0; });
+
+  auto count_docs = [this](string_view tag) {
+    auto resp = Run({"FT.SEARCH", "idx", absl::StrCat("@tag:{", tag, "}"), "NOCONTENT"});
+    return *resp.GetVec()[0].GetInt();
+  };
+  ExpectConditionWithinTimeout([&] { return count_docs("even") == 4 && count_docs("odd") == 4; });
+
+  // Indexed documents are kept in memory
+  EXPECT_EQ(GetMetrics().db_stats[0].tiered_entries, 0u);
+  Run({"HSET", "doc:2", "tag", "odd"});
+  EXPECT_EQ(count_docs("odd"), 5);
+  EXPECT_THAT(Run({"DEL", "doc:2", "doc:3"}), IntArg(2));
+  EXPECT_EQ(count_docs("odd"), 3);
+}
+
+TEST_F(TieredStorageTest, RelocateSparsePages) {
+  absl::FlagSaver saver;
+  SetFlag(&FLAGS_tiered_storage_compaction_utilization, 0.2f);  // relocate from sparse pages
+  ResetService();
+
+  SetFlag(&FLAGS_tiered_offload_threshold, 0.0f);  // offload all values
+
+  const int kNum = 500, kSmallNum = 100;
+
+  max_memory_limit = kNum * 4096;
+  pp_->at(0)->AwaitBrief([] { EngineShard::tlocal()->TEST_EnableHeartbeat(); });
+
+  // Small bins share pages with values occupying whole pages
+  for (size_t i = 0; i < kNum; i++) {
+    Run({"SET", absl::StrCat("k", i), BuildString(3000)});
+    if (i < kSmallNum)
+      Run({"SET", absl::StrCat("s", i), BuildString(500)});
+  }
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries >= kNum; });
+
+  // Leave only every 10th large value, so all pages become sparsely used
+  for (size_t i = 0; i < kNum; i++) {
+    if (i % 10 != 0)
+      Run({"DEL", absl::StrCat("k", i)});
+  }
+
+  // Values and bins from sparse pages are moved to other pages and the emptied pages are released
+  ExpectConditionWithinTimeout([&] { return GetMetrics().tiered_stats.reclaimed_bytes > 0; });
+
+  // Every remaining value or bin is relocated at most once
+  auto metrics = GetMetrics();
+  EXPECT_GT(metrics.tiered_stats.total_relocations, 0u);
+  EXPECT_LE(metrics.tiered_stats.total_relocations,
+            kNum / 10 + metrics.tiered_stats.small_bins_cnt);
+
+  for (size_t i = 0; i < kNum; i += 10) {
+    EXPECT_EQ(Run({"GET", absl::StrCat("k", i)}), BuildString(3000));
+  }
+  for (size_t i = 0; i < kSmallNum; i++) {
+    EXPECT_EQ(Run({"GET", absl::StrCat("s", i)}), BuildString(500));
+  }
+}
+
+TEST_F(TieredStorageTest, CompressedValues) {
+  absl::FlagSaver saver;
+  SetFlag(&FLAGS_tiered_storage_compression, tiering::CompressionKind::ZSTD);
+  ResetService();
+
+  SetFlag(&FLAGS_tiered_offload_threshold, 0.0f);  // offload all values
+
+  const int kNum = 100;
+
+  max_memory_limit = kNum * 4096;
+  pp_->at(0)->AwaitBrief([] { EngineShard::tlocal()->TEST_EnableHeartbeat(); });
+
+  auto value = [](size_t i, size_t len) {
+    string out;
+    while (out.size() < len)
+      absl::StrAppend(&out, "{\"id\": ", i, ", \"name\": \"item\"}");
+    out.resize(len);
+    return out;
+  };
+
+  // Values that occupy whole pages are compressed into small bins or less pages
+  for (size_t i = 0; i < kNum; i++) {
+    Run({"SET", absl::StrCat("k", i), value(i, i % 2 ? 3000 : 20000)});
+  }
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == kNum; });
+
+  auto metrics = GetMetrics();
+  EXPECT_LT(metrics.db_stats[0].tiered_used_bytes, kNum * 3000);
+  EXPECT_GT(metrics.tiered_stats.small_bins_entries_cnt, 0u);
+
+  for (size_t i = 0; i < kNum; i++) {
+    size_t len = i % 2 ? 3000 : 20000;
+    EXPECT_THAT(Run({"STRLEN", absl::StrCat("k", i)}), IntArg(len));
+    EXPECT_EQ(Run({"GET", absl::StrCat("k", i)}), value(i, len));
+  }
+
+  // Modify offloaded values
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == kNum; });
+  EXPECT_THAT(Run({"APPEND", "k0", "B"}), IntArg(20001));
+  EXPECT_THAT(Run({"APPEND", "k1", "B"}), IntArg(3001));
+  EXPECT_EQ(Run({"GET", "k0"}), value(0, 20000) + 'B');
+  EXPECT_EQ(Run({"GET", "k1"}), value(1, 3000) + 'B');
+}
+
+TEST_F(TieredStorageTest, KeepHotValues) {
+  absl::FlagSaver saver;
+  SetFlag(&FLAGS_tiered_storage_hot_frequency, 3u);  // keep values accessed 3 times
+  ResetService();
+
+  const int kNum = 10;
+  for (size_t i = 0; i < kNum; i++) {
+    Run({"SET", absl::StrCat("k", i), BuildString(3000)});
+  }
+  ExpectConditionWithinTimeout([&] { return GetMetrics().db_stats[0].tiered_entries == kNum; });
+
+  // Values read only once stay offloaded, frequently read values are promoted to memory
+  EXPECT_EQ(Run({"GET", "k1"}), BuildString(3000));
+  for (size_t i = 0; i < 5; i++) {
+    EXPECT_EQ(Run({"GET", "k0"}), BuildString(3000));
+  }
+
+  auto metrics = GetMetrics();
+  EXPECT_EQ(metrics.db_stats[0].tiered_entries, kNum - 1);
+  EXPECT_EQ(metrics.tiered_stats.total_promotes, 1u);
+  EXPECT_GE(metrics.tiered_stats.total_misses, 4u);
+  EXPECT_EQ(metrics.tiered_stats.total_hot_skips, 0u);
+
+  // Hot values are not offloaded
+  Run({"SET", "k0", BuildString(3000, 'B')});
+  metrics = GetMetrics();
+  EXPECT_EQ(metrics.tiered_stats.total_hot_skips, 1u);
+  EXPECT_EQ(metrics.db_stats[0].tiered_entries, kNum - 1);
+  EXPECT_EQ(Run({"GET", "k0"}), BuildString(3000, 'B'));
+}
+
 }  // namespace dfly
@@ -0,0 +1,112 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "server/tiering/compression.h"
+
+#include <absl/strings/str_cat.h>
+#include <lz4.h>
+#include <zstd.h>
+
+#include "base/logging.h"
+
+namespace dfly::tiering {
+
+using namespace std;
+
+namespace {
+
+// Compressed blobs are used only if they're at least 1/8 smaller, otherwise the cost of
+// decompression on every read is not worth it
+bool IsWorthIt(size_t compressed, size_t raw) {
+  return compressed + raw / 8 <= raw;
+}
+
+}  // namespace
+
+bool AbslParseFlag(string_view in, CompressionKind* flag, string* err) {
+  if (in == "none") {
+    *flag = CompressionKind::NONE;
+    return true;
+  }
+  if (in == "lz4") {
+    *flag = CompressionKind::LZ4;
+    return true;
+  }
+  if (in == "zstd") {
+    *flag = CompressionKind::ZSTD;
+    return true;
+  }
+
+  *err = absl::StrCat("Unknown value ", in, " for compression kind");
+  return false;
+}
+
+string AbslUnparseFlag(CompressionKind flag) {
+  switch (flag) {
+    case CompressionKind::NONE:
+      return "none";
+    case CompressionKind::LZ4:
+      return "lz4";
+    case CompressionKind::ZSTD:
+      return "zstd";
+  }
+  DCHECK(false) << "Unknown compression kind " << int(flag);
+  return "none";
+}
+
+ValueCompressor::ValueCompressor(CompressionKind kind) : kind_{kind} {
+  if (kind_ == CompressionKind::ZSTD)
+    zstd_cctx_ = ZSTD_createCCtx();
+}
+
+ValueCompressor::~ValueCompressor() {
+  if (zstd_cctx_)
+    ZSTD_freeCCtx(zstd_cctx_);
+}
+
+string_view ValueCompressor::Compress(string_view value, string* scratch) {
+  size_t compressed_size = 0;
+  switch (kind_) {
+    case CompressionKind::NONE:
+      return {};
+    case CompressionKind::LZ4: {
+      scratch->resize(LZ4_compressBound(value.size()));
+      int res = LZ4_compress_default(value.data(), scratch->data(), value.size(), scratch->size());
+      if (res <= 0)
+        return {};
+      compressed_size = res;
+      break;
+    }
+    case CompressionKind::ZSTD: {
+      scratch->resize(ZSTD_compressBound(value.size()));
+      size_t res = ZSTD_compressCCtx(zstd_cctx_, scratch->data(), scratch->size(), value.data(),
+                                     value.size(), 1 /* level */);
+      if (ZSTD_isError(res))
+        return {};
+      compressed_size = res;
+      break;
+    }
+  }
+
+  if (!IsWorthIt(compressed_size, value.size()))
+    return {};
+  return string_view{*scratch}.substr(0, compressed_size);
+}
+
+bool Decompress(CompressionKind kind, string_view blob, size_t raw_size, string* dest) {
+  dest->resize(raw_size);
+  switch (kind) {
+    case CompressionKind::NONE:
+      dest->assign(blob);
+      return true;
+    case CompressionKind::LZ4:
+      return LZ4_decompress_safe(blob.data(), dest->data(), blob.size(), raw_size) ==
+             int(raw_size);
+    case CompressionKind::ZSTD:
+      return ZSTD_decompress(dest->data(), raw_size, blob.data(), blob.size()) == raw_size;
+  }
+  return false;
+}
+
+}  // namespace dfly::tiering
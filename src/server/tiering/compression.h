@@ -0,0 +1,48 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+typedef struct ZSTD_CCtx_s ZSTD_CCtx;
+
+namespace dfly::tiering {
+
+// Compression method of offloaded blobs. Values are stored in external pointers, so they must
+// not change and fit into 4 bits
+enum class CompressionKind : uint8_t { NONE = 0, LZ4 = 1, ZSTD = 2 };
+
+bool AbslParseFlag(std::string_view in, CompressionKind* flag, std::string* err);
+std::string AbslUnparseFlag(CompressionKind flag);
+
+// Compresses values before they are offloaded. Owned by a single shard
+class ValueCompressor {
+ public:
+  explicit ValueCompressor(CompressionKind kind);
+  ~ValueCompressor();
+
+  ValueCompressor(const ValueCompressor&) = delete;
+  ValueCompressor& operator=(const ValueCompressor&) = delete;
+
+  // Compress value into scratch. Returns empty view if compression is disabled or it doesn't
+  // reduce the size substantially
+  std::string_view Compress(std::string_view value, std::string* scratch);
+
+  CompressionKind kind() const {
+    return kind_;
+  }
+
+ private:
+  CompressionKind kind_;
+  ZSTD_CCtx* zstd_cctx_ = nullptr;
+};
+
+// Decompress blob of given kind into dest, raw_size is the size of the uncompressed blob.
+// Returns false if the blob is corrupted
+bool Decompress(CompressionKind kind, std::string_view blob, size_t raw_size, std::string* dest);
+
+}  // namespace dfly::tiering
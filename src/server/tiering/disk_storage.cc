@@ -4,6 +4,8 @@
 
 #include "server/tiering/disk_storage.h"
 
+#include <linux/falloc.h>
+
 #include <system_error>
 
 #include "base/flags.h"
@@ -117,6 +119,7 @@ void DiskStorage::Read(DiskSegment segment, ReadCb cb) {
   };
 
   pending_ops_++;
+  read_cnt_++;
   if (buf.buf_idx)
     backing_file_->ReadFixedAsync(buf.bytes, segment.offset, *buf.buf_idx, std::move(io_cb));
   else
@@ -127,7 +130,37 @@ void DiskStorage::MarkAsFree(DiskSegment segment) {
   DCHECK_GT(segment.length, 0u);
   DCHECK_EQ(segment.offset % kPageSize, 0u);
 
-  alloc_.Free(segment.offset, segment.length);
+  if (auto page = alloc_.Free(segment.offset, segment.length); page)
+    unused_pages_.push_back(*page);
+}
+
+bool DiskStorage::ShouldRelocate(DiskSegment segment, float min_utilization) {
+  return alloc_.DrainIfUnderutilized(segment.offset, min_utilization);
+}
+
+void DiskStorage::ReclaimUnusedPages() {
+  std::vector<DiskSegment> pages = std::move(unused_pages_);
+  unused_pages_.clear();
+
+  for (DiskSegment page : pages) {
+    // The page could've been reused in the meantime. Otherwise keep it reserved while the
+    // operation is in flight, so it's not handed out for new stashes.
+    if (!backing_file_ || !alloc_.ReservePage(page))
+      continue;
+
+    pending_ops_++;
+    auto ec = DoFiberCall(&SubmitEntry::PrepFallocate, backing_file_->fd(),
+                          FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off_t(page.offset),
+                          off_t(page.length));
+    pending_ops_--;
+
+    alloc_.UnreservePage(page);
+    if (ec) {
+      LOG_FIRST_N(ERROR, 10) << "Could not punch hole in backing file: " << ec.message();
+      continue;
+    }
+    reclaimed_bytes_ += page.length;
+  }
 }
 
 std::error_code DiskStorage::Stash(io::Bytes bytes, StashCb cb) {
@@ -174,7 +207,8 @@ std::error_code DiskStorage::Stash(io::Bytes bytes, StashCb cb) {
 }
 
 DiskStorage::Stats DiskStorage::GetStats() const {
-  return {alloc_.allocated_bytes(), alloc_.capacity(), heap_buf_alloc_cnt_, reg_buf_alloc_cnt_};
+  return {alloc_.allocated_bytes(), alloc_.capacity(), heap_buf_alloc_cnt_, reg_buf_alloc_cnt_,
+          reclaimed_bytes_, read_cnt_};
 }
 
 std::error_code DiskStorage::Grow(off_t grow_size) {
@@ -22,6 +22,8 @@ class DiskStorage {
     size_t capacity_bytes = 0;
     uint64_t heap_buf_alloc_count = 0;
     uint64_t registered_buf_alloc_count = 0;
+    uint64_t reclaimed_bytes = 0;
+    uint64_t read_count = 0;  // reads submitted to the backing file
   };
 
   using ReadCb = std::function<void(std::string_view, std::error_code)>;
@@ -38,6 +40,14 @@ class DiskStorage {
   // Mark segment as free, performed immediately
   void MarkAsFree(DiskSegment segment);
 
+  // Returns true if segment lies in an underutilized region of the backing file. Values stored in
+  // such regions should be relocated, no new values are placed there until they are freed.
+  bool ShouldRelocate(DiskSegment segment, float min_utilization);
+
+  // Punch holes in the backing file for pages that became unused, so the file system can release
+  // the disk space. Blocks, so it must not be called from i/o callbacks
+  void ReclaimUnusedPages();
+
   // Request bytes to be stored, cb will be called with assigned segment on completion. Can block to
   // grow backing file. Returns error code if operation failed  immediately (most likely it failed
   // to grow the backing file) or passes an empty segment if the final write operation failed.
@@ -55,11 +65,14 @@ class DiskStorage {
 
   // how many times we allocate registered/heap buffers.
   uint64_t heap_buf_alloc_cnt_ = 0, reg_buf_alloc_cnt_ = 0;
+  uint64_t read_cnt_ = 0;
 
   bool grow_pending_ = false;
   std::unique_ptr<util::fb2::LinuxFile> backing_file_;
 
   ExternalAllocator alloc_;
+  std::vector<DiskSegment> unused_pages_;  // pages to reclaim with ReclaimUnusedPages
+  uint64_t reclaimed_bytes_ = 0;
 };
 
 };  // namespace dfly::tiering
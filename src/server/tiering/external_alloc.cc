@@ -144,6 +144,7 @@ struct Page {
   // need some mapping function to map from block_size to real_block_size given Page class.
   BinIdx bin_idx;
   uint8_t segment_inuse : 1;  // true if segment allocated this page.
+  uint8_t draining : 1;       // true if page is excluded from allocations until it's unused.
   uint8_t reserved[3];
 
   // can be computed via free_blocks.count().
@@ -366,17 +367,9 @@ int64_t ExternalAllocator::Malloc(size_t sz) {
   return seg->BlockOffset(page, pos);
 }
 
-void ExternalAllocator::Free(size_t offset, size_t sz) {
-  size_t idx = offset / 256_MB;
+std::optional<DiskSegment> ExternalAllocator::Free(size_t offset, size_t sz) {
+  auto [seg, page] = LocatePage(offset);
   size_t delta = offset % 256_MB;
-  CHECK_LT(idx, segments_.size());
-  CHECK(segments_[idx]);
-
-  SegmentDescr* seg = segments_[idx];
-  unsigned page_id = delta >> seg->page_shift();
-  CHECK_LT(page_id, seg->capacity());
-
-  Page* page = seg->GetPage(page_id);
   unsigned page_size = (1 << seg->page_shift());
   unsigned block_offs = delta % page_size;
   unsigned block_size = ToBlockSize(page->bin_idx);
@@ -391,16 +384,65 @@ void ExternalAllocator::Free(size_t offset, size_t sz) {
   ++page->available;
 
   DCHECK_EQ(page->available, page->free_blocks.count());
+  allocated_bytes_ -= block_size;
+
   // If page becomes fully free, return it to segment list, otherwise if it just became non-empty,
-  // then return it to free pages list
+  // then return it to free pages list. Draining pages are kept out of the free pages list.
   if (page->available == blocks_num) {
+    DiskSegment page_segment{seg->BlockOffset(page, 0), page_size};
     FreePage(page, seg, block_size);
-  } else if (page->available == 1) {
+    return page_segment;
+  } else if (page->available == 1 && !page->draining) {
     DCHECK_NE(page, free_pages_[page->bin_idx]);
     page->next_free = free_pages_[page->bin_idx];
     free_pages_[page->bin_idx] = page;
   }
-  allocated_bytes_ -= block_size;
+  return std::nullopt;
+}
+
+bool ExternalAllocator::DrainIfUnderutilized(size_t offset, float ratio) {
+  auto [seg, page] = LocatePage(offset);
+  if (page->draining)
+    return true;
+
+  // Don't drain the page that is currently being filled
+  if (free_pages_[page->bin_idx] == page)
+    return false;
+
+  unsigned blocks_num = (1 << seg->page_shift()) / ToBlockSize(page->bin_idx);
+  unsigned used = blocks_num - page->available;
+  if (used >= blocks_num * ratio)
+    return false;
+
+  page->draining = 1;
+  UnlinkFreePage(page, page->bin_idx);
+  return true;
+}
+
+bool ExternalAllocator::ReservePage(DiskSegment segment) {
+  auto [seg, page] = LocatePage(segment.offset);
+  if (page->segment_inuse)
+    return false;
+
+  page->segment_inuse = 1;
+  ++seg->page_info_.used;
+
+  // Unlink fully booked segment, so it's linked back properly once the page is returned
+  if (!seg->HasFreePages()) {
+    auto& sq = sq_[seg->page_class()];
+    if (sq == seg)
+      sq = seg->Detach();
+    else
+      seg->Detach();
+  }
+  return true;
+}
+
+void ExternalAllocator::UnreservePage(DiskSegment segment) {
+  auto [seg, page] = LocatePage(segment.offset);
+  DCHECK(page->segment_inuse);
+  DCHECK_EQ(page->available, 0u);
+  ReturnPage(page, seg);
 }
 
 void ExternalAllocator::AddStorage(size_t start, size_t size) {
@@ -488,21 +530,40 @@ void ExternalAllocator::FreePage(Page* page, SegmentDescr* owner, size_t block_s
   // page is fully free. Return it to the segment even if it's
   // referenced via free_pages_. The allows more elasticity by potentially reassigning
   // it to other bin sizes.
-  BinIdx bidx = ToBinIdx(block_size);
+  UnlinkFreePage(page, ToBinIdx(block_size));
+  ReturnPage(page, owner);
+}
+
+auto ExternalAllocator::LocatePage(size_t offset) -> std::pair<SegmentDescr*, Page*> {
+  size_t idx = offset / 256_MB;
+  size_t delta = offset % 256_MB;
+  CHECK_LT(idx, segments_.size());
+  CHECK(segments_[idx]);
 
+  SegmentDescr* seg = segments_[idx];
+  unsigned page_id = delta >> seg->page_shift();
+  CHECK_LT(page_id, seg->capacity());
+
+  return {seg, seg->GetPage(page_id)};
+}
+
+void ExternalAllocator::UnlinkFreePage(Page* page, uint8_t bin_idx) {
   // Remove fast allocation reference.
-  if (free_pages_[bidx] == page) {
-    free_pages_[bidx] = page->next_free ? page->next_free : &empty_page;
+  if (free_pages_[bin_idx] == page) {
+    free_pages_[bin_idx] = page->next_free ? page->next_free : &empty_page;
   } else {
-    for (auto* cur = free_pages_[bidx]; cur != nullptr; cur = cur->next_free) {
+    for (auto* cur = free_pages_[bin_idx]; cur != nullptr; cur = cur->next_free) {
       if (cur->next_free == page) {
         cur->next_free = page->next_free;
         break;
       }
     }
   }
+}
 
+void ExternalAllocator::ReturnPage(Page* page, SegmentDescr* owner) {
   page->segment_inuse = 0;
+  page->draining = 0;
   page->available = 0;
   page->next_free = nullptr;
 
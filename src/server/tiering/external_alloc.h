@@ -5,6 +5,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <vector>
 
 #include "core/extent_tree.h"
@@ -61,7 +62,21 @@ class ExternalAllocator {
   // size sz.
   int64_t Malloc(size_t sz);
 
-  void Free(size_t offset, size_t sz);
+  // Frees the block. Returns the range of its page if the page became unused as a result.
+  std::optional<DiskSegment> Free(size_t offset, size_t sz);
+
+  // Returns true if the block at offset belongs to a page with less than ratio of its blocks in
+  // use. Such pages are excluded from allocations until all their blocks are freed, so that
+  // relocating the remaining blocks makes them unused. The page being currently filled is never
+  // drained.
+  bool DrainIfUnderutilized(size_t offset, float ratio);
+
+  // Marks an unused page as used, so it's not handed out by Malloc while the underlying storage
+  // is being modified. Returns false if the page was taken in the meantime.
+  bool ReservePage(DiskSegment page);
+
+  // Returns page reserved with ReservePage back to the pool of unused pages.
+  void UnreservePage(DiskSegment page);
 
   /// Adds backing storage to the allocator. The range should not overlap with already
   /// added storage ranges.
@@ -92,6 +107,15 @@ class ExternalAllocator {
   SegmentDescr* GetNewSegment(detail::PageClass sc);
   void FreePage(Page* page, SegmentDescr* owner, size_t block_size);
 
+  // Returns segment and page that contain offset.
+  std::pair<SegmentDescr*, Page*> LocatePage(size_t offset);
+
+  // Removes page from the free_pages_ list of its bin if present.
+  void UnlinkFreePage(Page* page, uint8_t bin_idx);
+
+  // Returns unused page to its segment.
+  void ReturnPage(Page* page, SegmentDescr* owner);
+
   static SegmentDescr* ToSegDescr(Page*);
 
   SegmentDescr* sq_[2];                      // map: PageClass -> free Segment.
@@ -146,4 +146,45 @@ TEST_F(ExternalAllocatorTest, EmptyFull) {
     EXPECT_GT(ext_alloc_.Malloc(kAllocSize), 0u);
 }
 
+TEST_F(ExternalAllocatorTest, DrainPage) {
+  const size_t kBlocksInPage = 1_MB / kMinBlockSize;
+  ext_alloc_.AddStorage(0, kSegSize);
+
+  // Fill up first two pages and start filling the third one
+  vector<int64_t> offsets;
+  for (size_t i = 0; i < kBlocksInPage * 2 + 1; i++)
+    offsets.push_back(ext_alloc_.Malloc(kMinBlockSize));
+  EXPECT_EQ(offsets.back(), 2_MB);
+
+  // Keep only a few blocks on the first two pages, the second one becomes the one being filled
+  for (size_t i = 0; i < kBlocksInPage * 2; i++) {
+    if (i % kBlocksInPage >= 4)
+      EXPECT_FALSE(ext_alloc_.Free(offsets[i], kMinBlockSize));
+  }
+
+  EXPECT_FALSE(ext_alloc_.DrainIfUnderutilized(offsets[kBlocksInPage], 0.5));
+  EXPECT_FALSE(ext_alloc_.DrainIfUnderutilized(offsets[0], 0.01));
+  EXPECT_TRUE(ext_alloc_.DrainIfUnderutilized(offsets[0], 0.5));
+
+  // Draining page is not used for allocations
+  for (size_t i = 0; i < kBlocksInPage; i++)
+    EXPECT_GE(ext_alloc_.Malloc(kMinBlockSize), int64_t(1_MB));
+
+  // Freeing all remaining blocks makes the page unused
+  for (size_t i = 0; i < 3; i++)
+    EXPECT_FALSE(ext_alloc_.Free(offsets[i], kMinBlockSize));
+  auto page = ext_alloc_.Free(offsets[3], kMinBlockSize);
+  ASSERT_TRUE(page);
+  EXPECT_EQ(page->offset, 0u);
+  EXPECT_EQ(page->length, 1_MB);
+
+  // Reserved page is not handed out
+  EXPECT_TRUE(ext_alloc_.ReservePage(*page));
+  EXPECT_FALSE(ext_alloc_.ReservePage(*page));
+  EXPECT_GT(ext_alloc_.Malloc(16_KB), int64_t(1_MB));
+
+  ext_alloc_.UnreservePage(*page);
+  EXPECT_EQ(ext_alloc_.Malloc(32_KB), 0);
+}
+
 }  // namespace dfly::tiering
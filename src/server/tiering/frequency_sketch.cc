@@ -0,0 +1,93 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "server/tiering/frequency_sketch.h"
+
+#include <algorithm>
+
+#include "absl/numeric/bits.h"
+#include "base/logging.h"
+
+namespace dfly::tiering {
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t kSeeds[4] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+                                0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL};
+
+// Clears the bit that was shifted into each counter from its neighbour
+constexpr uint64_t kResetMask = 0x7777777777777777ULL;
+
+constexpr uint64_t kMaxCounter = 15;
+
+// Derive hash for i-th row of count-min sketch
+uint64_t Rehash(uint64_t hash, unsigned i) {
+  uint64_t h = (hash + kSeeds[i]) * kSeeds[i];
+  return h ^ (h >> 32);
+}
+
+}  // namespace
+
+FrequencySketch::FrequencySketch(size_t capacity) {
+  size_t words = absl::bit_ceil(max<size_t>(capacity, 64));
+  table_.resize(words);
+  doorkeeper_.resize(words / 4);  // 16 bits per key
+  sample_size_ = 10 * words;
+}
+
+void FrequencySketch::Touch(uint64_t hash) {
+  if (TestAndSetDoorkeeper(hash)) {
+    for (unsigned i = 0; i < 4; i++) {
+      uint64_t h = Rehash(hash, i);
+      uint64_t& word = table_[h & (table_.size() - 1)];
+      unsigned shift = (h >> 60) * 4;
+      if (((word >> shift) & kMaxCounter) < kMaxCounter)
+        word += 1ULL << shift;
+    }
+  }
+
+  if (++samples_ >= sample_size_)
+    Age();
+}
+
+unsigned FrequencySketch::Estimate(uint64_t hash) const {
+  // Counters are not gated by the doorkeeper, as it's cleared by aging while counters are only
+  // halved
+  uint64_t min_count = kMaxCounter;
+  for (unsigned i = 0; i < 4; i++) {
+    uint64_t h = Rehash(hash, i);
+    uint64_t word = table_[h & (table_.size() - 1)];
+    min_count = min(min_count, (word >> ((h >> 60) * 4)) & kMaxCounter);
+  }
+  return min_count + TestDoorkeeper(hash);
+}
+
+bool FrequencySketch::TestAndSetDoorkeeper(uint64_t hash) {
+  bool present = TestDoorkeeper(hash);
+  size_t mask = doorkeeper_.size() * 64 - 1;
+  for (uint64_t bit : {hash & mask, (hash >> 32) & mask})
+    doorkeeper_[bit / 64] |= 1ULL << (bit % 64);
+  return present;
+}
+
+bool FrequencySketch::TestDoorkeeper(uint64_t hash) const {
+  size_t mask = doorkeeper_.size() * 64 - 1;
+  for (uint64_t bit : {hash & mask, (hash >> 32) & mask}) {
+    if ((doorkeeper_[bit / 64] & (1ULL << (bit % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+void FrequencySketch::Age() {
+  DVLOG(1) << "Aging frequency sketch after " << samples_ << " samples";
+  for (uint64_t& word : table_)
+    word = (word >> 1) & kResetMask;
+  fill(doorkeeper_.begin(), doorkeeper_.end(), 0);
+  samples_ /= 2;
+}
+
+}  // namespace dfly::tiering
@@ -0,0 +1,49 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dfly::tiering {
+
+// Estimates how often keys were accessed recently, following TinyLFU:
+// - A doorkeeper bitmap absorbs keys that were seen only once, so the long tail of one-time
+//   accesses doesn't pollute the counters.
+// - A count-min sketch with 4-bit counters tracks repeated accesses.
+// - Once the number of recorded accesses reaches the sample size, all counters are halved and
+//   the doorkeeper is cleared, so estimates reflect recent popularity rather than all-time one.
+class FrequencySketch {
+ public:
+  static constexpr unsigned kMaxFrequency = 16;  // max counter value + doorkeeper bit
+
+  // capacity is the number of distinct keys that can be tracked with low error
+  explicit FrequencySketch(size_t capacity);
+
+  // Record access for key with given hash
+  void Touch(uint64_t hash);
+
+  // Returns estimated number of recent accesses, from 0 up to kMaxFrequency
+  unsigned Estimate(uint64_t hash) const;
+
+  size_t MallocUsed() const {
+    return (table_.capacity() + doorkeeper_.capacity()) * sizeof(uint64_t);
+  }
+
+ private:
+  // Returns true if hash was already present in the doorkeeper, otherwise adds it
+  bool TestAndSetDoorkeeper(uint64_t hash);
+  bool TestDoorkeeper(uint64_t hash) const;
+
+  // Halve all counters and clear doorkeeper
+  void Age();
+
+  std::vector<uint64_t> table_;       // 16 4-bit counters per word
+  std::vector<uint64_t> doorkeeper_;  // bitmap
+  size_t samples_ = 0, sample_size_ = 0;
+};
+
+}  // namespace dfly::tiering
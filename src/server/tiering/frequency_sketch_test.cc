@@ -0,0 +1,81 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "server/tiering/frequency_sketch.h"
+
+#include "base/gtest.h"
+#include "base/logging.h"
+
+namespace dfly::tiering {
+
+using namespace std;
+
+class FrequencySketchTest : public ::testing::Test {
+ protected:
+  // Spread sequential ids over the hash space
+  static uint64_t Hash(uint64_t id) {
+    return (id + 1) * 0x9e3779b97f4a7c15ULL;
+  }
+
+  FrequencySketch sketch_{1024};
+};
+
+TEST_F(FrequencySketchTest, Estimate) {
+  EXPECT_EQ(sketch_.Estimate(Hash(0)), 0u);
+
+  sketch_.Touch(Hash(0));
+  EXPECT_EQ(sketch_.Estimate(Hash(0)), 1u);
+
+  for (unsigned i = 0; i < 5; i++)
+    sketch_.Touch(Hash(0));
+  EXPECT_EQ(sketch_.Estimate(Hash(0)), 6u);
+
+  // Counters saturate
+  for (unsigned i = 0; i < 100; i++)
+    sketch_.Touch(Hash(0));
+  EXPECT_EQ(sketch_.Estimate(Hash(0)), FrequencySketch::kMaxFrequency);
+}
+
+TEST_F(FrequencySketchTest, HotAndCold) {
+  // Few hot keys accessed repeatedly among many keys accessed once
+  for (uint64_t i = 0; i < 1000; i++) {
+    sketch_.Touch(Hash(i % 10));
+    sketch_.Touch(Hash(100 + i));
+  }
+
+  unsigned cold_overestimates = 0;
+  for (uint64_t i = 0; i < 1000; i++)
+    cold_overestimates += sketch_.Estimate(Hash(100 + i)) > 2;
+
+  for (uint64_t i = 0; i < 10; i++)
+    EXPECT_GT(sketch_.Estimate(Hash(i)), 8u);
+  EXPECT_LT(cold_overestimates, 50u);
+}
+
+TEST_F(FrequencySketchTest, Aging) {
+  for (unsigned i = 0; i < 20; i++)
+    sketch_.Touch(Hash(0));
+  EXPECT_EQ(sketch_.Estimate(Hash(0)), FrequencySketch::kMaxFrequency);
+
+  // Other accesses eventually decay the counters of keys that are no longer accessed
+  for (uint64_t i = 0; i < 100'000; i++)
+    sketch_.Touch(Hash(1 + i % 5000));
+  EXPECT_LT(sketch_.Estimate(Hash(0)), 4u);
+}
+
+TEST_F(FrequencySketchTest, HotAcrossAging) {
+  for (unsigned i = 0; i < 20; i++)
+    sketch_.Touch(Hash(0));
+
+  // Keys accessed once fill up the sample of 10 accesses per counter word and trigger aging.
+  // It clears the doorkeeper, but counters of the hot key are only halved
+  for (uint64_t i = 1; i <= 10 * 1024 - 20; i++)
+    sketch_.Touch(Hash(i));
+  EXPECT_GE(sketch_.Estimate(Hash(0)), 7u);
+
+  sketch_.Touch(Hash(0));
+  EXPECT_GE(sketch_.Estimate(Hash(0)), 8u);
+}
+
+}  // namespace dfly::tiering
@@ -4,6 +4,7 @@
 
 #include "server/tiering/op_manager.h"
 
+#include <algorithm>
 #include <variant>
 
 #include "base/logging.h"
@@ -46,11 +47,42 @@ void OpManager::Close() {
   DCHECK(pending_reads_.empty());
 }
 
-void OpManager::Enqueue(EntryId id, DiskSegment segment, ReadCallback cb) {
+void OpManager::Enqueue(EntryId id, DiskSegment segment, ReadCallback cb, DecodeFn decode) {
   // Fill pages for prepared read as it has no penalty and potentially covers more small segments
-  PrepareRead(segment.ContainingPages())
-      .ForSegment(segment, id)
-      .callbacks.emplace_back(std::move(cb));
+  EntryOps& ops = PrepareRead(segment.ContainingPages()).ForSegment(segment, id);
+  ops.callbacks.emplace_back(std::move(cb));
+  if (decode && !ops.decode)
+    ops.decode = std::move(decode);
+}
+
+void OpManager::BeginReadBatch() {
+  read_batch_depth_++;
+}
+
+void OpManager::EndReadBatch() {
+  DCHECK_GT(read_batch_depth_, 0u);
+  if (--read_batch_depth_ > 0 || batched_reads_.empty())
+    return;
+
+  std::vector<size_t> offsets = std::move(batched_reads_);
+  batched_reads_.clear();
+  std::sort(offsets.begin(), offsets.end());
+
+  // Merge runs of reads that continue exactly where the previous one ended
+  for (size_t i = 0; i < offsets.size();) {
+    DiskSegment merged = pending_reads_.at(offsets[i]).segment;
+    size_t j = i + 1;
+    for (; j < offsets.size(); j++) {
+      DiskSegment next = pending_reads_.at(offsets[j]).segment;
+      if (next.offset != merged.offset + merged.length ||
+          merged.length + next.length > kMaxCoalescedRead)
+        break;
+      merged.length += next.length;
+    }
+
+    SubmitRead(merged, {offsets.begin() + i, offsets.begin() + j});
+    i = j;
+  }
 }
 
 void OpManager::Delete(EntryId id) {
@@ -59,6 +91,10 @@ void OpManager::Delete(EntryId id) {
   pending_stash_ver_.erase(ToOwned(id));
 }
 
+bool OpManager::IsPendingStash(EntryId id) const {
+  return pending_stash_ver_.contains(ToOwned(id));
+}
+
 void OpManager::DeleteOffloaded(DiskSegment segment) {
   EntryOps* pending_read = nullptr;
 
@@ -96,14 +132,25 @@ OpManager::ReadOp& OpManager::PrepareRead(DiskSegment aligned_segment) {
 
   auto [it, inserted] = pending_reads_.try_emplace(aligned_segment.offset, aligned_segment);
   if (inserted) {
-    auto io_cb = [this, aligned_segment](std::string_view value, std::error_code ec) {
-      ProcessRead(aligned_segment.offset, value);
-    };
-    storage_.Read(aligned_segment, io_cb);
+    if (read_batch_depth_ > 0)
+      batched_reads_.push_back(aligned_segment.offset);
+    else
+      SubmitRead(aligned_segment, {aligned_segment.offset});
   }
   return it->second;
 }
 
+void OpManager::SubmitRead(DiskSegment segment, std::vector<size_t> offsets) {
+  auto io_cb = [this, segment, offsets = std::move(offsets)](std::string_view value,
+                                                             std::error_code ec) {
+    for (size_t offset : offsets) {
+      size_t length = pending_reads_.at(offset).segment.length;
+      ProcessRead(offset, ec ? value : value.substr(offset - segment.offset, length));
+    }
+  };
+  storage_.Read(segment, std::move(io_cb));
+}
+
 void OpManager::ProcessStashed(EntryId id, unsigned version, DiskSegment segment,
                                std::error_code ec) {
   if (auto it = pending_stash_ver_.find(ToOwned(id));
@@ -138,6 +185,8 @@ void OpManager::ProcessRead(size_t offset, std::string_view value) {
   for (size_t i = 0; i < info->key_ops.size(); i++) {
     auto& ko = info->key_ops[i];
     key_value = value.substr(ko.segment.offset - info->segment.offset, ko.segment.length);
+    if (ko.decode)
+      ko.decode(&key_value);
 
     bool modified = false;
     for (auto& cb : ko.callbacks)
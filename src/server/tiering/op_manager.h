@@ -21,6 +21,9 @@ namespace dfly::tiering {
 // safely schedules deletes after reads and allows cancelling pending stashes
 class OpManager {
  public:
+  // Upper bound for the length of reads merged from adjacent pages within a read batch
+  static constexpr size_t kMaxCoalescedRead = 32 * kPageSize;
+
   struct Stats {
     DiskStorage::Stats disk_stats;
 
@@ -38,6 +41,9 @@ class OpManager {
   // Callback for post-read completion. Returns whether the value was modified
   using ReadCallback = std::function<bool(std::string*)>;
 
+  // Transforms stored blob into the value observed by read callbacks, i.e. decompresses it
+  using DecodeFn = std::function<void(std::string*)>;
+
   explicit OpManager(size_t max_size);
   virtual ~OpManager();
 
@@ -48,12 +54,24 @@ class OpManager {
 
   // Enqueue callback to be executed once value is read. Trigger read if none is pending yet for
   // this segment. Multiple entries can be obtained from a single segment, but every distinct id
-  // will have it's own independent callback loop that can safely modify the underlying value
-  void Enqueue(EntryId id, DiskSegment segment, ReadCallback cb);
+  // will have it's own independent callback loop that can safely modify the underlying value.
+  // If decode is set, it's applied once to the stored blob before any callbacks are run
+  void Enqueue(EntryId id, DiskSegment segment, ReadCallback cb, DecodeFn decode = {});
+
+  // Start collecting reads instead of submitting them immediately. Calls can be nested.
+  // Callbacks of reads enqueued within a batch are never run before EndReadBatch()
+  void BeginReadBatch();
+
+  // Submit reads collected since BeginReadBatch() ordered by offset, merging reads of adjacent
+  // pages into a single disk read
+  void EndReadBatch();
 
   // Delete entry with pending io
   void Delete(EntryId id);
 
+  // Returns true if entry has a pending stash
+  bool IsPendingStash(EntryId id) const;
+
   // Delete offloaded entry located at the segment.
   void DeleteOffloaded(DiskSegment segment);
 
@@ -84,6 +102,7 @@ class OpManager {
     OwnedEntryId id;
     DiskSegment segment;
     absl::InlinedVector<ReadCallback, 1> callbacks;
+    DecodeFn decode;
     bool deleting = false;
   };
 
@@ -106,6 +125,9 @@ class OpManager {
   // Refernce is valid until any other read operations occur.
   ReadOp& PrepareRead(DiskSegment aligned_segment);
 
+  // Issue disk read for segment spanning pending reads at given offsets
+  void SubmitRead(DiskSegment segment, std::vector<size_t> offsets);
+
   // Called once read finished
   void ProcessRead(size_t offset, std::string_view value);
 
@@ -117,6 +139,9 @@ class OpManager {
 
   absl::flat_hash_map<size_t /* offset */, ReadOp> pending_reads_;
 
+  unsigned read_batch_depth_ = 0;
+  std::vector<size_t> batched_reads_;  // offsets of reads delayed until batch end
+
   size_t pending_stash_counter_ = 0;
   // todo: allow heterogeneous lookups with non owned id
   absl::flat_hash_map<OwnedEntryId, unsigned /* version */> pending_stash_ver_;
@@ -169,4 +169,35 @@ TEST_F(OpManagerTest, Modify) {
   });
 }
 
+TEST_F(OpManagerTest, ReadBatch) {
+  pp_->at(0)->Await([this] {
+    Open();
+
+    for (unsigned i = 0; i < 100; i++)
+      EXPECT_FALSE(Stash(i, absl::StrCat("VALUE", i)));
+    while (stashed_.size() < 100)
+      util::ThisFiber::SleepFor(1ms);
+
+    // Issue reads in reverse order, they're submitted only when the batch ends
+    uint64_t disk_reads = GetStats().disk_stats.read_count;
+    BeginReadBatch();
+    std::vector<util::fb2::Future<std::string>> futures;
+    for (unsigned i = 100; i-- > 0;)
+      futures.emplace_back(Read(i, stashed_[i]));
+    EXPECT_EQ(GetStats().pending_read_cnt, 100u);
+    EndReadBatch();
+
+    // Reads of adjacent pages are merged
+    disk_reads = GetStats().disk_stats.read_count - disk_reads;
+    EXPECT_GT(disk_reads, 0u);
+    EXPECT_LT(disk_reads, 100u);
+
+    for (unsigned i = 0; i < 100; i++)
+      EXPECT_EQ(futures[i].Get(), absl::StrCat("VALUE", 99 - i));
+    EXPECT_EQ(GetStats().pending_read_cnt, 0u);
+
+    Close();
+  });
+}
+
 }  // namespace dfly::tiering
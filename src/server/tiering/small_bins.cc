@@ -180,13 +180,26 @@ SmallBins::Stats SmallBins::GetStats() const {
 }
 
 SmallBins::KeyHashDbList SmallBins::DeleteBin(DiskSegment segment, std::string_view value) {
-  DCHECK_EQ(value.size(), kPageSize);
-
   auto bin = stashed_bins_.extract(segment.offset);
   if (bin.empty())
     return {};
 
   stats_.stashed_entries_cnt -= bin.mapped().entries;
+  return ParseBin(segment, value);
+}
+
+SmallBins::KeyHashDbList SmallBins::MoveBin(DiskSegment from, DiskSegment to,
+                                            std::string_view value) {
+  auto bin = stashed_bins_.extract(from.offset);
+  if (bin.empty())
+    return {};
+
+  stashed_bins_[to.offset] = bin.mapped();
+  return ParseBin(from, value);
+}
+
+SmallBins::KeyHashDbList SmallBins::ParseBin(DiskSegment segment, std::string_view value) {
+  DCHECK_EQ(value.size(), kPageSize);
 
   const char* data = value.data();
 
@@ -68,12 +68,20 @@ class SmallBins {
   // Mainly used for defragmentation
   KeyHashDbList DeleteBin(DiskSegment segment, std::string_view value);
 
+  // Move stashed bin to a new page, once its value was copied there for compaction. Returns list
+  // of item key hashes and db indices with their segments on the previous page, or an empty list
+  // if the bin no longer exists
+  KeyHashDbList MoveBin(DiskSegment from, DiskSegment to, std::string_view value);
+
   Stats GetStats() const;
 
  private:
   // Flush current bin
   FilledBin FlushBin();
 
+  // Recover item key hashes and db indices from bin stored at segment
+  static KeyHashDbList ParseBin(DiskSegment segment, std::string_view value);
+
  private:
   struct StashInfo {
     uint8_t entries = 0;
@@ -10,6 +10,7 @@
 
 #include "base/gtest.h"
 #include "base/logging.h"
+#include "core/compact_object.h"
 #include "server/tiering/disk_storage.h"
 
 namespace dfly::tiering {
@@ -100,6 +101,35 @@ TEST_F(SmallBinsTest, PartialStashDelete) {
   }
 }
 
+TEST_F(SmallBinsTest, MoveBin) {
+  // Fill single bin
+  std::optional<SmallBins::FilledBin> bin;
+  for (unsigned i = 0; !bin; i++)
+    bin = bins_.Stash(0, absl::StrCat("k", i), absl::StrCat("v", i));
+
+  auto segments = bins_.ReportStashed(bin->first, DiskSegment{0, 4_KB});
+  string page = bin->second;
+  page.resize(4_KB);
+
+  // Recovered segments are on the previous page, deletes refer to the new one
+  auto moved = bins_.MoveBin(DiskSegment{0, 4_KB}, DiskSegment{8_KB, 4_KB}, page);
+  ASSERT_EQ(moved.size(), segments.size());
+  for (auto [dbid, hash, segment] : moved) {
+    auto it = find_if(segments.begin(), segments.end(),
+                      [segment = segment](const auto& entry) { return get<2>(entry) == segment; });
+    ASSERT_NE(it, segments.end());
+    EXPECT_EQ(hash, CompactObj::HashCode(get<1>(*it)));
+  }
+
+  EXPECT_TRUE(bins_.MoveBin(DiskSegment{0, 4_KB}, DiskSegment{8_KB, 4_KB}, page).empty());
+  for (size_t i = 0; i < segments.size(); i++) {
+    auto [dbid, key, segment] = segments[i];
+    auto info = bins_.Delete(DiskSegment{segment.offset + 8_KB, segment.length});
+    EXPECT_EQ(info.segment.ContainingPages().offset, 8_KB);
+    EXPECT_EQ(info.empty, i + 1 == segments.size());
+  }
+}
+
 TEST_F(SmallBinsTest, UpdateStatsAfterDelete) {
   // caused https://github.com/dragonflydb/dragonfly/issues/3240
   for (unsigned i = 0; i < 10; i++) {
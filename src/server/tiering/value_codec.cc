@@ -0,0 +1,149 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "server/tiering/value_codec.h"
+
+extern "C" {
+#include "redis/intset.h"
+#include "redis/listpack.h"
+#include "redis/quicklist.h"
+#include "redis/redis_aux.h"
+#include "redis/zmalloc.h"
+}
+
+#include "absl/base/internal/endian.h"
+#include "base/flags.h"
+#include "base/logging.h"
+
+ABSL_DECLARE_FLAG(int32_t, list_max_listpack_size);
+ABSL_DECLARE_FLAG(int32_t, list_compress_depth);
+
+namespace dfly::tiering {
+
+using namespace std;
+
+namespace {
+
+constexpr size_t kQlNodeHeaderSize = 1 /* container */ + 4 /* length */;
+
+// Returns pointer and size of blob for containers stored as a single allocation
+string_view ContiguousBlob(const CompactObj& pv) {
+  uint8_t* ptr = reinterpret_cast<uint8_t*>(pv.RObjPtr());
+  switch (pv.ObjType()) {
+    case OBJ_HASH:
+    case OBJ_ZSET:
+      return {reinterpret_cast<char*>(ptr), lpBytes(ptr)};
+    case OBJ_SET:
+      return {reinterpret_cast<char*>(ptr), intsetBlobLen(reinterpret_cast<intset*>(ptr))};
+  }
+  LOG(DFATAL) << "Unsupported type " << pv.ObjType();
+  return {};
+}
+
+uint8_t* CopyToMalloc(string_view blob) {
+  uint8_t* ptr = reinterpret_cast<uint8_t*>(zmalloc(blob.size()));
+  memcpy(ptr, blob.data(), blob.size());
+  return ptr;
+}
+
+}  // namespace
+
+bool IsSerializable(const CompactObj& pv) {
+  switch (pv.ObjType()) {
+    case OBJ_STRING:
+      return true;
+    case OBJ_HASH:
+      return pv.Encoding() == kEncodingListPack;
+    case OBJ_ZSET:
+      return pv.Encoding() == OBJ_ENCODING_LISTPACK;
+    case OBJ_SET:
+      return pv.Encoding() == kEncodingIntSet;
+    case OBJ_LIST: {
+      if (pv.Encoding() != OBJ_ENCODING_QUICKLIST)
+        return false;
+
+      // Compressed nodes would need to be decompressed first, skip them for now
+      const quicklist* ql = reinterpret_cast<const quicklist*>(pv.RObjPtr());
+      for (const quicklistNode* node = ql->head; node; node = node->next) {
+        if (node->encoding != QUICKLIST_NODE_ENCODING_RAW)
+          return false;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t SerializedSize(const CompactObj& pv) {
+  DCHECK(IsSerializable(pv));
+  switch (pv.ObjType()) {
+    case OBJ_STRING:
+      return pv.Size();
+    case OBJ_LIST: {
+      size_t total = 0;
+      const quicklist* ql = reinterpret_cast<const quicklist*>(pv.RObjPtr());
+      for (const quicklistNode* node = ql->head; node; node = node->next)
+        total += kQlNodeHeaderSize + node->sz;
+      return total;
+    }
+  }
+  return ContiguousBlob(pv).size();
+}
+
+string_view Serialize(const CompactObj& pv, string* scratch) {
+  DCHECK(IsSerializable(pv));
+  switch (pv.ObjType()) {
+    case OBJ_STRING:
+      return pv.GetSlice(scratch);
+    case OBJ_LIST: {
+      scratch->resize(SerializedSize(pv));
+      char* next = scratch->data();
+
+      const quicklist* ql = reinterpret_cast<const quicklist*>(pv.RObjPtr());
+      for (const quicklistNode* node = ql->head; node; node = node->next) {
+        *next++ = node->container;
+        absl::little_endian::Store32(next, node->sz);
+        next += sizeof(uint32_t);
+        memcpy(next, node->entry, node->sz);
+        next += node->sz;
+      }
+      return *scratch;
+    }
+  }
+  return ContiguousBlob(pv);
+}
+
+void Deserialize(unsigned obj_type, unsigned encoding, string_view blob, CompactObj* pv) {
+  switch (obj_type) {
+    case OBJ_STRING:
+      pv->SetCompressibleString(blob);
+      return;
+    case OBJ_HASH:
+    case OBJ_ZSET:
+    case OBJ_SET:
+      pv->InitRobj(obj_type, encoding, CopyToMalloc(blob));
+      return;
+    case OBJ_LIST: {
+      quicklist* ql = quicklistNew(absl::GetFlag(FLAGS_list_max_listpack_size),
+                                   absl::GetFlag(FLAGS_list_compress_depth));
+      while (!blob.empty()) {
+        DCHECK_GE(blob.size(), kQlNodeHeaderSize);
+        unsigned container = blob[0];
+        size_t len = absl::little_endian::Load32(blob.data() + 1);
+        uint8_t* node = CopyToMalloc(blob.substr(kQlNodeHeaderSize, len));
+        blob.remove_prefix(kQlNodeHeaderSize + len);
+
+        if (container == QUICKLIST_NODE_CONTAINER_PLAIN)
+          quicklistAppendPlainNode(ql, node, len);
+        else
+          quicklistAppendListpack(ql, node);
+      }
+      pv->InitRobj(OBJ_LIST, encoding, ql);
+      return;
+    }
+  }
+  LOG(DFATAL) << "Unsupported type " << obj_type;
+}
+
+}  // namespace dfly::tiering
@@ -0,0 +1,32 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "core/compact_object.h"
+
+namespace dfly::tiering {
+
+// Conversion of in-memory values to and from the flat blobs stored by tiered storage.
+// Strings are stored as is. Containers are supported only for compact encodings that are already
+// stored as contiguous blobs (same as in RDB): listpack hashes and sorted sets, intsets and
+// quicklists with uncompressed nodes. Quicklists are stored as a sequence of
+// [1 byte container][4 byte length][node blob] records.
+
+// Returns true if the value has an encoding that can be serialized for offloading
+bool IsSerializable(const CompactObj& pv);
+
+// Returns size of serialized representation, pv must be serializable
+size_t SerializedSize(const CompactObj& pv);
+
+// Serialize value. Returned view points either into the value itself or into scratch
+std::string_view Serialize(const CompactObj& pv, std::string* scratch);
+
+// Restore value of given type and encoding from its serialized representation
+void Deserialize(unsigned obj_type, unsigned encoding, std::string_view blob, CompactObj* pv);
+
+}  // namespace dfly::tiering
@@ -16,6 +16,7 @@
 #include "server/engine_shard_set.h"
 #include "server/journal/journal.h"
 #include "server/server_state.h"
+#include "server/tiered_storage.h"
 
 ABSL_FLAG(uint32_t, tx_queue_warning_len, 96,
           "Length threshold for warning about long transaction queue");
@@ -170,6 +171,7 @@ void Transaction::InitBase(DbIndex dbid, CmdArgList args) {
   global_ = false;
   db_index_ = dbid;
   full_args_ = args;
+  key_step_ = 1;
   local_result_ = OpStatus::OK;
   stats_.coordinator_index = ProactorBase::me() ? ProactorBase::me()->GetPoolIndex() : kInvalidSid;
 }
@@ -283,6 +285,7 @@ void Transaction::InitByKeys(const KeyIndex& key_index) {
   }
 
   DCHECK_LT(key_index.start, full_args_.size());
+  key_step_ = key_index.step;
 
   // Stub transactions always operate only on single shard.
   bool is_stub = multi_ && multi_->role == SQUASHED_STUB;
@@ -433,8 +436,10 @@ void Transaction::StartMultiLockedAhead(DbIndex dbid, CmdArgList keys, bool skip
   InitBase(dbid, keys);
   InitByKeys(KeyIndex::Range(0, keys.size()));
 
-  if (!skip_scheduling)
+  if (!skip_scheduling) {
     ScheduleInternal();
+    LoadOffloadedContainers();
+  }
 
   full_args_ = {nullptr, 0};  // InitBase set it to temporary keys, now we reset it.
 }
@@ -758,6 +763,42 @@ void Transaction::ScheduleInternal() {
   }
 }
 
+void Transaction::LoadOffloadedContainers() {
+  bool any = false;
+  IterateActiveShards([&any](const auto& sd, ShardId i) { any |= sd.local_mask & LOAD_OFFLOADED; });
+  if (!any)
+    return;
+
+  auto should_load = [this](ShardId i) {
+    return IsActive(i) && (shard_data_[SidToId(i)].local_mask & LOAD_OFFLOADED);
+  };
+
+  // Shards load in parallel, each one blocking only on its own keys
+  auto cb = [this](EngineShard* shard) {
+    DbSlice& db_slice = shard->db_slice();
+    IterateShardKeys(shard->shard_id(),
+                     [&](string_view key) { db_slice.LoadOffloadedContainer(db_index_, key); });
+    shard_data_[SidToId(shard->shard_id())].local_mask &= ~LOAD_OFFLOADED;
+  };
+  shard_set->RunBlockingInParallel(std::move(cb), should_load);
+}
+
+void Transaction::IterateShardKeys(ShardId sid, absl::FunctionRef<void(string_view)> f) const {
+  const IndexSlice* slices = args_slices_.data();
+  size_t slice_count = args_slices_.size();
+  if (unique_shard_cnt_ != 1) {
+    const auto& sd = shard_data_[sid];
+    slices += sd.slice_start;
+    slice_count = sd.slice_count;
+  }
+
+  // Slices always start with a key, values (if any) follow every key
+  for (size_t i = 0; i < slice_count; i++) {
+    for (uint32_t k = slices[i].first; k < slices[i].second; k += key_step_)
+      f(ArgS(full_args_, k));
+  }
+}
+
 void Transaction::ReportWritesSquashedMulti(absl::FunctionRef<bool(ShardId)> had_write) {
   DCHECK(multi_);
   for (unsigned i = 0; i < multi_->shard_journal_write.size(); i++)
@@ -832,6 +873,7 @@ void Transaction::Execute(RunnableType cb, bool conclude) {
 
   if ((coordinator_state_ & COORD_SCHED) == 0) {
     ScheduleInternal();
+    LoadOffloadedContainers();
   }
 
   DispatchHop();
@@ -1047,7 +1089,7 @@ bool Transaction::ScheduleInShard(EngineShard* shard, bool can_run_immediately)
 
   DCHECK(sd.local_mask & ACTIVE);
   DCHECK_EQ(sd.local_mask & KEYLOCK_ACQUIRED, 0);
-  sd.local_mask &= ~(OUT_OF_ORDER | RAN_IMMEDIATELY);
+  sd.local_mask &= ~(OUT_OF_ORDER | RAN_IMMEDIATELY | LOAD_OFFLOADED);
 
   TxQueue* txq = shard->txq();
   KeyLockArgs lock_args;
@@ -1063,6 +1105,19 @@ bool Transaction::ScheduleInShard(EngineShard* shard, bool can_run_immediately)
     lock_args = GetLockArgs(shard->shard_id());
     bool shard_unlocked = shard->shard_lock()->Check(mode);
 
+    // Offloaded containers are loaded by the coordinator once the keys are locked (see
+    // LoadOffloadedContainers), so the transaction can't run during scheduling
+    if (auto* ts = shard->tiered_storage(); ts && ts->HasOffloadedContainers()) {
+      bool offloaded = false;
+      IterateShardKeys(shard->shard_id(), [&](string_view key) {
+        offloaded |= shard->db_slice().IsOffloadedContainer(db_index_, key);
+      });
+      if (offloaded) {
+        sd.local_mask |= LOAD_OFFLOADED;
+        can_run_immediately = false;
+      }
+    }
+
     // Check if we can run immediately
     if (shard_unlocked && can_run_immediately && CheckLocks(shard->db_slice(), mode, lock_args)) {
       sd.local_mask |= RAN_IMMEDIATELY;
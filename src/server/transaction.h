@@ -167,6 +167,7 @@ class Transaction {
     AWAKED_Q = 1 << 5,         // Whether it was awakened (by NotifySuspended())
     UNLOCK_MULTI = 1 << 6,     // Whether this shard executed UnlockMultiShardCb
     RAN_IMMEDIATELY = 1 << 7,  // Whether the shard executed immediately (during schedule)
+    LOAD_OFFLOADED = 1 << 8,   // Whether some keys hold offloaded containers (set by schedule)
   };
 
   explicit Transaction(const CommandId* cid);
@@ -512,6 +513,14 @@ class Transaction {
 
   void ScheduleInternal();
 
+  // Load offloaded containers of keys back to memory on shards marked with LOAD_OFFLOADED, as
+  // callbacks can't block on loading them while they hold iterators. Runs after scheduling, when
+  // the keys are locked and can't be offloaded again
+  void LoadOffloadedContainers();
+
+  // Call f for every key (but not value) argument of the shard. Called from shard thread.
+  void IterateShardKeys(ShardId sid, absl::FunctionRef<void(std::string_view)> f) const;
+
   // Schedule on shards transaction queue. Returns true if scheduled successfully,
   // false if inconsistent order was detected and the schedule needs to be cancelled.
   bool ScheduleInShard(EngineShard* shard, bool can_run_immediately);
@@ -614,6 +623,9 @@ class Transaction {
   // Stores the full undivided command.
   CmdArgList full_args_;
 
+  // Distance between keys in args slices, i.e. 2 for MSET where each key is followed by a value.
+  unsigned key_step_ = 1;
+
   // Set if a NO_AUTOJOURNAL command asked to enable auto journal again
   bool re_enabled_auto_journal_ = false;
 